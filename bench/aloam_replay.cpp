@@ -0,0 +1,404 @@
+// Replays a bag through FeatureExtractor -> AloamOdometry -> AloamMapping as fast as the pipeline processes it.
+// Reports the latency percentiles of the stages, the throughput and the peak memory, and writes the estimated trajectories in the TUM format
+// (stamp x y z qx qy qz qw) for the accuracy regression. The parameters are loaded as by the nodelet (see launch/replay.launch).
+
+/* includes //{ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+
+#include <pcl_conversions/pcl_conversions.h>
+
+#include <tf2/buffer_core.h>
+#include <tf2_msgs/TFMessage.h>
+
+#include "aloam_slam/feature_extractor.h"
+#include "aloam_slam/odometry.h"
+#include "aloam_slam/mapping.h"
+#include "aloam_slam/frame_observer.h"
+
+//}
+
+using namespace aloam_slam;
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// indexed by PipelineStage
+const char *STAGE_NAMES[] = {"feature extraction", "odometry", "mapping"};
+
+/*//{ frameKey() */
+// the odometry and the mapping report the stamp of the pcl header (microseconds), the frames are identified by the stamp rounded the same way
+ros::Time frameKey(const ros::Time &stamp) {
+  std::uint64_t pcl_stamp;
+  pcl_conversions::toPCL(stamp, pcl_stamp);
+  ros::Time key;
+  pcl_conversions::fromPCL(pcl_stamp, key);
+  return key;
+}
+/*//}*/
+
+/*//{ class ReplayObserver */
+// collects the per-frame reports of the stages, every replayed frame ends either dropped by a stage or finished by the mapping
+class ReplayObserver : public FrameObserver {
+
+public:
+  /*//{ onFrameFed() */
+  void onFrameFed(const ros::Time &stamp) {
+    std::scoped_lock lock(_mutex);
+    _time_fed[frameKey(stamp)] = Clock::now();
+    _frames_fed++;
+  }
+  /*//}*/
+
+  /*//{ onStageFinished() */
+  void onStageFinished(const PipelineStage stage, const ros::Time &stamp, const double duration_ms) override {
+    std::scoped_lock lock(_mutex);
+    _durations_ms[int(stage)].push_back(duration_ms);
+
+    if (stage == PipelineStage::MAPPING) {
+      const auto it = _time_fed.find(frameKey(stamp));
+      if (it != _time_fed.end()) {
+        _end_to_end_ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - it->second).count());
+        _time_fed.erase(it);
+      }
+      _frames_finished++;
+      _cv.notify_all();
+    }
+  }
+  /*//}*/
+
+  /*//{ onFrameDropped() */
+  void onFrameDropped(const PipelineStage stage, const ros::Time &stamp) override {
+    std::scoped_lock lock(_mutex);
+    _time_fed.erase(frameKey(stamp));
+    _frames_dropped[int(stage)]++;
+    _cv.notify_all();
+  }
+  /*//}*/
+
+  /*//{ onPose() */
+  void onPose(const PipelineStage stage, const ros::Time &stamp, const tf::Transform &tf_fcu) override {
+    std::scoped_lock lock(_mutex);
+    if (stage == PipelineStage::ODOMETRY) {
+      _trajectory_odometry.emplace_back(stamp, tf_fcu);
+    } else if (stage == PipelineStage::MAPPING) {
+      _trajectory_mapping.emplace_back(stamp, tf_fcu);
+    }
+  }
+  /*//}*/
+
+  /*//{ waitForPipeline() */
+  // blocks until all fed frames left the pipeline
+  void waitForPipeline() {
+    std::unique_lock lock(_mutex);
+    while (ros::ok() && _frames_finished + framesDropped() < _frames_fed) {
+      _cv.wait_for(lock, std::chrono::milliseconds(100));
+    }
+  }
+  /*//}*/
+
+  /*//{ report() */
+  void report(const double wall_time_sec, const double bag_time_sec) {
+    std::scoped_lock lock(_mutex);
+
+    printf("\nframes: %lu replayed, %lu mapped, dropped %lu/%lu/%lu (feature extraction/odometry/mapping)\n", _frames_fed, _frames_finished,
+           _frames_dropped[0], _frames_dropped[1], _frames_dropped[2]);
+    printf("wall time: %.2f s (bag %.2f s, %.2fx real time), throughput: %.2f Hz\n", wall_time_sec, bag_time_sec,
+           wall_time_sec > 0.0 ? bag_time_sec / wall_time_sec : 0.0, wall_time_sec > 0.0 ? _frames_finished / wall_time_sec : 0.0);
+
+    printf("\n%-20s %8s %9s %9s %9s %9s %9s\n", "latency [ms]", "frames", "mean", "p50", "p90", "p99", "max");
+    for (int s = 0; s < 3; s++) {
+      printStats(STAGE_NAMES[s], _durations_ms[s]);
+    }
+    printStats("end to end", _end_to_end_ms);
+    if (_end_to_end_ms.size() != _frames_finished) {
+      printf("warning: %lu end to end samples of %lu mapped frames, the stamps reported by the stages do not match the replayed ones\n",
+             _end_to_end_ms.size(), _frames_finished);
+    }
+  }
+  /*//}*/
+
+  /*//{ writeTrajectory() */
+  bool writeTrajectory(const PipelineStage stage, const std::string &path) {
+    std::scoped_lock lock(_mutex);
+    const auto &     trajectory = stage == PipelineStage::MAPPING ? _trajectory_mapping : _trajectory_odometry;
+
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) {
+      return false;
+    }
+    for (const auto &[stamp, pose] : trajectory) {
+      const tf::Vector3    &t = pose.getOrigin();
+      const tf::Quaternion &q = pose.getRotation();
+      fprintf(file, "%.9f %.6f %.6f %.6f %.9f %.9f %.9f %.9f\n", stamp.toSec(), t.x(), t.y(), t.z(), q.x(), q.y(), q.z(), q.w());
+    }
+    return fclose(file) == 0;
+  }
+  /*//}*/
+
+private:
+  std::mutex              _mutex;
+  std::condition_variable _cv;
+
+  unsigned long _frames_fed        = 0;
+  unsigned long _frames_finished   = 0;
+  unsigned long _frames_dropped[3] = {0, 0, 0};
+
+  std::map<ros::Time, Clock::time_point> _time_fed;
+  std::vector<double>                    _durations_ms[3];
+  std::vector<double>                    _end_to_end_ms;
+
+  std::vector<std::pair<ros::Time, tf::Transform>> _trajectory_odometry;
+  std::vector<std::pair<ros::Time, tf::Transform>> _trajectory_mapping;
+
+  /*//{ framesDropped() */
+  unsigned long framesDropped() const {
+    return _frames_dropped[0] + _frames_dropped[1] + _frames_dropped[2];
+  }
+  /*//}*/
+
+  /*//{ printStats() */
+  static void printStats(const char *name, std::vector<double> values) {
+    if (values.empty()) {
+      printf("%-20s %8d\n", name, 0);
+      return;
+    }
+
+    std::sort(values.begin(), values.end());
+    double sum = 0.0;
+    for (const double v : values) {
+      sum += v;
+    }
+
+    // nearest-rank percentile
+    const auto percentile = [&values](const double p) {
+      const std::size_t rank = std::size_t(std::ceil(p / 100.0 * values.size()));
+      return values.at(std::clamp(rank, std::size_t(1), values.size()) - 1);
+    };
+
+    printf("%-20s %8lu %9.2f %9.2f %9.2f %9.2f %9.2f\n", name, values.size(), sum / values.size(), percentile(50), percentile(90), percentile(99),
+           values.back());
+  }
+  /*//}*/
+};
+/*//}*/
+
+/*//{ lookupStaticTf() */
+// transform of the lidar in the fcu frame from the TF messages recorded in the bag
+bool lookupStaticTf(rosbag::Bag &bag, const std::string &frame_fcu, const std::string &frame_lidar, tf::Transform &tf_lidar_in_fcu) {
+  tf2::BufferCore buffer;
+
+  rosbag::View view(bag, rosbag::TopicQuery(std::vector<std::string>{"/tf_static", "/tf"}));
+  for (const rosbag::MessageInstance &m : view) {
+    const tf2_msgs::TFMessage::ConstPtr msg = m.instantiate<tf2_msgs::TFMessage>();
+    if (!msg) {
+      continue;
+    }
+    const bool is_static = m.getTopic() == "/tf_static";
+    for (const auto &transform : msg->transforms) {
+      buffer.setTransform(transform, "bag", is_static);
+    }
+
+    if (buffer.canTransform(frame_lidar, frame_fcu, ros::Time(0))) {
+      break;
+    }
+  }
+
+  try {
+    const geometry_msgs::TransformStamped tf_msg = buffer.lookupTransform(frame_lidar, frame_fcu, ros::Time(0));
+    tf::transformMsgToTF(tf_msg.transform, tf_lidar_in_fcu);
+    return true;
+  }
+  catch (const tf2::TransformException &) {
+    return false;
+  }
+}
+/*//}*/
+
+/*//{ peakMemoryMiB() */
+double peakMemoryMiB() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0;  // [KiB] on Linux
+}
+/*//}*/
+
+}  // namespace
+
+/*//{ main() */
+int main(int argc, char **argv) {
+  ros::init(argc, argv, "aloam_replay");
+  ros::NodeHandle nh("~");
+
+  // every frame is processed, the producer waits for the next stage instead of dropping frames
+  nh.setParam("odometry/queue/policy", std::string("block"));
+  nh.setParam("mapping/queue/policy", std::string("block"));
+
+  mrs_lib::ParamLoader param_loader(nh, "AloamReplay");
+
+  const auto bag_path                 = param_loader.loadParam2<std::string>("replay/bag");
+  auto       points_topic             = param_loader.loadParam2<std::string>("replay/points_topic");
+  auto       orientation_topic        = param_loader.loadParam2<std::string>("replay/orientation_topic", std::string(""));
+  const auto trajectory_file          = param_loader.loadParam2<std::string>("replay/trajectory_file", std::string(""));
+  const auto odometry_trajectory_file = param_loader.loadParam2<std::string>("replay/odometry_trajectory_file", std::string(""));
+  const auto max_frames               = param_loader.loadParam2<int>("replay/max_frames", 0);
+
+  std::string uav_name;
+  std::string frame_fcu;
+  std::string frame_lidar;
+  std::string frame_odom;
+  std::string frame_map;
+  float       frequency;
+  bool        verbose;
+  param_loader.loadParam("uav_name", uav_name);
+  param_loader.loadParam("lidar_frame", frame_lidar);
+  param_loader.loadParam("fcu_frame", frame_fcu);
+  param_loader.loadParam("odom_frame", frame_odom);
+  param_loader.loadParam("map_frame", frame_map);
+  param_loader.loadParam("sensor_frequency", frequency, -1.0f);
+  param_loader.loadParam("verbose", verbose, false);
+
+  if (verbose && ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME, ros::console::levels::Debug)) {
+    ros::console::notifyLoggerLevelsChanged();
+  }
+
+  LatencyControllerOptions latency_options;
+  param_loader.loadParam("latency_control/enable", latency_options.enable, latency_options.enable);
+  param_loader.loadParam("latency_control/budget", latency_options.budget_ms, latency_options.budget_ms);
+  param_loader.loadParam("latency_control/gain", latency_options.gain, latency_options.gain);
+  param_loader.loadParam("latency_control/deadband", latency_options.deadband, latency_options.deadband);
+  param_loader.loadParam("latency_control/smoothing", latency_options.smoothing, latency_options.smoothing);
+  param_loader.loadParam("latency_control/min_feature_ratio", latency_options.min_feature_ratio, latency_options.min_feature_ratio);
+  param_loader.loadParam("latency_control/max_resolution_ratio", latency_options.max_resolution_ratio, latency_options.max_resolution_ratio);
+  param_loader.loadParam("latency_control/min_neighborhood_xy", latency_options.min_neighborhood_xy, latency_options.min_neighborhood_xy);
+
+  if (!param_loader.loadedSuccessfully()) {
+    ROS_ERROR("[AloamReplay]: Could not load all parameters!");
+    return 1;
+  }
+
+  rosbag::Bag bag;
+  try {
+    bag.open(bag_path, rosbag::bagmode::Read);
+  }
+  catch (const rosbag::BagException &e) {
+    ROS_ERROR("[AloamReplay]: Cannot open bag %s: %s", bag_path.c_str(), e.what());
+    return 1;
+  }
+
+  tf::Transform tf_lidar_in_fcu = tf::Transform::getIdentity();
+  if (!lookupStaticTf(bag, frame_fcu, frame_lidar, tf_lidar_in_fcu)) {
+    ROS_WARN("[AloamReplay]: Transform from %s to %s is not in the bag, using identity.", frame_fcu.c_str(), frame_lidar.c_str());
+  }
+
+  // | ----------------------- SLAM handlers  ------------------- |
+
+  const auto profiler           = std::make_shared<mrs_lib::Profiler>(nh, "AloamReplay", false);
+  const auto scope_timer_logger = std::make_shared<mrs_lib::ScopeTimerLogger>("", false);
+  const auto latency_controller = std::make_shared<LatencyController>(latency_options);
+  const auto observer           = std::make_shared<ReplayObserver>();
+
+  auto aloam_mapping     = std::make_shared<AloamMapping>(nh, param_loader, profiler, frame_fcu, frame_map, tf_lidar_in_fcu, latency_controller,
+                                                      SharedWorkers(), false, scope_timer_logger);
+  auto aloam_odometry    = std::make_shared<AloamOdometry>(nh, param_loader, uav_name, profiler, aloam_mapping, frame_fcu, frame_lidar, frame_odom,
+                                                        1.0f / frequency, tf_lidar_in_fcu, SharedWorkers(), false, scope_timer_logger);
+  auto feature_extractor = std::make_shared<FeatureExtractor>(nh, param_loader, profiler, aloam_odometry, frame_map, 1.0f / frequency, tf_lidar_in_fcu,
+                                                              latency_controller, "laser_cloud_in", false, scope_timer_logger);
+
+  if (!param_loader.loadedSuccessfully()) {
+    ROS_ERROR("[AloamReplay]: Could not load all parameters!");
+    return 1;
+  }
+
+  aloam_mapping->loadStartupMap(false);
+
+  aloam_mapping->setFrameObserver(observer);
+  aloam_odometry->setFrameObserver(observer);
+  feature_extractor->setFrameObserver(observer);
+
+  aloam_mapping->is_initialized     = true;
+  aloam_odometry->is_initialized    = true;
+  feature_extractor->is_initialized = true;
+
+  // | ------------------------- replay ------------------------- |
+
+  // the topics are recorded with the leading slash
+  const auto absoluteTopic = [](const std::string &topic) { return topic.empty() || topic.front() == '/' ? topic : "/" + topic; };
+  points_topic             = absoluteTopic(points_topic);
+  orientation_topic        = absoluteTopic(orientation_topic);
+
+  std::vector<std::string> topics = {points_topic};
+  if (!orientation_topic.empty()) {
+    topics.push_back(orientation_topic);
+  }
+  rosbag::View view(bag, rosbag::TopicQuery(topics));
+
+  ROS_INFO("[AloamReplay]: Replaying %u messages of %s.", view.size(), bag_path.c_str());
+
+  const auto time_start = Clock::now();
+  ros::Time  stamp_first;
+  ros::Time  stamp_last;
+  int        frames = 0;
+
+  for (const rosbag::MessageInstance &m : view) {
+    if (!ros::ok() || (max_frames > 0 && frames >= max_frames)) {
+      break;
+    }
+
+    if (m.getTopic() == points_topic) {
+      const sensor_msgs::PointCloud2::ConstPtr msg = m.instantiate<sensor_msgs::PointCloud2>();
+      if (!msg) {
+        continue;
+      }
+      if (frames++ == 0) {
+        stamp_first = msg->header.stamp;
+      }
+      stamp_last = msg->header.stamp;
+
+      observer->onFrameFed(msg->header.stamp);
+      feature_extractor->processCloud(msg);
+    } else {
+      const nav_msgs::Odometry::ConstPtr msg = m.instantiate<nav_msgs::Odometry>();
+      if (msg) {
+        feature_extractor->processOrientation(msg);
+      }
+    }
+  }
+
+  observer->waitForPipeline();
+  const double wall_time_sec = std::chrono::duration<double>(Clock::now() - time_start).count();
+
+  // joins the threads of the stages
+  feature_extractor.reset();
+  aloam_odometry.reset();
+  aloam_mapping.reset();
+  bag.close();
+
+  observer->report(wall_time_sec, (stamp_last - stamp_first).toSec());
+  printf("peak memory: %.1f MiB\n", peakMemoryMiB());
+
+  if (!trajectory_file.empty() && !observer->writeTrajectory(PipelineStage::MAPPING, trajectory_file)) {
+    ROS_ERROR("[AloamReplay]: Cannot write the trajectory to %s.", trajectory_file.c_str());
+  }
+  if (!odometry_trajectory_file.empty() && !observer->writeTrajectory(PipelineStage::ODOMETRY, odometry_trajectory_file)) {
+    ROS_ERROR("[AloamReplay]: Cannot write the odometry trajectory to %s.", odometry_trajectory_file.c_str());
+  }
+
+  return 0;
+}
+/*//}*/
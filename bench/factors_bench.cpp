@@ -0,0 +1,126 @@
+// Compares the autodiff and analytic-Jacobian lidar factors: agreement of residuals and Jacobians and evaluation time.
+
+#include <chrono>
+#include <random>
+#include <memory>
+#include <vector>
+#include <cstdio>
+
+#include "aloam_slam/lidarFactor.hpp"
+
+namespace
+{
+
+const int N_FACTORS = 10000;
+const int N_REPEATS = 20;
+
+/*//{ struct Stats */
+struct Stats
+{
+  double max_residual_error = 0.0;
+  double max_jacobian_error = 0.0;
+  double time_autodiff_us   = 0.0;
+  double time_analytic_us   = 0.0;
+};
+/*//}*/
+
+/*//{ compare() */
+// evaluates both sets of cost functions at the same parameters and measures the time per evaluation
+Stats compare(const std::vector<std::unique_ptr<ceres::CostFunction>> &autodiff, const std::vector<std::unique_ptr<ceres::CostFunction>> &analytic,
+              const double *q, const double *t) {
+  Stats stats;
+
+  const int num_residuals = autodiff.front()->num_residuals();
+
+  std::vector<double> residuals_autodiff(num_residuals), residuals_analytic(num_residuals);
+  std::vector<double> jac_q_autodiff(num_residuals * 4), jac_q_analytic(num_residuals * 4);
+  std::vector<double> jac_t_autodiff(num_residuals * 3), jac_t_analytic(num_residuals * 3);
+
+  const double *parameters[2]         = {q, t};
+  double *      jacobians_autodiff[2] = {jac_q_autodiff.data(), jac_t_autodiff.data()};
+  double *      jacobians_analytic[2] = {jac_q_analytic.data(), jac_t_analytic.data()};
+
+  for (std::size_t i = 0; i < autodiff.size(); i++) {
+    autodiff.at(i)->Evaluate(parameters, residuals_autodiff.data(), jacobians_autodiff);
+    analytic.at(i)->Evaluate(parameters, residuals_analytic.data(), jacobians_analytic);
+
+    for (int r = 0; r < num_residuals; r++) {
+      stats.max_residual_error = std::max(stats.max_residual_error, std::abs(residuals_autodiff.at(r) - residuals_analytic.at(r)));
+    }
+    for (int j = 0; j < num_residuals * 4; j++) {
+      stats.max_jacobian_error = std::max(stats.max_jacobian_error, std::abs(jac_q_autodiff.at(j) - jac_q_analytic.at(j)));
+    }
+    for (int j = 0; j < num_residuals * 3; j++) {
+      stats.max_jacobian_error = std::max(stats.max_jacobian_error, std::abs(jac_t_autodiff.at(j) - jac_t_analytic.at(j)));
+    }
+  }
+
+  const auto measure = [&](const std::vector<std::unique_ptr<ceres::CostFunction>> &factors, double *residuals, double **jacobians) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int k = 0; k < N_REPEATS; k++) {
+      for (const auto &factor : factors) {
+        factor->Evaluate(parameters, residuals, jacobians);
+      }
+    }
+    const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / double(N_REPEATS * factors.size());
+  };
+
+  stats.time_autodiff_us = measure(autodiff, residuals_autodiff.data(), jacobians_autodiff);
+  stats.time_analytic_us = measure(analytic, residuals_analytic.data(), jacobians_analytic);
+
+  return stats;
+}
+/*//}*/
+
+/*//{ print() */
+void print(const char *name, const Stats &stats) {
+  printf("%-22s max |dr| %.3e  max |dJ| %.3e  autodiff %.3f us  analytic %.3f us  speedup %.2fx\n", name, stats.max_residual_error,
+         stats.max_jacobian_error, stats.time_autodiff_us, stats.time_analytic_us, stats.time_autodiff_us / stats.time_analytic_us);
+}
+/*//}*/
+
+}  // namespace
+
+/*//{ main() */
+int main() {
+  std::mt19937                           generator(0);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+  const auto randomPoint = [&](const double scale) { return Eigen::Vector3d(uniform(generator), uniform(generator), uniform(generator)) * scale; };
+
+  const Eigen::Quaterniond q_pose(Eigen::AngleAxisd(0.2, randomPoint(1.0).normalized()));
+  const Eigen::Vector3d    t_pose = randomPoint(1.0);
+  const double             q[4]   = {q_pose.x(), q_pose.y(), q_pose.z(), q_pose.w()};
+  const double             t[3]   = {t_pose.x(), t_pose.y(), t_pose.z()};
+
+  for (const double s : {1.0, 0.5}) {
+    std::vector<std::unique_ptr<ceres::CostFunction>> edge_autodiff, edge_analytic;
+    std::vector<std::unique_ptr<ceres::CostFunction>> plane_autodiff, plane_analytic;
+    std::vector<std::unique_ptr<ceres::CostFunction>> plane_norm_autodiff, plane_norm_analytic;
+
+    for (int i = 0; i < N_FACTORS; i++) {
+      const Eigen::Vector3d cp = randomPoint(20.0);
+      const Eigen::Vector3d a  = cp + randomPoint(0.5);
+      const Eigen::Vector3d b  = cp + randomPoint(0.5);
+      const Eigen::Vector3d c  = cp + randomPoint(0.5);
+      const Eigen::Vector3d n  = randomPoint(1.0).normalized();
+      const double          d  = -n.dot(a);
+
+      edge_autodiff.emplace_back(LidarEdgeFactor::Create(cp, a, b, s));
+      edge_analytic.emplace_back(LidarEdgeAnalyticFactor::Create(cp, a, b, s));
+      plane_autodiff.emplace_back(LidarPlaneFactor::Create(cp, a, b, c, s));
+      plane_analytic.emplace_back(LidarPlaneAnalyticFactor::Create(cp, a, b, c, s));
+      plane_norm_autodiff.emplace_back(LidarPlaneNormFactor::Create(cp, n, d));
+      plane_norm_analytic.emplace_back(LidarPlaneNormAnalyticFactor::Create(cp, n, d));
+    }
+
+    printf("s = %.2f\n", s);
+    print("LidarEdgeFactor", compare(edge_autodiff, edge_analytic, q, t));
+    print("LidarPlaneFactor", compare(plane_autodiff, plane_analytic, q, t));
+    print("LidarPlaneNormFactor", compare(plane_norm_autodiff, plane_norm_analytic, q, t));
+  }
+
+  return 0;
+}
+/*//}*/
@@ -0,0 +1,789 @@
+// Micro-benchmarks of the hot kernels of the pipeline in isolation: the curvature and the feature selection of the feature extractor, the scan-line
+// correspondence search of the odometry, the 5-NN search with the line/plane fitting of the mapping, the voxel grid downsampling, the batch point
+// transforms and the evaluation of the lidar factors.
+// The scans are ray-cast in a synthetic room with pillars for 16, 64 and 128 rings. A recorded scan is benchmarked as well when
+// ALOAM_BENCH_PCD is set to a PCD file (x, y, z), its points are assigned to ALOAM_BENCH_PCD_RINGS (default 64) rings by their elevation.
+
+/* includes //{ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <pcl/io/pcd_io.h>
+#include <pcl/common/transforms.h>
+
+#include "aloam_slam/common.h"
+#include "aloam_slam/feature_cloud.h"
+#include "aloam_slam/feature_selection.h"
+#include "aloam_slam/scan_line_search.h"
+#include "aloam_slam/correspondences.h"
+#include "aloam_slam/batched_factor.h"
+#include "aloam_slam/transform_kernels.h"
+
+//}
+
+using namespace aloam_slam;
+
+namespace
+{
+
+const float  SCAN_PERIOD      = 0.1f;  // [s]
+const int    RECORDED_SCAN    = 0;     // the "rings" argument of the benchmarks on the recorded scan
+const int    MAP_SCANS        = 5;     // scans accumulated in the map of the mapping benchmarks
+const float  RESOLUTION_LINE  = 0.2f;  // mapping/line_resolution
+const float  RESOLUTION_PLANE = 0.4f;  // mapping/plane_resolution
+const double HUBER_LOSS       = 0.1;
+
+/*//{ struct Scan */
+// cloud ordered by the rings as produced by the parsing of FeatureExtractor
+struct Scan
+{
+  FeatureCloud               cloud;
+  std::vector<int>           rows_start_indices;
+  std::vector<int>           rows_end_indices;
+};
+/*//}*/
+
+/*//{ struct ScanFeatures */
+struct ScanFeatures
+{
+  pcl::PointCloud<PointType>::Ptr corner_points_sharp      = boost::make_shared<pcl::PointCloud<PointType>>();
+  pcl::PointCloud<PointType>::Ptr corner_points_less_sharp = boost::make_shared<pcl::PointCloud<PointType>>();
+  pcl::PointCloud<PointType>::Ptr surf_points_flat         = boost::make_shared<pcl::PointCloud<PointType>>();
+  pcl::PointCloud<PointType>::Ptr surf_points_less_flat    = boost::make_shared<pcl::PointCloud<PointType>>();
+  FeatureChannels                 corner_channels_sharp;
+  FeatureChannels                 corner_channels_less_sharp;
+  FeatureChannels                 surf_channels_flat;
+  FeatureChannels                 surf_channels_less_flat;
+};
+/*//}*/
+
+/*//{ scanPose() */
+// pose of the k-th scan in the world, the sensor moves forward and turns slowly
+Eigen::Isometry3d scanPose(const int k) {
+  Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+  pose.translate(Eigen::Vector3d(0.5 * k, 0.1 * k, 0.0));
+  pose.rotate(Eigen::AngleAxisd(deg2rad(1.0 * k), Eigen::Vector3d::UnitZ()));
+  return pose;
+}
+/*//}*/
+
+/*//{ castRay() */
+// distance to the first surface of the synthetic room (the sensor is 1.5 m above the floor), returns false if there is none
+bool castRay(const Eigen::Vector3d &origin, const Eigen::Vector3d &direction, double &range) {
+  const Eigen::Vector3d room_min(-20.0, -12.0, -1.5);
+  const Eigen::Vector3d room_max(20.0, 12.0, 6.5);
+
+  range = std::numeric_limits<double>::max();
+  for (int a = 0; a < 3; a++) {
+    if (std::fabs(direction(a)) > 1e-9) {
+      const double t = ((direction(a) > 0.0 ? room_max(a) : room_min(a)) - origin(a)) / direction(a);
+      if (t > 0.0) {
+        range = std::min(range, t);
+      }
+    }
+  }
+
+  // vertical pillars of 0.3 m radius
+  const double pillars[][2] = {{6.0, 4.0}, {6.0, -4.0}, {-6.0, 4.0}, {-6.0, -4.0}, {0.0, 8.0}, {0.0, -8.0}, {12.0, 0.0}, {-12.0, 0.0}};
+  const double a            = direction.x() * direction.x() + direction.y() * direction.y();
+  if (a > 1e-12) {
+    for (const auto &pillar : pillars) {
+      const double ox = origin.x() - pillar[0];
+      const double oy = origin.y() - pillar[1];
+      const double b  = 2.0 * (ox * direction.x() + oy * direction.y());
+      const double c  = ox * ox + oy * oy - 0.3 * 0.3;
+      const double d  = b * b - 4.0 * a * c;
+      if (d >= 0.0) {
+        const double t = (-b - std::sqrt(d)) / (2.0 * a);
+        if (t > 0.0) {
+          range = std::min(range, t);
+        }
+      }
+    }
+  }
+
+  return range < 100.0;
+}
+/*//}*/
+
+/*//{ appendPoint() */
+void appendPoint(const Eigen::Vector3d &point, const int ring, const float time, Scan &scan) {
+  const std::size_t i = scan.cloud.size();
+  scan.cloud.resize(i + 1);
+  scan.cloud.set(i, float(point.x()), float(point.y()), float(point.z()), ring, time);
+}
+/*//}*/
+
+/*//{ finishScan() */
+// sets the row indices of a cloud ordered by the rings, the first and the last 5 points of a ring have no curvature
+void finishScan(const std::vector<int> &ring_offsets, Scan &scan) {
+  const int rings = int(ring_offsets.size()) - 1;
+  scan.rows_start_indices.resize(rings);
+  scan.rows_end_indices.resize(rings);
+  for (int r = 0; r < rings; r++) {
+    scan.rows_start_indices.at(r) = ring_offsets.at(r) + 5;
+    scan.rows_end_indices.at(r)   = ring_offsets.at(r + 1) - 6;
+  }
+}
+/*//}*/
+
+/*//{ syntheticScan() */
+Scan syntheticScan(const int rings, const Eigen::Isometry3d &pose) {
+  const int    columns   = rings <= 16 ? 1800 : 1024;
+  const double vfov      = deg2rad(rings <= 16 ? 30.0 : rings <= 64 ? 33.2 : 45.0);
+  const double elevation = -vfov / 2.0;
+
+  std::mt19937                     generator(rings);
+  std::normal_distribution<double> noise(0.0, 0.005);
+
+  Scan             scan;
+  std::vector<int> ring_offsets = {0};
+  scan.cloud.scan_period_sec    = SCAN_PERIOD;
+  for (int r = 0; r < rings; r++) {
+    const double el = elevation + vfov * r / double(rings - 1);
+    for (int c = 0; c < columns; c++) {
+      const double          az = 2.0 * M_PI * c / double(columns);
+      const Eigen::Vector3d direction(std::cos(el) * std::cos(az), std::cos(el) * std::sin(az), std::sin(el));
+
+      double range;
+      if (!castRay(pose.translation(), pose.linear() * direction, range)) {
+        continue;
+      }
+
+      appendPoint(direction * (range + noise(generator)), r, float(c) / float(columns), scan);
+    }
+    ring_offsets.push_back(int(scan.cloud.size()));
+  }
+
+  finishScan(ring_offsets, scan);
+  return scan;
+}
+/*//}*/
+
+/*//{ recordedScan() */
+// the recorded scan seen from the pose relative to the pose it was recorded in, the rings are spread uniformly over the elevations of the points
+bool recordedScan(const Eigen::Isometry3d &pose, Scan &scan) {
+  const char *path = std::getenv("ALOAM_BENCH_PCD");
+  if (!path) {
+    return false;
+  }
+  const char *rings_env = std::getenv("ALOAM_BENCH_PCD_RINGS");
+  const int   rings     = rings_env ? std::max(std::atoi(rings_env), 2) : 64;
+
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  if (pcl::io::loadPCDFile(path, cloud) != 0 || cloud.empty()) {
+    return false;
+  }
+
+  std::vector<double> elevations, azimuths;
+  double              el_min = M_PI, el_max = -M_PI;
+  for (const auto &p : cloud.points) {
+    const double el = std::atan2(p.z, std::hypot(p.x, p.y));
+    elevations.push_back(el);
+    azimuths.push_back(std::atan2(p.y, p.x) + M_PI);
+    el_min = std::min(el_min, el);
+    el_max = std::max(el_max, el);
+  }
+
+  // points ordered by the ring and by the azimuth
+  std::vector<std::pair<int, double>> keys(cloud.size());
+  std::vector<std::size_t>            order(cloud.size());
+  for (std::size_t i = 0; i < cloud.size(); i++) {
+    const int ring = int(std::round((elevations.at(i) - el_min) / std::max(el_max - el_min, 1e-6) * (rings - 1)));
+    keys.at(i)     = {ring, azimuths.at(i)};
+    order.at(i)    = i;
+  }
+  std::sort(order.begin(), order.end(), [&keys](const std::size_t a, const std::size_t b) { return keys.at(a) < keys.at(b); });
+
+  const Eigen::Isometry3d pose_inv     = pose.inverse();
+  std::vector<int>        ring_offsets = {0};
+  scan.cloud.scan_period_sec           = SCAN_PERIOD;
+  for (const std::size_t i : order) {
+    while (int(ring_offsets.size()) - 1 < keys.at(i).first) {
+      ring_offsets.push_back(int(scan.cloud.size()));
+    }
+    const Eigen::Vector3d point = pose_inv * Eigen::Vector3d(cloud.points.at(i).x, cloud.points.at(i).y, cloud.points.at(i).z);
+    appendPoint(point, keys.at(i).first, std::min(float(keys.at(i).second / (2.0 * M_PI)), 1.0f - 1e-6f), scan);
+  }
+  while (int(ring_offsets.size()) <= rings) {
+    ring_offsets.push_back(int(scan.cloud.size()));
+  }
+
+  finishScan(ring_offsets, scan);
+  return true;
+}
+/*//}*/
+
+/*//{ getScan() */
+// the k-th scan of the sequence, cached between the benchmarks
+const Scan &getScan(const int rings, const int k) {
+  static std::map<std::pair<int, int>, std::unique_ptr<Scan>> scans;
+
+  auto &scan = scans[{rings, k}];
+  if (!scan) {
+    scan = std::make_unique<Scan>();
+    if (rings == RECORDED_SCAN) {
+      recordedScan(scanPose(k), *scan);
+    } else {
+      *scan = syntheticScan(rings, scanPose(k));
+    }
+  }
+  return *scan;
+}
+/*//}*/
+
+/*//{ getFeatures() */
+const ScanFeatures &getFeatures(const int rings, const int k) {
+  static std::map<std::pair<int, int>, std::unique_ptr<ScanFeatures>> features;
+
+  auto &f = features[{rings, k}];
+  if (!f) {
+    f = std::make_unique<ScanFeatures>();
+
+    const Scan &    scan  = getScan(rings, k);
+    FeatureCloud    cloud = scan.cloud;
+    FeatureSelector selector;
+    selector.computeCurvature(cloud);
+    selector.selectFeatures(cloud, scan.rows_start_indices, scan.rows_end_indices, FeatureSelectionParams(), *f->corner_points_sharp,
+                            *f->corner_points_less_sharp, *f->surf_points_flat, *f->surf_points_less_flat, f->corner_channels_sharp,
+                            f->corner_channels_less_sharp, f->surf_channels_flat, f->surf_channels_less_flat);
+  }
+  return *f;
+}
+/*//}*/
+
+/*//{ downsample() */
+pcl::PointCloud<PointType>::Ptr downsample(const pcl::PointCloud<PointType>::Ptr &cloud, const float resolution) {
+  pcl::VoxelGrid<PointType> filter;
+  filter.setLeafSize(resolution, resolution, resolution);
+  filter.setInputCloud(cloud);
+
+  const pcl::PointCloud<PointType>::Ptr cloud_ds = boost::make_shared<pcl::PointCloud<PointType>>();
+  filter.filter(*cloud_ds);
+  return cloud_ds;
+}
+/*//}*/
+
+/*//{ struct MapFixture */
+// local map of the mapping built from the first MAP_SCANS scans and the downsampled features of the next scan associated to it
+struct MapFixture
+{
+  pcl::PointCloud<PointType>::Ptr corners = boost::make_shared<pcl::PointCloud<PointType>>();
+  pcl::PointCloud<PointType>::Ptr surfs   = boost::make_shared<pcl::PointCloud<PointType>>();
+  pcl::KdTreeFLANN<PointType>     kdtree_corners;
+  pcl::KdTreeFLANN<PointType>     kdtree_surfs;
+
+  pcl::PointCloud<PointType>::Ptr frame_corners;
+  pcl::PointCloud<PointType>::Ptr frame_surfs;
+  Eigen::Isometry3d               frame_pose;
+
+  explicit MapFixture(const int rings) {
+    for (int k = 0; k < MAP_SCANS; k++) {
+      const ScanFeatures &features = getFeatures(rings, k);
+      const Eigen::Matrix4f      pose = scanPose(k).matrix().cast<float>();
+      pcl::PointCloud<PointType> corners_world, surfs_world;
+      pcl::transformPointCloud(*features.corner_points_less_sharp, corners_world, pose);
+      pcl::transformPointCloud(*features.surf_points_less_flat, surfs_world, pose);
+      *corners += corners_world;
+      *surfs += surfs_world;
+    }
+    corners = downsample(corners, RESOLUTION_LINE);
+    surfs   = downsample(surfs, RESOLUTION_PLANE);
+    kdtree_corners.setInputCloud(corners);
+    kdtree_surfs.setInputCloud(surfs);
+
+    const ScanFeatures &features = getFeatures(rings, MAP_SCANS);
+    frame_corners                = downsample(features.corner_points_less_sharp, RESOLUTION_LINE);
+    frame_surfs                  = downsample(features.surf_points_less_flat, RESOLUTION_PLANE);
+    frame_pose                   = scanPose(MAP_SCANS);
+  }
+};
+/*//}*/
+
+/*//{ getMap() */
+const MapFixture &getMap(const int rings) {
+  static std::map<int, std::unique_ptr<MapFixture>> maps;
+
+  auto &map = maps[rings];
+  if (!map) {
+    map = std::make_unique<MapFixture>(rings);
+  }
+  return *map;
+}
+/*//}*/
+
+/*//{ associateToMap() */
+template <typename CorrespondenceT, typename FitT>
+void associateToMap(const pcl::KdTreeFLANN<PointType> &kdtree, const pcl::PointCloud<PointType> &map, const pcl::PointCloud<PointType> &frame,
+                    const Eigen::Isometry3d &pose, const FitT &fit, std::vector<CorrespondenceT> &correspondences) {
+  std::vector<int>       point_search_indices;
+  std::vector<float>     point_search_sq_dist;
+  std::vector<PointType> point_search_neighbors;
+
+  for (const PointType &point_ori : frame.points) {
+    const Eigen::Vector3d curr_point(point_ori.x, point_ori.y, point_ori.z);
+    const Eigen::Vector3d point_w = pose * curr_point;
+    PointType             point_sel;
+    point_sel.x         = float(point_w.x());
+    point_sel.y         = float(point_w.y());
+    point_sel.z         = float(point_w.z());
+    point_sel.intensity = point_ori.intensity;
+
+    if (kdtree.nearestKSearch(point_sel, 5, point_search_indices, point_search_sq_dist) < 5 || point_search_sq_dist.at(4) >= 1.0) {
+      continue;
+    }
+    point_search_neighbors.clear();
+    for (const int ind : point_search_indices) {
+      point_search_neighbors.push_back(map.points.at(ind));
+    }
+
+    CorrespondenceT corr;
+    if (fit(curr_point, point_search_neighbors, corr)) {
+      correspondences.push_back(corr);
+    }
+  }
+}
+/*//}*/
+
+/*//{ odometryCorrespondences() */
+void odometryCorrespondences(const int rings, std::vector<EdgeCorrespondence> &edges, std::vector<PlaneCorrespondence> &planes) {
+  const ScanFeatures &last = getFeatures(rings, 0);
+  const ScanFeatures &curr = getFeatures(rings, 1);
+
+  pcl::KdTreeFLANN<PointType> kdtree_corners, kdtree_surfs;
+  kdtree_corners.setInputCloud(last.corner_points_less_sharp);
+  kdtree_surfs.setInputCloud(last.surf_points_less_flat);
+  ScanLineIndex index_corners, index_surfs;
+  index_corners.build(*last.corner_points_less_sharp, last.corner_channels_less_sharp);
+  index_surfs.build(*last.surf_points_less_flat, last.surf_channels_less_flat);
+
+  const Eigen::Isometry3d  pose = scanPose(1);
+  const Eigen::Quaterniond q_last_curr(pose.linear());
+  const Eigen::Vector3d    t_last_curr(pose.translation());
+  MotionBins motion;
+  motion.sample(q_last_curr, t_last_curr, ScanLineSearchParams());
+  findEdgeCorrespondences(kdtree_corners, index_corners, *curr.corner_points_sharp, curr.corner_channels_sharp, motion, ScanLineSearchParams(), 0,
+                          curr.corner_points_sharp->size(), edges);
+  findPlaneCorrespondences(kdtree_surfs, index_surfs, *curr.surf_points_flat, curr.surf_channels_flat, motion, ScanLineSearchParams(), 0,
+                           curr.surf_points_flat->size(), planes);
+}
+/*//}*/
+
+/*//{ hasScan() */
+// the recorded scan is skipped when it is not given
+bool hasScan(benchmark::State &state, const int rings) {
+  if (getScan(rings, 0).cloud.size() < 11) {
+    state.SkipWithError("no scan (set ALOAM_BENCH_PCD)");
+    return false;
+  }
+  return true;
+}
+/*//}*/
+
+}  // namespace
+
+/*//{ Feature extraction */
+
+static void BM_Curvature(benchmark::State &state) {
+  const int rings = int(state.range(0));
+  if (!hasScan(state, rings)) {
+    return;
+  }
+  const Scan &scan = getScan(rings, 0);
+
+  FeatureCloud    cloud = scan.cloud;
+  FeatureSelector selector;
+  for (auto _ : state) {
+    selector.computeCurvature(cloud);
+    benchmark::DoNotOptimize(cloud.curvature.data());
+  }
+  state.SetItemsProcessed(state.iterations() * scan.cloud.size());
+}
+
+// the curvature is computed in every iteration as it also resets the selection buffers
+static void BM_CurvatureAndSelection(benchmark::State &state) {
+  const int rings = int(state.range(0));
+  if (!hasScan(state, rings)) {
+    return;
+  }
+  const Scan &scan = getScan(rings, 0);
+
+  FeatureCloud    cloud = scan.cloud;
+  FeatureSelector selector;
+  ScanFeatures    features;
+  for (auto _ : state) {
+    features.corner_points_sharp->clear();
+    features.corner_points_less_sharp->clear();
+    features.surf_points_flat->clear();
+    features.surf_points_less_flat->clear();
+    features.corner_channels_sharp.clear();
+    features.corner_channels_less_sharp.clear();
+    features.surf_channels_flat.clear();
+    features.surf_channels_less_flat.clear();
+
+    selector.computeCurvature(cloud);
+    selector.selectFeatures(cloud, scan.rows_start_indices, scan.rows_end_indices, FeatureSelectionParams(), *features.corner_points_sharp,
+                            *features.corner_points_less_sharp, *features.surf_points_flat, *features.surf_points_less_flat,
+                            features.corner_channels_sharp, features.corner_channels_less_sharp, features.surf_channels_flat,
+                            features.surf_channels_less_flat);
+  }
+  state.SetItemsProcessed(state.iterations() * scan.cloud.size());
+  state.counters["sharp"]     = features.corner_points_sharp->size();
+  state.counters["less_flat"] = features.surf_points_less_flat->size();
+}
+
+static void BM_VoxelGrid(benchmark::State &state) {
+  const int rings = int(state.range(0));
+  if (!hasScan(state, rings)) {
+    return;
+  }
+  const float                           resolution = float(state.range(1)) / 100.0f;
+  const pcl::PointCloud<PointType>::Ptr cloud      = boost::make_shared<pcl::PointCloud<PointType>>();
+  getScan(rings, 0).cloud.toPointCloud(*cloud);
+
+  pcl::VoxelGrid<PointType> filter;
+  filter.setLeafSize(resolution, resolution, resolution);
+  pcl::PointCloud<PointType> cloud_ds;
+  for (auto _ : state) {
+    filter.setInputCloud(cloud);
+    filter.filter(cloud_ds);
+  }
+  state.SetItemsProcessed(state.iterations() * cloud->size());
+  state.counters["output"] = cloud_ds.size();
+}
+
+// the full-resolution scan transformed to the map (the features of the mapping are transformed by the same kernel in every iteration)
+static void BM_TransformPoints(benchmark::State &state) {
+  const int rings = int(state.range(0));
+  if (!hasScan(state, rings)) {
+    return;
+  }
+  pcl::PointCloud<PointType> cloud;
+  getScan(rings, 0).cloud.toPointCloud(cloud);
+
+  const Eigen::Isometry3d    pose      = scanPose(1);
+  const Eigen::Matrix4f      transform = toTransform(Eigen::Quaterniond(pose.linear()), pose.translation());
+  pcl::PointCloud<PointType> cloud_w;
+  for (auto _ : state) {
+    transformPoints(cloud, transform, cloud_w);
+    benchmark::DoNotOptimize(cloud_w.points.data());
+  }
+  state.SetItemsProcessed(state.iterations() * cloud.size());
+}
+
+/*//}*/
+
+/*//{ Odometry */
+
+static void BM_OdometryEdgeSearch(benchmark::State &state) {
+  const int rings = int(state.range(0));
+  if (!hasScan(state, rings)) {
+    return;
+  }
+  const ScanFeatures &last = getFeatures(rings, 0);
+  const ScanFeatures &curr = getFeatures(rings, 1);
+
+  pcl::KdTreeFLANN<PointType> kdtree;
+  kdtree.setInputCloud(last.corner_points_less_sharp);
+  ScanLineIndex index;
+  index.build(*last.corner_points_less_sharp, last.corner_channels_less_sharp);
+
+  const Eigen::Isometry3d  pose = scanPose(1);
+  const Eigen::Quaterniond q_last_curr(pose.linear());
+  const Eigen::Vector3d    t_last_curr(pose.translation());
+
+  MotionBins motion;
+  motion.sample(q_last_curr, t_last_curr, ScanLineSearchParams());
+
+  std::vector<EdgeCorrespondence> correspondences;
+  for (auto _ : state) {
+    correspondences.clear();
+    findEdgeCorrespondences(kdtree, index, *curr.corner_points_sharp, curr.corner_channels_sharp, motion, ScanLineSearchParams(), 0,
+                            curr.corner_points_sharp->size(), correspondences);
+  }
+  state.SetItemsProcessed(state.iterations() * curr.corner_points_sharp->size());
+  state.counters["matched"] = correspondences.size();
+}
+
+// the points are transformed by the share of the motion of their time bin, the bins are sampled by every iteration of the odometry
+static void BM_OdometryEdgeSearchDistortion(benchmark::State &state) {
+  const int rings = int(state.range(0));
+  if (!hasScan(state, rings)) {
+    return;
+  }
+  const ScanFeatures &last = getFeatures(rings, 0);
+  const ScanFeatures &curr = getFeatures(rings, 1);
+
+  pcl::KdTreeFLANN<PointType> kdtree;
+  kdtree.setInputCloud(last.corner_points_less_sharp);
+  ScanLineIndex index;
+  index.build(*last.corner_points_less_sharp, last.corner_channels_less_sharp);
+
+  const Eigen::Isometry3d  pose = scanPose(1);
+  const Eigen::Quaterniond q_last_curr(pose.linear());
+  const Eigen::Vector3d    t_last_curr(pose.translation());
+
+  ScanLineSearchParams params;
+  params.distortion = true;
+
+  MotionBins                      motion;
+  std::vector<EdgeCorrespondence> correspondences;
+  for (auto _ : state) {
+    correspondences.clear();
+    motion.sample(q_last_curr, t_last_curr, params);
+    findEdgeCorrespondences(kdtree, index, *curr.corner_points_sharp, curr.corner_channels_sharp, motion, params, 0,
+                            curr.corner_points_sharp->size(), correspondences);
+  }
+  state.SetItemsProcessed(state.iterations() * curr.corner_points_sharp->size());
+  state.counters["matched"] = correspondences.size();
+}
+
+static void BM_OdometryPlaneSearch(benchmark::State &state) {
+  const int rings = int(state.range(0));
+  if (!hasScan(state, rings)) {
+    return;
+  }
+  const ScanFeatures &last = getFeatures(rings, 0);
+  const ScanFeatures &curr = getFeatures(rings, 1);
+
+  pcl::KdTreeFLANN<PointType> kdtree;
+  kdtree.setInputCloud(last.surf_points_less_flat);
+  ScanLineIndex index;
+  index.build(*last.surf_points_less_flat, last.surf_channels_less_flat);
+
+  const Eigen::Isometry3d  pose = scanPose(1);
+  const Eigen::Quaterniond q_last_curr(pose.linear());
+  const Eigen::Vector3d    t_last_curr(pose.translation());
+
+  MotionBins motion;
+  motion.sample(q_last_curr, t_last_curr, ScanLineSearchParams());
+
+  std::vector<PlaneCorrespondence> correspondences;
+  for (auto _ : state) {
+    correspondences.clear();
+    findPlaneCorrespondences(kdtree, index, *curr.surf_points_flat, curr.surf_channels_flat, motion, ScanLineSearchParams(), 0,
+                             curr.surf_points_flat->size(), correspondences);
+  }
+  state.SetItemsProcessed(state.iterations() * curr.surf_points_flat->size());
+  state.counters["matched"] = correspondences.size();
+}
+
+// the kd-trees and the ring indices of the previous features are rebuilt by every odometry frame
+static void BM_OdometryIndexBuild(benchmark::State &state) {
+  const int rings = int(state.range(0));
+  if (!hasScan(state, rings)) {
+    return;
+  }
+  const ScanFeatures &last = getFeatures(rings, 0);
+
+  ScanLineIndex index_corners, index_surfs;
+  for (auto _ : state) {
+    pcl::KdTreeFLANN<PointType> kdtree_corners, kdtree_surfs;
+    kdtree_corners.setInputCloud(last.corner_points_less_sharp);
+    kdtree_surfs.setInputCloud(last.surf_points_less_flat);
+    index_corners.build(*last.corner_points_less_sharp, last.corner_channels_less_sharp);
+    index_surfs.build(*last.surf_points_less_flat, last.surf_channels_less_flat);
+  }
+  state.SetItemsProcessed(state.iterations() * (last.corner_points_less_sharp->size() + last.surf_points_less_flat->size()));
+}
+
+/*//}*/
+
+/*//{ Mapping */
+
+static void BM_MappingEdgeFit(benchmark::State &state) {
+  const int rings = int(state.range(0));
+  if (!hasScan(state, rings)) {
+    return;
+  }
+  const MapFixture &map = getMap(rings);
+
+  std::vector<EdgeCorrespondence> correspondences;
+  for (auto _ : state) {
+    correspondences.clear();
+    associateToMap(map.kdtree_corners, *map.corners, *map.frame_corners, map.frame_pose, fitEdgeCorrespondence, correspondences);
+  }
+  state.SetItemsProcessed(state.iterations() * map.frame_corners->size());
+  state.counters["matched"] = correspondences.size();
+}
+
+static void BM_MappingPlaneFit(benchmark::State &state) {
+  const int rings = int(state.range(0));
+  if (!hasScan(state, rings)) {
+    return;
+  }
+  const MapFixture &map = getMap(rings);
+
+  std::vector<PlaneNormCorrespondence> correspondences;
+  for (auto _ : state) {
+    correspondences.clear();
+    associateToMap(map.kdtree_surfs, *map.surfs, *map.frame_surfs, map.frame_pose, fitPlaneCorrespondence, correspondences);
+  }
+  state.SetItemsProcessed(state.iterations() * map.frame_surfs->size());
+  state.counters["matched"] = correspondences.size();
+}
+
+// the local map kd-trees are rebuilt by every mapping frame unless the incremental index is used
+static void BM_MappingKdTreeBuild(benchmark::State &state) {
+  const int rings = int(state.range(0));
+  if (!hasScan(state, rings)) {
+    return;
+  }
+  const MapFixture &map = getMap(rings);
+
+  for (auto _ : state) {
+    pcl::KdTreeFLANN<PointType> kdtree_corners, kdtree_surfs;
+    kdtree_corners.setInputCloud(map.corners);
+    kdtree_surfs.setInputCloud(map.surfs);
+  }
+  state.SetItemsProcessed(state.iterations() * (map.corners->size() + map.surfs->size()));
+}
+
+/*//}*/
+
+/*//{ Factors */
+
+// evaluates the residuals and the Jacobians of all correspondences of the frame by the factor type given by the second argument
+template <typename CorrespondenceT>
+void evaluateFactors(benchmark::State &state, const std::vector<CorrespondenceT> &correspondences, const Eigen::Isometry3d &pose) {
+  const FactorType         type = FactorType(state.range(1));
+  const Eigen::Quaterniond q_pose(pose.linear());
+  const double             q[4]          = {q_pose.x(), q_pose.y(), q_pose.z(), q_pose.w()};
+  const double             t[3]          = {pose.translation().x(), pose.translation().y(), pose.translation().z()};
+  const double *           parameters[2] = {q, t};
+
+  std::vector<std::unique_ptr<ceres::CostFunction>> factors;
+  if (type == FactorType::BATCHED) {
+    auto factor = std::make_unique<BatchedLidarFactor>(new ceres::HuberLoss(HUBER_LOSS));
+    for (const auto &corr : correspondences) {
+      if constexpr (std::is_same_v<CorrespondenceT, EdgeCorrespondence>) {
+        factor->addEdge(corr);
+      } else {
+        factor->addPlane(corr);
+      }
+    }
+    factors.push_back(std::move(factor));
+  } else {
+    for (const auto &corr : correspondences) {
+      factors.emplace_back(createCostFunction(corr, type));
+    }
+  }
+
+  std::size_t num_residuals = 0;
+  for (const auto &factor : factors) {
+    num_residuals = std::max(num_residuals, std::size_t(factor->num_residuals()));
+  }
+  std::vector<double> residuals(num_residuals), jacobian_q(num_residuals * 4), jacobian_t(num_residuals * 3);
+  double *            jacobians[2] = {jacobian_q.data(), jacobian_t.data()};
+
+  for (auto _ : state) {
+    for (const auto &factor : factors) {
+      factor->Evaluate(parameters, residuals.data(), jacobians);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * correspondences.size());
+}
+
+static void BM_EdgeFactors(benchmark::State &state) {
+  const int rings = int(state.range(0));
+  if (!hasScan(state, rings)) {
+    return;
+  }
+  std::vector<EdgeCorrespondence>  edges;
+  std::vector<PlaneCorrespondence> planes;
+  odometryCorrespondences(rings, edges, planes);
+  evaluateFactors(state, edges, scanPose(1));
+}
+
+static void BM_PlaneFactors(benchmark::State &state) {
+  const int rings = int(state.range(0));
+  if (!hasScan(state, rings)) {
+    return;
+  }
+  std::vector<EdgeCorrespondence>  edges;
+  std::vector<PlaneCorrespondence> planes;
+  odometryCorrespondences(rings, edges, planes);
+  evaluateFactors(state, planes, scanPose(1));
+}
+
+static void BM_PlaneNormFactors(benchmark::State &state) {
+  const int rings = int(state.range(0));
+  if (!hasScan(state, rings)) {
+    return;
+  }
+  const MapFixture &map = getMap(rings);
+
+  std::vector<PlaneNormCorrespondence> planes;
+  associateToMap(map.kdtree_surfs, *map.surfs, *map.frame_surfs, map.frame_pose, fitPlaneCorrespondence, planes);
+  evaluateFactors(state, planes, map.frame_pose);
+}
+
+/*//}*/
+
+/*//{ Registration */
+
+static void scanArguments(benchmark::internal::Benchmark *b) {
+  for (const int rings : {16, 64, 128}) {
+    b->Arg(rings);
+  }
+  if (std::getenv("ALOAM_BENCH_PCD")) {
+    b->Arg(RECORDED_SCAN);
+  }
+  b->ArgName("rings");
+}
+
+static void voxelGridArguments(benchmark::internal::Benchmark *b) {
+  for (const int rings : {16, 64, 128}) {
+    for (const int resolution_cm : {20, 40}) {
+      b->Args({rings, resolution_cm});
+    }
+  }
+  if (std::getenv("ALOAM_BENCH_PCD")) {
+    b->Args({RECORDED_SCAN, 20});
+    b->Args({RECORDED_SCAN, 40});
+  }
+  b->ArgNames({"rings", "leaf_cm"});
+}
+
+static void factorArguments(benchmark::internal::Benchmark *b) {
+  for (const int rings : {16, 64, 128}) {
+    for (const FactorType type : {FactorType::AUTODIFF, FactorType::ANALYTIC, FactorType::BATCHED}) {
+      b->Args({rings, int(type)});
+    }
+  }
+  if (std::getenv("ALOAM_BENCH_PCD")) {
+    for (const FactorType type : {FactorType::AUTODIFF, FactorType::ANALYTIC, FactorType::BATCHED}) {
+      b->Args({RECORDED_SCAN, int(type)});
+    }
+  }
+  b->ArgNames({"rings", "type"});
+}
+
+BENCHMARK(BM_Curvature)->Apply(scanArguments);
+BENCHMARK(BM_CurvatureAndSelection)->Apply(scanArguments);
+BENCHMARK(BM_VoxelGrid)->Apply(voxelGridArguments);
+BENCHMARK(BM_TransformPoints)->Apply(scanArguments);
+BENCHMARK(BM_OdometryEdgeSearch)->Apply(scanArguments);
+BENCHMARK(BM_OdometryEdgeSearchDistortion)->Apply(scanArguments);
+BENCHMARK(BM_OdometryPlaneSearch)->Apply(scanArguments);
+BENCHMARK(BM_OdometryIndexBuild)->Apply(scanArguments);
+BENCHMARK(BM_MappingEdgeFit)->Apply(scanArguments);
+BENCHMARK(BM_MappingPlaneFit)->Apply(scanArguments);
+BENCHMARK(BM_MappingKdTreeBuild)->Apply(scanArguments);
+BENCHMARK(BM_EdgeFactors)->Apply(factorArguments);
+BENCHMARK(BM_PlaneFactors)->Apply(factorArguments);
+BENCHMARK(BM_PlaneNormFactors)->Apply(factorArguments);
+
+/*//}*/
+
+BENCHMARK_MAIN();
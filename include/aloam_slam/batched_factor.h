@@ -0,0 +1,101 @@
+#ifndef ALOAM_BATCHED_FACTOR_H
+#define ALOAM_BATCHED_FACTOR_H
+
+/* includes //{ */
+
+#include <memory>
+#include <vector>
+
+#include <ceres/ceres.h>
+#include <eigen3/Eigen/Dense>
+
+#include "aloam_slam/correspondences.h"
+
+//}
+
+namespace aloam_slam
+{
+
+/*//{ class BatchedLidarFactor */
+// Single cost function holding all point-to-line and point-to-plane correspondences of one frame in contiguous arrays.
+// The residuals are ordered as the correspondences were added, each edge contributes 3 residuals and each plane 1 residual.
+// The robust loss is applied inside of the cost function per correspondence: the residuals are scaled by sqrt(rho(s) / s)
+// (s is the squared norm of the correspondence residual), so the cost seen by ceres is exactly the robustified cost of the
+// corresponding per-correspondence residual blocks, and the Jacobians are the exact derivatives of the scaled residuals.
+// Parameter blocks are q = [x, y, z, w] (ambient, 4) and t (3).
+class BatchedLidarFactor : public ceres::CostFunction {
+
+public:
+  // takes ownership of loss_function (nullptr means no robust loss)
+  explicit BatchedLidarFactor(ceres::LossFunction *loss_function);
+
+  void addEdge(const EdgeCorrespondence &corr);
+  void addPlane(const PlaneCorrespondence &corr);
+  void addPlane(const PlaneNormCorrespondence &corr);
+
+  std::size_t numEdges() const;
+  std::size_t numPlanes() const;
+
+  virtual bool Evaluate(double const *const *parameters, double *residuals, double **jacobians) const;
+
+private:
+  std::unique_ptr<ceres::LossFunction> _loss_function;
+
+  // point-to-line: r = (lp - a) x d, with lp = q_s * p + s * t and d the unit line direction
+  std::vector<double> _edge_px, _edge_py, _edge_pz;
+  std::vector<double> _edge_ax, _edge_ay, _edge_az;
+  std::vector<double> _edge_dx, _edge_dy, _edge_dz;
+  std::vector<double> _edge_s;
+
+  // point-to-plane: r = n . lp + offset
+  std::vector<double> _plane_px, _plane_py, _plane_pz;
+  std::vector<double> _plane_nx, _plane_ny, _plane_nz;
+  std::vector<double> _plane_offset;
+  std::vector<double> _plane_s;
+
+  void robustify(double *residuals, const int size, double *jacobian_q, double *jacobian_t) const;
+};
+/*//}*/
+
+/*//{ addCorrespondences() */
+template <typename PlaneCorrespondenceT>
+void addCorrespondences(BatchedLidarFactor &factor, const std::vector<EdgeCorrespondence> &edges, const std::vector<PlaneCorrespondenceT> &planes) {
+  for (const auto &corr : edges) {
+    factor.addEdge(corr);
+  }
+  for (const auto &corr : planes) {
+    factor.addPlane(corr);
+  }
+}
+/*//}*/
+
+/*//{ addResidualBlocks() */
+// adds residual blocks of all the correspondences to the problem using the given factor type, takes ownership of loss_function
+template <typename PlaneCorrespondenceT>
+void addResidualBlocks(ceres::Problem &problem, const std::vector<EdgeCorrespondence> &edges, const std::vector<PlaneCorrespondenceT> &planes,
+                       const FactorType type, ceres::LossFunction *loss_function, double *q, double *t) {
+
+  if (edges.empty() && planes.empty()) {
+    delete loss_function;
+    return;
+  }
+
+  if (type == FactorType::BATCHED) {
+    BatchedLidarFactor *factor = new BatchedLidarFactor(loss_function);
+    addCorrespondences(*factor, edges, planes);
+    problem.AddResidualBlock(factor, nullptr, q, t);
+    return;
+  }
+
+  for (const auto &corr : edges) {
+    problem.AddResidualBlock(createCostFunction(corr, type), loss_function, q, t);
+  }
+  for (const auto &corr : planes) {
+    problem.AddResidualBlock(createCostFunction(corr, type), loss_function, q, t);
+  }
+}
+/*//}*/
+
+}  // namespace aloam_slam
+
+#endif
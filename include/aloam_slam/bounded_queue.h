@@ -0,0 +1,153 @@
+#ifndef ALOAM_BOUNDED_QUEUE_H
+#define ALOAM_BOUNDED_QUEUE_H
+
+/* includes //{ */
+
+#include <deque>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+//}
+
+namespace aloam_slam
+{
+
+// behavior of the channel between two pipeline stages when the consumer is behind
+enum class QueuePolicy
+{
+  DROP_OLDEST,  // BoundedQueue, the oldest item is discarded, the producer never waits
+  BLOCK,        // BoundedQueue, the producer waits until the consumer pops an item
+  LATEST,       // LatestMailbox, lock-free handoff of the newest item only (the capacity is ignored)
+};
+
+/*//{ parseQueuePolicy() */
+inline bool parseQueuePolicy(const std::string &name, QueuePolicy &policy) {
+  if (name == "drop_oldest") {
+    policy = QueuePolicy::DROP_OLDEST;
+  } else if (name == "block") {
+    policy = QueuePolicy::BLOCK;
+  } else if (name == "latest") {
+    policy = QueuePolicy::LATEST;
+  } else {
+    return false;
+  }
+  return true;
+}
+/*//}*/
+
+/*//{ struct QueueStats */
+struct QueueStats
+{
+  unsigned long pushed    = 0;
+  unsigned long popped    = 0;
+  unsigned long dropped   = 0;
+  std::size_t   depth     = 0;  // current number of items
+  std::size_t   max_depth = 0;  // the highest number of items since the construction
+};
+/*//}*/
+
+/*//{ class FrameChannel */
+// Handoff of the frames from one pipeline stage to the next one (single producer, single consumer).
+// The consumer blocks in pop() until an item arrives, so the stage runs exactly when there is data to process.
+template <typename T>
+class FrameChannel {
+
+public:
+  virtual ~FrameChannel() = default;
+
+  // returns false if the channel was closed (the item is discarded)
+  virtual bool push(T item) = 0;
+
+  // blocks until an item is available, returns false once the channel is closed
+  virtual bool pop(T &item) = 0;
+
+  // wakes up both sides, all following push() and pop() calls fail
+  virtual void close() = 0;
+
+  virtual QueueStats stats() const = 0;
+};
+/*//}*/
+
+/*//{ class BoundedQueue */
+// FIFO of a bounded capacity, a full queue either drops the oldest item or blocks the producer
+template <typename T>
+class BoundedQueue : public FrameChannel<T> {
+
+public:
+  BoundedQueue(const std::size_t capacity, const QueuePolicy policy) : _capacity(std::max(capacity, std::size_t(1))), _policy(policy) {
+  }
+
+  BoundedQueue(const BoundedQueue &) = delete;
+  BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+  bool push(T item) override {
+    {
+      std::unique_lock lock(_mutex);
+      if (_policy == QueuePolicy::BLOCK) {
+        _cv_not_full.wait(lock, [this] { return _closed || _items.size() < _capacity; });
+      }
+      if (_closed) {
+        return false;
+      }
+      if (_items.size() >= _capacity) {
+        _items.pop_front();
+        _stats.dropped++;
+      }
+      _items.push_back(std::move(item));
+      _stats.pushed++;
+      _stats.max_depth = std::max(_stats.max_depth, _items.size());
+    }
+    _cv_not_empty.notify_one();
+    return true;
+  }
+
+  bool pop(T &item) override {
+    {
+      std::unique_lock lock(_mutex);
+      _cv_not_empty.wait(lock, [this] { return _closed || !_items.empty(); });
+      if (_closed) {
+        return false;
+      }
+      item = std::move(_items.front());
+      _items.pop_front();
+      _stats.popped++;
+    }
+    _cv_not_full.notify_one();
+    return true;
+  }
+
+  void close() override {
+    {
+      std::scoped_lock lock(_mutex);
+      _closed = true;
+      _items.clear();
+    }
+    _cv_not_empty.notify_all();
+    _cv_not_full.notify_all();
+  }
+
+  QueueStats stats() const override {
+    std::scoped_lock lock(_mutex);
+    QueueStats       stats = _stats;
+    stats.depth            = _items.size();
+    return stats;
+  }
+
+private:
+  const std::size_t _capacity;
+  const QueuePolicy _policy;
+
+  mutable std::mutex      _mutex;
+  std::condition_variable _cv_not_empty;
+  std::condition_variable _cv_not_full;
+  std::deque<T>           _items;
+  bool                    _closed = false;
+  QueueStats              _stats;
+};
+/*//}*/
+
+}  // namespace aloam_slam
+
+#endif
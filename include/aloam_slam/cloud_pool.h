@@ -0,0 +1,65 @@
+#ifndef ALOAM_CLOUD_POOL_H
+#define ALOAM_CLOUD_POOL_H
+
+/* includes //{ */
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include "aloam_slam/common.h"
+
+//}
+
+namespace aloam_slam
+{
+
+/*//{ struct CloudPoolStats */
+struct CloudPoolStats
+{
+  unsigned long acquired  = 0;  // clouds handed out by acquire()
+  unsigned long allocated = 0;  // clouds newly allocated because the pool was empty
+  std::size_t   cached    = 0;  // clouds currently waiting in the pool
+};
+/*//}*/
+
+/*//{ class CloudPool */
+// Recycles point clouds so that the steady-state processing does not allocate the point buffers.
+// The clouds are handed out as regular pcl::PointCloud::Ptr with a custom deleter: once the last reference is dropped (in any thread,
+// e.g., by the next pipeline stage), the cloud is emptied and returned to the pool with the capacity of its point buffer kept.
+// Clouds released after the pool was destroyed, or when the pool already holds `max_cached` clouds, are deleted.
+class CloudPool {
+
+public:
+  explicit CloudPool(const std::size_t max_cached);
+
+  CloudPool(const CloudPool &) = delete;
+  CloudPool &operator=(const CloudPool &) = delete;
+
+  // empty cloud with the default header
+  pcl::PointCloud<PointType>::Ptr acquire();
+
+  CloudPoolStats stats() const;
+
+private:
+  struct Storage
+  {
+    std::size_t                               max_cached;
+    std::mutex                                mutex;
+    std::vector<pcl::PointCloud<PointType> *> clouds;
+    CloudPoolStats                            stats;
+
+    ~Storage();
+    void release(pcl::PointCloud<PointType> *cloud);
+  };
+
+  std::shared_ptr<Storage> _storage;
+};
+/*//}*/
+
+}  // namespace aloam_slam
+
+#endif
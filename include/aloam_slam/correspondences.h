@@ -0,0 +1,157 @@
+#ifndef ALOAM_CORRESPONDENCES_H
+#define ALOAM_CORRESPONDENCES_H
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <eigen3/Eigen/Dense>
+
+#include "aloam_slam/common.h"
+#include "aloam_slam/lidarFactor.hpp"
+
+namespace aloam_slam
+{
+
+// point of the current scan and a line given by two points of the previous scan (map)
+struct EdgeCorrespondence
+{
+  Eigen::Vector3d curr_point;
+  Eigen::Vector3d point_a;
+  Eigen::Vector3d point_b;
+  double          s;
+};
+
+// point of the current scan and a plane given by three points of the previous scan
+struct PlaneCorrespondence
+{
+  Eigen::Vector3d curr_point;
+  Eigen::Vector3d point_j;
+  Eigen::Vector3d point_l;
+  Eigen::Vector3d point_m;
+  double          s;
+};
+
+// point of the current scan and a plane of the map given by its unit normal and offset
+struct PlaneNormCorrespondence
+{
+  Eigen::Vector3d curr_point;
+  Eigen::Vector3d plane_unit_norm;
+  double          negative_OA_dot_norm;
+};
+
+// implementation of the residual blocks built from the correspondences
+enum class FactorType
+{
+  AUTODIFF,
+  ANALYTIC,
+  BATCHED,
+};
+
+/*//{ parseFactorType() */
+inline bool parseFactorType(const std::string &name, FactorType &type) {
+  if (name == "autodiff") {
+    type = FactorType::AUTODIFF;
+  } else if (name == "analytic") {
+    type = FactorType::ANALYTIC;
+  } else if (name == "batched") {
+    type = FactorType::BATCHED;
+  } else {
+    return false;
+  }
+  return true;
+}
+/*//}*/
+
+/*//{ createCostFunction() */
+// the BATCHED type has no per-correspondence cost function, the analytic one is used for it
+inline ceres::CostFunction *createCostFunction(const EdgeCorrespondence &corr, const FactorType type) {
+  if (type != FactorType::AUTODIFF) {
+    return LidarEdgeAnalyticFactor::Create(corr.curr_point, corr.point_a, corr.point_b, corr.s);
+  }
+  return LidarEdgeFactor::Create(corr.curr_point, corr.point_a, corr.point_b, corr.s);
+}
+
+inline ceres::CostFunction *createCostFunction(const PlaneCorrespondence &corr, const FactorType type) {
+  if (type != FactorType::AUTODIFF) {
+    return LidarPlaneAnalyticFactor::Create(corr.curr_point, corr.point_j, corr.point_l, corr.point_m, corr.s);
+  }
+  return LidarPlaneFactor::Create(corr.curr_point, corr.point_j, corr.point_l, corr.point_m, corr.s);
+}
+
+inline ceres::CostFunction *createCostFunction(const PlaneNormCorrespondence &corr, const FactorType type) {
+  if (type != FactorType::AUTODIFF) {
+    return LidarPlaneNormAnalyticFactor::Create(corr.curr_point, corr.plane_unit_norm, corr.negative_OA_dot_norm);
+  }
+  return LidarPlaneNormFactor::Create(corr.curr_point, corr.plane_unit_norm, corr.negative_OA_dot_norm);
+}
+/*//}*/
+
+/*//{ fitEdgeCorrespondence() */
+// line through the 5 nearest map features of the point, returns false if the features are not distributed along a line
+inline bool fitEdgeCorrespondence(const Eigen::Vector3d &curr_point, const std::vector<PointType> &neighbors, EdgeCorrespondence &corr) {
+  std::vector<Eigen::Vector3d> nearCorners;
+  Eigen::Vector3d              center(0, 0, 0);
+  for (int j = 0; j < 5; j++) {
+    const Eigen::Vector3d tmp(neighbors.at(j).x, neighbors.at(j).y, neighbors.at(j).z);
+    center = center + tmp;
+    nearCorners.push_back(tmp);
+  }
+  center = center / 5.0;
+
+  Eigen::Matrix3d covMat = Eigen::Matrix3d::Zero();
+  for (int j = 0; j < 5; j++) {
+    const Eigen::Matrix<double, 3, 1> tmpZeroMean = nearCorners.at(j) - center;
+    covMat                                        = covMat + tmpZeroMean * tmpZeroMean.transpose();
+  }
+
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> saes(covMat);
+
+  // if is indeed line feature
+  // note Eigen library sort eigenvalues in increasing order
+  if (saes.eigenvalues()[2] <= 3 * saes.eigenvalues()[1]) {
+    return false;
+  }
+
+  const Eigen::Vector3d unit_direction = saes.eigenvectors().col(2);
+  corr.curr_point                      = curr_point;
+  corr.point_a                         = 0.1 * unit_direction + center;
+  corr.point_b                         = -0.1 * unit_direction + center;
+  corr.s                               = 1.0;
+  return true;
+}
+/*//}*/
+
+/*//{ fitPlaneCorrespondence() */
+// plane through the 5 nearest map features of the point, returns false if any of the features is farther than 0.2 m from the plane
+inline bool fitPlaneCorrespondence(const Eigen::Vector3d &curr_point, const std::vector<PointType> &neighbors, PlaneNormCorrespondence &corr) {
+  Eigen::Matrix<double, 5, 3> matA0;
+  Eigen::Matrix<double, 5, 1> matB0 = -1 * Eigen::Matrix<double, 5, 1>::Ones();
+  for (int j = 0; j < 5; j++) {
+    matA0(j, 0) = neighbors.at(j).x;
+    matA0(j, 1) = neighbors.at(j).y;
+    matA0(j, 2) = neighbors.at(j).z;
+  }
+  // find the norm of plane
+  Eigen::Vector3d norm                 = matA0.colPivHouseholderQr().solve(matB0);
+  const double    negative_OA_dot_norm = 1 / norm.norm();
+  norm.normalize();
+
+  // Here n(pa, pb, pc) is unit norm of plane
+  for (int j = 0; j < 5; j++) {
+    // if OX * n > 0.2, then plane is not fit well
+    if (std::fabs(norm(0) * neighbors.at(j).x + norm(1) * neighbors.at(j).y + norm(2) * neighbors.at(j).z + negative_OA_dot_norm) > 0.2) {
+      return false;
+    }
+  }
+
+  corr.curr_point           = curr_point;
+  corr.plane_unit_norm      = norm;
+  corr.negative_OA_dot_norm = negative_OA_dot_norm;
+  return true;
+}
+/*//}*/
+
+}  // namespace aloam_slam
+
+#endif
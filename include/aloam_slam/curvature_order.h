@@ -0,0 +1,99 @@
+#ifndef ALOAM_CURVATURE_ORDER_H
+#define ALOAM_CURVATURE_ORDER_H
+
+/* includes //{ */
+
+#include <algorithm>
+#include <vector>
+
+//}
+
+namespace aloam_slam
+{
+
+/*//{ class CurvatureOrder */
+// Indices of points ordered by their curvature, sorted lazily in chunks from both ends of the range.
+// The feature selection walks only the few sharpest and the few flattest points of a region, so the range is partitioned by std::nth_element
+// and only the visited chunks are sorted, i.e., O(n) per region in the typical case instead of O(n log n) of sorting the whole region.
+class CurvatureOrder {
+
+public:
+  // reorders the indices in [begin, end) in place, `curvature` is indexed by the point indices, `chunk` is the number of points sorted at once
+  CurvatureOrder(const std::vector<int>::iterator begin, const std::vector<int>::iterator end, const float *const curvature, const int chunk)
+      : _begin(begin), _size(int(end - begin)), _chunk(std::max(chunk, 1)), _curvature(curvature) {
+  }
+
+  int size() const {
+    return _size;
+  }
+
+  // index of the point with the k-th lowest curvature
+  int ascending(const int k) {
+    if (k >= _sorted_front) {
+      sortFront(k + 1);
+    }
+    return *(_begin + k);
+  }
+
+  // index of the point with the k-th highest curvature
+  int descending(const int k) {
+    if (k >= _sorted_back) {
+      sortBack(k + 1);
+    }
+    return *(_begin + (_size - 1 - k));
+  }
+
+private:
+  std::vector<int>::iterator _begin;
+  int                        _size;
+  int                        _chunk;
+  const float *              _curvature;
+
+  // number of sorted elements at the front and at the back of the range, the unsorted elements in between are not lower than the front and not
+  // higher than the back
+  int _sorted_front = 0;
+  int _sorted_back  = 0;
+
+  bool less(const int a, const int b) const {
+    return _curvature[a] < _curvature[b];
+  }
+
+  void sortFront(const int count) {
+    const int unsorted_end = _size - _sorted_back;
+    const int front_end    = std::min(std::max(count, _sorted_front + _chunk), unsorted_end);
+
+    const auto cmp = [this](const int a, const int b) { return less(a, b); };
+    if (front_end < unsorted_end) {
+      std::nth_element(_begin + _sorted_front, _begin + front_end, _begin + unsorted_end, cmp);
+    }
+    std::sort(_begin + _sorted_front, _begin + front_end, cmp);
+
+    _sorted_front = front_end;
+    if (_sorted_front == unsorted_end) {
+      _sorted_front = _size;
+      _sorted_back  = _size;
+    }
+  }
+
+  void sortBack(const int count) {
+    const int unsorted_end = _size - _sorted_back;
+    const int back_begin   = std::max(_size - std::max(count, _sorted_back + _chunk), _sorted_front);
+
+    const auto cmp = [this](const int a, const int b) { return less(a, b); };
+    if (back_begin > _sorted_front) {
+      std::nth_element(_begin + _sorted_front, _begin + back_begin, _begin + unsorted_end, cmp);
+    }
+    std::sort(_begin + back_begin, _begin + unsorted_end, cmp);
+
+    _sorted_back = _size - back_begin;
+    if (back_begin == _sorted_front) {
+      _sorted_front = _size;
+      _sorted_back  = _size;
+    }
+  }
+};
+/*//}*/
+
+}  // namespace aloam_slam
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef ALOAM_DESKEW_H
+#define ALOAM_DESKEW_H
+
+/* includes //{ */
+
+#include <deque>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+
+#include <eigen3/Eigen/Dense>
+
+#include "aloam_slam/feature_cloud.h"
+
+//}
+
+namespace aloam_slam
+{
+
+// source of the motion of the lidar during the scan
+enum class DeskewSource
+{
+  NONE,               // the scan is not deskewed
+  CONSTANT_VELOCITY,  // motion between the previous two odometry frames
+  ORIENTATION,        // rotation interpolated from the orientation measurements (e.g., IMU), translation by the constant velocity
+};
+
+/*//{ parseDeskewSource() */
+inline bool parseDeskewSource(const std::string &name, DeskewSource &source) {
+  if (name == "none") {
+    source = DeskewSource::NONE;
+  } else if (name == "constant_velocity") {
+    source = DeskewSource::CONSTANT_VELOCITY;
+  } else if (name == "orientation") {
+    source = DeskewSource::ORIENTATION;
+  } else {
+    return false;
+  }
+  return true;
+}
+/*//}*/
+
+/*//{ class Deskewer */
+// Removes the motion distortion of a scan by transforming every point to the pose of the lidar at the beginning of the scan (the stamp of the
+// scan) given by the time of the point within the scan.
+// The pose is sampled in `time_bins` uniform time bins of the scan and every point is transformed by the pose of its bin, so the scan is
+// deskewed by a single pass of 3x3 matrix-vector products without interpolating the pose per point. The points of a ring are ordered by time,
+// so the consecutive points of the same bin are transformed together.
+class Deskewer {
+
+public:
+  // `q_lidar_fcu` is the rotation of the fcu frame in the lidar frame (the orientation measurements are of the fcu frame)
+  Deskewer(const DeskewSource source, const float scan_period_sec, const int time_bins, const Eigen::Quaterniond &q_lidar_fcu);
+
+  DeskewSource source() const;
+
+  // motion of the lidar between two consecutive odometry frames `dt` seconds apart (pose of the later frame in the earlier one)
+  void setMotion(const Eigen::Quaterniond &q_last_curr, const Eigen::Vector3d &t_last_curr, const double dt);
+
+  // orientation of the fcu frame in a fixed frame, the measurements have to be added in the order of their stamps
+  void addOrientation(const ros::Time &stamp, const Eigen::Quaterniond &orientation);
+
+  // returns false if the motion during the scan is not known (the cloud is not modified)
+  bool deskew(FeatureCloud &cloud, const ros::Time &stamp);
+
+private:
+  DeskewSource       _source;
+  float              _scan_period_sec;
+  int                _time_bins;
+  Eigen::Quaterniond _q_lidar_fcu;
+
+  std::mutex _mutex;
+
+  bool              _has_motion = false;
+  Eigen::AngleAxisd _motion_rotation;  // per second
+  Eigen::Vector3d   _motion_velocity;
+
+  std::deque<std::pair<ros::Time, Eigen::Quaterniond>> _orientations;
+
+  // poses of the time bins, reused between the scans
+  std::vector<Eigen::Matrix3f> _bin_rotations;
+  std::vector<Eigen::Vector3f> _bin_translations;
+
+  bool interpolateOrientation(const ros::Time &stamp, Eigen::Quaterniond &orientation) const;
+};
+/*//}*/
+
+}  // namespace aloam_slam
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef ALOAM_DEVICE_BUFFER_CUH
+#define ALOAM_DEVICE_BUFFER_CUH
+
+/* includes //{ */
+
+#include <cstddef>
+#include <string>
+
+#include <cuda_runtime.h>
+
+//}
+
+namespace aloam_slam
+{
+
+namespace gpu
+{
+
+/*//{ class DeviceBuffer */
+// device memory which only grows, so the buffers of the per-frame kernels are allocated only until they fit the largest frame
+template <typename T>
+class DeviceBuffer {
+
+public:
+  DeviceBuffer() = default;
+
+  ~DeviceBuffer() {
+    if (_data) {
+      cudaFree(_data);
+    }
+  }
+
+  DeviceBuffer(const DeviceBuffer &) = delete;
+  DeviceBuffer &operator=(const DeviceBuffer &) = delete;
+
+  // the content is not preserved when the buffer grows
+  cudaError_t reserve(const std::size_t size) {
+    if (size <= _capacity) {
+      return cudaSuccess;
+    }
+    if (_data) {
+      cudaFree(_data);
+      _data     = nullptr;
+      _capacity = 0;
+    }
+    const cudaError_t result = cudaMalloc(reinterpret_cast<void **>(&_data), size * sizeof(T));
+    if (result == cudaSuccess) {
+      _capacity = size;
+    }
+    return result;
+  }
+
+  T *data() const {
+    return _data;
+  }
+
+private:
+  T *         _data     = nullptr;
+  std::size_t _capacity = 0;
+};
+/*//}*/
+
+/*//{ cudaCheck() */
+// false and the message in `error` if the call failed
+inline bool cudaCheck(const cudaError_t result, const char *what, std::string &error) {
+  if (result == cudaSuccess) {
+    return true;
+  }
+  error = std::string(what) + ": " + cudaGetErrorString(result);
+  return false;
+}
+/*//}*/
+
+/*//{ blocks() */
+inline unsigned int blocks(const std::size_t count, const unsigned int threads) {
+  return static_cast<unsigned int>((count + threads - 1) / threads);
+}
+/*//}*/
+
+}  // namespace gpu
+
+}  // namespace aloam_slam
+
+#endif
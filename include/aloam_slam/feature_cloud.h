@@ -0,0 +1,78 @@
+#ifndef ALOAM_FEATURE_CLOUD_H
+#define ALOAM_FEATURE_CLOUD_H
+
+/* includes //{ */
+
+#include <cstdint>
+#include <vector>
+
+#include <eigen3/Eigen/Dense>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include "aloam_slam/common.h"
+
+//}
+
+namespace aloam_slam
+{
+
+/*//{ struct FeatureChannels */
+// Ring and time (as in FeatureCloud) of every point of a pcl::PointCloud of features, in the order of the points.
+struct FeatureChannels
+{
+  std::vector<std::uint16_t> ring;
+  std::vector<float>         time;
+
+  std::size_t size() const;
+  void        clear();
+  void        push_back(const int point_ring, const float point_time);
+  void        append(const FeatureChannels &other);
+};
+/*//}*/
+
+/*//{ class FeatureCloud */
+// Points of a scan inside the feature extraction (parsing, deskewing, curvature and the feature selection) in separate aligned arrays.
+// The ring and the time of a point are kept in their own fields instead of being packed into the intensity of a pcl::PointXYZI. The selected
+// features are handed over to the odometry as pcl::PointCloud<PointType> (which its kd-trees, the voxel filters, the map cubes and the messages
+// take) with their rings and times in FeatureChannels next to them. The intensity is still filled by toPoint() (ring + scan_period_sec * time) for
+// the published clouds and the map, but it is not decoded downstream.
+class FeatureCloud {
+
+public:
+  template <typename T>
+  using AlignedVector = std::vector<T, Eigen::aligned_allocator<T>>;
+
+  AlignedVector<float>       x;
+  AlignedVector<float>       y;
+  AlignedVector<float>       z;
+  AlignedVector<float>       time;       // since the beginning of the scan relative to the scan period, in [0, 1)
+  AlignedVector<float>       curvature;  // filled by FeatureSelector::computeCurvature()
+  std::vector<std::uint16_t> ring;
+
+  float scan_period_sec = 0.1f;
+
+  std::size_t size() const;
+  bool        empty() const;
+
+  // the buffers keep their capacity, so a reused cloud does not allocate once it is large enough
+  void resize(const std::size_t size);
+  void clear();
+
+  void set(const std::size_t i, const float px, const float py, const float pz, const int point_ring, const float point_time);
+
+  PointType toPoint(const std::size_t i) const;
+  void      toPointCloud(pcl::PointCloud<PointType> &cloud) const;
+
+  // appends the point to the features and its ring and time to their channels
+  void appendTo(const std::size_t i, pcl::PointCloud<PointType> &features, FeatureChannels &channels) const;
+
+  // transforms the points [begin, end) by p <- R * p + t
+  void transform(const std::size_t begin, const std::size_t end, const Eigen::Matrix3f &R, const Eigen::Vector3f &t);
+};
+/*//}*/
+
+}  // namespace aloam_slam
+
+#endif
@@ -2,7 +2,15 @@
 #define ALOAM_FEATURE_EXTRACTOR_H
 
 #include "aloam_slam/odometry.h"
+#include "aloam_slam/feature_merger.h"
 #include "aloam_slam/mapping.h"
+#include "aloam_slam/point_cloud_fields.h"
+#include "aloam_slam/feature_cloud.h"
+#include "aloam_slam/feature_selection.h"
+#include "aloam_slam/gpu_backend.h"
+#include "aloam_slam/cloud_pool.h"
+#include "aloam_slam/deskew.h"
+#include "aloam_slam/latency_controller.h"
 
 #include <ouster_ros/point.h>
 #include <mrs_lib/subscribe_handler.h>
@@ -13,11 +21,25 @@ class FeatureExtractor {
 
 public:
   FeatureExtractor(const ros::NodeHandle &parent_nh, mrs_lib::ParamLoader param_loader, std::shared_ptr<mrs_lib::Profiler> profiler,
-                   const std::shared_ptr<AloamOdometry> odometry, const std::string &map_frame, const float scan_period_sec, const bool enable_scope_timer,
+                   const std::shared_ptr<AloamOdometry> odometry, const std::string &map_frame, const float scan_period_sec, const tf::Transform &tf_lidar_to_fcu,
+                   const std::shared_ptr<LatencyController> latency_controller, const std::string &cloud_topic, const bool enable_scope_timer,
                    const std::shared_ptr<mrs_lib::ScopeTimerLogger> scope_timer_logger);
 
   std::atomic<bool> is_initialized = false;
 
+  // the first second of data is processed instead of being dropped (the warm start restores the state of the previous run)
+  std::atomic<bool> skip_initialization_delay = false;
+
+  // entry points of the subscribers, also called directly by the offline replay (from a single thread)
+  void processCloud(const sensor_msgs::PointCloud2::ConstPtr &laserCloudMsg);
+  void processOrientation(const nav_msgs::Odometry::ConstPtr &msg);
+
+  void setFrameObserver(const std::shared_ptr<FrameObserver> &observer);
+
+  // the frames are handed to the merger instead of the odometry, primary_T_lidar transforms the points of this lidar to the primary lidar
+  // (identity for the primary lidar 0), the observer of the primary lidar receives the frames dropped by the merger
+  void setMerger(const std::shared_ptr<FeatureMerger> &merger, const int lidar_index, const Eigen::Isometry3d &primary_T_lidar);
+
 private:
   bool _enable_scope_timer;
   bool _has_required_parameters = false;
@@ -28,9 +50,19 @@ private:
   // member objects
   std::shared_ptr<mrs_lib::Profiler>                  _profiler;
   mrs_lib::SubscribeHandler<sensor_msgs::PointCloud2> _sub_laser_cloud;
+  mrs_lib::SubscribeHandler<nav_msgs::Odometry>       _sub_orientation;
+  ros::Publisher                                      _pub_diagnostics;
 
   std::shared_ptr<AloamOdometry>             _odometry;
   std::shared_ptr<mrs_lib::ScopeTimerLogger> _scope_timer_logger;
+  std::shared_ptr<Deskewer>                  _deskewer;
+  std::shared_ptr<LatencyController>         _latency_controller;
+  std::shared_ptr<FrameObserver>             _frame_observer;
+
+  // merging with the other lidars (nullptr: the frames are handed to the odometry directly)
+  std::shared_ptr<FeatureMerger> _merger;
+  int                            _lidar_index     = 0;
+  Eigen::Isometry3d              _primary_T_lidar = Eigen::Isometry3d::Identity();
 
   // member variables
   std::string _frame_map;
@@ -43,22 +75,64 @@ private:
 
   long int _frame_count = 0;
 
+  // frames handed over to the odometry and frames discarded since the start (published in the diagnostics)
+  unsigned long _frames_processed = 0;
+  unsigned long _frames_dropped   = 0;
+
   int _number_of_rings;
 
   bool _data_have_ring_field;
+  bool _use_organized_layout;
+
+  // every ring is split into regions, the sharpest and the flattest points of each region are selected as features
+  int   _regions_per_ring;
+  int   _sharp_points_per_region;
+  int   _less_sharp_points_per_region;  // including the sharp points
+  int   _flat_points_per_region;
+  float _curvature_threshold;
 
-  void parseRowsFromCloudMsg(const sensor_msgs::PointCloud2::ConstPtr &cloud, const pcl::PointCloud<PointType>::Ptr &cloud_processed,
+  // parsing buffers reused between the scans (ring and relative time of every point of the msg, ring < 0 for discarded points, range of every ring)
+  std::vector<int>   _parse_rings;
+  std::vector<float> _parse_times;
+  std::vector<int>   _parse_ring_offsets;
+  std::vector<int>   _rows_start_idxs;
+  std::vector<int>   _rows_end_idxs;
+
+  // the parsed scan ordered by rings, reused between the scans (converted to pcl only for the odometry)
+  FeatureCloud _scan;
+
+  // feature selection buffers reused between the scans
+  std::shared_ptr<CloudPool>       _cloud_pool;
+  std::shared_ptr<FeatureSelector> _feature_selector;
+
+  // the optional CUDA selection, nullptr if it is disabled or unavailable (the CPU selector is the fallback)
+  std::shared_ptr<GpuFeatureSelector> _gpu_feature_selector;
+
+  // constants
+  const float LESS_FLAT_RESOLUTION = 0.2f;  // [m] leaf size of the downsampled less flat features
+  const int   MERGED_RING_GAP      = 3;     // [rings] between the merged lidars, more than odometry nearby_scan, so the scan lines are not mixed
+
+  void parseRowsFromCloudMsg(const sensor_msgs::PointCloud2::ConstPtr &cloud, FeatureCloud &cloud_processed,
                              std::vector<int> &rows_start_indices, std::vector<int> &rows_end_indices);
-  void parseRowsFromOusterMsg(const sensor_msgs::PointCloud2::ConstPtr &cloud, const pcl::PointCloud<PointType>::Ptr &cloud_processed,
+  void parseRowsFromOusterMsg(const sensor_msgs::PointCloud2::ConstPtr &cloud, FeatureCloud &cloud_processed,
                               std::vector<int> &rows_start_indices, std::vector<int> &rows_end_indices);
 
-  void removeNaNFromPointCloud(const pcl::PointCloud<ouster_ros::Point>::Ptr &cloud_in, pcl::PointCloud<ouster_ros::Point>::Ptr &cloud_out,
-                               std::unordered_map<unsigned int, unsigned int> &indices);
+  void parseRowsFromOrganizedMsg(const sensor_msgs::PointCloud2::ConstPtr &cloud, FeatureCloud &cloud_processed,
+                                 std::vector<int> &rows_start_indices, std::vector<int> &rows_end_indices);
+
+  void writeRows(const sensor_msgs::PointCloud2::ConstPtr &cloud, const PointCloudField &field_x, const PointCloudField &field_y,
+                 const PointCloudField &field_z, FeatureCloud &cloud_processed, std::vector<int> &rows_start_indices,
+                 std::vector<int> &rows_end_indices);
+
+  float          relativeTime(float point_azimuth, const float azimuth_start, const float azimuth_end, bool &half_passed);
+  const uint8_t *getPointData(const sensor_msgs::PointCloud2::ConstPtr &cloud, const int index);
+  bool           isFinitePoint(const uint8_t *point_data, const PointCloudField &field_x, const PointCloudField &field_y, const PointCloudField &field_z);
 
   bool hasField(const std::string field, const sensor_msgs::PointCloud2::ConstPtr &msg);
 
   // callbacks
   void callbackLaserCloud(mrs_lib::SubscribeHandler<sensor_msgs::PointCloud2> &laserCloudMsg);
+  void callbackOrientation(mrs_lib::SubscribeHandler<nav_msgs::Odometry> &sub);
 };
 }  // namespace aloam_slam
 #endif
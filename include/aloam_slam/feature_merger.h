@@ -0,0 +1,64 @@
+#ifndef ALOAM_FEATURE_MERGER_H
+#define ALOAM_FEATURE_MERGER_H
+
+/* includes //{ */
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "aloam_slam/odometry.h"
+#include "aloam_slam/cloud_pool.h"
+#include "aloam_slam/frame_observer.h"
+
+//}
+
+namespace aloam_slam
+{
+
+/*//{ class FeatureMerger */
+// Merges the features of several synchronized lidars (one FeatureExtractor per lidar) into a single frame of the odometry and the mapping.
+// The lidar 0 is the primary one, the frames of the other lidars are expected in the frame of the primary lidar with their rings shifted after
+// the rings of the previous lidars (see FeatureExtractor::setMerger()). The latest frame of every lidar waits until each lidar has a frame within
+// max_time_difference from the frame of the primary lidar, the merged frame is then handed to the odometry with the stamp of the primary lidar.
+// Frames that cannot be matched anymore (older than the frames of the other lidars by more than max_time_difference, or replaced by the next frame of
+// the same lidar before they are merged) are dropped and reported to the observer as dropped by the feature extraction.
+class FeatureMerger {
+
+public:
+  FeatureMerger(const std::shared_ptr<AloamOdometry> odometry, const int lidars, const double max_time_difference);
+
+  int lidars() const;
+
+  void setFrameObserver(const std::shared_ptr<FrameObserver> &observer);
+
+  // frames of the lidar dropped without being merged (for the diagnostics of its extractor)
+  unsigned long framesDropped(const int lidar) const;
+
+  // called by the extractors (possibly from several threads)
+  void setData(const int lidar, const ros::Time &stamp, OdometryFrame frame);
+
+private:
+  struct Pending
+  {
+    bool          valid = false;
+    ros::Time     stamp;
+    OdometryFrame frame;
+  };
+
+  std::shared_ptr<AloamOdometry> _odometry;
+  std::shared_ptr<CloudPool>     _cloud_pool;
+  std::shared_ptr<FrameObserver> _frame_observer;
+  double                         _max_time_difference;
+
+  mutable std::mutex         _mutex;
+  std::vector<Pending>       _pending;
+  std::vector<unsigned long> _frames_dropped;
+
+  void merge(OdometryFrame &merged);
+};
+/*//}*/
+
+}  // namespace aloam_slam
+
+#endif
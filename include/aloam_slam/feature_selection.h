@@ -0,0 +1,76 @@
+#ifndef ALOAM_FEATURE_SELECTION_H
+#define ALOAM_FEATURE_SELECTION_H
+
+/* includes //{ */
+
+#include <vector>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/filters/voxel_grid.h>
+
+#include "aloam_slam/common.h"
+#include "aloam_slam/curvature_order.h"
+#include "aloam_slam/feature_cloud.h"
+
+//}
+
+namespace aloam_slam
+{
+
+/*//{ struct FeatureSelectionParams */
+struct FeatureSelectionParams
+{
+  // every ring is split into regions, the sharpest and the flattest points of each region are selected as features
+  int   regions_per_ring             = 6;
+  int   sharp_points_per_region      = 2;
+  int   less_sharp_points_per_region = 20;  // including the sharp points
+  int   flat_points_per_region       = 4;
+  float curvature_threshold          = 0.1f;
+  float less_flat_resolution         = 0.2f;  // [m] leaf size of the downsampled less flat features
+};
+/*//}*/
+
+/*//{ class FeatureSelector */
+// Curvature of the points of a scan and the selection of the edge and plane features from it (the kernels of FeatureExtractor).
+// The cloud holds the rings one after another, the points of the ring `i` are in [rows_start_indices[i], rows_end_indices[i]). The selected
+// features are converted to pcl::PointXYZI (see FeatureCloud::toPoint()), their rings and times are appended to the channels of every cloud.
+// The per-point buffers are reused between the scans, so a selector must not be shared between threads.
+class FeatureSelector {
+
+public:
+  FeatureSelector();
+
+  // curvature of every point from its 5 neighbors on both sides in the cloud, written to cloud.curvature
+  void computeCurvature(FeatureCloud &cloud);
+
+  // selects the features of the cloud of the last computeCurvature() call, the features are appended to the output clouds
+  void selectFeatures(const FeatureCloud &cloud, const std::vector<int> &rows_start_indices, const std::vector<int> &rows_end_indices,
+                      const FeatureSelectionParams &params, pcl::PointCloud<PointType> &corner_points_sharp,
+                      pcl::PointCloud<PointType> &corner_points_less_sharp, pcl::PointCloud<PointType> &surf_points_flat,
+                      pcl::PointCloud<PointType> &surf_points_less_flat, FeatureChannels &corner_channels_sharp,
+                      FeatureChannels &corner_channels_less_sharp, FeatureChannels &surf_channels_flat, FeatureChannels &surf_channels_less_flat);
+
+private:
+  std::vector<int> _cloud_sort_indices;
+  std::vector<int> _cloud_neighbor_picked;
+  std::vector<int> _cloud_label;
+
+  pcl::PointCloud<PointType>::Ptr _surf_points_less_flat_scan;
+  pcl::PointCloud<PointType>      _surf_points_less_flat_scan_ds;
+  pcl::VoxelGrid<PointType>       _filter_less_flat;
+
+  void markNeighborsPicked(const FeatureCloud &cloud, const int ind);
+};
+/*//}*/
+
+// Downsamples the less flat features of one ring, which hold their time in the intensity (so the time of a downsampled point is the mean time of
+// its voxel). The downsampled points are appended to the less flat features with the intensity of FeatureCloud::toPoint(), their ring and time to
+// the channels. `downsampled` is the buffer of the filter output.
+void downsampleLessFlat(pcl::VoxelGrid<PointType> &filter, const pcl::PointCloud<PointType>::Ptr &ring_points, const int ring,
+                        const float scan_period_sec, pcl::PointCloud<PointType> &downsampled, pcl::PointCloud<PointType> &surf_points_less_flat,
+                        FeatureChannels &surf_channels_less_flat);
+
+}  // namespace aloam_slam
+
+#endif
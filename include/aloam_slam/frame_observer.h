@@ -0,0 +1,46 @@
+#ifndef ALOAM_FRAME_OBSERVER_H
+#define ALOAM_FRAME_OBSERVER_H
+
+/* includes //{ */
+
+#include <ros/ros.h>
+
+#include <tf/transform_datatypes.h>
+
+//}
+
+namespace aloam_slam
+{
+
+// stages of the pipeline reported to the FrameObserver
+enum class PipelineStage
+{
+  FEATURE_EXTRACTION,
+  ODOMETRY,
+  MAPPING,
+};
+
+/*//{ class FrameObserver */
+// Receives the processing time and the result of every frame from the pipeline stages (e.g., the offline replay benchmark).
+// The methods are called from the threads of the stages, so the implementation has to be thread-safe. The observer of a stage has to be set
+// before the first frame is passed to it.
+class FrameObserver {
+
+public:
+  virtual ~FrameObserver() = default;
+
+  // the stage finished the frame of `stamp` in `duration_ms`, excluding the time spent waiting for the next stage
+  virtual void onStageFinished(const PipelineStage stage, const ros::Time &stamp, const double duration_ms) = 0;
+
+  // the stage discarded the frame of `stamp`, it does not reach the following stages
+  virtual void onFrameDropped(const PipelineStage stage, const ros::Time &stamp) = 0;
+
+  // pose of the fcu estimated by the stage (in the odom frame for the odometry, in the map frame for the mapping)
+  virtual void onPose([[maybe_unused]] const PipelineStage stage, [[maybe_unused]] const ros::Time &stamp, [[maybe_unused]] const tf::Transform &tf_fcu) {
+  }
+};
+/*//}*/
+
+}  // namespace aloam_slam
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef ALOAM_GPU_BACKEND_H
+#define ALOAM_GPU_BACKEND_H
+
+/* includes //{ */
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/filters/voxel_grid.h>
+
+#include "aloam_slam/common.h"
+#include "aloam_slam/correspondences.h"
+#include "aloam_slam/feature_cloud.h"
+#include "aloam_slam/feature_selection.h"
+#include "aloam_slam/gpu_kernels.h"
+
+//}
+
+// Optional CUDA backend of the feature selection and the map association. The classes are always compiled, without the CMake option
+// ALOAM_ENABLE_CUDA every call fails with an error and the callers keep using the CPU path, which stays the reference implementation.
+
+namespace aloam_slam
+{
+
+// false and the reason in `error` if the backend is not built or there is no CUDA device
+bool gpuBackendAvailable(std::string &error);
+
+/*//{ class GpuFeatureSelector */
+// FeatureSelector on the GPU: the curvature and the picks of the regions are computed by the kernels, the features are assembled into the output
+// clouds in the order of the CPU selection (including the downsampling of the less flat features of every ring), so the features equal the ones
+// of FeatureSelector up to the order of the points of equal curvature.
+class GpuFeatureSelector {
+
+public:
+  GpuFeatureSelector();
+
+  // computeCurvature() and selectFeatures() of FeatureSelector in one pass, the outputs are not modified if it fails
+  bool selectFeatures(FeatureCloud &cloud, const std::vector<int> &rows_start_indices, const std::vector<int> &rows_end_indices,
+                      const FeatureSelectionParams &params, pcl::PointCloud<PointType> &corner_points_sharp,
+                      pcl::PointCloud<PointType> &corner_points_less_sharp, pcl::PointCloud<PointType> &surf_points_flat,
+                      pcl::PointCloud<PointType> &surf_points_less_flat, FeatureChannels &corner_channels_sharp,
+                      FeatureChannels &corner_channels_less_sharp, FeatureChannels &surf_channels_flat, FeatureChannels &surf_channels_less_flat,
+                      std::string &error);
+
+private:
+  std::shared_ptr<gpu::FeatureKernels> _kernels;
+
+  std::vector<gpu::SelectionRegion> _regions;
+  std::vector<int>                  _ring_regions;
+  std::vector<int>                  _sharp_indices;
+  std::vector<int>                  _sharp_counts;
+  std::vector<int>                  _flat_indices;
+  std::vector<int>                  _flat_counts;
+  std::vector<std::int8_t>          _labels;
+
+  pcl::PointCloud<PointType>::Ptr _surf_points_less_flat_scan;
+  pcl::PointCloud<PointType>      _surf_points_less_flat_scan_ds;
+  pcl::VoxelGrid<PointType>       _filter_less_flat;
+};
+/*//}*/
+
+/*//{ class GpuMapAssociation */
+// Correspondences of the features of a mapping frame to the local map: the map features are indexed by voxel hash maps on the GPU and the
+// 5 nearest map features of all the features of an iteration are searched and fitted by a line or a plane in one batch.
+// The search radius is 1 m as in the CPU association (the 5th neighbor has to be closer than 1 m).
+class GpuMapAssociation {
+
+public:
+  GpuMapAssociation();
+
+  // map of the following queries, a static map (the same clouds on every call, e.g., of the localization) is uploaded only once
+  bool setMap(const pcl::PointCloud<PointType>::ConstPtr &map_corners, const pcl::PointCloud<PointType>::ConstPtr &map_surfs, const bool is_static,
+              std::string &error);
+
+  // correspondences of the features (`*_sel` transformed to the map, `*_ori` in the lidar frame) in the order of the features,
+  // the outputs are not modified if it fails
+  bool findCorrespondences(const pcl::PointCloud<PointType> &corners_ori, const pcl::PointCloud<PointType> &corners_sel,
+                           const pcl::PointCloud<PointType> &surfs_ori, const pcl::PointCloud<PointType> &surfs_sel,
+                           std::vector<EdgeCorrespondence> &corner_correspondences, std::vector<PlaneNormCorrespondence> &surf_correspondences,
+                           std::string &error);
+
+private:
+  std::shared_ptr<gpu::VoxelHashMap> _map_corners;
+  std::shared_ptr<gpu::VoxelHashMap> _map_surfs;
+
+  // the uploaded static map, kept so that its clouds are not reused while they are identified by the pointers
+  pcl::PointCloud<PointType>::ConstPtr _static_corners;
+  pcl::PointCloud<PointType>::ConstPtr _static_surfs;
+
+  std::vector<gpu::EdgeFit>  _edge_fits;
+  std::vector<gpu::PlaneFit> _plane_fits;
+};
+/*//}*/
+
+}  // namespace aloam_slam
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef ALOAM_GPU_KERNELS_H
+#define ALOAM_GPU_KERNELS_H
+
+/* includes //{ */
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+//}
+
+// Kernels of the CUDA backend (src/*.cu, built with the CMake option ALOAM_ENABLE_CUDA), used through gpu_backend.h.
+// The header is compiled by both nvcc and the host compiler, so it uses only plain arrays: the points of the pcl::PointXYZI clouds are read with
+// a stride (in floats) and the results are copied back as flat arrays, converted to the pcl clouds and the correspondences by the host.
+
+namespace aloam_slam
+{
+
+namespace gpu
+{
+
+// largest region of the feature selection (its curvature is sorted in the shared memory of a thread block)
+constexpr int MAX_REGION_SIZE = 4096;
+
+/*//{ struct SelectionRegion */
+// points [begin, end) of the scan
+struct SelectionRegion
+{
+  int begin;
+  int end;
+};
+/*//}*/
+
+/*//{ struct SelectionParams */
+struct SelectionParams
+{
+  int   sharp_points_per_region;
+  int   less_sharp_points_per_region;
+  int   flat_points_per_region;
+  float curvature_threshold;
+};
+/*//}*/
+
+/*//{ sharpStride(), flatStride() */
+// capacity of the selections of a region (the CPU selection stores one flat point even with no quota)
+inline int sharpStride(const SelectionParams &params) {
+  return params.sharp_points_per_region > params.less_sharp_points_per_region ? params.sharp_points_per_region : params.less_sharp_points_per_region;
+}
+
+inline int flatStride(const SelectionParams &params) {
+  return params.flat_points_per_region > 1 ? params.flat_points_per_region : 1;
+}
+/*//}*/
+
+/*//{ class FeatureKernels */
+// Curvature and the selection of the edge and plane features of a scan. One thread block selects the features of one ring: the curvature of
+// every region is sorted in the shared memory and the order is walked as by FeatureSelector, the regions of the ring one after another (the
+// neighbors of a point picked at the end of a region are not picked in the next region, as on the CPU).
+// The device buffers grow with the scans and are reused.
+class FeatureKernels {
+
+public:
+  FeatureKernels();
+  ~FeatureKernels();
+
+  FeatureKernels(const FeatureKernels &) = delete;
+  FeatureKernels &operator=(const FeatureKernels &) = delete;
+
+  // curvature of the points (the 5 points at both ends of the scan have 0) and the selection of every region, the regions of the ring k are
+  // [ring_regions[k], ring_regions[k + 1]) (rings_count + 1 offsets), the regions of a ring are consecutive and ordered:
+  //   sharp_indices[r * sharpStride(params) + k], k < sharp_counts[r]: the sharp and the less sharp points of the region in the order of the
+  //                                                                   selection (the first sharp_points_per_region are sharp)
+  //   flat_indices[r * flatStride(params) + k], k < flat_counts[r]: the flat points of the region in the order of the selection
+  //   labels[i]: 2 sharp, 1 less sharp, -1 flat, 0 otherwise (as FeatureSelector), 0 outside of the regions
+  // returns false if a CUDA call fails
+  bool selectFeatures(const float *x, const float *y, const float *z, const std::size_t size, const SelectionRegion *regions, const int regions_count,
+                      const int *ring_regions, const int rings_count, const SelectionParams &params, float *curvature, int *sharp_indices,
+                      int *sharp_counts, int *flat_indices, int *flat_counts, std::int8_t *labels, std::string &error);
+
+private:
+  struct Buffers;
+  std::unique_ptr<Buffers> _buffers;
+};
+/*//}*/
+
+/*//{ struct EdgeFit */
+// line through the 5 nearest map points of a query
+struct EdgeFit
+{
+  float center[3];
+  float direction[3];  // unit
+  int   valid;         // the neighbors are distributed along a line
+};
+/*//}*/
+
+/*//{ struct PlaneFit */
+// plane n * p + offset = 0 through the 5 nearest map points of a query
+struct PlaneFit
+{
+  float normal[3];  // unit
+  float offset;
+  int   valid;  // none of the neighbors is farther than 0.2 m from the plane
+};
+/*//}*/
+
+/*//{ class VoxelHashMap */
+// Map points in the GPU memory sorted by their voxel and indexed by an open-addressing hash table of the occupied voxels. The voxel size equals
+// the search radius, so all the neighbors of a query within the radius are in the 27 voxels around it and the 5 nearest neighbors within the
+// radius are exact. The queries are answered in batches: the 5 nearest neighbors of every query and the line or the plane fitted to them.
+class VoxelHashMap {
+
+public:
+  explicit VoxelHashMap(const float radius);
+  ~VoxelHashMap();
+
+  VoxelHashMap(const VoxelHashMap &) = delete;
+  VoxelHashMap &operator=(const VoxelHashMap &) = delete;
+
+  // replaces the map by the points (x, y, z at points[i * stride])
+  bool build(const float *points, const std::size_t count, const std::size_t stride, std::string &error);
+
+  std::size_t size() const;
+
+  // fits[i] of the query i (x, y, z at queries[i * stride]), invalid if the query has fewer than 5 neighbors within the radius
+  bool fitEdges(const float *queries, const std::size_t count, const std::size_t stride, EdgeFit *fits, std::string &error);
+  bool fitPlanes(const float *queries, const std::size_t count, const std::size_t stride, PlaneFit *fits, std::string &error);
+
+private:
+  struct Buffers;
+  std::unique_ptr<Buffers> _buffers;
+
+  float _radius;
+
+  bool findNeighbors(const float *queries, const std::size_t count, const std::size_t stride, std::string &error);
+};
+/*//}*/
+
+// false if there is no CUDA device
+bool deviceAvailable(std::string &error);
+
+}  // namespace gpu
+
+}  // namespace aloam_slam
+
+#endif
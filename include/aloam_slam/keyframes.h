@@ -0,0 +1,117 @@
+#ifndef ALOAM_KEYFRAMES_H
+#define ALOAM_KEYFRAMES_H
+
+/* includes //{ */
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include <ros/ros.h>
+
+#include <eigen3/Eigen/Dense>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/kdtree/kdtree_flann.h>
+
+#include "aloam_slam/common.h"
+
+//}
+
+namespace aloam_slam
+{
+
+/*//{ struct StaticMap */
+// map indexed by kd-trees built once (the map of the localization-only mode or the sliding window of keyframes), it is never modified once
+// built, so the kd-trees are queried without the lock of the map
+struct StaticMap
+{
+  pcl::PointCloud<PointType>::Ptr  corners;
+  pcl::PointCloud<PointType>::Ptr  surfs;
+  pcl::KdTreeFLANN<PointType>::Ptr kdtree_corners;
+  pcl::KdTreeFLANN<PointType>::Ptr kdtree_surfs;
+};
+/*//}*/
+
+/*//{ struct KeyframePolicyOptions */
+struct KeyframePolicyOptions
+{
+  bool   enable       = false;  // every frame is a keyframe if disabled
+  double translation  = 0.5;    // [m] from the last keyframe
+  double rotation     = 0.17;   // [rad] from the last keyframe
+  double max_interval = 0.0;    // [s] from the last keyframe (0: no time threshold)
+};
+/*//}*/
+
+/*//{ class KeyframePolicy */
+// Decides which registered frames update the map. A frame is a keyframe once the vehicle moved or turned by the threshold from the last keyframe
+// or the time threshold elapsed, so a hovering vehicle does not insert the same surfaces into the map over and over.
+class KeyframePolicy {
+
+public:
+  explicit KeyframePolicy(const KeyframePolicyOptions &options);
+
+  bool enabled() const;
+
+  // returns true if the frame registered at the pose is a keyframe, the pose then becomes the last keyframe
+  bool update(const ros::Time &stamp, const Eigen::Quaterniond &q_w_curr, const Eigen::Vector3d &t_w_curr);
+
+  // the next frame is a keyframe
+  void reset();
+
+private:
+  KeyframePolicyOptions _options;
+
+  std::mutex         _mutex;
+  bool               _has_keyframe = false;
+  ros::Time          _stamp;
+  Eigen::Quaterniond _q_w_keyframe;
+  Eigen::Vector3d    _t_w_keyframe;
+};
+/*//}*/
+
+/*//{ class KeyframeWindow */
+// Local map of the last `size` keyframes (their features in the map frame) used for the registration instead of the cube neighborhood.
+// The window is merged, downsampled and indexed by kd-trees only when a keyframe is added, the frames in between are registered to the same
+// snapshot, so the cost of the map follows the distance traveled instead of the time.
+// add() is called by a single thread (the map update), map() and clear() may be called from any thread.
+class KeyframeWindow {
+
+public:
+  KeyframeWindow(const int size, const float resolution_line, const float resolution_plane);
+
+  // the features are not copied and must not be modified afterwards
+  void add(const pcl::PointCloud<PointType>::Ptr &corners_w, const pcl::PointCloud<PointType>::Ptr &surfs_w);
+
+  // snapshot of the window, nullptr before the first keyframe
+  std::shared_ptr<const StaticMap> map() const;
+
+  int keyframes() const;
+
+  void clear();
+
+private:
+  struct Keyframe
+  {
+    pcl::PointCloud<PointType>::Ptr corners;
+    pcl::PointCloud<PointType>::Ptr surfs;
+  };
+
+  int _size;
+
+  pcl::VoxelGrid<PointType> _filter_corners;
+  pcl::VoxelGrid<PointType> _filter_surfs;
+
+  mutable std::mutex               _mutex;
+  std::deque<Keyframe>             _keyframes;
+  std::shared_ptr<const StaticMap> _map;
+  unsigned long                    _generation = 0;  // incremented by clear(), a snapshot built before is discarded
+};
+/*//}*/
+
+}  // namespace aloam_slam
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef ALOAM_LATENCY_CONTROLLER_H
+#define ALOAM_LATENCY_CONTROLLER_H
+
+/* includes //{ */
+
+#include <atomic>
+#include <cmath>
+#include <algorithm>
+
+//}
+
+namespace aloam_slam
+{
+
+/*//{ struct LatencyControllerOptions */
+struct LatencyControllerOptions
+{
+  bool  enable               = false;
+  float budget_ms            = 80.0f;  // target processing time of a frame
+  float gain                 = 0.05f;  // change of the degradation per frame at the error of the whole budget
+  float deadband             = 0.1f;   // relative error tolerated without any change
+  float smoothing            = 0.2f;   // weight of the newest latency in the moving average
+  float min_feature_ratio    = 0.5f;   // feature quotas at the full degradation relative to the configured ones
+  float max_resolution_ratio = 2.0f;   // leaf sizes at the full degradation relative to the configured ones
+  int   min_neighborhood_xy  = 1;      // mapping neighborhood (in cubes) at the full degradation
+};
+/*//}*/
+
+/*//{ class LatencyController */
+// Holds the processing time of the mapping frames close to a latency budget by trading the quality of the processing for time.
+// The degradation in [0, 1] rises while the smoothed latency is above the budget and falls back while it is below, the stages scale their
+// feature quotas, leaf sizes and the map neighborhood by it (0: the configured values, 1: the limits given by the options).
+// update() is called by a single stage (the mapping), the other stages only read the degradation.
+class LatencyController {
+
+public:
+  explicit LatencyController(const LatencyControllerOptions &options);
+
+  bool enabled() const;
+
+  // processing time of the last frame
+  void update(const float latency_ms);
+
+  float degradation() const;
+  float smoothedLatency() const;
+
+  // configured value scaled by the current degradation
+  int   scaleFeatureCount(const int count) const;
+  float scaleResolution(const float resolution) const;
+  int   scaleNeighborhood(const int radius) const;
+
+private:
+  LatencyControllerOptions _options;
+
+  std::atomic<float> _degradation{0.0f};
+  std::atomic<float> _smoothed_latency_ms{0.0f};
+  bool               _has_latency = false;  // accessed by the updating stage only
+};
+/*//}*/
+
+}  // namespace aloam_slam
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef ALOAM_LATEST_MAILBOX_H
+#define ALOAM_LATEST_MAILBOX_H
+
+/* includes //{ */
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+#include "aloam_slam/bounded_queue.h"
+
+//}
+
+namespace aloam_slam
+{
+
+/*//{ class LatestMailbox */
+// Lock-free "latest value" handoff between one producer and one consumer implemented as a triple buffer.
+// The producer writes into its own slot and publishes it by a single atomic exchange with the middle slot, an unread item in the middle slot
+// is dropped. The consumer takes the middle slot in the same way, so neither side ever copies or waits for the data of the other one.
+// The mutex is used only to put the idle consumer to sleep, the producer takes it momentarily to wake the consumer up and never waits for the
+// consumer to finish processing.
+template <typename T>
+class LatestMailbox : public FrameChannel<T> {
+
+public:
+  LatestMailbox() = default;
+
+  LatestMailbox(const LatestMailbox &) = delete;
+  LatestMailbox &operator=(const LatestMailbox &) = delete;
+
+  bool push(T item) override {
+    if (_closed.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    _slots[_back] = std::move(item);
+    const uint8_t prev = _middle.exchange(_back | DIRTY, std::memory_order_acq_rel);
+    _back              = prev & INDEX;
+
+    _pushed.fetch_add(1, std::memory_order_relaxed);
+    if (prev & DIRTY) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    { std::scoped_lock lock(_mutex_wait); }
+    _cv_wait.notify_one();
+    return true;
+  }
+
+  bool pop(T &item) override {
+    if (!tryTake(item)) {
+      std::unique_lock lock(_mutex_wait);
+      _cv_wait.wait(lock, [&] { return _closed.load(std::memory_order_acquire) || tryTake(item); });
+    }
+    return !_closed.load(std::memory_order_acquire);
+  }
+
+  void close() override {
+    {
+      std::scoped_lock lock(_mutex_wait);
+      _closed.store(true, std::memory_order_release);
+    }
+    _cv_wait.notify_all();
+  }
+
+  QueueStats stats() const override {
+    QueueStats stats;
+    stats.pushed    = _pushed.load(std::memory_order_relaxed);
+    stats.popped    = _popped.load(std::memory_order_relaxed);
+    stats.dropped   = _dropped.load(std::memory_order_relaxed);
+    stats.depth     = (_middle.load(std::memory_order_relaxed) & DIRTY) ? 1 : 0;
+    stats.max_depth = 1;
+    return stats;
+  }
+
+private:
+  static constexpr uint8_t INDEX = 0x3;
+  static constexpr uint8_t DIRTY = 0x4;  // the middle slot holds an item not taken by the consumer yet
+
+  T _slots[3];
+
+  uint8_t              _back  = 0;  // owned by the producer
+  uint8_t              _front = 1;  // owned by the consumer
+  std::atomic<uint8_t> _middle{2};
+
+  std::atomic<bool>          _closed{false};
+  std::atomic<unsigned long> _pushed{0};
+  std::atomic<unsigned long> _popped{0};
+  std::atomic<unsigned long> _dropped{0};
+
+  std::mutex              _mutex_wait;
+  std::condition_variable _cv_wait;
+
+  bool tryTake(T &item) {
+    if (!(_middle.load(std::memory_order_acquire) & DIRTY)) {
+      return false;
+    }
+    _front = _middle.exchange(_front, std::memory_order_acq_rel) & INDEX;
+    item   = std::move(_slots[_front]);
+    _popped.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+};
+/*//}*/
+
+/*//{ createFrameChannel() */
+template <typename T>
+std::shared_ptr<FrameChannel<T>> createFrameChannel(const std::size_t capacity, const QueuePolicy policy) {
+  if (policy == QueuePolicy::LATEST) {
+    return std::make_shared<LatestMailbox<T>>();
+  }
+  return std::make_shared<BoundedQueue<T>>(capacity, policy);
+}
+/*//}*/
+
+}  // namespace aloam_slam
+
+#endif
@@ -1,6 +1,9 @@
 // Author:   Tong Qin               qintonguav@gmail.com
 // 	         Shaozu Cao 		    saozu.cao@connect.ust.hk
 
+#ifndef ALOAM_LIDAR_FACTOR_HPP
+#define ALOAM_LIDAR_FACTOR_HPP
+
 #include <ceres/ceres.h>
 #include <ceres/rotation.h>
 #include <eigen3/Eigen/Dense>
@@ -169,4 +172,231 @@ struct LidarDistanceFactor
 
 	Eigen::Vector3d curr_point;
 	Eigen::Vector3d closed_point;
-};
\ No newline at end of file
+};
+
+// Analytic-Jacobian counterparts of the factors above. They evaluate the same residuals as the autodiff
+// versions (including Eigen's slerp and quaternion-vector product conventions), but without the Jet overhead.
+// Parameter blocks are the same: q = [x, y, z, w] (ambient, 4) and t (3).
+
+namespace lidar_factor_jacobians
+{
+
+// derivative of rotating point v by (not necessarily unit) quaternion q in the way Eigen does it,
+// i.e., f(q) = v + 2w (u x v) + 2 u x (u x v), with respect to q = [x, y, z, w]
+inline Eigen::Matrix<double, 3, 4> rotatedPointJacobian(const Eigen::Quaterniond &q, const Eigen::Vector3d &v)
+{
+	const Eigen::Vector3d u = q.vec();
+	const double w = q.w();
+
+	Eigen::Matrix3d v_skew;
+	v_skew << 0, -v.z(), v.y(), v.z(), 0, -v.x(), -v.y(), v.x(), 0;
+
+	Eigen::Matrix<double, 3, 4> J;
+	J.leftCols<3>() = -2.0 * w * v_skew + 2.0 * (u * v.transpose() + u.dot(v) * Eigen::Matrix3d::Identity() - 2.0 * v * u.transpose());
+	J.col(3) = 2.0 * u.cross(v);
+	return J;
+}
+
+// q_s = Identity().slerp(s, q) as computed by Eigen, together with the derivative dq_s/dq (coefficients in [x, y, z, w] order)
+inline Eigen::Quaterniond slerpFromIdentity(const double s, const Eigen::Quaterniond &q, Eigen::Matrix4d &J)
+{
+	static const double one = 1.0 - Eigen::NumTraits<double>::epsilon();
+
+	const double d = q.w();
+	const double abs_d = std::abs(d);
+	const double sign = d < 0.0 ? -1.0 : 1.0;
+
+	double scale0, scale1;
+	double dscale0_dw = 0.0, dscale1_dw = 0.0;
+
+	if (abs_d >= one)
+	{
+		scale0 = 1.0 - s;
+		scale1 = s;
+	}
+	else
+	{
+		const double theta = std::acos(abs_d);
+		const double sin_theta = std::sin(theta);
+		const double cos_theta = abs_d;
+		scale0 = std::sin((1.0 - s) * theta) / sin_theta;
+		scale1 = std::sin(s * theta) / sin_theta;
+
+		const double dscale0_dtheta = ((1.0 - s) * std::cos((1.0 - s) * theta) * sin_theta - std::sin((1.0 - s) * theta) * cos_theta) / (sin_theta * sin_theta);
+		const double dscale1_dtheta = (s * std::cos(s * theta) * sin_theta - std::sin(s * theta) * cos_theta) / (sin_theta * sin_theta);
+		const double dtheta_dw = -sign / sin_theta;
+		dscale0_dw = dscale0_dtheta * dtheta_dw;
+		dscale1_dw = dscale1_dtheta * dtheta_dw;
+	}
+
+	scale1 *= sign;
+	dscale1_dw *= sign;
+
+	// q_s = scale0 * identity + scale1 * q, the scales depend on w only
+	J = scale1 * Eigen::Matrix4d::Identity();
+	J.col(3) += dscale1_dw * q.coeffs();
+	J(3, 3) += dscale0_dw;
+
+	Eigen::Quaterniond q_s;
+	q_s.coeffs() = scale1 * q.coeffs();
+	q_s.w() += scale0;
+	return q_s;
+}
+
+// lp = slerp(s) * cp + s * t and its derivatives with respect to q and t
+inline Eigen::Vector3d interpolatedPoint(const double *q, const double *t, const Eigen::Vector3d &cp, const double s,
+										 Eigen::Matrix<double, 3, 4> *dlp_dq)
+{
+	const Eigen::Map<const Eigen::Quaterniond> q_last_curr(q);
+	const Eigen::Map<const Eigen::Vector3d> t_last_curr(t);
+
+	Eigen::Matrix4d dqs_dq;
+	const Eigen::Quaterniond q_s = slerpFromIdentity(s, q_last_curr, dqs_dq);
+
+	if (dlp_dq)
+	{
+		*dlp_dq = rotatedPointJacobian(q_s, cp) * dqs_dq;
+	}
+
+	return q_s * cp + s * t_last_curr;
+}
+
+} // namespace lidar_factor_jacobians
+
+struct LidarEdgeAnalyticFactor : public ceres::SizedCostFunction<3, 4, 3>
+{
+	LidarEdgeAnalyticFactor(Eigen::Vector3d curr_point_, Eigen::Vector3d last_point_a_,
+							Eigen::Vector3d last_point_b_, double s_)
+		: curr_point(curr_point_), last_point_a(last_point_a_), last_point_b(last_point_b_), s(s_)
+	{
+		de_norm = (last_point_a - last_point_b).norm();
+		const Eigen::Vector3d ba = last_point_b - last_point_a;
+		dres_dlp << 0, -ba.z(), ba.y(), ba.z(), 0, -ba.x(), -ba.y(), ba.x(), 0;
+		dres_dlp /= de_norm;
+	}
+
+	virtual bool Evaluate(double const *const *parameters, double *residuals, double **jacobians) const
+	{
+		const bool need_q = jacobians && jacobians[0];
+		const bool need_t = jacobians && jacobians[1];
+
+		Eigen::Matrix<double, 3, 4> dlp_dq;
+		const Eigen::Vector3d lp = lidar_factor_jacobians::interpolatedPoint(parameters[0], parameters[1], curr_point, s, need_q ? &dlp_dq : nullptr);
+
+		Eigen::Map<Eigen::Vector3d> residual(residuals);
+		residual = (lp - last_point_a).cross(lp - last_point_b) / de_norm;
+
+		if (need_q)
+		{
+			Eigen::Map<Eigen::Matrix<double, 3, 4, Eigen::RowMajor>> jacobian_q(jacobians[0]);
+			jacobian_q = dres_dlp * dlp_dq;
+		}
+		if (need_t)
+		{
+			Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> jacobian_t(jacobians[1]);
+			jacobian_t = s * dres_dlp;
+		}
+
+		return true;
+	}
+
+	static ceres::CostFunction *Create(const Eigen::Vector3d curr_point_, const Eigen::Vector3d last_point_a_,
+									   const Eigen::Vector3d last_point_b_, const double s_)
+	{
+		return new LidarEdgeAnalyticFactor(curr_point_, last_point_a_, last_point_b_, s_);
+	}
+
+	Eigen::Vector3d curr_point, last_point_a, last_point_b;
+	double s;
+	double de_norm;
+	Eigen::Matrix3d dres_dlp;
+};
+
+struct LidarPlaneAnalyticFactor : public ceres::SizedCostFunction<1, 4, 3>
+{
+	LidarPlaneAnalyticFactor(Eigen::Vector3d curr_point_, Eigen::Vector3d last_point_j_,
+							 Eigen::Vector3d last_point_l_, Eigen::Vector3d last_point_m_, double s_)
+		: curr_point(curr_point_), last_point_j(last_point_j_), last_point_l(last_point_l_),
+		  last_point_m(last_point_m_), s(s_)
+	{
+		ljm_norm = (last_point_j - last_point_l).cross(last_point_j - last_point_m);
+		ljm_norm.normalize();
+	}
+
+	virtual bool Evaluate(double const *const *parameters, double *residuals, double **jacobians) const
+	{
+		const bool need_q = jacobians && jacobians[0];
+		const bool need_t = jacobians && jacobians[1];
+
+		Eigen::Matrix<double, 3, 4> dlp_dq;
+		const Eigen::Vector3d lp = lidar_factor_jacobians::interpolatedPoint(parameters[0], parameters[1], curr_point, s, need_q ? &dlp_dq : nullptr);
+
+		residuals[0] = (lp - last_point_j).dot(ljm_norm);
+
+		if (need_q)
+		{
+			Eigen::Map<Eigen::Matrix<double, 1, 4>> jacobian_q(jacobians[0]);
+			jacobian_q = ljm_norm.transpose() * dlp_dq;
+		}
+		if (need_t)
+		{
+			Eigen::Map<Eigen::Matrix<double, 1, 3>> jacobian_t(jacobians[1]);
+			jacobian_t = s * ljm_norm.transpose();
+		}
+
+		return true;
+	}
+
+	static ceres::CostFunction *Create(const Eigen::Vector3d curr_point_, const Eigen::Vector3d last_point_j_,
+									   const Eigen::Vector3d last_point_l_, const Eigen::Vector3d last_point_m_,
+									   const double s_)
+	{
+		return new LidarPlaneAnalyticFactor(curr_point_, last_point_j_, last_point_l_, last_point_m_, s_);
+	}
+
+	Eigen::Vector3d curr_point, last_point_j, last_point_l, last_point_m;
+	Eigen::Vector3d ljm_norm;
+	double s;
+};
+
+struct LidarPlaneNormAnalyticFactor : public ceres::SizedCostFunction<1, 4, 3>
+{
+
+	LidarPlaneNormAnalyticFactor(Eigen::Vector3d curr_point_, Eigen::Vector3d plane_unit_norm_,
+								 double negative_OA_dot_norm_) : curr_point(curr_point_), plane_unit_norm(plane_unit_norm_),
+																 negative_OA_dot_norm(negative_OA_dot_norm_) {}
+
+	virtual bool Evaluate(double const *const *parameters, double *residuals, double **jacobians) const
+	{
+		const Eigen::Map<const Eigen::Quaterniond> q_w_curr(parameters[0]);
+		const Eigen::Map<const Eigen::Vector3d> t_w_curr(parameters[1]);
+
+		const Eigen::Vector3d point_w = q_w_curr * curr_point + t_w_curr;
+		residuals[0] = plane_unit_norm.dot(point_w) + negative_OA_dot_norm;
+
+		if (jacobians && jacobians[0])
+		{
+			Eigen::Map<Eigen::Matrix<double, 1, 4>> jacobian_q(jacobians[0]);
+			jacobian_q = plane_unit_norm.transpose() * lidar_factor_jacobians::rotatedPointJacobian(q_w_curr, curr_point);
+		}
+		if (jacobians && jacobians[1])
+		{
+			Eigen::Map<Eigen::Matrix<double, 1, 3>> jacobian_t(jacobians[1]);
+			jacobian_t = plane_unit_norm.transpose();
+		}
+
+		return true;
+	}
+
+	static ceres::CostFunction *Create(const Eigen::Vector3d curr_point_, const Eigen::Vector3d plane_unit_norm_,
+									   const double negative_OA_dot_norm_)
+	{
+		return new LidarPlaneNormAnalyticFactor(curr_point_, plane_unit_norm_, negative_OA_dot_norm_);
+	}
+
+	Eigen::Vector3d curr_point;
+	Eigen::Vector3d plane_unit_norm;
+	double negative_OA_dot_norm;
+};
+
+#endif
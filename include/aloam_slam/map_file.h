@@ -0,0 +1,122 @@
+#ifndef ALOAM_MAP_FILE_H
+#define ALOAM_MAP_FILE_H
+
+/* includes //{ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <ros/ros.h>
+
+#include <eigen3/Eigen/Dense>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include "aloam_slam/common.h"
+#include "aloam_slam/voxel_map.h"
+#include "aloam_slam/cloud_pool.h"
+
+//}
+
+namespace aloam_slam
+{
+
+// Binary tiled map file (host byte order):
+//   MapFileHeader
+//   MapFileTile[num_tiles]          directory of the cubes
+//   float[4] (x, y, z, intensity)   points of the tiles, corners followed by surfs of each tile
+// The directory is read once when the file is opened, the points of a tile are read from the memory-mapped file only when the tile is loaded.
+
+/*//{ struct MapFileHeader */
+struct MapFileHeader
+{
+  char     magic[8];
+  uint32_t version;
+  float    cube_size;
+  uint64_t num_tiles;
+};
+static_assert(sizeof(MapFileHeader) == 24, "unexpected padding of MapFileHeader");
+/*//}*/
+
+/*//{ struct MapFileTile */
+struct MapFileTile
+{
+  int32_t  i;
+  int32_t  j;
+  int32_t  k;
+  uint32_t num_corners;
+  uint32_t num_surfs;
+  uint32_t reserved;
+  uint64_t offset;  // of the first point from the beginning of the file
+};
+static_assert(sizeof(MapFileTile) == 32, "unexpected padding of MapFileTile");
+/*//}*/
+
+/*//{ saveMapFile() */
+// writes the cubes into a temporary file which is synced to the disk and then renamed to `path`, so an existing file is replaced only by a complete map
+bool saveMapFile(const std::string &path, const float cube_size, const std::vector<std::pair<CubeKey, MapCube>> &cubes, std::string &error);
+/*//}*/
+
+/*//{ struct PersistedPose */
+// last pose of the mapping, restored by the warm start: the pose of the lidar in the odometry frame and the correction of the odometry frame
+// in the map frame, so both frames continue where they stopped
+struct PersistedPose
+{
+  ros::Time          stamp;
+  Eigen::Quaterniond q_wodom_curr = Eigen::Quaterniond::Identity();
+  Eigen::Vector3d    t_wodom_curr = Eigen::Vector3d::Zero();
+  Eigen::Quaterniond q_wmap_wodom = Eigen::Quaterniond::Identity();
+  Eigen::Vector3d    t_wmap_wodom = Eigen::Vector3d::Zero();
+};
+/*//}*/
+
+/*//{ savePoseFile() */
+// one line of text, written into a temporary file which is then renamed to `path` (as the map file)
+bool savePoseFile(const std::string &path, const PersistedPose &pose, std::string &error);
+/*//}*/
+
+/*//{ loadPoseFile() */
+bool loadPoseFile(const std::string &path, PersistedPose &pose, std::string &error);
+/*//}*/
+
+/*//{ class MappedMapFile */
+// Read-only map file mapped into the memory, tiles are loaded on demand (the pages of the unused tiles are never read from the disk)
+class MappedMapFile {
+
+public:
+  MappedMapFile() = default;
+  ~MappedMapFile();
+
+  MappedMapFile(const MappedMapFile &) = delete;
+  MappedMapFile &operator=(const MappedMapFile &) = delete;
+
+  bool open(const std::string &path, std::string &error);
+  void close();
+
+  bool               isOpen() const;
+  const std::string &path() const;
+  float              cubeSize() const;
+
+  std::size_t          size() const;
+  std::vector<CubeKey> keys() const;
+  bool                 contains(const CubeKey &key) const;
+
+  // copies the points of the tile into clouds taken from `cloud_pool`, returns false if the tile is not in the file
+  bool readCube(const CubeKey &key, CloudPool &cloud_pool, MapCube &cube) const;
+
+private:
+  const uint8_t *_data      = nullptr;
+  std::size_t    _size      = 0;
+  float          _cube_size = 0.0f;
+  std::string    _path;
+
+  std::unordered_map<CubeKey, MapFileTile, CubeKeyHash> _tiles;
+};
+/*//}*/
+
+}  // namespace aloam_slam
+
+#endif
@@ -11,10 +11,13 @@
 #include <vector>
 #include <string>
 #include <thread>
+#include <chrono>
 #include <iostream>
 #include <mutex>
+#include <shared_mutex>
 #include <condition_variable>
 #include <queue>
+#include <unordered_map>
 
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
@@ -58,6 +61,25 @@
 #include "aloam_slam/common.h"
 #include "aloam_slam/tic_toc.h"
 #include "aloam_slam/lidarFactor.hpp"
+#include "aloam_slam/voxel_map.h"
+#include "aloam_slam/voxel_index.h"
+#include "aloam_slam/thread_pool.h"
+#include "aloam_slam/correspondences.h"
+#include "aloam_slam/batched_factor.h"
+#include "aloam_slam/pose_solver.h"
+#include "aloam_slam/latest_mailbox.h"
+#include "aloam_slam/cloud_pool.h"
+#include "aloam_slam/transform_kernels.h"
+#include "aloam_slam/map_file.h"
+#include "aloam_slam/latency_controller.h"
+#include "aloam_slam/frame_observer.h"
+#include "aloam_slam/keyframes.h"
+#include "aloam_slam/gpu_backend.h"
+
+#include <aloam_slam/MapDelta.h>
+#include <aloam_slam/GetMapSnapshot.h>
+#include <aloam_slam/MapFile.h>
+#include <aloam_slam/StageDiagnostics.h>
 
 //}
 
@@ -72,12 +94,40 @@ inline bool isfinite(const pc_t &pc) {
   return true;
 }
 
+/*//{ struct MappingFrame */
+// registered scan handed from AloamOdometry to AloamMapping
+struct MappingFrame
+{
+  ros::Time                       stamp;
+  tf::Transform                   odometry;
+  pcl::PointCloud<PointType>::Ptr features_corners_last;
+  pcl::PointCloud<PointType>::Ptr features_surfs_last;
+  pcl::PointCloud<PointType>::Ptr cloud_full_res;
+};
+/*//}*/
+
+/*//{ struct MapUpdate */
+// registered features of one frame inserted into the map (possibly by the background map update thread)
+struct MapUpdate
+{
+  ros::Time                       stamp;
+  Eigen::Quaterniond              q_w_curr;
+  Eigen::Vector3d                 t_w_curr;
+  pcl::PointCloud<PointType>::Ptr features_corners;
+  pcl::PointCloud<PointType>::Ptr features_surfs;
+  pcl::PointCloud<PointType>::Ptr cloud_full_res;
+  bool                            keyframe = true;  // the features are inserted into the map only for keyframes
+};
+/*//}*/
+
 class AloamMapping {
 
 public:
   AloamMapping(const ros::NodeHandle &parent_nh, mrs_lib::ParamLoader param_loader, const std::shared_ptr<mrs_lib::Profiler> profiler,
                const std::string &frame_fcu, const std::string &frame_map, const tf::Transform &tf_lidar_to_fcu,
-               const bool enable_scope_timer, const std::shared_ptr<mrs_lib::ScopeTimerLogger> scope_timer_logger);
+               const std::shared_ptr<LatencyController> latency_controller, const SharedWorkers &shared_workers, const bool enable_scope_timer,
+               const std::shared_ptr<mrs_lib::ScopeTimerLogger> scope_timer_logger);
+  ~AloamMapping();
 
   std::atomic<bool> is_initialized = false;
 
@@ -86,6 +136,15 @@ public:
 
   void setTransform(const Eigen::Vector3d &t, const Eigen::Quaterniond &q, const ros::Time &stamp);
 
+  // transformation of the odometry frame in the map frame, applied by the next setTransform() (warm start)
+  void setMapCorrection(const Eigen::Vector3d &t_wmap_wodom, const Eigen::Quaterniond &q_wmap_wodom);
+
+  // loads the map file if configured (map_file/load_on_start, localization_only) or if the nodelet is warm-started, called once before the mapping
+  // is initialized (in parallel with the initialization of the other components)
+  void loadStartupMap(const bool warm_start);
+
+  void setFrameObserver(const std::shared_ptr<FrameObserver> &observer);
+
 private:
   bool _enable_scope_timer;
 
@@ -93,23 +152,86 @@ private:
   std::shared_ptr<mrs_lib::Profiler>             _profiler;
   std::shared_ptr<tf2_ros::TransformBroadcaster> _tf_broadcaster;
   std::shared_ptr<mrs_lib::ScopeTimerLogger>     _scope_timer_logger;
-
-  ros::Timer _timer_mapping_loop;
-  ros::Time  _time_last_map_publish;
-
-  std::mutex                                   _mutex_cloud_features;
-  std::vector<pcl::PointCloud<PointType>::Ptr> _cloud_corners;
-  std::vector<pcl::PointCloud<PointType>::Ptr> _cloud_surfs;
-
-  // Feature extractor newest data
-  std::mutex                      _mutex_odometry_data;
-  std::condition_variable         _cv_odometry_data;
-  bool                            _has_new_data = false;
-  ros::Time                       _time_aloam_odometry;
-  tf::Transform                   _aloam_odometry;
-  pcl::PointCloud<PointType>::Ptr _features_corners_last;
-  pcl::PointCloud<PointType>::Ptr _features_surfs_last;
-  pcl::PointCloud<PointType>::Ptr _cloud_full_res;
+  std::shared_ptr<ThreadPool>                    _thread_pool;
+  std::shared_ptr<PoseSolver>                    _pose_solver;
+  std::shared_ptr<CloudPool>                     _cloud_pool;
+  std::shared_ptr<CloudPool>                     _map_cloud_pool;
+  std::shared_ptr<LatencyController>             _latency_controller;
+  std::shared_ptr<FrameObserver>                 _frame_observer;
+
+  // the optional CUDA association, nullptr if it is disabled or unavailable (the kd-trees are the fallback)
+  std::shared_ptr<GpuMapAssociation> _gpu_association;
+
+  ros::Time _time_map_update;
+  ros::Time _time_last_eigenvalues_publish;
+
+  // the association only reads the incremental index, so it takes the lock as shared and only around the nearest neighbor queries
+  std::shared_mutex           _mutex_cloud_features;
+  std::shared_ptr<VoxelMap>   _voxel_map;
+  std::shared_ptr<VoxelIndex> _index_corners;
+  std::shared_ptr<VoxelIndex> _index_surfs;
+
+  // frames from the odometry, processed by the mapping thread as they arrive
+  std::shared_ptr<FrameChannel<MappingFrame>> _queue_odometry;
+  std::thread                                 _thread_mapping;
+
+  // the map insertion, downsampling and the map/scan publishing, either in the background thread or at the end of the mapping frame
+  bool                                     _background_map_update;
+  std::shared_ptr<BoundedQueue<MapUpdate>> _queue_map_update;
+  std::thread                              _thread_map_update;
+  pcl::VoxelGrid<PointType>                _filter_map_corners;
+  pcl::VoxelGrid<PointType>                _filter_map_surfs;
+
+  // association buffers reused between the frames (the kd-trees are rebuilt from the local map of every frame)
+  pcl::VoxelGrid<PointType>                         _filter_downsize_corners;
+  pcl::VoxelGrid<PointType>                         _filter_downsize_surfs;
+  pcl::KdTreeFLANN<PointType>::Ptr                  _kdtree_map_corners;
+  pcl::KdTreeFLANN<PointType>::Ptr                  _kdtree_map_surfs;
+  std::vector<EdgeCorrespondence>                   _corner_correspondences;
+  std::vector<PlaneNormCorrespondence>              _surf_correspondences;
+  std::vector<std::vector<EdgeCorrespondence>>      _corner_chunk_correspondences;
+  std::vector<std::vector<PlaneNormCorrespondence>> _surf_chunk_correspondences;
+
+  // the registered scan is published either in the lidar frame (as received) or transformed into the map frame
+  bool                          _scan_registered_in_lidar_frame;
+  sensor_msgs::PointCloud2::Ptr _msg_scan_registered;
+
+  // the map (or its changes for the delta output) is serialized and published by its own thread
+  bool                    _map_output_delta;
+  std::thread             _thread_map_publisher;
+  std::mutex              _mutex_map_publisher;
+  std::condition_variable _cv_map_publisher;
+  bool                    _stop_map_publisher = false;
+
+  // map file kept open for streaming its cubes into the map around the vehicle (guarded by _mutex_cloud_features)
+  std::string                    _map_file_path;
+  bool                           _map_file_stream;
+  int                            _map_file_stream_radius_xy;
+  int                            _map_file_stream_radius_z;
+  std::shared_ptr<MappedMapFile> _map_file;
+  bool                           _map_file_load_on_start;
+  bool                           _has_stream_center = false;
+  CubeKey                        _stream_center;
+
+  // modified cubes evicted from the streamed map, kept until they are written back to the map file (streamed again from here until then)
+  std::unordered_map<CubeKey, MapCube, CubeKeyHash> _evicted_cubes;
+
+  // the map file is written by one thread at a time (the periodic saving, the service and the write-back of the evicted cubes)
+  std::mutex _mutex_map_file_write;
+
+  // the pose and the map are persisted for the warm start periodically and on shutdown (the map to the map file path)
+  std::string _warm_start_pose_file;
+  float       _warm_start_pose_save_period;
+  float       _warm_start_map_save_period;
+  bool        _warm_start_save_map;
+
+  // the loaded map is frozen and only used for the registration, no features are inserted into it
+  bool                             _localization_only;
+  std::shared_ptr<const StaticMap> _static_map;
+
+  // only the keyframes update the map, optionally the last keyframes form the local map of the registration (nullptr if disabled)
+  std::shared_ptr<KeyframePolicy> _keyframe_policy;
+  std::shared_ptr<KeyframeWindow> _keyframe_window;
 
   // publishers and subscribers
   ros::Publisher _pub_laser_cloud_map;
@@ -117,9 +239,14 @@ private:
   ros::Publisher _pub_odom_global;
   ros::Publisher _pub_path;
   ros::Publisher _pub_eigenvalue;
+  ros::Publisher _pub_map_delta;
+  ros::Publisher _pub_diagnostics;
 
   // services
   ros::ServiceServer _srv_reset_mapping;
+  ros::ServiceServer _srv_get_map_snapshot;
+  ros::ServiceServer _srv_save_map;
+  ros::ServiceServer _srv_load_map;
 
   // ROS messages
   nav_msgs::Path::Ptr _laser_path_msg      = boost::make_shared<nav_msgs::Path>();
@@ -149,24 +276,52 @@ private:
 
   long int _frame_count = 0;
 
-  int       _cloud_center_width  = 10;
-  int       _cloud_center_height = 10;
-  int       _cloud_center_depth  = 5;
-  const int _cloud_width         = 21;
-  const int _cloud_height        = 21;
-  const int _cloud_depth         = 11;
-  const int _cloud_volume        = _cloud_width * _cloud_height * _cloud_depth;  // 4851
+  // frames registered and frames discarded by the mapping since the start (published in the diagnostics)
+  unsigned long _frames_processed = 0;
+  unsigned long _frames_dropped   = 0;
+
+  float _cube_size;
+  int   _cube_eviction_radius_xy;
+  int   _cube_eviction_radius_z;
+  int   _cube_neighborhood_xy = 2;
+  int   _cube_neighborhood_z  = 1;
+
+  bool  _use_incremental_index;
+  float _incremental_index_resolution;
+
+  FactorType _factor_type;
+  SolverType _solver_type;
+
+  bool   _degeneracy_publish_eigenvalues;
+  float  _degeneracy_publish_period;
+  bool   _degeneracy_aware_update;
+  double _degeneracy_eigenvalue_threshold;
 
   float _resolution_line;
   float _resolution_plane;
 
   // member methods
-  void timerMapping([[maybe_unused]] const ros::TimerEvent &event);
+  void threadMapping();
+  void threadMapUpdate();
+  void updateMap(const MapUpdate &update);
   bool callbackResetMapping(std_srvs::Trigger::Request &req, std_srvs::Trigger::Response &res);
+  bool callbackGetMapSnapshot(aloam_slam::GetMapSnapshot::Request &req, aloam_slam::GetMapSnapshot::Response &res);
+  bool callbackSaveMap(aloam_slam::MapFile::Request &req, aloam_slam::MapFile::Response &res);
+  bool callbackLoadMap(aloam_slam::MapFile::Request &req, aloam_slam::MapFile::Response &res);
+
+  bool saveMap(const std::string &path, std::string &message);
+  bool loadMap(const std::string &path, std::string &message);
+  void streamMap(const CubeKey &center);
+
+  std::shared_ptr<const StaticMap> buildStaticMap(const std::vector<std::pair<CubeKey, MapCube>> &cubes);
+
+  void threadMapPublisher();
+  void publishMap();
+  void fillMapDelta(const std::vector<std::pair<CubeKey, MapCube>> &cubes, const std::vector<CubeKey> &removed, const ros::Time &stamp,
+                    const bool full_snapshot, aloam_slam::MapDelta &msg);
 
   void transformAssociateToMap();
   void transformUpdate();
-  void pointAssociateToMap(PointType const *const pi, PointType *const po);
 };
 }  // namespace aloam_slam
 #endif
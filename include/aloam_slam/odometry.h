@@ -2,25 +2,50 @@
 #define ALOAM_ODOMETRY_H
 
 #include "aloam_slam/mapping.h"
+#include "aloam_slam/feature_cloud.h"
+#include "aloam_slam/scan_line_search.h"
 
 namespace aloam_slam
 {
+
+/*//{ struct OdometryFrame */
+// features of one scan handed from FeatureExtractor to AloamOdometry
+struct OdometryFrame
+{
+  pcl::PointCloud<PointType>::Ptr corner_points_sharp;
+  pcl::PointCloud<PointType>::Ptr corner_points_less_sharp;
+  pcl::PointCloud<PointType>::Ptr surf_points_flat;
+  pcl::PointCloud<PointType>::Ptr surf_points_less_flat;
+  pcl::PointCloud<PointType>::Ptr cloud_full_res;
+
+  // ring and time of the points of the feature clouds, the odometry does not decode them from the intensity
+  FeatureChannels corner_channels_sharp;
+  FeatureChannels corner_channels_less_sharp;
+  FeatureChannels surf_channels_flat;
+  FeatureChannels surf_channels_less_flat;
+};
+/*//}*/
+
 class AloamOdometry {
 
 public:
-  AloamOdometry(const ros::NodeHandle &parent_nh, const std::string uav_name, const std::shared_ptr<mrs_lib::Profiler> profiler,
-                const std::shared_ptr<AloamMapping> aloam_mapping, const std::string &frame_fcu, const std::string &frame_lidar, const std::string &frame_odom,
-                const float scan_period_sec, const tf::Transform &tf_lidar_to_fcu, const bool enable_scope_timer,
-                const std::shared_ptr<mrs_lib::ScopeTimerLogger> scope_timer_logger);
+  AloamOdometry(const ros::NodeHandle &parent_nh, mrs_lib::ParamLoader param_loader, const std::string uav_name,
+                const std::shared_ptr<mrs_lib::Profiler> profiler, const std::shared_ptr<AloamMapping> aloam_mapping, const std::string &frame_fcu,
+                const std::string &frame_lidar, const std::string &frame_odom, const float scan_period_sec, const tf::Transform &tf_lidar_to_fcu,
+                const SharedWorkers &shared_workers, const bool enable_scope_timer, const std::shared_ptr<mrs_lib::ScopeTimerLogger> scope_timer_logger);
+  ~AloamOdometry();
 
   std::atomic<bool> is_initialized = false;
 
-  void setData(pcl::PointCloud<PointType>::Ptr corner_points_sharp, pcl::PointCloud<PointType>::Ptr corner_points_less_sharp,
-               pcl::PointCloud<PointType>::Ptr surf_points_flat, pcl::PointCloud<PointType>::Ptr surf_points_less_flat,
-               pcl::PointCloud<PointType>::Ptr laser_cloud_full_res);
+  void setData(OdometryFrame frame);
 
   void setTransform(const Eigen::Vector3d &t, const Eigen::Quaterniond &q, const ros::Time &stamp);
 
+  // motion of the lidar between the last two processed frames `dt` seconds apart, returns false before two frames were processed
+  bool getLastMotion(Eigen::Quaterniond &q_last_curr, Eigen::Vector3d &t_last_curr, double &dt);
+
+  void setFrameObserver(const std::shared_ptr<FrameObserver> &observer);
+
 private:
   bool _enable_scope_timer;
 
@@ -28,30 +53,41 @@ private:
   std::shared_ptr<mrs_lib::Profiler>             _profiler;
   std::shared_ptr<AloamMapping>                  _aloam_mapping;
   std::shared_ptr<tf2_ros::TransformBroadcaster> _tf_broadcaster;
-  ros::Timer                                     _timer_odometry_loop;
 
   std::shared_ptr<mrs_lib::Transformer>      _transformer;
   std::shared_ptr<mrs_lib::ScopeTimerLogger> _scope_timer_logger;
+  std::shared_ptr<ThreadPool>                _thread_pool;
+  std::shared_ptr<PoseSolver>                _pose_solver;
+  std::shared_ptr<FrameObserver>             _frame_observer;
   /* mrs_lib::SubscribeHandler<nav_msgs::Odometry> _sub_handler_orientation; */
 
   std::mutex                      _mutex_odometry_process;
   pcl::PointCloud<PointType>::Ptr _features_corners_last;
   pcl::PointCloud<PointType>::Ptr _features_surfs_last;
+  std::shared_ptr<ScanLineIndex>  _index_corners_last;  // rebuilt from the features of the previous frame, the buffers are reused
+  std::shared_ptr<ScanLineIndex>  _index_surfs_last;
+  FeatureChannels                 _channels_corners_last;  // rings of the previous features the indices are built from
+  FeatureChannels                 _channels_surfs_last;
+
+  // search buffers reused between the frames (the kd-trees are rebuilt from the features of the previous frame)
+  pcl::KdTreeFLANN<PointType>                   _kdtree_corners_last;
+  pcl::KdTreeFLANN<PointType>                   _kdtree_surfs_last;
+  std::vector<EdgeCorrespondence>               _corner_correspondences;
+  std::vector<PlaneCorrespondence>              _plane_correspondences;
+  std::vector<std::vector<EdgeCorrespondence>>  _corner_chunk_correspondences;
+  std::vector<std::vector<PlaneCorrespondence>> _plane_chunk_correspondences;
+  MotionBins                                    _motion_bins;  // sampled from the current estimate of the motion by every iteration
 
   Eigen::Quaterniond _q_w_curr;
   Eigen::Vector3d    _t_w_curr;
 
-  // Feature extractor newest data
-  std::mutex                      _mutex_extracted_features;
-  bool                            _has_new_data = false;
-  pcl::PointCloud<PointType>::Ptr _corner_points_sharp;
-  pcl::PointCloud<PointType>::Ptr _corner_points_less_sharp;
-  pcl::PointCloud<PointType>::Ptr _surf_points_flat;
-  pcl::PointCloud<PointType>::Ptr _surf_points_less_flat;
-  pcl::PointCloud<PointType>::Ptr _cloud_full_ress;
+  // frames from the feature extractor, processed by the odometry thread as they arrive
+  std::shared_ptr<FrameChannel<OdometryFrame>> _queue_features;
+  std::thread                                  _thread_odometry;
 
   // publishers and subscribers
   ros::Publisher _pub_odometry_local;
+  ros::Publisher _pub_diagnostics;
 
   // member variables
   std::string _frame_fcu;
@@ -60,8 +96,17 @@ private:
 
   float _scan_period_sec;
 
+  FactorType _factor_type;
+  SolverType _solver_type;
+  int        _outer_iterations;
+  int        _ceres_max_iterations;
+
   long int _frame_count = 0;
 
+  // frames passed to the mapping and frames discarded by the odometry since the start (published in the diagnostics)
+  unsigned long _frames_processed = 0;
+  unsigned long _frames_dropped   = 0;
+
   tf::Transform _tf_lidar_to_fcu;
 
   double                         _para_q[4] = {0, 0, 0, 1};
@@ -69,16 +114,21 @@ private:
   Eigen::Map<Eigen::Quaterniond> _q_last_curr;
   Eigen::Map<Eigen::Vector3d>    _t_last_curr;
 
+  std::mutex         _mutex_last_motion;
+  bool               _has_last_motion = false;
+  Eigen::Quaterniond _last_motion_q;
+  Eigen::Vector3d    _last_motion_t;
+  double             _last_motion_dt;
+  ros::Time          _stamp_last_frame;
+
   // constants
   const double DISTANCE_SQ_THRESHOLD = 25.0;
   const double NEARBY_SCAN           = 2.5;
   const bool   DISTORTION            = false;
 
   // member methods
-  void timerOdometry([[maybe_unused]] const ros::TimerEvent &event);
-
-  void TransformToStart(PointType const *const pi, PointType *const po);
-  void TransformToEnd(PointType const *const pi, PointType *const po);
+  void threadOdometry();
+  void processFrame(OdometryFrame &frame);
 };
 }  // namespace aloam_slam
 #endif
@@ -0,0 +1,81 @@
+#ifndef ALOAM_POINT_CLOUD_FIELDS_H
+#define ALOAM_POINT_CLOUD_FIELDS_H
+
+/* includes //{ */
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/PointField.h>
+
+//}
+
+namespace aloam_slam
+{
+
+/*//{ struct PointCloudField */
+// Offset and datatype of a field of sensor_msgs::PointCloud2, used to read the fields directly from the message buffer
+struct PointCloudField
+{
+  int     offset   = -1;
+  uint8_t datatype = 0;
+
+  bool valid() const {
+    return offset >= 0;
+  }
+};
+/*//}*/
+
+/*//{ findField() */
+inline PointCloudField findField(const sensor_msgs::PointCloud2 &msg, const std::string &name) {
+  PointCloudField field;
+  for (const auto &f : msg.fields) {
+    if (f.name == name) {
+      field.offset   = int(f.offset);
+      field.datatype = f.datatype;
+      break;
+    }
+  }
+  return field;
+}
+/*//}*/
+
+/*//{ readField() */
+// reads the field of the point starting at `point_data` and converts it to T (the message is expected in the host byte order)
+template <typename T>
+inline T readField(const uint8_t *point_data, const PointCloudField &field) {
+  const uint8_t *ptr = point_data + field.offset;
+
+  const auto read = [ptr](auto value) {
+    std::memcpy(&value, ptr, sizeof(value));
+    return T(value);
+  };
+
+  switch (field.datatype) {
+    case sensor_msgs::PointField::INT8:
+      return read(int8_t(0));
+    case sensor_msgs::PointField::UINT8:
+      return read(uint8_t(0));
+    case sensor_msgs::PointField::INT16:
+      return read(int16_t(0));
+    case sensor_msgs::PointField::UINT16:
+      return read(uint16_t(0));
+    case sensor_msgs::PointField::INT32:
+      return read(int32_t(0));
+    case sensor_msgs::PointField::UINT32:
+      return read(uint32_t(0));
+    case sensor_msgs::PointField::FLOAT32:
+      return read(float(0));
+    case sensor_msgs::PointField::FLOAT64:
+      return read(double(0));
+    default:
+      return T(0);
+  }
+}
+/*//}*/
+
+}  // namespace aloam_slam
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef ALOAM_POSE_SOLVER_H
+#define ALOAM_POSE_SOLVER_H
+
+/* includes //{ */
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <eigen3/Eigen/Dense>
+
+#include "aloam_slam/batched_factor.h"
+
+//}
+
+namespace aloam_slam
+{
+
+// solver of the scan registration, CERES builds and solves a ceres::Problem, GAUSS_NEWTON uses the PoseSolver below
+enum class SolverType
+{
+  CERES,
+  GAUSS_NEWTON,
+};
+
+/*//{ parseSolverType() */
+inline bool parseSolverType(const std::string &name, SolverType &type) {
+  if (name == "ceres") {
+    type = SolverType::CERES;
+  } else if (name == "gauss_newton") {
+    type = SolverType::GAUSS_NEWTON;
+  } else {
+    return false;
+  }
+  return true;
+}
+/*//}*/
+
+/*//{ struct PoseSolverOptions */
+struct PoseSolverOptions
+{
+  // Levenberg-Marquardt damping with step rejection, plain Gauss-Newton otherwise
+  bool levenberg_marquardt = true;
+  int  max_iterations      = 4;
+
+  // Huber reweighting of the correspondences (iteratively reweighted least squares), disabled if not positive
+  double huber_delta = 0.1;
+
+  // the iterations stop when the norm of the update or the relative decrease of the cost falls below these thresholds
+  double min_update_norm            = 1e-6;
+  double min_relative_cost_decrease = 1e-6;
+};
+/*//}*/
+
+/*//{ struct PoseSolverSummary */
+struct PoseSolverSummary
+{
+  int    iterations   = 0;
+  bool   converged    = false;
+  double initial_cost = 0.0;
+  double final_cost   = 0.0;
+
+  // J^T * J (with the robust weights) at the initial pose, in the tangent space [theta_x, theta_y, theta_z, x, y, z]
+  Eigen::Matrix<double, 6, 6> information = Eigen::Matrix<double, 6, 6>::Zero();
+};
+/*//}*/
+
+/*//{ class PoseSolver */
+// Lightweight solver of the 6-DoF registration of a scan to the correspondences held by a BatchedLidarFactor.
+// The 6x6 normal equations are accumulated directly from the residuals and solved by LDLT. The pose is updated in the same
+// tangent space as ceres::EigenQuaternionParameterization uses, i.e., q <- [sin(|d|) * d / |d|, cos(|d|)] * q, t <- t + dt.
+class PoseSolver {
+
+public:
+  explicit PoseSolver(const PoseSolverOptions &options);
+
+  // q = [x, y, z, w], t = [x, y, z] are updated in place, the factor should be constructed without a loss function
+  PoseSolverSummary solve(const BatchedLidarFactor &factor, double *q, double *t) const;
+
+  // J^T * J (with the robust weights) at the given pose, in the tangent space
+  Eigen::Matrix<double, 6, 6> information(const BatchedLidarFactor &factor, const double *q, const double *t) const;
+
+private:
+  PoseSolverOptions _options;
+
+  // returns the robustified cost, H and g are filled only if they are not null
+  double linearize(const BatchedLidarFactor &factor, const double *q, const double *t, std::vector<double> &residuals, std::vector<double> &jacobian_q,
+                   std::vector<double> &jacobian_t, Eigen::Matrix<double, 6, 6> *H, Eigen::Matrix<double, 6, 1> *g) const;
+};
+/*//}*/
+
+// q <- [sin(|d|) * d / |d|, cos(|d|)] * q, t <- t + dt for dx = [d, dt]
+void applyPoseUpdate(const Eigen::Matrix<double, 6, 1> &dx, double *q, double *t);
+
+// inverse of applyPoseUpdate(): dx such that applying it to (q_from, t_from) gives (q_to, t_to)
+Eigen::Matrix<double, 6, 1> poseDifference(const double *q_from, const double *t_from, const double *q_to, const double *t_to);
+
+// for every tangent axis [theta_x, theta_y, theta_z, x, y, z], the eigenvalue of the information matrix whose eigenvector is dominated by the axis
+Eigen::Matrix<double, 6, 1> axisEigenvalues(const Eigen::Matrix<double, 6, 6> &information);
+
+// projection of the tangent space onto the eigenvectors of the information matrix with eigenvalues above the threshold,
+// i.e., the update is kept only in the well-constrained directions (degenerate directions are left at the prior)
+Eigen::Matrix<double, 6, 6> degeneracyProjection(const Eigen::Matrix<double, 6, 6> &information, const double eigenvalue_threshold);
+
+}  // namespace aloam_slam
+
+#endif
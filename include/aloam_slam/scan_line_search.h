@@ -0,0 +1,109 @@
+#ifndef ALOAM_SCAN_LINE_SEARCH_H
+#define ALOAM_SCAN_LINE_SEARCH_H
+
+/* includes //{ */
+
+#include <vector>
+
+#include <eigen3/Eigen/Dense>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/kdtree/kdtree_flann.h>
+
+#include "aloam_slam/common.h"
+#include "aloam_slam/correspondences.h"
+#include "aloam_slam/feature_cloud.h"
+
+//}
+
+namespace aloam_slam
+{
+
+/*//{ struct ScanLineSearchParams */
+struct ScanLineSearchParams
+{
+  double distance_sq_threshold = 25.0;  // [m^2] the farthest accepted neighbor
+  double nearby_scan           = 2.5;   // [rings] the farthest ring searched for the second (and third) point
+
+  // the points are interpolated within the scan by their time (FeatureChannels::time) instead of transformed by the whole motion
+  bool distortion = false;
+  int  time_bins  = 64;  // [-] the share of the motion is sampled once per bin of the scan duration
+};
+/*//}*/
+
+/*//{ class MotionBins */
+// Motion of the current scan in the previous one (q_last_curr, t_last_curr) as transformations of the points. With params.distortion, the share
+// of the motion is sampled at the centers of uniform time bins of the scan and every point is transformed by the share of its bin (as by
+// Deskewer) instead of slerping the motion per point. Otherwise there is a single bin with the whole motion.
+class MotionBins {
+
+public:
+  // sampled once the motion changes, before the correspondences are searched
+  void sample(const Eigen::Quaterniond &q_last_curr, const Eigen::Vector3d &t_last_curr, const ScanLineSearchParams &params);
+
+  int bins() const;
+
+  // bin of the point at the time (relative to the scan period)
+  int binOf(const float time) const;
+
+  const Eigen::Matrix4f &transform(const int bin) const;
+
+private:
+  std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f>> _transforms;
+};
+/*//}*/
+
+/*//{ class ScanLineIndex */
+// Features of the previous scan grouped by the ring, the points of every ring are stored contiguously (x, y, z and the azimuth in separate
+// arrays) and sorted by the azimuth. The rings of the points are taken from the channels of the cloud (FeatureChannels::ring).
+// The nearest point of a ring is searched outwards from the azimuth of the query. A point of the ring at the azimuth difference d is at least
+// r * sin(d) (r for d >= pi/2) away from the query at the horizontal range r, so the search stops once this bound exceeds the nearest distance.
+class ScanLineIndex {
+
+public:
+  // the channels hold the ring of every point of the cloud
+  void build(const pcl::PointCloud<PointType> &cloud, const FeatureChannels &channels);
+
+  int rings() const;
+
+  // ring of the point of the cloud the index was built from
+  int ringOf(const int index) const;
+
+  Eigen::Vector3d point(const int index) const;
+
+  // the point of the ring nearer to `point` than sqrt(sq_dist) other than `exclude` (index in the cloud), its squared distance is written to
+  // sq_dist, returns the index of the point in the cloud or -1 if there is none
+  int nearestInRing(const int ring, const Eigen::Vector3f &point, const float azimuth, const int exclude, float &sq_dist) const;
+
+private:
+  // the points of ring r are [_ring_offsets[r], _ring_offsets[r + 1]) in the sorted arrays
+  std::vector<int>   _ring_offsets;
+  std::vector<float> _x;
+  std::vector<float> _y;
+  std::vector<float> _z;
+  std::vector<float> _azimuth;
+  std::vector<int>   _cloud_index;  // index in the cloud of the sorted point
+
+  // per point of the cloud
+  std::vector<int>   _ring_of_point;
+  std::vector<float> _azimuth_of_point;
+  std::vector<int>   _sorted_of_point;  // position of the point in the sorted arrays
+};
+/*//}*/
+
+// Correspondences of the odometry (the kernels of AloamOdometry).
+// Every point in [begin, end) of `points` is transformed to the previous scan by `motion` (by the bin of its time in `channels` of `points`),
+// and its nearest feature of the previous scan is found in the kd-tree (built from the same cloud as `index_last`). The other points of the line
+// (plane) are then the nearest points of the nearby rings (the same ring) found in `index_last`.
+void findEdgeCorrespondences(const pcl::KdTreeFLANN<PointType> &kdtree_last, const ScanLineIndex &index_last, const pcl::PointCloud<PointType> &points,
+                             const FeatureChannels &channels, const MotionBins &motion, const ScanLineSearchParams &params, const std::size_t begin,
+                             const std::size_t end, std::vector<EdgeCorrespondence> &correspondences);
+
+void findPlaneCorrespondences(const pcl::KdTreeFLANN<PointType> &kdtree_last, const ScanLineIndex &index_last, const pcl::PointCloud<PointType> &points,
+                              const FeatureChannels &channels, const MotionBins &motion, const ScanLineSearchParams &params, const std::size_t begin,
+                              const std::size_t end, std::vector<PlaneCorrespondence> &correspondences);
+
+}  // namespace aloam_slam
+
+#endif
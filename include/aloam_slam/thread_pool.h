@@ -0,0 +1,157 @@
+#ifndef ALOAM_THREAD_POOL_H
+#define ALOAM_THREAD_POOL_H
+
+/* includes //{ */
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <memory>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+//}
+
+namespace aloam_slam
+{
+
+/*//{ class WorkerPool */
+// Worker threads shared by the thread pools of several pipeline stages and instances (e.g., all nodelets in one nodelet manager), so that the
+// cores are not oversubscribed by a pool per stage. The tasks are run by the priority of their submitter (higher first, in the order of
+// submission within the same priority).
+class WorkerPool {
+
+public:
+  explicit WorkerPool(const int num_threads);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  // the pool shared by the whole process, created with num_threads (<= 0: one per core) by the first call, the later calls get the same pool
+  static std::shared_ptr<WorkerPool> shared(const int num_threads);
+
+  int size() const;
+
+  void submit(const int priority, std::function<void()> task);
+
+private:
+  struct Task
+  {
+    int                   priority;
+    unsigned long         sequence;
+    std::function<void()> fn;
+
+    bool operator<(const Task &other) const {
+      return priority != other.priority ? priority < other.priority : sequence > other.sequence;
+    }
+  };
+
+  std::vector<std::thread> _workers;
+
+  std::mutex                _mutex;
+  std::condition_variable   _cv_task;
+  std::priority_queue<Task> _tasks;
+  unsigned long             _sequence = 0;
+  bool                      _stop     = false;
+
+  void workerLoop();
+};
+/*//}*/
+
+/*//{ class ThreadPool */
+// Fork-join pool for data-parallel loops. The calling thread takes part in the work, so pool of size 1 has no worker threads.
+// A pool on a shared WorkerPool has no threads of its own, its chunks are queued to the shared workers with the priority of the pool. The chunks
+// are claimed by whichever thread comes first, so the calling thread processes the chunks not yet started by the busy workers itself instead of
+// waiting for them. The chunks (and the results of parallelCollect) are the same in both cases.
+// parallelFor() is expected to be called from a single thread (the owner of the pool).
+class ThreadPool {
+
+public:
+  explicit ThreadPool(const int num_threads);
+  ThreadPool(const int num_chunks, const std::shared_ptr<WorkerPool> &workers, const int priority);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  int size() const;
+
+  // Splits [0, count) into size() contiguous chunks (chunk t is processed as fn(t, begin, end)) and blocks until all of them are processed.
+  void parallelFor(const std::size_t count, const std::function<void(const int, const std::size_t, const std::size_t)> &fn);
+
+private:
+  int                      _num_threads;
+  std::vector<std::thread> _workers;
+
+  std::shared_ptr<WorkerPool> _shared_workers;
+  int                         _priority = 0;
+
+  std::mutex              _mutex;
+  std::condition_variable _cv_job;
+  std::condition_variable _cv_done;
+  bool                    _stop       = false;
+  unsigned long           _generation = 0;
+  int                     _pending    = 0;
+  std::size_t             _count      = 0;
+
+  const std::function<void(const int, const std::size_t, const std::size_t)> *_fn = nullptr;
+
+  void workerLoop(const int thread_idx);
+  void parallelForShared(const std::size_t count, const std::function<void(const int, const std::size_t, const std::size_t)> &fn);
+  void runChunk(const int thread_idx, const std::size_t count, const std::function<void(const int, const std::size_t, const std::size_t)> &fn) const;
+};
+/*//}*/
+
+/*//{ struct SharedWorkers */
+// workers of the pools of one pipeline instance, the instance uses pools with own threads if `pool` is nullptr
+struct SharedWorkers
+{
+  std::shared_ptr<WorkerPool> pool;
+  int                         priority = 0;
+};
+
+// pool processing `num_threads` chunks either by own threads or by the shared workers
+inline std::shared_ptr<ThreadPool> createThreadPool(const int num_threads, const SharedWorkers &shared_workers) {
+  if (shared_workers.pool) {
+    return std::make_shared<ThreadPool>(num_threads, shared_workers.pool, shared_workers.priority);
+  }
+  return std::make_shared<ThreadPool>(num_threads);
+}
+/*//}*/
+
+/*//{ parallelCollect() */
+// Runs fn(begin, end, chunk_results) over contiguous chunks of [0, count) in parallel and concatenates the per-chunk results in the order
+// of the chunks, so the output is identical to a serial loop regardless of the number of threads.
+// The per-chunk results are collected in chunk_results, which keeps their capacity when it is reused by the caller between the calls.
+template <typename T, typename F>
+void parallelCollect(ThreadPool &pool, const std::size_t count, std::vector<T> &results, std::vector<std::vector<T>> &chunk_results, const F &fn) {
+  results.clear();
+
+  if (pool.size() == 1) {
+    fn(std::size_t(0), count, results);
+    return;
+  }
+
+  chunk_results.resize(pool.size());
+  for (auto &chunk : chunk_results) {
+    chunk.clear();
+  }
+  pool.parallelFor(count, [&](const int thread_idx, const std::size_t begin, const std::size_t end) { fn(begin, end, chunk_results.at(thread_idx)); });
+
+  std::size_t total = 0;
+  for (const auto &chunk : chunk_results) {
+    total += chunk.size();
+  }
+  results.reserve(total);
+  for (const auto &chunk : chunk_results) {
+    results.insert(results.end(), chunk.begin(), chunk.end());
+  }
+}
+/*//}*/
+
+}  // namespace aloam_slam
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef ALOAM_TRANSFORM_KERNELS_H
+#define ALOAM_TRANSFORM_KERNELS_H
+
+/* includes //{ */
+
+#include <eigen3/Eigen/Dense>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/PointField.h>
+
+#include "aloam_slam/common.h"
+
+//}
+
+namespace aloam_slam
+{
+
+// Writes the points of the cloud into a sensor_msgs::PointCloud2 with fields x, y, z, intensity (float32, 16 B per point).
+// The points are processed as a 3xN matrix strided over the PointType array, so the transformation is a single vectorized matrix product.
+// The message data buffer is resized in place, i.e., a reused message does not allocate once its capacity suffices.
+void toCloudMsg(const pcl::PointCloud<PointType> &cloud, sensor_msgs::PointCloud2 &msg);
+void transformToCloudMsg(const pcl::PointCloud<PointType> &cloud, const Eigen::Matrix4f &transform, sensor_msgs::PointCloud2 &msg);
+
+// rigid transformation p_out = q * p + t as a single precision matrix
+Eigen::Matrix4f toTransform(const Eigen::Quaterniond &q, const Eigen::Vector3d &t);
+
+// Transforms `count` points from `in` to `out` (the ranges may be the same), the intensity is copied.
+// Every point is loaded as one aligned 4-float packet (x, y, z and the padding of PointType) and transformed by three broadcast multiply-adds of
+// the columns of the precomputed matrix, i.e., no quaternion math per point.
+void transformPoints(const PointType *in, const std::size_t count, const Eigen::Matrix4f &transform, PointType *out);
+void transformPoints(const pcl::PointCloud<PointType> &cloud, const Eigen::Matrix4f &transform, pcl::PointCloud<PointType> &out);
+
+}  // namespace aloam_slam
+
+#endif
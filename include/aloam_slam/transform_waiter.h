@@ -0,0 +1,70 @@
+#ifndef ALOAM_TRANSFORM_WAITER_H
+#define ALOAM_TRANSFORM_WAITER_H
+
+/* includes //{ */
+
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <ros/ros.h>
+
+#include <geometry_msgs/TransformStamped.h>
+
+#include <tf2_ros/buffer.h>
+#include <tf2_ros/transform_listener.h>
+
+//}
+
+namespace aloam_slam
+{
+
+/*//{ class TransformWaiter */
+// Waits for transforms without polling the tf buffer. A request is tested by the tf2 buffer whenever a new transform arrives (the transformable
+// requests of tf2::BufferCore, the mechanism behind tf2_ros::MessageFilter), the future of the request becomes ready with the transform as soon
+// as the frames are connected. The latched static transforms arrive right after the listener subscribes, so the transforms of all lidars are
+// usually resolved while the rest of the nodelet is being initialized.
+class TransformWaiter {
+
+public:
+  TransformWaiter();
+  ~TransformWaiter();
+
+  TransformWaiter(const TransformWaiter &) = delete;
+  TransformWaiter &operator=(const TransformWaiter &) = delete;
+
+  // the latest transform from `frame_from` to `frame_to` (the convention of mrs_lib::Transformer::getTransform())
+  std::shared_future<geometry_msgs::TransformStamped> request(const std::string &frame_from, const std::string &frame_to);
+
+  // the pending and the future requests fail with an exception (unblocks the initialization on shutdown)
+  void cancel();
+
+private:
+  struct Request
+  {
+    std::string                                  target_frame;
+    std::string                                  source_frame;
+    std::promise<geometry_msgs::TransformStamped> promise;
+  };
+
+  tf2_ros::Buffer                              _buffer;
+  std::unique_ptr<tf2_ros::TransformListener> _listener;
+  tf2::TransformableCallbackHandle             _callback_handle;
+
+  std::mutex                                                    _mutex;
+  bool                                                          _cancelled = false;
+  std::unordered_map<tf2::TransformableRequestHandle, Request> _requests;
+
+  void callbackTransformable(const tf2::TransformableRequestHandle handle);
+
+  // with the lock
+  void submit(Request &&request);
+  bool resolve(Request &request);
+};
+/*//}*/
+
+}  // namespace aloam_slam
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef ALOAM_VOXEL_INDEX_H
+#define ALOAM_VOXEL_INDEX_H
+
+/* includes //{ */
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include "aloam_slam/common.h"
+#include "aloam_slam/voxel_map.h"
+
+//}
+
+namespace aloam_slam
+{
+
+/*//{ class VoxelIndex */
+// Incremental nearest-neighbor index over a hashed grid of fine voxels.
+// The fine voxels are nested in the map cubes, so the content of a whole cube can be replaced or removed
+// without touching the rest of the index and nothing has to be rebuilt when the map changes.
+// K-nearest-neighbor queries are exact for all neighbors closer than the voxel resolution.
+class VoxelIndex {
+
+public:
+  // resolution is rounded so that every map cube consists of integer number of voxels
+  VoxelIndex(const float cube_size, const float resolution);
+
+  // replaces all points of cube `cube` in the index
+  void setCube(const CubeKey &cube, const pcl::PointCloud<PointType> &points);
+  void removeCube(const CubeKey &cube);
+  void clear();
+
+  // returns number of found neighbors, `neighbors` and `sq_distances` are sorted by increasing distance
+  int nearestKSearch(const PointType &point, const int k, std::vector<PointType> &neighbors, std::vector<float> &sq_distances) const;
+
+  std::size_t size() const;
+
+private:
+  float _cube_size_half;
+  float _resolution;
+  int   _voxels_per_cube;
+
+  std::size_t _points_count = 0;
+
+  std::unordered_map<CubeKey, std::vector<PointType>, CubeKeyHash> _voxels;
+  std::unordered_map<CubeKey, std::vector<CubeKey>, CubeKeyHash>   _cube_voxels;
+
+  CubeKey getVoxelKey(const float x, const float y, const float z) const;
+};
+/*//}*/
+
+}  // namespace aloam_slam
+
+#endif
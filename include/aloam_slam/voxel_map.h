@@ -0,0 +1,171 @@
+#ifndef ALOAM_VOXEL_MAP_H
+#define ALOAM_VOXEL_MAP_H
+
+/* includes //{ */
+
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/filters/voxel_grid.h>
+
+#include "aloam_slam/common.h"
+#include "aloam_slam/cloud_pool.h"
+
+//}
+
+namespace aloam_slam
+{
+
+class VoxelIndex;
+
+/*//{ struct CubeKey */
+// Integer coordinates of a map cube
+struct CubeKey
+{
+  int i = 0;
+  int j = 0;
+  int k = 0;
+
+  bool operator==(const CubeKey &other) const {
+    return i == other.i && j == other.j && k == other.k;
+  }
+};
+
+struct CubeKeyHash
+{
+  std::size_t operator()(const CubeKey &key) const {
+    // spatial hashing primes (Teschner et al., 2003)
+    return (std::size_t(key.i) * 73856093u) ^ (std::size_t(key.j) * 19349663u) ^ (std::size_t(key.k) * 83492791u);
+  }
+};
+/*//}*/
+
+/*//{ struct MapCube */
+// The clouds of a cube in the map are never modified in place, an update replaces them by new clouds (copy-on-write), so a copy of the MapCube
+// taken under the lock of the map stays valid and can be read without the lock
+struct MapCube
+{
+  pcl::PointCloud<PointType>::Ptr corners;
+  pcl::PointCloud<PointType>::Ptr surfs;
+
+  unsigned long version  = 0;      // from a counter of the whole map, increases whenever the clouds are replaced (also if the cube is re-created)
+  bool          modified = false;  // the clouds were updated since the cube was added from outside of the map (e.g., from a map file)
+};
+/*//}*/
+
+/*//{ struct CubeUpdate */
+// points inserted into a cube waiting to be merged into the cube by downsampling
+struct CubeUpdate
+{
+  CubeKey       key;
+  unsigned long epoch = 0;
+  unsigned long version = 0;  // of the cube when the update was taken (0 for a new cube)
+  MapCube       cube;         // current clouds of the cube (null for a new cube), the downsampled clouds after VoxelMap::downsample()
+  MapCube       inserted;     // points inserted since the last downsampling
+};
+/*//}*/
+
+/*//{ class VoxelMap */
+// Sparse map of feature cubes indexed by integer cube coordinates.
+// Cubes are created on first insertion and evicted once they fall out of the configured radius around the vehicle,
+// so moving the vehicle never shifts any data and the map is not bounded by a fixed volume.
+class VoxelMap {
+
+public:
+  // eviction radii are in cubes (Chebyshev distance), non-positive value disables eviction in the respective axes
+  VoxelMap(const float cube_size, const int eviction_radius_xy, const int eviction_radius_z);
+
+  // indices are kept consistent with the content of the cubes (updated after downsampling, eviction and clearing)
+  void attachIndices(const std::shared_ptr<VoxelIndex> &index_corners, const std::shared_ptr<VoxelIndex> &index_surfs);
+
+  // Cube stored outside of the map (e.g., the tile of a streamed map file) of a key which is not in the map, called with the lock of the map
+  // before the first point is inserted into the cube, so the inserted points are merged into the stored cube instead of replacing it.
+  // Returns false if there is no such cube.
+  using CubeLoader = std::function<bool(const CubeKey &key, MapCube &cube)>;
+  void setCubeLoader(const CubeLoader &loader);
+
+  CubeKey getKey(const float x, const float y, const float z) const;
+
+  void insertCorner(const PointType &point);
+  void insertSurf(const PointType &point);
+
+  // keys of existing cubes in the (2*radius_xy+1)x(2*radius_xy+1)x(2*radius_z+1) neighborhood of cube `center`
+  std::vector<CubeKey> getNeighborhood(const CubeKey &center, const int radius_xy, const int radius_z) const;
+
+  void getFeatures(const std::vector<CubeKey> &keys, pcl::PointCloud<PointType> &corners, pcl::PointCloud<PointType> &surfs) const;
+  void getMap(pcl::PointCloud<PointType> &cloud) const;
+
+  // merges the points inserted since the last call into their cubes and downsamples them
+  void downsampleModified(pcl::VoxelGrid<PointType> &filter_corners, pcl::VoxelGrid<PointType> &filter_surfs);
+
+  // The steps of downsampleModified() for downsampling without holding the lock of the map: takeModified() takes the inserted points,
+  // downsample() builds the new clouds of the cubes (the map is not accessed) and replaceCubes() swaps them into the map. Until then, the map
+  // keeps the previous clouds of the cubes and can be read. A cube added or replaced in the meantime (e.g., streamed from the map file) is not
+  // overwritten, the downsampled points are merged into it by the next downsampling.
+  std::vector<CubeUpdate> takeModified();
+  void                    downsample(std::vector<CubeUpdate> &updates, pcl::VoxelGrid<PointType> &filter_corners, pcl::VoxelGrid<PointType> &filter_surfs) const;
+  void                    replaceCubes(const std::vector<CubeUpdate> &updates);
+
+  // the changes are recorded only if enabled (e.g., for the delta map output), they accumulate until takeChanges()
+  void setTrackChanges(const bool track_changes);
+
+  // cubes replaced and keys of cubes removed (evicted or cleared) since the last call
+  void takeChanges(std::vector<std::pair<CubeKey, MapCube>> &changed, std::vector<CubeKey> &removed);
+
+  // all cubes of the map
+  void getCubes(std::vector<std::pair<CubeKey, MapCube>> &cubes) const;
+
+  // adds cubes loaded from outside of the map (e.g., from a map file), cubes already in the map and cubes out of the eviction radius are skipped
+  void addCubes(const std::vector<std::pair<CubeKey, MapCube>> &cubes);
+
+  bool contains(const CubeKey &key) const;
+
+  // removes cubes out of the eviction radius around cube `center`, the removed cubes which are modified are appended to `evicted_modified`
+  void evict(const CubeKey &center, std::vector<std::pair<CubeKey, MapCube>> &evicted_modified);
+
+  void clear();
+
+  std::size_t size() const;
+
+private:
+  float _cube_size;
+  float _cube_size_half;
+  int   _eviction_radius_xy;
+  int   _eviction_radius_z;
+
+  bool    _has_eviction_center = false;
+  CubeKey _eviction_center;
+
+  std::unordered_map<CubeKey, MapCube, CubeKeyHash> _cubes;
+  std::unordered_map<CubeKey, MapCube, CubeKeyHash> _pending_cubes;  // points inserted since the last downsampling
+  std::unordered_set<CubeKey, CubeKeyHash>          _changed_cubes;
+  std::unordered_set<CubeKey, CubeKeyHash>          _removed_cubes;
+  bool                                              _track_changes = false;
+
+  // version of the next replaced cube, never reset, so the versions of a re-created cube keep increasing
+  unsigned long _next_version = 1;
+
+  // incremented by clear(), updates taken before clearing are discarded
+  unsigned long _epoch = 0;
+
+  std::shared_ptr<VoxelIndex> _index_corners;
+  std::shared_ptr<VoxelIndex> _index_surfs;
+
+  std::shared_ptr<CloudPool> _cloud_pool;
+
+  CubeLoader _cube_loader;
+
+  bool     isOutOfEvictionRadius(const CubeKey &key, const CubeKey &center) const;
+  MapCube &getOrCreatePending(const CubeKey &key);
+};
+/*//}*/
+
+}  // namespace aloam_slam
+
+#endif
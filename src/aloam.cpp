@@ -3,6 +3,11 @@
 #include "aloam_slam/feature_extractor.h"
 #include "aloam_slam/odometry.h"
 #include "aloam_slam/mapping.h"
+#include "aloam_slam/feature_merger.h"
+#include "aloam_slam/transform_waiter.h"
+
+#include <atomic>
+#include <future>
 
 #include <tf2_eigen/tf2_eigen.h>
 
@@ -18,33 +23,77 @@ class AloamSlam : public nodelet::Nodelet {
 public:
   virtual void onInit();
 
-  tf::Transform getStaticTf(std::string frame_from, std::string frame_to);
-
-  void initOdom();
+  ~AloamSlam();
 
 private:
-  std::shared_ptr<AloamMapping>              aloam_mapping;
-  std::shared_ptr<AloamOdometry>             aloam_odometry;
-  std::shared_ptr<FeatureExtractor>          feature_extractor;
-  std::shared_ptr<mrs_lib::Profiler>         profiler;
-  std::shared_ptr<mrs_lib::ScopeTimerLogger> scope_timer_logger = nullptr;
+  std::shared_ptr<AloamMapping>                  aloam_mapping;
+  std::shared_ptr<AloamOdometry>                 aloam_odometry;
+  std::shared_ptr<FeatureExtractor>              feature_extractor;
+  std::vector<std::shared_ptr<FeatureExtractor>> secondary_extractors;
+  std::shared_ptr<FeatureMerger>                 feature_merger;
+  std::shared_ptr<mrs_lib::Profiler>             profiler;
+  std::shared_ptr<mrs_lib::ScopeTimerLogger>     scope_timer_logger = nullptr;
+  std::shared_ptr<TransformWaiter>               transform_waiter;
 
   std::string frame_fcu;
   std::string frame_lidar;
   std::string frame_init;
-  std::thread t_odom_init;
+  std::thread t_init;
+
+  // set on the destruction, stops the initialization
+  std::atomic<bool> stopping = false;
+
+  void initialize();
+
+  bool getStaticTf(const std::shared_future<geometry_msgs::TransformStamped> &tf_future, tf::Transform &tf_ret);
+
+  bool initOdom();
+
+  void setInitialized();
 };
 
 //}
 
 /* //{ onInit() */
 
+// returns right away, the nodelet is initialized by its own thread so the nodelet manager loads the other nodelets meanwhile
 void AloamSlam::onInit() {
-  ros::NodeHandle nh_ = nodelet::Nodelet::getMTPrivateNodeHandle();
+  ROS_INFO("[Aloam]: initializing");
 
-  ros::Time::waitForValid();
+  // the tf listener starts filling its buffer while the parameters are loaded
+  transform_waiter = std::make_shared<TransformWaiter>();
 
-  ROS_INFO("[Aloam]: initializing");
+  t_init = std::thread(&AloamSlam::initialize, this);
+}
+
+//}
+
+/* //{ ~AloamSlam() */
+
+AloamSlam::~AloamSlam() {
+  stopping = true;
+  if (transform_waiter) {
+    transform_waiter->cancel();
+  }
+  if (t_init.joinable()) {
+    t_init.join();
+  }
+}
+
+//}
+
+/* //{ initialize() */
+
+void AloamSlam::initialize() {
+  ros::NodeHandle nh_ = nodelet::Nodelet::getMTPrivateNodeHandle();
+
+  // the simulated time might never become valid, so the waiting is interrupted by the destruction of the nodelet
+  while (!ros::Time::waitForValid(ros::WallDuration(0.1))) {
+    if (stopping || !ros::ok()) {
+      ROS_WARN("[Aloam]: Stopped waiting for a valid time.");
+      return;
+    }
+  }
 
   // | --------------------- parameters ------------------------- |
 
@@ -73,13 +122,41 @@ void AloamSlam::onInit() {
   param_loader.loadParam("scope_timer/enable", enable_scope_timer, false);
   param_loader.loadParam("scope_timer/log_filename", time_logger_filepath, std::string(""));
   const auto initialize_from_odom = param_loader.loadParam2<bool>("initialize_from_odom", false);
+  const auto warm_start_enable    = param_loader.loadParam2<bool>("warm_start/enable", false);
+  const auto warm_start_pose_file = param_loader.loadParam2<std::string>("warm_start/pose_file", std::string(""));
+
+  const auto multi_lidar_enable = param_loader.loadParam2<bool>("multi_lidar/enable", false);
+  const auto secondary_frames   = multi_lidar_enable
+                                      ? param_loader.loadParam2<std::vector<std::string>>("multi_lidar/secondary_frames", std::vector<std::string>())
+                                      : std::vector<std::string>();
 
   if (verbose && ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME, ros::console::levels::Debug)) {
     ros::console::notifyLoggerLevelsChanged();
   }
 
   // | --------------------- tf transformer --------------------- |
-  tf_lidar_in_fcu_frame = getStaticTf(frame_fcu, frame_lidar);
+  // the static transforms of all lidars are requested at once and resolved by the tf listener while the rest is initialized
+  ROS_INFO("[Aloam]: Looking for transform from %s to %s", frame_fcu.c_str(), frame_lidar.c_str());
+  const auto tf_lidar_future = transform_waiter->request(frame_fcu, frame_lidar);
+
+  std::vector<std::shared_future<geometry_msgs::TransformStamped>> tf_secondary_futures;
+  for (const auto &frame : secondary_frames) {
+    tf_secondary_futures.push_back(transform_waiter->request(frame_fcu, frame));
+  }
+
+  // | ----------------------- warm start ----------------------- |
+  // the pose (and the map) persisted by the previous run, the frames are processed right away instead of waiting for the initialization
+  PersistedPose warm_start_pose;
+  bool          warm_start = false;
+  if (warm_start_enable && !warm_start_pose_file.empty()) {
+    std::string error;
+    warm_start = loadPoseFile(warm_start_pose_file, warm_start_pose, error);
+    if (warm_start) {
+      ROS_INFO("[Aloam]: Warm start from the pose persisted at %.3f s.", warm_start_pose.stamp.toSec());
+    } else {
+      ROS_WARN("[Aloam]: No warm start, cannot load the persisted pose: %s", error.c_str());
+    }
+  }
 
   // | ------------------------ profiler ------------------------ |
   profiler = std::make_shared<mrs_lib::Profiler>(nh_, "Aloam", enable_profiler);
@@ -87,83 +164,153 @@ void AloamSlam::onInit() {
   // | ------------------- scope timer logger ------------------- |
   scope_timer_logger = std::make_shared<mrs_lib::ScopeTimerLogger>(time_logger_filepath, enable_scope_timer);
 
+  // | ------------------- latency controller ------------------ |
+  LatencyControllerOptions latency_options;
+  param_loader.loadParam("latency_control/enable", latency_options.enable, latency_options.enable);
+  param_loader.loadParam("latency_control/budget", latency_options.budget_ms, latency_options.budget_ms);
+  param_loader.loadParam("latency_control/gain", latency_options.gain, latency_options.gain);
+  param_loader.loadParam("latency_control/deadband", latency_options.deadband, latency_options.deadband);
+  param_loader.loadParam("latency_control/smoothing", latency_options.smoothing, latency_options.smoothing);
+  param_loader.loadParam("latency_control/min_feature_ratio", latency_options.min_feature_ratio, latency_options.min_feature_ratio);
+  param_loader.loadParam("latency_control/max_resolution_ratio", latency_options.max_resolution_ratio, latency_options.max_resolution_ratio);
+  param_loader.loadParam("latency_control/min_neighborhood_xy", latency_options.min_neighborhood_xy, latency_options.min_neighborhood_xy);
+  const auto latency_controller = std::make_shared<LatencyController>(latency_options);
+
+  // | ---------------------- worker pool ----------------------- |
+  // the association of all instances loaded into the same nodelet manager runs on one pool
+  SharedWorkers shared_workers;
+  if (param_loader.loadParam2<bool>("worker_pool/shared", false)) {
+    shared_workers.pool = WorkerPool::shared(param_loader.loadParam2<int>("worker_pool/threads", 0));
+    param_loader.loadParam("worker_pool/priority", shared_workers.priority, 0);
+    ROS_INFO("[Aloam]: Using the shared worker pool of %d threads with priority %d.", shared_workers.pool->size(), shared_workers.priority);
+  }
+
+  if (!getStaticTf(tf_lidar_future, tf_lidar_in_fcu_frame)) {
+    return;
+  }
+
   // | ----------------------- SLAM handlers  ------------------- |
 
-  aloam_mapping  = std::make_shared<AloamMapping>(nh_, param_loader, profiler, frame_fcu, frame_map, tf_lidar_in_fcu_frame, enable_scope_timer,
-                                                 scope_timer_logger);
-  aloam_odometry = std::make_shared<AloamOdometry>(nh_, uav_name, profiler, aloam_mapping, frame_fcu, frame_lidar, frame_odom, 1.0f / frequency,
-                                                   tf_lidar_in_fcu_frame, enable_scope_timer, scope_timer_logger);
+  aloam_mapping = std::make_shared<AloamMapping>(nh_, param_loader, profiler, frame_fcu, frame_map, tf_lidar_in_fcu_frame, latency_controller,
+                                                 shared_workers, enable_scope_timer, scope_timer_logger);
+
+  // the map file is loaded (and indexed) while the other components are created
+  auto map_loaded = std::async(std::launch::async, [this, warm_start] { aloam_mapping->loadStartupMap(warm_start); });
+
+  aloam_odometry = std::make_shared<AloamOdometry>(nh_, param_loader, uav_name, profiler, aloam_mapping, frame_fcu, frame_lidar, frame_odom,
+                                                   1.0f / frequency, tf_lidar_in_fcu_frame, shared_workers, enable_scope_timer, scope_timer_logger);
   feature_extractor =
-      std::make_shared<FeatureExtractor>(nh_, param_loader, profiler, aloam_odometry, frame_map, 1.0f / frequency, enable_scope_timer, scope_timer_logger);
+      std::make_shared<FeatureExtractor>(nh_, param_loader, profiler, aloam_odometry, frame_map, 1.0f / frequency, tf_lidar_in_fcu_frame,
+                                         latency_controller, "laser_cloud_in", enable_scope_timer, scope_timer_logger);
+
+  // | ------------------- multi-lidar merging ------------------ |
+  // the features of the other lidars (of the same model) are expressed in the primary lidar frame and merged into one frame of the odometry
+  if (multi_lidar_enable) {
+    const auto max_time_difference = param_loader.loadParam2<double>("multi_lidar/max_time_difference", 0.02);
+
+    feature_merger = std::make_shared<FeatureMerger>(aloam_odometry, int(secondary_frames.size()) + 1, max_time_difference);
+    feature_extractor->setMerger(feature_merger, 0, Eigen::Isometry3d::Identity());
+
+    for (std::size_t i = 0; i < secondary_frames.size(); i++) {
+      const int     lidar_index = int(i) + 1;
+      tf::Transform tf_secondary_in_fcu;
+      if (!getStaticTf(tf_secondary_futures.at(i), tf_secondary_in_fcu)) {
+        return;
+      }
+
+      // the static transforms take the points from the fcu frame to the lidar frame
+      Eigen::Isometry3d primary_T_secondary;
+      tf::transformTFToEigen(tf_lidar_in_fcu_frame * tf_secondary_in_fcu.inverse(), primary_T_secondary);
+
+      const auto extractor = std::make_shared<FeatureExtractor>(nh_, param_loader, profiler, aloam_odometry, frame_map, 1.0f / frequency,
+                                                                tf_secondary_in_fcu, latency_controller, "laser_cloud_in_" + std::to_string(lidar_index),
+                                                                enable_scope_timer, scope_timer_logger);
+      extractor->setMerger(feature_merger, lidar_index, primary_T_secondary);
+      secondary_extractors.push_back(extractor);
+      ROS_INFO("[Aloam]: Merging the features of lidar %s (laser_cloud_in_%d).", secondary_frames.at(i).c_str(), lidar_index);
+    }
+  }
+
+  map_loaded.wait();
 
   if (!param_loader.loadedSuccessfully()) {
     ROS_ERROR("[Aloam]: Could not load all parameters!");
     ros::shutdown();
+    return;
   }
 
-  if (initialize_from_odom) {
-    t_odom_init = std::thread(&AloamSlam::initOdom, this);
-    t_odom_init.detach();
-    ROS_WARN("[Aloam] Waiting for pose initialization.");
-  } else {
-    feature_extractor->is_initialized = true;
-    aloam_odometry->is_initialized    = true;
-    aloam_mapping->is_initialized     = true;
-    ROS_INFO("[Aloam]: \033[1;32minitialized\033[0m");
+  if (warm_start) {
+    // both the odometry and the map frame continue from the persisted pose, the odometry registers the first frame against nothing anyway
+    const ros::Time stamp = ros::Time::now();
+    aloam_odometry->setTransform(warm_start_pose.t_wodom_curr, warm_start_pose.q_wodom_curr, stamp);
+    aloam_mapping->setMapCorrection(warm_start_pose.t_wmap_wodom, warm_start_pose.q_wmap_wodom);
+    aloam_mapping->setTransform(warm_start_pose.t_wodom_curr, warm_start_pose.q_wodom_curr, stamp);
+
+    feature_extractor->skip_initialization_delay = true;
+    for (const auto &extractor : secondary_extractors) {
+      extractor->skip_initialization_delay = true;
+    }
+  } else if (initialize_from_odom && !initOdom()) {
+    return;
   }
+
+  setInitialized();
 }
 
 //}
 
 /*//{ getStaticTf() */
-tf::Transform AloamSlam::getStaticTf(std::string frame_from, std::string frame_to) {
-  tf::Transform        tf_ret;
-  mrs_lib::Transformer transformer("Aloam");
-  ros::Duration(1.0).sleep();  // Wait for TF buffer to fill
-
-  ROS_INFO_ONCE("[Aloam]: Looking for transform from %s to %s", frame_from.c_str(), frame_to.c_str());
-  auto tf_lidar_fcu = transformer.getTransform(frame_from, frame_to, ros::Time(0));
-  while (!tf_lidar_fcu) {
-    tf_lidar_fcu = transformer.getTransform(frame_from, frame_to, ros::Time(0));
-    ros::Duration(0.1).sleep();
+// blocks until the transform arrives, the waiting thread is woken up by the tf listener (the buffer is not polled)
+bool AloamSlam::getStaticTf(const std::shared_future<geometry_msgs::TransformStamped> &tf_future, tf::Transform &tf_ret) {
+  try {
+    const geometry_msgs::TransformStamped tf_msg = tf_future.get();
+    ROS_INFO("[Aloam]: Successfully found transformation from %s to %s.", tf_msg.child_frame_id.c_str(), tf_msg.header.frame_id.c_str());
+    tf::transformMsgToTF(tf_msg.transform, tf_ret);
+    return true;
+  }
+  catch (const std::exception &e) {
+    ROS_WARN("[Aloam]: Stopped waiting for a static transform: %s", e.what());
+    return false;
   }
-  ROS_INFO("[Aloam]: Successfully found transformation from %s to %s.", frame_from.c_str(), frame_to.c_str());
-
-  tf::transformMsgToTF(tf_lidar_fcu->transform, tf_ret);
-  return tf_ret;
 }
 /*//}*/
 
 /* initOdom() //{ */
 
-void AloamSlam::initOdom() {
-  mrs_lib::Transformer transformer("Aloam");
-
+bool AloamSlam::initOdom() {
   ROS_WARN_STREAM("[Aloam] Waiting for transformation between " << frame_lidar << " and " << frame_init << ".");
-  bool got_tf = false;
-  while (!got_tf && ros::ok()) {
-    const auto tf_opt = transformer.getTransform(frame_lidar, frame_init, ros::Time(0));
-    if (tf_opt.has_value()) {
 
-      const auto tf = tf2::transformToEigen(tf_opt->transform);
+  geometry_msgs::TransformStamped tf_msg;
+  try {
+    tf_msg = transform_waiter->request(frame_lidar, frame_init).get();
+  }
+  catch (const std::exception &e) {
+    ROS_WARN("[Aloam]: Stopped waiting for the odometry initialization transform: %s", e.what());
+    return false;
+  }
+
+  const auto tf = tf2::transformToEigen(tf_msg.transform);
 
-      /* Eigen::Isometry3d init_T = tf2::transformToEigen(tf.transform); */
-      Eigen::Vector3d    t(tf.translation());
-      Eigen::Quaterniond q(tf.rotation());
+  Eigen::Vector3d    t(tf.translation());
+  Eigen::Quaterniond q(tf.rotation());
 
-      aloam_odometry->setTransform(t, q, tf_opt->header.stamp);
-      aloam_mapping->setTransform(t, q, tf_opt->header.stamp);
+  aloam_odometry->setTransform(t, q, tf_msg.header.stamp);
+  aloam_mapping->setTransform(t, q, tf_msg.header.stamp);
+  return true;
+}
 
-      feature_extractor->is_initialized = true;
-      aloam_odometry->is_initialized    = true;
-      aloam_mapping->is_initialized     = true;
-      got_tf                            = true;
-      ROS_INFO("[Aloam]: \033[1;32minitialized\033[0m");
-    } else {
-      ROS_WARN_STREAM_THROTTLE(1.0, "[AloamSlam]: Did not get odometry initialization transform between " << frame_lidar << " and " << frame_init << ".");
-      ros::Duration(0.1).sleep();
-    }
+//}
+
+/* setInitialized() //{ */
+
+void AloamSlam::setInitialized() {
+  feature_extractor->is_initialized = true;
+  for (const auto &extractor : secondary_extractors) {
+    extractor->is_initialized = true;
   }
+  aloam_odometry->is_initialized = true;
+  aloam_mapping->is_initialized  = true;
+  ROS_INFO("[Aloam]: \033[1;32minitialized\033[0m");
 }
 
 //}
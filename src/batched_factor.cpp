@@ -0,0 +1,219 @@
+#include "aloam_slam/batched_factor.h"
+
+namespace aloam_slam
+{
+
+/*//{ BatchedLidarFactor() */
+BatchedLidarFactor::BatchedLidarFactor(ceres::LossFunction *loss_function) : _loss_function(loss_function) {
+  mutable_parameter_block_sizes()->push_back(4);
+  mutable_parameter_block_sizes()->push_back(3);
+  set_num_residuals(0);
+}
+/*//}*/
+
+/*//{ addEdge() */
+void BatchedLidarFactor::addEdge(const EdgeCorrespondence &corr) {
+  // (lp - a) x (lp - b) / |a - b| == (lp - a) x d
+  const Eigen::Vector3d direction = (corr.point_a - corr.point_b).normalized();
+
+  _edge_px.push_back(corr.curr_point.x());
+  _edge_py.push_back(corr.curr_point.y());
+  _edge_pz.push_back(corr.curr_point.z());
+  _edge_ax.push_back(corr.point_a.x());
+  _edge_ay.push_back(corr.point_a.y());
+  _edge_az.push_back(corr.point_a.z());
+  _edge_dx.push_back(direction.x());
+  _edge_dy.push_back(direction.y());
+  _edge_dz.push_back(direction.z());
+  _edge_s.push_back(corr.s);
+
+  set_num_residuals(num_residuals() + 3);
+}
+/*//}*/
+
+/*//{ addPlane() */
+void BatchedLidarFactor::addPlane(const PlaneCorrespondence &corr) {
+  const Eigen::Vector3d norm = (corr.point_j - corr.point_l).cross(corr.point_j - corr.point_m).normalized();
+
+  _plane_px.push_back(corr.curr_point.x());
+  _plane_py.push_back(corr.curr_point.y());
+  _plane_pz.push_back(corr.curr_point.z());
+  _plane_nx.push_back(norm.x());
+  _plane_ny.push_back(norm.y());
+  _plane_nz.push_back(norm.z());
+  _plane_offset.push_back(-norm.dot(corr.point_j));
+  _plane_s.push_back(corr.s);
+
+  set_num_residuals(num_residuals() + 1);
+}
+
+void BatchedLidarFactor::addPlane(const PlaneNormCorrespondence &corr) {
+  _plane_px.push_back(corr.curr_point.x());
+  _plane_py.push_back(corr.curr_point.y());
+  _plane_pz.push_back(corr.curr_point.z());
+  _plane_nx.push_back(corr.plane_unit_norm.x());
+  _plane_ny.push_back(corr.plane_unit_norm.y());
+  _plane_nz.push_back(corr.plane_unit_norm.z());
+  _plane_offset.push_back(corr.negative_OA_dot_norm);
+  _plane_s.push_back(1.0);
+
+  set_num_residuals(num_residuals() + 1);
+}
+/*//}*/
+
+/*//{ numEdges() */
+std::size_t BatchedLidarFactor::numEdges() const {
+  return _edge_s.size();
+}
+/*//}*/
+
+/*//{ numPlanes() */
+std::size_t BatchedLidarFactor::numPlanes() const {
+  return _plane_s.size();
+}
+/*//}*/
+
+/*//{ Evaluate() */
+bool BatchedLidarFactor::Evaluate(double const *const *parameters, double *residuals, double **jacobians) const {
+
+  const Eigen::Map<const Eigen::Quaterniond> q(parameters[0]);
+  const Eigen::Map<const Eigen::Vector3d>    t(parameters[1]);
+
+  double *jacobian_q = jacobians ? jacobians[0] : nullptr;
+  double *jacobian_t = jacobians ? jacobians[1] : nullptr;
+
+  // Eigen rotates by a (not necessarily unit) quaternion as R(q) * p = p + 2w (u x p) + 2 u x (u x p), the coefficients of R(q) are
+  // the same, and the derivative of R(q) * p with respect to the k-th quaternion coefficient is linear in p: dR_k * p
+  const Eigen::Matrix3d R = q.toRotationMatrix();
+  const Eigen::Vector3d u = q.vec();
+  const double          w = q.w();
+
+  Eigen::Matrix3d dR[4];
+  for (int k = 0; k < 3; k++) {
+    const Eigen::Vector3d e = Eigen::Vector3d::Unit(k);
+    Eigen::Matrix3d       e_skew;
+    e_skew << 0, -e.z(), e.y(), e.z(), 0, -e.x(), -e.y(), e.x(), 0;
+    dR[k] = 2.0 * (w * e_skew + u * e.transpose() + e * u.transpose() - 2.0 * u(k) * Eigen::Matrix3d::Identity());
+  }
+  dR[3] << 0, -2.0 * u.z(), 2.0 * u.y(), 2.0 * u.z(), 0, -2.0 * u.x(), -2.0 * u.y(), 2.0 * u.x(), 0;
+
+  // lp = q_s * p + s * t, the slerp is skipped for s == 1 (no distortion), where it does not change the rotation
+  const auto interpolatedPoint = [&](const Eigen::Vector3d &p, const double s, Eigen::Matrix<double, 3, 4> &dlp_dq) {
+    if (s == 1.0) {
+      for (int k = 0; k < 4; k++) {
+        dlp_dq.col(k) = dR[k] * p;
+      }
+      return Eigen::Vector3d(R * p + t);
+    }
+    return lidar_factor_jacobians::interpolatedPoint(parameters[0], parameters[1], p, s, &dlp_dq);
+  };
+
+  Eigen::Matrix<double, 3, 4> dlp_dq;
+  int                         row = 0;
+
+  /*//{ point-to-line */
+  for (std::size_t i = 0; i < _edge_s.size(); i++, row += 3) {
+    const Eigen::Vector3d p(_edge_px[i], _edge_py[i], _edge_pz[i]);
+    const Eigen::Vector3d a(_edge_ax[i], _edge_ay[i], _edge_az[i]);
+    const Eigen::Vector3d d(_edge_dx[i], _edge_dy[i], _edge_dz[i]);
+    const double          s = _edge_s[i];
+
+    const Eigen::Vector3d lp = interpolatedPoint(p, s, dlp_dq);
+
+    Eigen::Map<Eigen::Vector3d> residual(residuals + row);
+    residual = (lp - a).cross(d);
+
+    // dr/dlp = -[d]x
+    Eigen::Matrix3d dr_dlp;
+    dr_dlp << 0, d.z(), -d.y(), -d.z(), 0, d.x(), d.y(), -d.x(), 0;
+
+    if (jacobian_q) {
+      Eigen::Map<Eigen::Matrix<double, 3, 4, Eigen::RowMajor>> J_q(jacobian_q + row * 4);
+      J_q = dr_dlp * dlp_dq;
+    }
+    if (jacobian_t) {
+      Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> J_t(jacobian_t + row * 3);
+      J_t = s * dr_dlp;
+    }
+
+    robustify(residuals + row, 3, jacobian_q ? jacobian_q + row * 4 : nullptr, jacobian_t ? jacobian_t + row * 3 : nullptr);
+  }
+  /*//}*/
+
+  /*//{ point-to-plane */
+  for (std::size_t i = 0; i < _plane_s.size(); i++, row++) {
+    const Eigen::Vector3d p(_plane_px[i], _plane_py[i], _plane_pz[i]);
+    const Eigen::Vector3d n(_plane_nx[i], _plane_ny[i], _plane_nz[i]);
+    const double          s = _plane_s[i];
+
+    const Eigen::Vector3d lp = interpolatedPoint(p, s, dlp_dq);
+
+    residuals[row] = n.dot(lp) + _plane_offset[i];
+
+    if (jacobian_q) {
+      Eigen::Map<Eigen::Matrix<double, 1, 4>> J_q(jacobian_q + row * 4);
+      J_q = n.transpose() * dlp_dq;
+    }
+    if (jacobian_t) {
+      Eigen::Map<Eigen::Matrix<double, 1, 3>> J_t(jacobian_t + row * 3);
+      J_t = s * n.transpose();
+    }
+
+    robustify(residuals + row, 1, jacobian_q ? jacobian_q + row * 4 : nullptr, jacobian_t ? jacobian_t + row * 3 : nullptr);
+  }
+  /*//}*/
+
+  return true;
+}
+/*//}*/
+
+/*//{ robustify() */
+// r' = g(|r|^2) * r with g(sq) = sqrt(rho(sq) / sq), so that |r'|^2 = rho(|r|^2), and J' = g * J + 2 * g'(sq) * r * (r^T * J)
+void BatchedLidarFactor::robustify(double *residuals, const int size, double *jacobian_q, double *jacobian_t) const {
+  if (!_loss_function) {
+    return;
+  }
+
+  double sq_norm = 0.0;
+  for (int i = 0; i < size; i++) {
+    sq_norm += residuals[i] * residuals[i];
+  }
+
+  double rho[3];
+  _loss_function->Evaluate(sq_norm, rho);
+
+  double g, dg;
+  if (sq_norm > 0.0) {
+    g  = std::sqrt(rho[0] / sq_norm);
+    dg = (rho[1] * sq_norm - rho[0]) / (2.0 * sq_norm * sq_norm * g);
+  } else {
+    // limit of rho(sq) / sq for sq -> 0
+    g  = std::sqrt(rho[1]);
+    dg = 0.0;
+  }
+
+  const auto scaleJacobian = [&](double *jacobian, const int cols) {
+    if (!jacobian) {
+      return;
+    }
+    for (int c = 0; c < cols; c++) {
+      double rJ = 0.0;
+      for (int i = 0; i < size; i++) {
+        rJ += residuals[i] * jacobian[i * cols + c];
+      }
+      for (int i = 0; i < size; i++) {
+        jacobian[i * cols + c] = g * jacobian[i * cols + c] + 2.0 * dg * residuals[i] * rJ;
+      }
+    }
+  };
+
+  scaleJacobian(jacobian_q, 4);
+  scaleJacobian(jacobian_t, 3);
+
+  for (int i = 0; i < size; i++) {
+    residuals[i] *= g;
+  }
+}
+/*//}*/
+
+}  // namespace aloam_slam
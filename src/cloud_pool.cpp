@@ -0,0 +1,78 @@
+#include "aloam_slam/cloud_pool.h"
+
+namespace aloam_slam
+{
+
+/*//{ CloudPool() */
+CloudPool::CloudPool(const std::size_t max_cached) : _storage(std::make_shared<Storage>()) {
+  _storage->max_cached = max_cached;
+  _storage->clouds.reserve(max_cached);
+}
+/*//}*/
+
+/*//{ acquire() */
+pcl::PointCloud<PointType>::Ptr CloudPool::acquire() {
+  pcl::PointCloud<PointType> *cloud = nullptr;
+  {
+    std::scoped_lock lock(_storage->mutex);
+    _storage->stats.acquired++;
+    if (!_storage->clouds.empty()) {
+      cloud = _storage->clouds.back();
+      _storage->clouds.pop_back();
+    } else {
+      _storage->stats.allocated++;
+    }
+  }
+
+  if (!cloud) {
+    cloud = new pcl::PointCloud<PointType>();
+  }
+
+  const std::weak_ptr<Storage> storage = _storage;
+  return pcl::PointCloud<PointType>::Ptr(cloud, [storage](pcl::PointCloud<PointType> *cloud) {
+    const std::shared_ptr<Storage> owner = storage.lock();
+    if (owner) {
+      owner->release(cloud);
+    } else {
+      delete cloud;
+    }
+  });
+}
+/*//}*/
+
+/*//{ stats() */
+CloudPoolStats CloudPool::stats() const {
+  std::scoped_lock lock(_storage->mutex);
+  CloudPoolStats   stats = _storage->stats;
+  stats.cached           = _storage->clouds.size();
+  return stats;
+}
+/*//}*/
+
+/*//{ Storage::~Storage() */
+CloudPool::Storage::~Storage() {
+  for (auto *cloud : clouds) {
+    delete cloud;
+  }
+}
+/*//}*/
+
+/*//{ Storage::release() */
+void CloudPool::Storage::release(pcl::PointCloud<PointType> *cloud) {
+  // clear() keeps the capacity of the point buffer
+  cloud->clear();
+  cloud->header   = pcl::PCLHeader();
+  cloud->is_dense = true;
+
+  {
+    std::scoped_lock lock(mutex);
+    if (clouds.size() < max_cached) {
+      clouds.push_back(cloud);
+      return;
+    }
+  }
+  delete cloud;
+}
+/*//}*/
+
+}  // namespace aloam_slam
@@ -0,0 +1,134 @@
+#include "aloam_slam/deskew.h"
+
+namespace aloam_slam
+{
+
+/*//{ Deskewer() */
+Deskewer::Deskewer(const DeskewSource source, const float scan_period_sec, const int time_bins, const Eigen::Quaterniond &q_lidar_fcu)
+    : _source(source), _scan_period_sec(scan_period_sec), _time_bins(std::max(time_bins, 1)), _q_lidar_fcu(q_lidar_fcu.normalized()) {
+  _bin_rotations.resize(_time_bins);
+  _bin_translations.resize(_time_bins);
+}
+/*//}*/
+
+/*//{ source() */
+DeskewSource Deskewer::source() const {
+  return _source;
+}
+/*//}*/
+
+/*//{ setMotion() */
+void Deskewer::setMotion(const Eigen::Quaterniond &q_last_curr, const Eigen::Vector3d &t_last_curr, const double dt) {
+  if (dt <= 0.0) {
+    return;
+  }
+
+  std::scoped_lock lock(_mutex);
+  const Eigen::AngleAxisd rotation(q_last_curr.normalized());
+  _motion_rotation = Eigen::AngleAxisd(rotation.angle() / dt, rotation.axis());
+  _motion_velocity = t_last_curr / dt;
+  _has_motion      = true;
+}
+/*//}*/
+
+/*//{ addOrientation() */
+void Deskewer::addOrientation(const ros::Time &stamp, const Eigen::Quaterniond &orientation) {
+  std::scoped_lock lock(_mutex);
+
+  if (!_orientations.empty() && stamp <= _orientations.back().first) {
+    return;
+  }
+  _orientations.emplace_back(stamp, orientation.normalized());
+
+  // a few scans of history are enough, the scans arrive with a delay shorter than that
+  const ros::Duration history(10.0 * _scan_period_sec);
+  while (_orientations.size() > 2 && stamp - _orientations.front().first > history) {
+    _orientations.pop_front();
+  }
+}
+/*//}*/
+
+/*//{ deskew() */
+bool Deskewer::deskew(FeatureCloud &cloud, const ros::Time &stamp) {
+  if (_source == DeskewSource::NONE || cloud.empty()) {
+    return false;
+  }
+
+  /*//{ Sample the pose in the time bins */
+  {
+    std::scoped_lock lock(_mutex);
+
+    Eigen::Quaterniond orientation_start;
+    bool               use_orientation = _source == DeskewSource::ORIENTATION && interpolateOrientation(stamp, orientation_start);
+    if (use_orientation) {
+      Eigen::Quaterniond orientation_end;
+      use_orientation = interpolateOrientation(stamp + ros::Duration(_scan_period_sec), orientation_end);
+    }
+
+    if (!use_orientation && !_has_motion) {
+      return false;
+    }
+    if (_source == DeskewSource::ORIENTATION && !use_orientation) {
+      ROS_WARN_THROTTLE(1.0, "[Deskewer]: Orientation measurements do not cover the scan, deskewing by the constant velocity.");
+    }
+
+    for (int b = 0; b < _time_bins; b++) {
+      const double time = (b + 0.5) / _time_bins * _scan_period_sec;
+
+      Eigen::Quaterniond q_start_point = Eigen::Quaterniond::Identity();
+      if (use_orientation) {
+        // rotation of the fcu frame since the beginning of the scan expressed in the lidar frame
+        Eigen::Quaterniond orientation_point;
+        interpolateOrientation(stamp + ros::Duration(time), orientation_point);
+        q_start_point = _q_lidar_fcu * (orientation_start.inverse() * orientation_point) * _q_lidar_fcu.inverse();
+      } else if (_has_motion) {
+        q_start_point = Eigen::AngleAxisd(_motion_rotation.angle() * time, _motion_rotation.axis());
+      }
+
+      _bin_rotations[b]    = q_start_point.toRotationMatrix().cast<float>();
+      _bin_translations[b] = _has_motion ? Eigen::Vector3f((_motion_velocity * time).cast<float>()) : Eigen::Vector3f::Zero();
+    }
+  }
+  /*//}*/
+
+  /*//{ Transform the points */
+  const auto binOf = [this, &cloud](const std::size_t i) { return std::min(std::max(int(cloud.time[i] * _time_bins), 0), _time_bins - 1); };
+
+  const std::size_t cloud_size = cloud.size();
+  std::size_t       begin      = 0;
+  while (begin < cloud_size) {
+    const int   bin = binOf(begin);
+    std::size_t end = begin + 1;
+    while (end < cloud_size && binOf(end) == bin) {
+      end++;
+    }
+    cloud.transform(begin, end, _bin_rotations[bin], _bin_translations[bin]);
+    begin = end;
+  }
+  /*//}*/
+
+  return true;
+}
+/*//}*/
+
+/*//{ interpolateOrientation() */
+bool Deskewer::interpolateOrientation(const ros::Time &stamp, Eigen::Quaterniond &orientation) const {
+  if (_orientations.size() < 2 || stamp < _orientations.front().first || stamp > _orientations.back().first) {
+    return false;
+  }
+
+  const auto after = std::lower_bound(_orientations.begin(), _orientations.end(), stamp,
+                                      [](const std::pair<ros::Time, Eigen::Quaterniond> &o, const ros::Time &t) { return o.first < t; });
+  if (after == _orientations.begin()) {
+    orientation = after->second;
+    return true;
+  }
+
+  const auto   before = std::prev(after);
+  const double ratio  = (stamp - before->first).toSec() / (after->first - before->first).toSec();
+  orientation         = before->second.slerp(ratio, after->second);
+  return true;
+}
+/*//}*/
+
+}  // namespace aloam_slam
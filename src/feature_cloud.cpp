@@ -0,0 +1,118 @@
+#include "aloam_slam/feature_cloud.h"
+
+namespace aloam_slam
+{
+
+/*//{ FeatureChannels::size() */
+std::size_t FeatureChannels::size() const {
+  return ring.size();
+}
+/*//}*/
+
+/*//{ FeatureChannels::clear() */
+void FeatureChannels::clear() {
+  ring.clear();
+  time.clear();
+}
+/*//}*/
+
+/*//{ FeatureChannels::push_back() */
+void FeatureChannels::push_back(const int point_ring, const float point_time) {
+  ring.push_back(std::uint16_t(point_ring));
+  time.push_back(point_time);
+}
+/*//}*/
+
+/*//{ FeatureChannels::append() */
+void FeatureChannels::append(const FeatureChannels &other) {
+  ring.insert(ring.end(), other.ring.begin(), other.ring.end());
+  time.insert(time.end(), other.time.begin(), other.time.end());
+}
+/*//}*/
+
+/*//{ size() */
+std::size_t FeatureCloud::size() const {
+  return x.size();
+}
+/*//}*/
+
+/*//{ empty() */
+bool FeatureCloud::empty() const {
+  return x.empty();
+}
+/*//}*/
+
+/*//{ resize() */
+void FeatureCloud::resize(const std::size_t size) {
+  x.resize(size);
+  y.resize(size);
+  z.resize(size);
+  time.resize(size);
+  curvature.resize(size);
+  ring.resize(size);
+}
+/*//}*/
+
+/*//{ clear() */
+void FeatureCloud::clear() {
+  resize(0);
+}
+/*//}*/
+
+/*//{ set() */
+void FeatureCloud::set(const std::size_t i, const float px, const float py, const float pz, const int point_ring, const float point_time) {
+  x[i]    = px;
+  y[i]    = py;
+  z[i]    = pz;
+  ring[i] = std::uint16_t(point_ring);
+  time[i] = point_time;
+}
+/*//}*/
+
+/*//{ toPoint() */
+PointType FeatureCloud::toPoint(const std::size_t i) const {
+  PointType point;
+  point.x         = x[i];
+  point.y         = y[i];
+  point.z         = z[i];
+  point.intensity = float(ring[i]) + scan_period_sec * time[i];
+  return point;
+}
+/*//}*/
+
+/*//{ toPointCloud() */
+void FeatureCloud::toPointCloud(pcl::PointCloud<PointType> &cloud) const {
+  const std::size_t cloud_size = size();
+  cloud.resize(cloud_size);
+  for (std::size_t i = 0; i < cloud_size; i++) {
+    cloud.points[i] = toPoint(i);
+  }
+}
+/*//}*/
+
+/*//{ appendTo() */
+void FeatureCloud::appendTo(const std::size_t i, pcl::PointCloud<PointType> &features, FeatureChannels &channels) const {
+  features.push_back(toPoint(i));
+  channels.push_back(ring[i], time[i]);
+}
+/*//}*/
+
+/*//{ transform() */
+// the loop over the separate arrays has no dependencies between the points, so it is vectorized by the compiler
+void FeatureCloud::transform(const std::size_t begin, const std::size_t end, const Eigen::Matrix3f &R, const Eigen::Vector3f &t) {
+  float *const px = x.data();
+  float *const py = y.data();
+  float *const pz = z.data();
+
+  for (std::size_t i = begin; i < end; i++) {
+    const float xi = px[i];
+    const float yi = py[i];
+    const float zi = pz[i];
+    px[i]          = R(0, 0) * xi + R(0, 1) * yi + R(0, 2) * zi + t.x();
+    py[i]          = R(1, 0) * xi + R(1, 1) * yi + R(1, 2) * zi + t.y();
+    pz[i]          = R(2, 0) * xi + R(2, 1) * yi + R(2, 2) * zi + t.z();
+  }
+}
+/*//}*/
+
+}  // namespace aloam_slam
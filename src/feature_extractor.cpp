@@ -6,9 +6,12 @@ namespace aloam_slam
 /*//{ FeatureExtractor() */
 FeatureExtractor::FeatureExtractor(const ros::NodeHandle &parent_nh, mrs_lib::ParamLoader param_loader, std::shared_ptr<mrs_lib::Profiler> profiler,
                                    const std::shared_ptr<AloamOdometry> odometry, const std::string &map_frame, const float scan_period_sec,
-                                   const bool enable_scope_timer, const std::shared_ptr<mrs_lib::ScopeTimerLogger> scope_timer_logger)
+                                   const tf::Transform &tf_lidar_to_fcu, const std::shared_ptr<LatencyController> latency_controller,
+                                   const std::string &cloud_topic, const bool enable_scope_timer,
+                                   const std::shared_ptr<mrs_lib::ScopeTimerLogger> scope_timer_logger)
     : _profiler(profiler),
       _odometry(odometry),
+      _latency_controller(latency_controller),
       _frame_map(map_frame),
       _scan_period_sec(scan_period_sec),
       _scope_timer_logger(scope_timer_logger),
@@ -16,10 +19,39 @@ FeatureExtractor::FeatureExtractor(const ros::NodeHandle &parent_nh, mrs_lib::Pa
 
   ros::NodeHandle nh_(parent_nh);
 
-  ros::Time::waitForValid();
+  // the clouds of a frame are released by the odometry and the mapping, a few frames may be in flight
+  _cloud_pool       = std::make_shared<CloudPool>(32);
+  _feature_selector = std::make_shared<FeatureSelector>();
 
   param_loader.loadParam("vertical_fov", _vertical_fov_half, -1.0f);
   param_loader.loadParam("scan_line", _number_of_rings, -1);
+  param_loader.loadParam("organized_input/enable", _use_organized_layout, false);
+
+  param_loader.loadParam("feature_selection/regions_per_ring", _regions_per_ring, 6);
+  param_loader.loadParam("feature_selection/sharp_points_per_region", _sharp_points_per_region, 2);
+  param_loader.loadParam("feature_selection/less_sharp_points_per_region", _less_sharp_points_per_region, 20);
+  param_loader.loadParam("feature_selection/flat_points_per_region", _flat_points_per_region, 4);
+  param_loader.loadParam("feature_selection/curvature_threshold", _curvature_threshold, 0.1f);
+
+  if (param_loader.loadParam2<bool>("gpu/feature_selection", false)) {
+    std::string error;
+    if (gpuBackendAvailable(error)) {
+      _gpu_feature_selector = std::make_shared<GpuFeatureSelector>();
+    } else {
+      ROS_WARN("[AloamFeatureExtractor]: GPU feature selection unavailable (%s), selecting the features on the CPU.", error.c_str());
+    }
+  }
+
+  const auto deskew_source_name = param_loader.loadParam2<std::string>("deskew/source", std::string("none"));
+  const auto deskew_time_bins   = param_loader.loadParam2<int>("deskew/time_bins", 64);
+  DeskewSource deskew_source;
+  if (!parseDeskewSource(deskew_source_name, deskew_source)) {
+    ROS_ERROR("[AloamFeatureExtractor]: Unknown deskew source \"%s\", the scans are not deskewed.", deskew_source_name.c_str());
+    deskew_source = DeskewSource::NONE;
+  }
+  Eigen::Quaterniond q_lidar_fcu;
+  tf::quaternionTFToEigen(tf_lidar_to_fcu.getRotation(), q_lidar_fcu);
+  _deskewer = std::make_shared<Deskewer>(deskew_source, scan_period_sec, deskew_time_bins, q_lidar_fcu);
 
   _has_required_parameters = scan_period_sec > 0.0f && _vertical_fov_half > 0.0f && _number_of_rings > 0;
 
@@ -36,198 +68,159 @@ FeatureExtractor::FeatureExtractor(const ros::NodeHandle &parent_nh, mrs_lib::Pa
   mrs_lib::SubscribeHandlerOptions shopts(nh_);
   shopts.node_name          = "FeatureExtractor";
   shopts.no_message_timeout = ros::Duration(5.0);
-  _sub_laser_cloud          = mrs_lib::SubscribeHandler<sensor_msgs::PointCloud2>(shopts, "laser_cloud_in",
+  _sub_laser_cloud          = mrs_lib::SubscribeHandler<sensor_msgs::PointCloud2>(shopts, cloud_topic,
                                                                          std::bind(&FeatureExtractor::callbackLaserCloud, this, std::placeholders::_1));
   /* ROS_INFO_STREAM("[AloamFeatureExtractor]: Listening to laser cloud at topic: " << _sub_laser_cloud.topicName()); */
+
+  _pub_diagnostics = nh_.advertise<aloam_slam::StageDiagnostics>("diagnostics_out", 10);
+
+  if (deskew_source == DeskewSource::ORIENTATION) {
+    mrs_lib::SubscribeHandlerOptions shopts_orientation(nh_);
+    shopts_orientation.node_name          = "FeatureExtractor";
+    shopts_orientation.threadsafe         = true;
+    shopts_orientation.no_message_timeout = mrs_lib::no_timeout;
+    _sub_orientation = mrs_lib::SubscribeHandler<nav_msgs::Odometry>(shopts_orientation, "orientation_in",
+                                                                     std::bind(&FeatureExtractor::callbackOrientation, this, std::placeholders::_1));
+  }
 }
 /*//}*/
 
 /*//{ callbackLaserCloud() */
 void FeatureExtractor::callbackLaserCloud(mrs_lib::SubscribeHandler<sensor_msgs::PointCloud2> &sub) {
-  if (!is_initialized || !sub.hasMsg()) {
+  if (!sub.hasMsg()) {
+    return;
+  }
+  processCloud(sub.getMsg());
+}
+/*//}*/
+
+/*//{ processCloud() */
+void FeatureExtractor::processCloud(const sensor_msgs::PointCloud2::ConstPtr &laserCloudMsg) {
+  const auto dropFrame = [this, &laserCloudMsg]() {
+    _frames_dropped++;
+    if (_frame_observer) {
+      _frame_observer->onFrameDropped(PipelineStage::FEATURE_EXTRACTION, laserCloudMsg->header.stamp);
+    }
+  };
+
+  if (!is_initialized) {
+    dropFrame();
     return;
   }
   if (!_has_required_parameters) {
     ROS_WARN("[AloamFeatureExtractor] Not all parameters loaded from config. Waiting for msg on topic (%s) to read them.",
              _sub_input_data_processing_diag.getTopic().c_str());
+    dropFrame();
     return;
   }
 
-  const auto laserCloudMsg = sub.getMsg();
   if (laserCloudMsg->data.size() == 0) {
     ROS_WARN("[AloamFeatureExtractor]: Received empty laser cloud msg. Skipping frame.");
+    dropFrame();
     return;
   }
   mrs_lib::ScopeTimer timer            = mrs_lib::ScopeTimer("ALOAM::FeatureExtraction::callbackLaserCloud", _scope_timer_logger, _enable_scope_timer);
   mrs_lib::Routine    profiler_routine = _profiler->createRoutine("callbackLaserCloud");
 
+  const auto time_frame_start = std::chrono::steady_clock::now();
+
   // Skip 1s of data
   ROS_INFO_ONCE("[AloamFeatureExtractor]: Received first laser cloud msg.");
-  if (_frame_count++ < _initialization_frames_delay) {
-    if (_frame_count == 1) {
-      _data_have_ring_field = hasField("ring", laserCloudMsg);
-      ROS_INFO_COND(_data_have_ring_field, "[AloamFeatureExtractor]: Laser cloud msg contains field `ring`. Will use this information for data processing.");
-    }
+  if (_frame_count++ == 0) {
+    _data_have_ring_field = hasField("ring", laserCloudMsg);
+    ROS_INFO_COND(_data_have_ring_field, "[AloamFeatureExtractor]: Laser cloud msg contains field `ring`. Will use this information for data processing.");
+  }
+  if (!skip_initialization_delay && _frame_count <= _initialization_frames_delay) {
+    dropFrame();
     return;
   }
 
   // Process input data per row
-  std::vector<int>                      rows_start_idxs(_number_of_rings, 0);
-  std::vector<int>                      rows_end_idxs(_number_of_rings, 0);
-  const pcl::PointCloud<PointType>::Ptr laser_cloud = boost::make_shared<pcl::PointCloud<PointType>>();
-  if (_data_have_ring_field) {
-    parseRowsFromOusterMsg(laserCloudMsg, laser_cloud, rows_start_idxs, rows_end_idxs);
+  _rows_start_idxs.assign(_number_of_rings, 0);
+  _rows_end_idxs.assign(_number_of_rings, 0);
+  _scan.clear();
+  _scan.scan_period_sec = _scan_period_sec;
+  if (_use_organized_layout && int(laserCloudMsg->height) == _number_of_rings) {
+    parseRowsFromOrganizedMsg(laserCloudMsg, _scan, _rows_start_idxs, _rows_end_idxs);
+  } else if (_data_have_ring_field) {
+    parseRowsFromOusterMsg(laserCloudMsg, _scan, _rows_start_idxs, _rows_end_idxs);
   } else {
-    parseRowsFromCloudMsg(laserCloudMsg, laser_cloud, rows_start_idxs, rows_end_idxs);
+    parseRowsFromCloudMsg(laserCloudMsg, _scan, _rows_start_idxs, _rows_end_idxs);
   }
   timer.checkpoint("parsing lidar data");
 
+  if (_scan.size() < 11) {
+    ROS_WARN_THROTTLE(1.0, "[AloamFeatureExtractor]: Not enough valid points in the laser cloud msg. Skipping frame.");
+    dropFrame();
+    return;
+  }
+
+  // the whole scan is deskewed once, the features and the full-resolution cloud are then treated as measured at the stamp of the scan
+  if (_deskewer->source() != DeskewSource::NONE) {
+    Eigen::Quaterniond q_last_curr;
+    Eigen::Vector3d    t_last_curr;
+    double             dt;
+    if (_odometry->getLastMotion(q_last_curr, t_last_curr, dt)) {
+      if (_lidar_index > 0) {
+        // the motion of the odometry is the motion of the primary lidar
+        Eigen::Isometry3d motion = Eigen::Isometry3d::Identity();
+        motion.translate(t_last_curr);
+        motion.rotate(q_last_curr);
+        motion      = _primary_T_lidar.inverse() * motion * _primary_T_lidar;
+        q_last_curr = Eigen::Quaterniond(motion.rotation());
+        t_last_curr = motion.translation();
+      }
+      _deskewer->setMotion(q_last_curr, t_last_curr, dt);
+    }
+    _deskewer->deskew(_scan, laserCloudMsg->header.stamp);
+    timer.checkpoint("deskewing");
+  }
+
   /* if (!isfinite(*laser_cloud)) */
   /*   std::cerr << "                                                                [FeatureExtractor::callbackLaserCloud]: laser_cloud are not finite!!" <<
    * "\n"; */
 
-  std::vector<float> cloudCurvature;
-  std::vector<int>   cloudSortInd;
-  std::vector<int>   cloudNeighborPicked;
-  std::vector<int>   cloudLabel;
-
-  const unsigned int cloud_size = laser_cloud->points.size();
-  cloudCurvature.resize(cloud_size);
-  cloudSortInd.resize(cloud_size);
-  cloudNeighborPicked.resize(cloud_size, 0);
-  cloudLabel.resize(cloud_size, 0);
-
-  for (unsigned int i = 5; i < cloud_size - 5; i++) {
-    const float diffX = laser_cloud->points.at(i - 5).x + laser_cloud->points.at(i - 4).x + laser_cloud->points.at(i - 3).x + laser_cloud->points.at(i - 2).x +
-                        laser_cloud->points.at(i - 1).x - 10 * laser_cloud->points.at(i).x + laser_cloud->points.at(i + 1).x + laser_cloud->points.at(i + 2).x +
-                        laser_cloud->points.at(i + 3).x + laser_cloud->points.at(i + 4).x + laser_cloud->points.at(i + 5).x;
-    const float diffY = laser_cloud->points.at(i - 5).y + laser_cloud->points.at(i - 4).y + laser_cloud->points.at(i - 3).y + laser_cloud->points.at(i - 2).y +
-                        laser_cloud->points.at(i - 1).y - 10 * laser_cloud->points.at(i).y + laser_cloud->points.at(i + 1).y + laser_cloud->points.at(i + 2).y +
-                        laser_cloud->points.at(i + 3).y + laser_cloud->points.at(i + 4).y + laser_cloud->points.at(i + 5).y;
-    const float diffZ = laser_cloud->points.at(i - 5).z + laser_cloud->points.at(i - 4).z + laser_cloud->points.at(i - 3).z + laser_cloud->points.at(i - 2).z +
-                        laser_cloud->points.at(i - 1).z - 10 * laser_cloud->points.at(i).z + laser_cloud->points.at(i + 1).z + laser_cloud->points.at(i + 2).z +
-                        laser_cloud->points.at(i + 3).z + laser_cloud->points.at(i + 4).z + laser_cloud->points.at(i + 5).z;
-
-    cloudCurvature.at(i) = diffX * diffX + diffY * diffY + diffZ * diffZ;
-    cloudSortInd.at(i)   = i;
-  }
-
-  const pcl::PointCloud<PointType>::Ptr corner_points_sharp      = boost::make_shared<pcl::PointCloud<PointType>>();
-  const pcl::PointCloud<PointType>::Ptr corner_points_less_sharp = boost::make_shared<pcl::PointCloud<PointType>>();
-  const pcl::PointCloud<PointType>::Ptr surf_points_flat         = boost::make_shared<pcl::PointCloud<PointType>>();
-  const pcl::PointCloud<PointType>::Ptr surf_points_less_flat    = boost::make_shared<pcl::PointCloud<PointType>>();
+  const pcl::PointCloud<PointType>::Ptr corner_points_sharp      = _cloud_pool->acquire();
+  const pcl::PointCloud<PointType>::Ptr corner_points_less_sharp = _cloud_pool->acquire();
+  const pcl::PointCloud<PointType>::Ptr surf_points_flat         = _cloud_pool->acquire();
+  const pcl::PointCloud<PointType>::Ptr surf_points_less_flat    = _cloud_pool->acquire();
 
-  /*//{ Compute features (planes and edges) in two resolutions */
-  for (int i = 0; i < _number_of_rings; i++) {
-    if (rows_end_idxs.at(i) - rows_start_idxs.at(i) < 6) {
-      continue;
-    }
-    pcl::PointCloud<PointType>::Ptr surfPointsLessFlatScan = boost::make_shared<pcl::PointCloud<PointType>>();
-    for (int j = 0; j < 6; j++) {
-      const int sp = rows_start_idxs.at(i) + (rows_end_idxs.at(i) - rows_start_idxs.at(i)) * j / 6;
-      const int ep = rows_start_idxs.at(i) + (rows_end_idxs.at(i) - rows_start_idxs.at(i)) * (j + 1) / 6 - 1;
-
-      std::sort(cloudSortInd.begin() + sp, cloudSortInd.begin() + ep + 1,
-                [&cloudCurvature](int i, int j) { return cloudCurvature.at(i) < cloudCurvature.at(j); });
-
-      int largestPickedNum = 0;
-      for (int k = ep; k >= sp; k--) {
-        const int ind = cloudSortInd.at(k);
-
-        if (cloudNeighborPicked.at(ind) == 0 && cloudCurvature.at(ind) > 0.1) {
-
-          largestPickedNum++;
-          if (largestPickedNum <= 2) {
-            cloudLabel.at(ind) = 2;
-            corner_points_sharp->push_back(laser_cloud->points.at(ind));
-            corner_points_less_sharp->push_back(laser_cloud->points.at(ind));
-          } else if (largestPickedNum <= 20) {
-            cloudLabel.at(ind) = 1;
-            corner_points_less_sharp->push_back(laser_cloud->points.at(ind));
-          } else {
-            break;
-          }
-
-          cloudNeighborPicked.at(ind) = 1;
-
-          for (int l = 1; l <= 5; l++) {
-            const float diffX = laser_cloud->points.at(ind + l).x - laser_cloud->points.at(ind + l - 1).x;
-            const float diffY = laser_cloud->points.at(ind + l).y - laser_cloud->points.at(ind + l - 1).y;
-            const float diffZ = laser_cloud->points.at(ind + l).z - laser_cloud->points.at(ind + l - 1).z;
-            if (diffX * diffX + diffY * diffY + diffZ * diffZ > 0.05) {
-              break;
-            }
-
-            cloudNeighborPicked.at(ind + l) = 1;
-          }
-          for (int l = -1; l >= -5; l--) {
-            const float diffX = laser_cloud->points.at(ind + l).x - laser_cloud->points.at(ind + l + 1).x;
-            const float diffY = laser_cloud->points.at(ind + l).y - laser_cloud->points.at(ind + l + 1).y;
-            const float diffZ = laser_cloud->points.at(ind + l).z - laser_cloud->points.at(ind + l + 1).z;
-            if (diffX * diffX + diffY * diffY + diffZ * diffZ > 0.05) {
-              break;
-            }
-
-            cloudNeighborPicked.at(ind + l) = 1;
-          }
-        }
-      }
+  // ring and time of the features, handed over to the odometry next to the clouds
+  OdometryFrame frame;
 
-      int smallestPickedNum = 0;
-      for (int k = sp; k <= ep; k++) {
-        const int ind = cloudSortInd.at(k);
-
-        if (cloudNeighborPicked.at(ind) == 0 && cloudCurvature.at(ind) < 0.1) {
-
-          cloudLabel.at(ind) = -1;
-          surf_points_flat->push_back(laser_cloud->points.at(ind));
-
-          smallestPickedNum++;
-          if (smallestPickedNum >= 4) {
-            break;
-          }
-
-          cloudNeighborPicked.at(ind) = 1;
-          for (int l = 1; l <= 5; l++) {
-            const float diffX = laser_cloud->points.at(ind + l).x - laser_cloud->points.at(ind + l - 1).x;
-            const float diffY = laser_cloud->points.at(ind + l).y - laser_cloud->points.at(ind + l - 1).y;
-            const float diffZ = laser_cloud->points.at(ind + l).z - laser_cloud->points.at(ind + l - 1).z;
-            if (diffX * diffX + diffY * diffY + diffZ * diffZ > 0.05) {
-              break;
-            }
-
-            cloudNeighborPicked.at(ind + l) = 1;
-          }
-          for (int l = -1; l >= -5; l--) {
-            const float diffX = laser_cloud->points.at(ind + l).x - laser_cloud->points.at(ind + l + 1).x;
-            const float diffY = laser_cloud->points.at(ind + l).y - laser_cloud->points.at(ind + l + 1).y;
-            const float diffZ = laser_cloud->points.at(ind + l).z - laser_cloud->points.at(ind + l + 1).z;
-            if (diffX * diffX + diffY * diffY + diffZ * diffZ > 0.05) {
-              break;
-            }
-
-            cloudNeighborPicked.at(ind + l) = 1;
-          }
-        }
-      }
+  // fewer features are selected while the mapping does not keep up with the latency budget
+  FeatureSelectionParams selection_params;
+  selection_params.regions_per_ring             = _regions_per_ring;
+  selection_params.sharp_points_per_region      = _latency_controller->scaleFeatureCount(_sharp_points_per_region);
+  selection_params.less_sharp_points_per_region = _latency_controller->scaleFeatureCount(_less_sharp_points_per_region);
+  selection_params.flat_points_per_region       = _latency_controller->scaleFeatureCount(_flat_points_per_region);
+  selection_params.curvature_threshold          = _curvature_threshold;
+  selection_params.less_flat_resolution         = _latency_controller->scaleResolution(LESS_FLAT_RESOLUTION);
 
-      for (int k = sp; k <= ep; k++) {
-        if (cloudLabel.at(k) <= 0) {
-          surfPointsLessFlatScan->push_back(laser_cloud->points.at(k));
-        }
-      }
+  /*//{ Compute features (planes and edges) in two resolutions */
+  bool selected_on_gpu = false;
+  if (_gpu_feature_selector) {
+    std::string error;
+    selected_on_gpu = _gpu_feature_selector->selectFeatures(_scan, _rows_start_idxs, _rows_end_idxs, selection_params, *corner_points_sharp,
+                                                            *corner_points_less_sharp, *surf_points_flat, *surf_points_less_flat,
+                                                            frame.corner_channels_sharp, frame.corner_channels_less_sharp, frame.surf_channels_flat,
+                                                            frame.surf_channels_less_flat, error);
+    if (!selected_on_gpu) {
+      ROS_WARN_THROTTLE(1.0, "[AloamFeatureExtractor]: GPU feature selection failed (%s), selecting the features on the CPU.", error.c_str());
     }
-
-    pcl::PointCloud<PointType> surfPointsLessFlatScanDS;
-    pcl::VoxelGrid<PointType>  downSizeFilter;
-    downSizeFilter.setInputCloud(surfPointsLessFlatScan);
-    downSizeFilter.setLeafSize(0.2, 0.2, 0.2);
-    downSizeFilter.filter(surfPointsLessFlatScanDS);
-
-    *surf_points_less_flat += surfPointsLessFlatScanDS;
+  }
+  if (!selected_on_gpu) {
+    _feature_selector->computeCurvature(_scan);
+    _feature_selector->selectFeatures(_scan, _rows_start_idxs, _rows_end_idxs, selection_params, *corner_points_sharp, *corner_points_less_sharp,
+                                      *surf_points_flat, *surf_points_less_flat, frame.corner_channels_sharp, frame.corner_channels_less_sharp,
+                                      frame.surf_channels_flat, frame.surf_channels_less_flat);
   }
   /*//}*/
 
+  // the full-resolution cloud is converted to pcl once, together with the features it is used in the kd-trees and the filters downstream
+  const pcl::PointCloud<PointType>::Ptr laser_cloud = _cloud_pool->acquire();
+  _scan.toPointCloud(*laser_cloud);
+
   timer.checkpoint("parsing features");
 
   laser_cloud->header.frame_id              = _frame_map;
@@ -244,13 +237,105 @@ void FeatureExtractor::callbackLaserCloud(mrs_lib::SubscribeHandler<sensor_msgs:
   surf_points_flat->header.stamp         = stamp;
   surf_points_less_flat->header.stamp    = stamp;
 
-  _odometry->setData(corner_points_sharp, corner_points_less_sharp, surf_points_flat, surf_points_less_flat, laser_cloud);
+  const double duration_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time_frame_start).count();
+  _frames_processed++;
 
-  /* ROS_INFO_THROTTLE(1.0, "[AloamFeatureExtractor] Run time: %0.1f ms (%0.1f Hz)", time_whole, std::min(1.0f / _scan_period_sec, 1000.0f / time_whole)); */
-  /* ROS_DEBUG_THROTTLE(1.0, "[AloamFeatureExtractor] points: %d; preparing data: %0.1f ms; q-sorting data: %0.1f ms; computing features: %0.1f ms", cloud_size,
-   */
-  /*                    processing_time, time_q_sort, time_pts); */
-  /* ROS_WARN_COND(time_whole > _scan_period_sec * 1000.0f, "[AloamFeatureExtractor] Feature extraction took over %0.2f ms", _scan_period_sec * 1000.0f); */
+  if (_frame_observer) {
+    _frame_observer->onStageFinished(PipelineStage::FEATURE_EXTRACTION, laserCloudMsg->header.stamp, duration_ms);
+  }
+
+  // the sizes are read before the clouds are handed over to the odometry thread
+  const aloam_slam::StageDiagnostics::Ptr diag_msg = boost::make_shared<aloam_slam::StageDiagnostics>();
+  diag_msg->points                                 = laser_cloud->size();
+  diag_msg->features_corners                       = corner_points_less_sharp->size();
+  diag_msg->features_surfs                         = surf_points_less_flat->size();
+
+  frame.corner_points_sharp      = corner_points_sharp;
+  frame.corner_points_less_sharp = corner_points_less_sharp;
+  frame.surf_points_flat         = surf_points_flat;
+  frame.surf_points_less_flat    = surf_points_less_flat;
+  frame.cloud_full_res           = laser_cloud;
+
+  if (_merger) {
+    if (_lidar_index > 0) {
+      // in the frame of the primary lidar with the rings after the rings of the previous lidars
+      const Eigen::Matrix4f primary_T_lidar = _primary_T_lidar.matrix().cast<float>();
+      const int             ring_offset     = _lidar_index * (_number_of_rings + MERGED_RING_GAP);
+      for (const auto &cloud : {corner_points_sharp, corner_points_less_sharp, surf_points_flat, surf_points_less_flat, laser_cloud}) {
+        transformPoints(*cloud, primary_T_lidar, *cloud);
+        for (auto &point : cloud->points) {
+          point.intensity += float(ring_offset);
+        }
+      }
+      for (FeatureChannels *channels :
+           {&frame.corner_channels_sharp, &frame.corner_channels_less_sharp, &frame.surf_channels_flat, &frame.surf_channels_less_flat}) {
+        for (auto &ring : channels->ring) {
+          ring = std::uint16_t(ring + ring_offset);
+        }
+      }
+    }
+
+    _merger->setData(_lidar_index, laserCloudMsg->header.stamp, std::move(frame));
+  } else {
+    _odometry->setData(std::move(frame));
+  }
+
+  /*//{ Publish diagnostics */
+  if (_pub_diagnostics.getNumSubscribers() > 0) {
+    diag_msg->header.stamp     = laserCloudMsg->header.stamp;
+    diag_msg->header.frame_id  = laserCloudMsg->header.frame_id;
+    diag_msg->stage            = aloam_slam::StageDiagnostics::STAGE_FEATURE_EXTRACTION;
+    diag_msg->duration_ms      = duration_ms;
+    diag_msg->latency_ms       = (ros::Time::now() - laserCloudMsg->header.stamp).toSec() * 1000.0;
+    diag_msg->frames_processed = _frames_processed;
+    diag_msg->frames_dropped   = _frames_dropped + (_merger ? _merger->framesDropped(_lidar_index) : 0);
+
+    try {
+      _pub_diagnostics.publish(diag_msg);
+    }
+    catch (...) {
+      ROS_ERROR("[AloamFeatureExtractor]: Exception caught during publishing topic %s.", _pub_diagnostics.getTopic().c_str());
+    }
+  }
+  /*//}*/
+}
+/*//}*/
+
+/*//{ callbackOrientation() */
+void FeatureExtractor::callbackOrientation(mrs_lib::SubscribeHandler<nav_msgs::Odometry> &sub) {
+  if (!sub.hasMsg()) {
+    return;
+  }
+  processOrientation(sub.getMsg());
+}
+/*//}*/
+
+/*//{ processOrientation() */
+void FeatureExtractor::processOrientation(const nav_msgs::Odometry::ConstPtr &msg) {
+  Eigen::Quaterniond orientation;
+  tf::quaternionMsgToEigen(msg->pose.pose.orientation, orientation);
+  _deskewer->addOrientation(msg->header.stamp, orientation);
+}
+/*//}*/
+
+/*//{ setFrameObserver() */
+void FeatureExtractor::setFrameObserver(const std::shared_ptr<FrameObserver> &observer) {
+  _frame_observer = observer;
+  // the frames dropped by the merger are reported by the observer of the primary lidar
+  if (_merger && _lidar_index == 0) {
+    _merger->setFrameObserver(observer);
+  }
+}
+/*//}*/
+
+/*//{ setMerger() */
+void FeatureExtractor::setMerger(const std::shared_ptr<FeatureMerger> &merger, const int lidar_index, const Eigen::Isometry3d &primary_T_lidar) {
+  _merger          = merger;
+  _lidar_index     = lidar_index;
+  _primary_T_lidar = primary_T_lidar;
+  if (_merger && _lidar_index == 0 && _frame_observer) {
+    _merger->setFrameObserver(_frame_observer);
+  }
 }
 /*//}*/
 
@@ -281,16 +366,38 @@ void FeatureExtractor::callbackInputDataProcDiag(const mrs_msgs::PclToolsDiagnos
 /*//}*/
 
 /*//{ parseRowsFromCloudMsg() */
-void FeatureExtractor::parseRowsFromCloudMsg(const sensor_msgs::PointCloud2::ConstPtr &cloud, const pcl::PointCloud<PointType>::Ptr &cloud_processed,
+void FeatureExtractor::parseRowsFromCloudMsg(const sensor_msgs::PointCloud2::ConstPtr &cloud, FeatureCloud &cloud_processed,
                                              std::vector<int> &rows_start_indices, std::vector<int> &rows_end_indices) {
 
-  pcl::PointCloud<PointType> cloud_pcl;
-  pcl::fromROSMsg(*cloud, cloud_pcl);
+  const PointCloudField field_x = findField(*cloud, "x");
+  const PointCloudField field_y = findField(*cloud, "y");
+  const PointCloudField field_z = findField(*cloud, "z");
+  if (!field_x.valid() || !field_y.valid() || !field_z.valid()) {
+    ROS_ERROR_THROTTLE(1.0, "[AloamFeatureExtractor]: Laser cloud msg does not contain fields x, y, z. Skipping frame.");
+    return;
+  }
 
   /*//{ Precompute points indices */
-  const int   cloud_size    = cloud_pcl.points.size();
-  const float azimuth_start = -std::atan2(cloud_pcl.points.at(0).y, cloud_pcl.points.at(0).x);
-  float       azimuth_end   = -std::atan2(cloud_pcl.points.at(cloud_size - 1).y, cloud_pcl.points.at(cloud_size - 1).x) + 2 * M_PI;
+  const int cloud_size = cloud->width * cloud->height;
+  _parse_rings.assign(cloud_size, -1);
+  _parse_times.resize(cloud_size);
+
+  int first_valid = -1;
+  int last_valid  = -1;
+  for (int i = 0; i < cloud_size; i++) {
+    if (isFinitePoint(getPointData(cloud, i), field_x, field_y, field_z)) {
+      first_valid = first_valid < 0 ? i : first_valid;
+      last_valid  = i;
+    }
+  }
+  if (first_valid < 0) {
+    return;
+  }
+
+  const uint8_t *first_point   = getPointData(cloud, first_valid);
+  const uint8_t *last_point    = getPointData(cloud, last_valid);
+  const float    azimuth_start = -std::atan2(readField<float>(first_point, field_y), readField<float>(first_point, field_x));
+  float          azimuth_end   = -std::atan2(readField<float>(last_point, field_y), readField<float>(last_point, field_x)) + 2 * M_PI;
 
   if (azimuth_end - azimuth_start > 3 * M_PI) {
     azimuth_end -= 2 * M_PI;
@@ -298,32 +405,32 @@ void FeatureExtractor::parseRowsFromCloudMsg(const sensor_msgs::PointCloud2::Con
     azimuth_end += 2 * M_PI;
   }
 
-  bool                                    halfPassed = false;
-  int                                     count      = cloud_size;
-  std::vector<pcl::PointCloud<PointType>> laser_cloud_rows(_number_of_rings);
-  for (int i = 0; i < cloud_size; i++) {
-    PointType point;
-    point.x = cloud_pcl.points.at(i).x;
-    point.y = cloud_pcl.points.at(i).y;
-    point.z = cloud_pcl.points.at(i).z;
+  bool halfPassed = false;
+  for (int i = first_valid; i <= last_valid; i++) {
+    const uint8_t *point_data = getPointData(cloud, i);
+    if (!isFinitePoint(point_data, field_x, field_y, field_z)) {
+      continue;
+    }
+
+    const float x = readField<float>(point_data, field_x);
+    const float y = readField<float>(point_data, field_y);
+    const float z = readField<float>(point_data, field_z);
 
     int point_ring = 0;
 
-    const float angle = (M_PI_2 - acos(point.z / sqrt(point.x * point.x + point.y * point.y + point.z * point.z))) * 180.0 / M_PI;
+    const float angle = (M_PI_2 - acos(z / sqrt(x * x + y * y + z * z))) * 180.0 / M_PI;
 
     if (_number_of_rings == 16) {
       point_ring = std::round((angle + _vertical_fov_half) / _ray_vert_delta);
-      /* ROS_WARN("point: (%0.2f, %0.2f, %0.2f), angle: %0.2f deg, scan_id: %d", point.x, point.y, point.z, angle, point_ring); */
+      /* ROS_WARN("point: (%0.2f, %0.2f, %0.2f), angle: %0.2f deg, scan_id: %d", x, y, z, angle, point_ring); */
       /* point_ring = int((angle + 15) / 2 + 0.5); */
       if (point_ring > int(_number_of_rings - 1) || point_ring < 0) {
-        count--;
         continue;
       }
     } else if (_number_of_rings == 32) {
       // TODO: get correct point_ring
       point_ring = int((angle + 92.0 / 3.0) * 3.0 / 4.0);
       if (point_ring > int(_number_of_rings - 1) || point_ring < 0) {
-        count--;
         continue;
       }
     } else if (_number_of_rings == 64) {
@@ -335,61 +442,55 @@ void FeatureExtractor::parseRowsFromCloudMsg(const sensor_msgs::PointCloud2::Con
 
       // use [0 50]  > 50 remove outlies
       if (angle > 2 || angle < -24.33 || point_ring > 50 || point_ring < 0) {
-        count--;
         continue;
       }
     }
 
-    float point_azimuth = -std::atan2(point.y, point.x);
-    if (!halfPassed) {
-      if (point_azimuth < azimuth_start - M_PI / 2) {
-        point_azimuth += 2 * M_PI;
-      } else if (point_azimuth > azimuth_start + M_PI * 3 / 2) {
-        point_azimuth -= 2 * M_PI;
-      }
-
-      if (point_azimuth - azimuth_start > M_PI) {
-        halfPassed = true;
-      }
-    } else {
-      point_azimuth += 2 * M_PI;
-      if (point_azimuth < azimuth_end - M_PI * 3 / 2) {
-        point_azimuth += 2 * M_PI;
-      } else if (point_azimuth > azimuth_end + M_PI / 2) {
-        point_azimuth -= 2 * M_PI;
-      }
-    }
-
-    const float rel_time = (point_azimuth - azimuth_start) / (azimuth_end - azimuth_start);
-    point.intensity      = point_ring + _scan_period_sec * rel_time;
-    laser_cloud_rows.at(point_ring).push_back(point);
+    const float rel_time     = relativeTime(-std::atan2(y, x), azimuth_start, azimuth_end, halfPassed);
+    _parse_rings.at(i)       = point_ring;
+    _parse_times.at(i)       = rel_time;
   }
   /*//}*/
 
-  for (int i = 0; i < _number_of_rings; i++) {
-    rows_start_indices.at(i) = cloud_processed->size() + 5;
-    *cloud_processed += laser_cloud_rows.at(i);
-    rows_end_indices.at(i) = cloud_processed->size() - 6;
-  }
+  writeRows(cloud, field_x, field_y, field_z, cloud_processed, rows_start_indices, rows_end_indices);
 }
 /*//}*/
 
 /*//{ parseRowsFromOusterMsg() */
-void FeatureExtractor::parseRowsFromOusterMsg(const sensor_msgs::PointCloud2::ConstPtr &cloud, const pcl::PointCloud<PointType>::Ptr &cloud_processed,
+void FeatureExtractor::parseRowsFromOusterMsg(const sensor_msgs::PointCloud2::ConstPtr &cloud, FeatureCloud &cloud_processed,
                                               std::vector<int> &rows_start_indices, std::vector<int> &rows_end_indices) {
 
-  // Create PointOS1 pointcloud {x, y, z, intensity, t, reflectivity, ring, noise, range}
-  pcl::PointCloud<ouster_ros::Point>::Ptr        cloud_raw = boost::make_shared<pcl::PointCloud<ouster_ros::Point>>();
-  pcl::PointCloud<ouster_ros::Point>::Ptr        cloud_pcl = boost::make_shared<pcl::PointCloud<ouster_ros::Point>>();
-  std::unordered_map<unsigned int, unsigned int> indices_in_raw_cloud;
-
-  pcl::fromROSMsg(*cloud, *cloud_raw);
-  removeNaNFromPointCloud(cloud_raw, cloud_pcl, indices_in_raw_cloud);
+  const PointCloudField field_x    = findField(*cloud, "x");
+  const PointCloudField field_y    = findField(*cloud, "y");
+  const PointCloudField field_z    = findField(*cloud, "z");
+  const PointCloudField field_ring = findField(*cloud, "ring");
+  const PointCloudField field_t    = findField(*cloud, "t");
+  if (!field_x.valid() || !field_y.valid() || !field_z.valid() || !field_ring.valid()) {
+    ROS_ERROR_THROTTLE(1.0, "[AloamFeatureExtractor]: Laser cloud msg does not contain fields x, y, z, ring. Skipping frame.");
+    return;
+  }
 
   /*//{ Precompute points indices */
-  const int   cloud_size    = cloud_pcl->points.size();
-  const float azimuth_start = -std::atan2(cloud_pcl->points.at(0).y, cloud_pcl->points.at(0).x);
-  float       azimuth_end   = -std::atan2(cloud_pcl->points.at(cloud_size - 1).y, cloud_pcl->points.at(cloud_size - 1).x) + 2 * M_PI;
+  const int cloud_size = cloud->width * cloud->height;
+  _parse_rings.assign(cloud_size, -1);
+  _parse_times.resize(cloud_size);
+
+  int first_valid = -1;
+  int last_valid  = -1;
+  for (int i = 0; i < cloud_size; i++) {
+    if (isFinitePoint(getPointData(cloud, i), field_x, field_y, field_z)) {
+      first_valid = first_valid < 0 ? i : first_valid;
+      last_valid  = i;
+    }
+  }
+  if (first_valid < 0) {
+    return;
+  }
+
+  const uint8_t *first_point   = getPointData(cloud, first_valid);
+  const uint8_t *last_point    = getPointData(cloud, last_valid);
+  const float    azimuth_start = -std::atan2(readField<float>(first_point, field_y), readField<float>(first_point, field_x));
+  float          azimuth_end   = -std::atan2(readField<float>(last_point, field_y), readField<float>(last_point, field_x)) + 2 * M_PI;
 
   if (azimuth_end - azimuth_start > 3 * M_PI) {
     azimuth_end -= 2 * M_PI;
@@ -397,82 +498,162 @@ void FeatureExtractor::parseRowsFromOusterMsg(const sensor_msgs::PointCloud2::Co
     azimuth_end += 2 * M_PI;
   }
 
-  bool                                    halfPassed = false;
-  std::vector<pcl::PointCloud<PointType>> laser_cloud_rows(_number_of_rings);
-  for (int i = 0; i < cloud_size; i++) {
-    PointType point;
-    point.x = cloud_pcl->points.at(i).x;
-    point.y = cloud_pcl->points.at(i).y;
-    point.z = cloud_pcl->points.at(i).z;
+  const float max_rel_time   = 1.0f - 1e-6f;  // keeps the time below the end of the scan (and the time part of the intensity below one ring)
+  const float ns_to_rel_time = 1e-9f / _scan_period_sec;
 
-    // Read row (ring) directly from msg
-    const int point_ring = cloud_pcl->points.at(i).ring;
-
-    // Compute intensity TODO: can we polish this crazy ifs?
-    float point_azimuth = -std::atan2(point.y, point.x);
-    if (!halfPassed) {
-      if (point_azimuth < azimuth_start - M_PI / 2) {
-        point_azimuth += 2 * M_PI;
-      } else if (point_azimuth > azimuth_start + M_PI * 3 / 2) {
-        point_azimuth -= 2 * M_PI;
-      }
+  bool halfPassed = false;
+  for (int i = first_valid; i <= last_valid; i++) {
+    const uint8_t *point_data = getPointData(cloud, i);
+    if (!isFinitePoint(point_data, field_x, field_y, field_z)) {
+      continue;
+    }
 
-      if (point_azimuth - azimuth_start > M_PI) {
-        halfPassed = true;
-      }
-    } else {
-      point_azimuth += 2 * M_PI;
-      if (point_azimuth < azimuth_end - M_PI * 3 / 2) {
-        point_azimuth += 2 * M_PI;
-      } else if (point_azimuth > azimuth_end + M_PI / 2) {
-        point_azimuth -= 2 * M_PI;
-      }
+    // Read row (ring) directly from msg
+    const int point_ring = readField<int>(point_data, field_ring);
+    if (point_ring < 0 || point_ring >= _number_of_rings) {
+      continue;
     }
 
-    // TODO: can we use `t` fiels from OS1 message?
-    const float rel_time = (point_azimuth - azimuth_start) / (azimuth_end - azimuth_start);
-    point.intensity      = point_ring + _scan_period_sec * rel_time;
-    laser_cloud_rows.at(point_ring).push_back(point);
+    // the `t` field of Ouster clouds is the time since the beginning of the scan in nanoseconds
+    const float rel_time = field_t.valid() ? std::min(readField<float>(point_data, field_t) * ns_to_rel_time, max_rel_time)
+                                           : relativeTime(-std::atan2(readField<float>(point_data, field_y), readField<float>(point_data, field_x)),
+                                                          azimuth_start, azimuth_end, halfPassed);
+    _parse_rings.at(i)       = point_ring;
+    _parse_times.at(i)       = rel_time;
   }
   /*//}*/
 
-  for (int i = 0; i < _number_of_rings; i++) {
-    rows_start_indices.at(i) = cloud_processed->size() + 5;
-    *cloud_processed += laser_cloud_rows.at(i);
-    rows_end_indices.at(i) = cloud_processed->size() - 6;
-  }
+  writeRows(cloud, field_x, field_y, field_z, cloud_processed, rows_start_indices, rows_end_indices);
 }
 /*//}*/
 
-/*//{ removeNaNFromPointCloud() */
-void FeatureExtractor::removeNaNFromPointCloud(const pcl::PointCloud<ouster_ros::Point>::Ptr &cloud_in, pcl::PointCloud<ouster_ros::Point>::Ptr &cloud_out,
-                                               std::unordered_map<unsigned int, unsigned int> &indices) {
-
-  if (cloud_in->is_dense) {
-    cloud_out = cloud_in;
+/*//{ parseRowsFromOrganizedMsg() */
+// Organized clouds (e.g., from Ouster) have one row per ring and the columns ordered by the time of measurement, so the ring is the row index and
+// the relative time is given by the `t` field (nanoseconds since the start of the scan) or by the column index. Invalid returns are skipped while
+// copying the rows, no azimuth has to be computed.
+void FeatureExtractor::parseRowsFromOrganizedMsg(const sensor_msgs::PointCloud2::ConstPtr &cloud, FeatureCloud &cloud_processed,
+                                                 std::vector<int> &rows_start_indices, std::vector<int> &rows_end_indices) {
+
+  const PointCloudField field_x = findField(*cloud, "x");
+  const PointCloudField field_y = findField(*cloud, "y");
+  const PointCloudField field_z = findField(*cloud, "z");
+  const PointCloudField field_t = findField(*cloud, "t");
+  if (!field_x.valid() || !field_y.valid() || !field_z.valid()) {
+    ROS_ERROR_THROTTLE(1.0, "[AloamFeatureExtractor]: Laser cloud msg does not contain fields x, y, z. Skipping frame.");
     return;
   }
 
-  unsigned int k = 0;
+  const int    width           = cloud->width;
+  const double max_rel_time    = 1.0 - 1e-6;  // keeps the time below the end of the scan (and the time part of the intensity below one ring)
+  const double ns_to_rel_time  = 1e-9 / _scan_period_sec;
+  const double col_to_rel_time = 1.0 / double(width);
 
-  cloud_out->resize(cloud_in->size());
+  cloud_processed.resize(_number_of_rings * width);
 
-  for (unsigned int i = 0; i < cloud_in->size(); i++) {
+  int count = 0;
+  for (int row = 0; row < _number_of_rings; row++) {
+    rows_start_indices.at(row) = count + 5;
 
-    if (std::isfinite(cloud_in->at(i).x) && std::isfinite(cloud_in->at(i).y) && std::isfinite(cloud_in->at(i).z)) {
-      cloud_out->at(k) = cloud_in->at(i);
-      indices[k]       = i;
+    const uint8_t *row_data = cloud->data.data() + row * cloud->row_step;
+    for (int col = 0; col < width; col++) {
+      const uint8_t *point_data = row_data + col * cloud->point_step;
 
-      k++;
+      const float x = readField<float>(point_data, field_x);
+      const float y = readField<float>(point_data, field_y);
+      const float z = readField<float>(point_data, field_z);
+      if (!std::isfinite(x) || !std::isfinite(y) || !std::isfinite(z) || (x == 0.0f && y == 0.0f && z == 0.0f)) {
+        continue;
+      }
+
+      const double rel_time = field_t.valid() ? readField<double>(point_data, field_t) * ns_to_rel_time : col * col_to_rel_time;
+
+      cloud_processed.set(count++, x, y, z, row, float(std::min(rel_time, max_rel_time)));
+    }
+
+    rows_end_indices.at(row) = count - 6;
+  }
+
+  cloud_processed.resize(count);
+}
+/*//}*/
+
+/*//{ writeRows() */
+// writes the points with assigned ring (see _parse_rings) into cloud_processed ordered by rings, every point is written exactly once
+void FeatureExtractor::writeRows(const sensor_msgs::PointCloud2::ConstPtr &cloud, const PointCloudField &field_x, const PointCloudField &field_y,
+                                 const PointCloudField &field_z, FeatureCloud &cloud_processed, std::vector<int> &rows_start_indices,
+                                 std::vector<int> &rows_end_indices) {
+
+  const int cloud_size = _parse_rings.size();
+
+  _parse_ring_offsets.assign(_number_of_rings + 1, 0);
+  for (int i = 0; i < cloud_size; i++) {
+    if (_parse_rings.at(i) >= 0) {
+      _parse_ring_offsets.at(_parse_rings.at(i) + 1)++;
+    }
+  }
+  for (int r = 0; r < _number_of_rings; r++) {
+    _parse_ring_offsets.at(r + 1) += _parse_ring_offsets.at(r);
+  }
+
+  for (int r = 0; r < _number_of_rings; r++) {
+    rows_start_indices.at(r) = _parse_ring_offsets.at(r) + 5;
+    rows_end_indices.at(r)   = _parse_ring_offsets.at(r + 1) - 6;
+  }
+
+  cloud_processed.resize(_parse_ring_offsets.at(_number_of_rings));
+
+  for (int i = 0; i < cloud_size; i++) {
+    const int ring = _parse_rings.at(i);
+    if (ring < 0) {
+      continue;
     }
+
+    const uint8_t *point_data = getPointData(cloud, i);
+    cloud_processed.set(_parse_ring_offsets.at(ring)++, readField<float>(point_data, field_x), readField<float>(point_data, field_y),
+                        readField<float>(point_data, field_z), ring, _parse_times.at(i));
   }
+}
+/*//}*/
 
-  cloud_out->header   = cloud_in->header;
-  cloud_out->is_dense = true;
+/*//{ relativeTime() */
+// relative time of the point within the scan computed from its azimuth, the points have to be processed in the order of the scan
+float FeatureExtractor::relativeTime(float point_azimuth, const float azimuth_start, const float azimuth_end, bool &half_passed) {
+  if (!half_passed) {
+    if (point_azimuth < azimuth_start - M_PI / 2) {
+      point_azimuth += 2 * M_PI;
+    } else if (point_azimuth > azimuth_start + M_PI * 3 / 2) {
+      point_azimuth -= 2 * M_PI;
+    }
 
-  if (cloud_in->size() != k) {
-    cloud_out->resize(k);
+    if (point_azimuth - azimuth_start > M_PI) {
+      half_passed = true;
+    }
+  } else {
+    point_azimuth += 2 * M_PI;
+    if (point_azimuth < azimuth_end - M_PI * 3 / 2) {
+      point_azimuth += 2 * M_PI;
+    } else if (point_azimuth > azimuth_end + M_PI / 2) {
+      point_azimuth -= 2 * M_PI;
+    }
   }
+
+  return (point_azimuth - azimuth_start) / (azimuth_end - azimuth_start);
+}
+/*//}*/
+
+/*//{ getPointData() */
+const uint8_t *FeatureExtractor::getPointData(const sensor_msgs::PointCloud2::ConstPtr &cloud, const int index) {
+  const int row = index / cloud->width;
+  const int col = index % cloud->width;
+  return cloud->data.data() + row * cloud->row_step + col * cloud->point_step;
+}
+/*//}*/
+
+/*//{ isFinitePoint() */
+bool FeatureExtractor::isFinitePoint(const uint8_t *point_data, const PointCloudField &field_x, const PointCloudField &field_y,
+                                     const PointCloudField &field_z) {
+  return std::isfinite(readField<float>(point_data, field_x)) && std::isfinite(readField<float>(point_data, field_y)) &&
+         std::isfinite(readField<float>(point_data, field_z));
 }
 /*//}*/
 
@@ -0,0 +1,318 @@
+#include "aloam_slam/gpu_kernels.h"
+#include "aloam_slam/device_buffer.cuh"
+
+#include <cfloat>
+#include <climits>
+
+namespace aloam_slam
+{
+
+namespace gpu
+{
+
+namespace
+{
+
+constexpr unsigned int CURVATURE_THREADS = 256;
+constexpr unsigned int SELECTION_THREADS = 256;
+
+// neighbors on each side suppressed by a picked point
+constexpr int SUPPRESSED_NEIGHBORS = 5;
+
+// curvature, point indices and labels of the region
+constexpr std::size_t SELECTION_SHARED_MEMORY = MAX_REGION_SIZE * (sizeof(float) + sizeof(int) + sizeof(signed char));
+
+/*//{ stencil() */
+// the 5 neighbors on both sides minus 10 times the point, summed in the order of FeatureSelector::computeCurvature() without fused
+// multiply-adds, so the curvature equals the one of the CPU
+__device__ float stencil(const float *v, const int i) {
+  float sum = v[i - 5];
+  sum       = __fadd_rn(sum, v[i - 4]);
+  sum       = __fadd_rn(sum, v[i - 3]);
+  sum       = __fadd_rn(sum, v[i - 2]);
+  sum       = __fadd_rn(sum, v[i - 1]);
+  sum       = __fsub_rn(sum, __fmul_rn(10.0f, v[i]));
+  for (int l = 1; l <= 5; l++) {
+    sum = __fadd_rn(sum, v[i + l]);
+  }
+  return sum;
+}
+/*//}*/
+
+/*//{ squaredNorm() */
+__device__ float squaredNorm(const float dx, const float dy, const float dz) {
+  return __fadd_rn(__fadd_rn(__fmul_rn(dx, dx), __fmul_rn(dy, dy)), __fmul_rn(dz, dz));
+}
+/*//}*/
+
+/*//{ curvatureKernel() */
+__global__ void curvatureKernel(const float *x, const float *y, const float *z, const int size, float *curvature) {
+  const int i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i >= size) {
+    return;
+  }
+  if (i < 5 || i + 5 >= size) {
+    curvature[i] = 0.0f;
+    return;
+  }
+  curvature[i] = squaredNorm(stencil(x, i), stencil(y, i), stencil(z, i));
+}
+/*//}*/
+
+/*//{ lessCurvature() */
+// the ties are ordered by the index, so the order is deterministic
+__device__ bool lessCurvature(const float curvature_a, const int index_a, const float curvature_b, const int index_b) {
+  return curvature_a < curvature_b || (curvature_a == curvature_b && index_a < index_b);
+}
+/*//}*/
+
+/*//{ markNeighborsPicked() */
+// as FeatureSelector::markNeighborsPicked(), the flags of the whole cloud, so the suppression reaches over the regions shorter than the
+// suppressed neighbors as well (the regions start 5 points after the start of the ring and end 5 points before its end)
+__device__ void markNeighborsPicked(const float *x, const float *y, const float *z, const int ind, unsigned char *picked) {
+  picked[ind] = 1;
+
+  for (int j = ind + 1; j <= ind + SUPPRESSED_NEIGHBORS; j++) {
+    if (double(squaredNorm(x[j] - x[j - 1], y[j] - y[j - 1], z[j] - z[j - 1])) > 0.05) {
+      break;
+    }
+    picked[j] = 1;
+  }
+  for (int j = ind - 1; j >= ind - SUPPRESSED_NEIGHBORS; j--) {
+    if (double(squaredNorm(x[j] - x[j + 1], y[j] - y[j + 1], z[j] - z[j + 1])) > 0.05) {
+      break;
+    }
+    picked[j] = 1;
+  }
+}
+/*//}*/
+
+/*//{ selectionKernel() */
+// one block per ring, the regions of the ring are selected one after another as by FeatureSelector: bitonic sort of the curvature of the region,
+// then the selection by the first thread (it stops after a few points); the picked flags (zeroed, one per point) are read and written only by the
+// first thread, the points picked as neighbors suppress the following regions of the ring as on the CPU
+__global__ void selectionKernel(const float *x, const float *y, const float *z, const float *curvature, const SelectionRegion *regions,
+                                const int *ring_regions, const SelectionParams params, const int sharp_stride, const int flat_stride,
+                                int *sharp_indices, int *sharp_counts, int *flat_indices, int *flat_counts, signed char *labels,
+                                unsigned char *picked) {
+  extern __shared__ unsigned char shared[];
+  float *      keys          = reinterpret_cast<float *>(shared);
+  int *        indices       = reinterpret_cast<int *>(keys + MAX_REGION_SIZE);
+  signed char *region_labels = reinterpret_cast<signed char *>(indices + MAX_REGION_SIZE);
+
+  const int first_region = ring_regions[blockIdx.x];
+  const int last_region  = ring_regions[blockIdx.x + 1];
+
+  for (int r = first_region; r < last_region; r++) {
+    const SelectionRegion region = regions[r];
+    const int             count  = region.end - region.begin;
+
+    int padded = 1;
+    while (padded < count) {
+      padded <<= 1;
+    }
+
+    for (int t = threadIdx.x; t < padded; t += blockDim.x) {
+      if (t < count) {
+        keys[t]          = curvature[region.begin + t];
+        indices[t]       = region.begin + t;
+        region_labels[t] = 0;
+      } else {
+        keys[t]    = FLT_MAX;
+        indices[t] = INT_MAX;
+      }
+    }
+    __syncthreads();
+
+    for (int k = 2; k <= padded; k <<= 1) {
+      for (int j = k >> 1; j > 0; j >>= 1) {
+        for (int t = threadIdx.x; t < padded; t += blockDim.x) {
+          const int partner = t ^ j;
+          if (partner > t) {
+            const bool ascending = (t & k) == 0;
+            if (lessCurvature(keys[partner], indices[partner], keys[t], indices[t]) == ascending) {
+              const float key  = keys[t];
+              const int   ind  = indices[t];
+              keys[t]          = keys[partner];
+              indices[t]       = indices[partner];
+              keys[partner]    = key;
+              indices[partner] = ind;
+            }
+          }
+        }
+        __syncthreads();
+      }
+    }
+
+    if (threadIdx.x == 0) {
+      int *region_sharp = sharp_indices + r * sharp_stride;
+      int *region_flat  = flat_indices + r * flat_stride;
+
+      int largest_picked = 0;
+      for (int k = count - 1; k >= 0; k--) {
+        const int ind = indices[k];
+        if (keys[k] <= params.curvature_threshold) {
+          break;
+        }
+        if (picked[ind]) {
+          continue;
+        }
+
+        largest_picked++;
+        if (largest_picked <= params.sharp_points_per_region) {
+          region_labels[ind - region.begin] = 2;
+        } else if (largest_picked <= params.less_sharp_points_per_region) {
+          region_labels[ind - region.begin] = 1;
+        } else {
+          largest_picked--;
+          break;
+        }
+        region_sharp[largest_picked - 1] = ind;
+
+        markNeighborsPicked(x, y, z, ind, picked);
+      }
+      sharp_counts[r] = largest_picked;
+
+      int smallest_picked = 0;
+      for (int k = 0; k < count; k++) {
+        const int ind = indices[k];
+        if (keys[k] >= params.curvature_threshold) {
+          break;
+        }
+        if (picked[ind]) {
+          continue;
+        }
+
+        region_labels[ind - region.begin] = -1;
+        region_flat[smallest_picked]      = ind;
+
+        smallest_picked++;
+        if (smallest_picked >= params.flat_points_per_region) {
+          break;
+        }
+
+        markNeighborsPicked(x, y, z, ind, picked);
+      }
+      flat_counts[r] = smallest_picked;
+    }
+    __syncthreads();
+
+    for (int t = threadIdx.x; t < count; t += blockDim.x) {
+      labels[region.begin + t] = region_labels[t];
+    }
+    __syncthreads();
+  }
+}
+/*//}*/
+
+}  // namespace
+
+/*//{ struct FeatureKernels::Buffers */
+struct FeatureKernels::Buffers
+{
+  DeviceBuffer<float>           x;
+  DeviceBuffer<float>           y;
+  DeviceBuffer<float>           z;
+  DeviceBuffer<float>           curvature;
+  DeviceBuffer<SelectionRegion> regions;
+  DeviceBuffer<int>             ring_regions;
+  DeviceBuffer<int>             sharp_indices;
+  DeviceBuffer<int>             sharp_counts;
+  DeviceBuffer<int>             flat_indices;
+  DeviceBuffer<int>             flat_counts;
+  DeviceBuffer<signed char>     labels;
+  DeviceBuffer<unsigned char>   picked;
+};
+/*//}*/
+
+/*//{ FeatureKernels() */
+FeatureKernels::FeatureKernels() : _buffers(std::make_unique<Buffers>()) {
+}
+/*//}*/
+
+/*//{ ~FeatureKernels() */
+FeatureKernels::~FeatureKernels() = default;
+/*//}*/
+
+/*//{ selectFeatures() */
+bool FeatureKernels::selectFeatures(const float *x, const float *y, const float *z, const std::size_t size, const SelectionRegion *regions,
+                                    const int regions_count, const int *ring_regions, const int rings_count, const SelectionParams &params, float *curvature, int *sharp_indices, int *sharp_counts,
+                                    int *flat_indices, int *flat_counts, std::int8_t *labels, std::string &error) {
+  if (size == 0) {
+    return true;
+  }
+
+  Buffers &         b            = *_buffers;
+  const int         sharp_stride = sharpStride(params);
+  const int         flat_stride  = flatStride(params);
+  const std::size_t regions_size = std::size_t(regions_count);
+
+  // clang-format off
+  const bool allocated =
+      cudaCheck(b.x.reserve(size), "cudaMalloc", error) &&
+      cudaCheck(b.y.reserve(size), "cudaMalloc", error) &&
+      cudaCheck(b.z.reserve(size), "cudaMalloc", error) &&
+      cudaCheck(b.curvature.reserve(size), "cudaMalloc", error) &&
+      cudaCheck(b.labels.reserve(size), "cudaMalloc", error) &&
+      cudaCheck(b.picked.reserve(size), "cudaMalloc", error) &&
+      cudaCheck(b.regions.reserve(regions_size + 1), "cudaMalloc", error) &&
+      cudaCheck(b.ring_regions.reserve(std::size_t(rings_count) + 1), "cudaMalloc", error) &&
+      cudaCheck(b.sharp_indices.reserve(regions_size * sharp_stride + 1), "cudaMalloc", error) &&
+      cudaCheck(b.sharp_counts.reserve(regions_size + 1), "cudaMalloc", error) &&
+      cudaCheck(b.flat_indices.reserve(regions_size * flat_stride + 1), "cudaMalloc", error) &&
+      cudaCheck(b.flat_counts.reserve(regions_size + 1), "cudaMalloc", error);
+  // clang-format on
+  if (!allocated) {
+    return false;
+  }
+
+  if (!cudaCheck(cudaMemcpy(b.x.data(), x, size * sizeof(float), cudaMemcpyHostToDevice), "cudaMemcpy", error) ||
+      !cudaCheck(cudaMemcpy(b.y.data(), y, size * sizeof(float), cudaMemcpyHostToDevice), "cudaMemcpy", error) ||
+      !cudaCheck(cudaMemcpy(b.z.data(), z, size * sizeof(float), cudaMemcpyHostToDevice), "cudaMemcpy", error) ||
+      !cudaCheck(cudaMemcpy(b.regions.data(), regions, regions_size * sizeof(SelectionRegion), cudaMemcpyHostToDevice), "cudaMemcpy", error) ||
+      !cudaCheck(cudaMemcpy(b.ring_regions.data(), ring_regions, (std::size_t(rings_count) + 1) * sizeof(int), cudaMemcpyHostToDevice), "cudaMemcpy",
+                 error) ||
+      !cudaCheck(cudaMemset(b.labels.data(), 0, size * sizeof(signed char)), "cudaMemset", error) ||
+      !cudaCheck(cudaMemset(b.picked.data(), 0, size * sizeof(unsigned char)), "cudaMemset", error)) {
+    return false;
+  }
+
+  curvatureKernel<<<blocks(size, CURVATURE_THREADS), CURVATURE_THREADS>>>(b.x.data(), b.y.data(), b.z.data(), int(size), b.curvature.data());
+  if (rings_count > 0) {
+    selectionKernel<<<rings_count, SELECTION_THREADS, SELECTION_SHARED_MEMORY>>>(
+        b.x.data(), b.y.data(), b.z.data(), b.curvature.data(), b.regions.data(), b.ring_regions.data(), params, sharp_stride, flat_stride,
+        b.sharp_indices.data(), b.sharp_counts.data(), b.flat_indices.data(), b.flat_counts.data(), b.labels.data(), b.picked.data());
+  }
+  if (!cudaCheck(cudaGetLastError(), "selection kernels", error)) {
+    return false;
+  }
+
+  // the copies wait for the kernels
+  return cudaCheck(cudaMemcpy(curvature, b.curvature.data(), size * sizeof(float), cudaMemcpyDeviceToHost), "cudaMemcpy", error) &&
+         cudaCheck(cudaMemcpy(labels, b.labels.data(), size * sizeof(signed char), cudaMemcpyDeviceToHost), "cudaMemcpy", error) &&
+         cudaCheck(cudaMemcpy(sharp_indices, b.sharp_indices.data(), regions_size * sharp_stride * sizeof(int), cudaMemcpyDeviceToHost), "cudaMemcpy",
+                   error) &&
+         cudaCheck(cudaMemcpy(sharp_counts, b.sharp_counts.data(), regions_size * sizeof(int), cudaMemcpyDeviceToHost), "cudaMemcpy", error) &&
+         cudaCheck(cudaMemcpy(flat_indices, b.flat_indices.data(), regions_size * flat_stride * sizeof(int), cudaMemcpyDeviceToHost), "cudaMemcpy",
+                   error) &&
+         cudaCheck(cudaMemcpy(flat_counts, b.flat_counts.data(), regions_size * sizeof(int), cudaMemcpyDeviceToHost), "cudaMemcpy", error);
+}
+/*//}*/
+
+/*//{ deviceAvailable() */
+bool deviceAvailable(std::string &error) {
+  int count = 0;
+  if (!cudaCheck(cudaGetDeviceCount(&count), "cudaGetDeviceCount", error)) {
+    return false;
+  }
+  if (count == 0) {
+    error = "no CUDA device";
+    return false;
+  }
+  return true;
+}
+/*//}*/
+
+}  // namespace gpu
+
+}  // namespace aloam_slam
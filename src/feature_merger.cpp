@@ -0,0 +1,127 @@
+#include "aloam_slam/feature_merger.h"
+
+#include <algorithm>
+
+namespace aloam_slam
+{
+
+/*//{ FeatureMerger() */
+FeatureMerger::FeatureMerger(const std::shared_ptr<AloamOdometry> odometry, const int lidars, const double max_time_difference)
+    : _odometry(odometry), _max_time_difference(max_time_difference), _pending(std::max(lidars, 1)), _frames_dropped(_pending.size(), 0) {
+  // the merged clouds are released by the odometry and the mapping, a few frames may be in flight
+  _cloud_pool = std::make_shared<CloudPool>(16);
+}
+/*//}*/
+
+/*//{ lidars() */
+int FeatureMerger::lidars() const {
+  return int(_pending.size());
+}
+/*//}*/
+
+/*//{ setFrameObserver() */
+void FeatureMerger::setFrameObserver(const std::shared_ptr<FrameObserver> &observer) {
+  _frame_observer = observer;
+}
+/*//}*/
+
+/*//{ framesDropped() */
+unsigned long FeatureMerger::framesDropped(const int lidar) const {
+  std::scoped_lock lock(_mutex);
+  return lidar >= 0 && lidar < lidars() ? _frames_dropped.at(lidar) : 0;
+}
+/*//}*/
+
+/*//{ setData() */
+void FeatureMerger::setData(const int lidar, const ros::Time &stamp, OdometryFrame frame) {
+  if (lidar < 0 || lidar >= lidars()) {
+    return;
+  }
+
+  std::vector<ros::Time> dropped;
+  {
+    std::scoped_lock lock(_mutex);
+
+    const auto dropPending = [this, &dropped](const int l) {
+      dropped.push_back(_pending.at(l).stamp);
+      _frames_dropped.at(l)++;
+      ROS_WARN_THROTTLE(5.0, "[AloamFeatureMerger]: Dropped a frame of lidar %d without a counterpart within %.3f s.", l, _max_time_difference);
+      _pending.at(l) = Pending();
+    };
+
+    // the previous frame of the lidar was not merged
+    if (_pending.at(lidar).valid) {
+      dropPending(lidar);
+    }
+
+    _pending.at(lidar).valid = true;
+    _pending.at(lidar).stamp = stamp;
+    _pending.at(lidar).frame = std::move(frame);
+
+    // the frames older than the newest frame by more than the tolerance have no counterpart anymore
+    ros::Time newest = stamp;
+    for (const auto &pending : _pending) {
+      if (pending.valid && pending.stamp > newest) {
+        newest = pending.stamp;
+      }
+    }
+    for (int l = 0; l < lidars(); l++) {
+      if (_pending.at(l).valid && (newest - _pending.at(l).stamp).toSec() > _max_time_difference) {
+        dropPending(l);
+      }
+    }
+
+    // the merged frame is pushed under the lock, the feature mailbox of the odometry has a single producer
+    if (std::all_of(_pending.begin(), _pending.end(), [](const Pending &pending) { return pending.valid; })) {
+      OdometryFrame merged;
+      merge(merged);
+      for (auto &pending : _pending) {
+        pending = Pending();
+      }
+      _odometry->setData(std::move(merged));
+    }
+  }
+
+  if (_frame_observer) {
+    for (const auto &dropped_stamp : dropped) {
+      _frame_observer->onFrameDropped(PipelineStage::FEATURE_EXTRACTION, dropped_stamp);
+    }
+  }
+
+}
+/*//}*/
+
+/*//{ merge() */
+// concatenates the pending frames in the order of the lidars, the merged clouds have the header of the primary lidar
+void FeatureMerger::merge(OdometryFrame &merged) {
+  const auto concatenate = [this](const pcl::PointCloud<PointType>::Ptr OdometryFrame::*member) {
+    const pcl::PointCloud<PointType>::Ptr cloud = _cloud_pool->acquire();
+
+    std::size_t size = 0;
+    for (const auto &pending : _pending) {
+      size += (pending.frame.*member)->size();
+    }
+    cloud->reserve(size);
+    for (const auto &pending : _pending) {
+      *cloud += *(pending.frame.*member);
+    }
+    cloud->header = (_pending.front().frame.*member)->header;
+    return cloud;
+  };
+
+  merged.corner_points_sharp      = concatenate(&OdometryFrame::corner_points_sharp);
+  merged.corner_points_less_sharp = concatenate(&OdometryFrame::corner_points_less_sharp);
+  merged.surf_points_flat         = concatenate(&OdometryFrame::surf_points_flat);
+  merged.surf_points_less_flat    = concatenate(&OdometryFrame::surf_points_less_flat);
+  merged.cloud_full_res           = concatenate(&OdometryFrame::cloud_full_res);
+
+  for (const auto &pending : _pending) {
+    merged.corner_channels_sharp.append(pending.frame.corner_channels_sharp);
+    merged.corner_channels_less_sharp.append(pending.frame.corner_channels_less_sharp);
+    merged.surf_channels_flat.append(pending.frame.surf_channels_flat);
+    merged.surf_channels_less_flat.append(pending.frame.surf_channels_less_flat);
+  }
+}
+/*//}*/
+
+}  // namespace aloam_slam
@@ -0,0 +1,186 @@
+#include "aloam_slam/feature_selection.h"
+
+namespace aloam_slam
+{
+
+/*//{ FeatureSelector() */
+FeatureSelector::FeatureSelector() {
+  _surf_points_less_flat_scan = boost::make_shared<pcl::PointCloud<PointType>>();
+}
+/*//}*/
+
+/*//{ computeCurvature() */
+void FeatureSelector::computeCurvature(FeatureCloud &cloud) {
+  std::vector<int> &cloudSortInd = _cloud_sort_indices;
+
+  const unsigned int cloud_size = cloud.size();
+  cloud.curvature.assign(cloud_size, 0.0f);
+  cloudSortInd.assign(cloud_size, 0);
+  _cloud_neighbor_picked.assign(cloud_size, 0);
+  _cloud_label.assign(cloud_size, 0);
+
+  const float *const x              = cloud.x.data();
+  const float *const y              = cloud.y.data();
+  const float *const z              = cloud.z.data();
+  float *const       cloudCurvature = cloud.curvature.data();
+
+  // the coordinates are in separate arrays, so the stencil over the neighbors is vectorized by the compiler
+  for (unsigned int i = 5; i + 5 < cloud_size; i++) {
+    const float diffX = x[i - 5] + x[i - 4] + x[i - 3] + x[i - 2] + x[i - 1] - 10 * x[i] + x[i + 1] + x[i + 2] + x[i + 3] + x[i + 4] + x[i + 5];
+    const float diffY = y[i - 5] + y[i - 4] + y[i - 3] + y[i - 2] + y[i - 1] - 10 * y[i] + y[i + 1] + y[i + 2] + y[i + 3] + y[i + 4] + y[i + 5];
+    const float diffZ = z[i - 5] + z[i - 4] + z[i - 3] + z[i - 2] + z[i - 1] - 10 * z[i] + z[i + 1] + z[i + 2] + z[i + 3] + z[i + 4] + z[i + 5];
+
+    cloudCurvature[i] = diffX * diffX + diffY * diffY + diffZ * diffZ;
+  }
+
+  for (unsigned int i = 5; i + 5 < cloud_size; i++) {
+    cloudSortInd[i] = i;
+  }
+}
+/*//}*/
+
+/*//{ selectFeatures() */
+void FeatureSelector::selectFeatures(const FeatureCloud &cloud, const std::vector<int> &rows_start_indices,
+                                     const std::vector<int> &rows_end_indices, const FeatureSelectionParams &params,
+                                     pcl::PointCloud<PointType> &corner_points_sharp, pcl::PointCloud<PointType> &corner_points_less_sharp,
+                                     pcl::PointCloud<PointType> &surf_points_flat, pcl::PointCloud<PointType> &surf_points_less_flat,
+                                     FeatureChannels &corner_channels_sharp, FeatureChannels &corner_channels_less_sharp,
+                                     FeatureChannels &surf_channels_flat, FeatureChannels &surf_channels_less_flat) {
+  const auto &      cloudCurvature      = cloud.curvature;
+  std::vector<int> &cloudSortInd        = _cloud_sort_indices;
+  std::vector<int> &cloudNeighborPicked = _cloud_neighbor_picked;
+  std::vector<int> &cloudLabel          = _cloud_label;
+
+  _filter_less_flat.setLeafSize(params.less_flat_resolution, params.less_flat_resolution, params.less_flat_resolution);
+
+  // the selection usually stops within the quota of points plus a few points picked as neighbors
+  const int sort_chunk = 2 * std::max(params.less_sharp_points_per_region, params.flat_points_per_region);
+
+  const int number_of_rings = int(std::min(rows_start_indices.size(), rows_end_indices.size()));
+  for (int i = 0; i < number_of_rings; i++) {
+    if (rows_end_indices.at(i) - rows_start_indices.at(i) < 6) {
+      continue;
+    }
+    const pcl::PointCloud<PointType>::Ptr &surfPointsLessFlatScan = _surf_points_less_flat_scan;
+    surfPointsLessFlatScan->clear();
+    for (int j = 0; j < params.regions_per_ring; j++) {
+      const int sp = rows_start_indices.at(i) + (rows_end_indices.at(i) - rows_start_indices.at(i)) * j / params.regions_per_ring;
+      const int ep = rows_start_indices.at(i) + (rows_end_indices.at(i) - rows_start_indices.at(i)) * (j + 1) / params.regions_per_ring - 1;
+      if (ep < sp) {
+        continue;
+      }
+
+      CurvatureOrder order(cloudSortInd.begin() + sp, cloudSortInd.begin() + ep + 1, cloudCurvature.data(), sort_chunk);
+
+      int largestPickedNum = 0;
+      for (int k = 0; k < order.size(); k++) {
+        const int ind = order.descending(k);
+
+        if (cloudCurvature.at(ind) <= params.curvature_threshold) {
+          break;
+        }
+
+        if (cloudNeighborPicked.at(ind) == 0) {
+
+          largestPickedNum++;
+          if (largestPickedNum <= params.sharp_points_per_region) {
+            cloudLabel.at(ind) = 2;
+            cloud.appendTo(ind, corner_points_sharp, corner_channels_sharp);
+            cloud.appendTo(ind, corner_points_less_sharp, corner_channels_less_sharp);
+          } else if (largestPickedNum <= params.less_sharp_points_per_region) {
+            cloudLabel.at(ind) = 1;
+            cloud.appendTo(ind, corner_points_less_sharp, corner_channels_less_sharp);
+          } else {
+            break;
+          }
+
+          markNeighborsPicked(cloud, ind);
+        }
+      }
+
+      int smallestPickedNum = 0;
+      for (int k = 0; k < order.size(); k++) {
+        const int ind = order.ascending(k);
+
+        if (cloudCurvature.at(ind) >= params.curvature_threshold) {
+          break;
+        }
+
+        if (cloudNeighborPicked.at(ind) == 0) {
+
+          cloudLabel.at(ind) = -1;
+          cloud.appendTo(ind, surf_points_flat, surf_channels_flat);
+
+          smallestPickedNum++;
+          if (smallestPickedNum >= params.flat_points_per_region) {
+            break;
+          }
+
+          markNeighborsPicked(cloud, ind);
+        }
+      }
+
+      for (int k = sp; k <= ep; k++) {
+        if (cloudLabel.at(k) <= 0) {
+          surfPointsLessFlatScan->push_back(cloud.toPoint(k));
+          surfPointsLessFlatScan->points.back().intensity = cloud.time[k];
+        }
+      }
+    }
+
+    downsampleLessFlat(_filter_less_flat, surfPointsLessFlatScan, cloud.ring.at(rows_start_indices.at(i)), cloud.scan_period_sec,
+                       _surf_points_less_flat_scan_ds, surf_points_less_flat, surf_channels_less_flat);
+  }
+}
+/*//}*/
+
+/*//{ markNeighborsPicked() */
+// the point and its neighbors closer than ~0.22 m to each other (up to 5 on each side) are not selected again
+void FeatureSelector::markNeighborsPicked(const FeatureCloud &cloud, const int ind) {
+  std::vector<int> &cloudNeighborPicked = _cloud_neighbor_picked;
+
+  const auto &x = cloud.x;
+  const auto &y = cloud.y;
+  const auto &z = cloud.z;
+
+  cloudNeighborPicked.at(ind) = 1;
+
+  for (int l = 1; l <= 5; l++) {
+    const float diffX = x.at(ind + l) - x.at(ind + l - 1);
+    const float diffY = y.at(ind + l) - y.at(ind + l - 1);
+    const float diffZ = z.at(ind + l) - z.at(ind + l - 1);
+    if (diffX * diffX + diffY * diffY + diffZ * diffZ > 0.05) {
+      break;
+    }
+
+    cloudNeighborPicked.at(ind + l) = 1;
+  }
+  for (int l = -1; l >= -5; l--) {
+    const float diffX = x.at(ind + l) - x.at(ind + l + 1);
+    const float diffY = y.at(ind + l) - y.at(ind + l + 1);
+    const float diffZ = z.at(ind + l) - z.at(ind + l + 1);
+    if (diffX * diffX + diffY * diffY + diffZ * diffZ > 0.05) {
+      break;
+    }
+
+    cloudNeighborPicked.at(ind + l) = 1;
+  }
+}
+/*//}*/
+
+/*//{ downsampleLessFlat() */
+void downsampleLessFlat(pcl::VoxelGrid<PointType> &filter, const pcl::PointCloud<PointType>::Ptr &ring_points, const int ring,
+                        const float scan_period_sec, pcl::PointCloud<PointType> &downsampled, pcl::PointCloud<PointType> &surf_points_less_flat,
+                        FeatureChannels &surf_channels_less_flat) {
+  filter.setInputCloud(ring_points);
+  filter.filter(downsampled);
+
+  for (auto &point : downsampled.points) {
+    surf_channels_less_flat.push_back(ring, point.intensity);
+    point.intensity = float(ring) + scan_period_sec * point.intensity;
+  }
+  surf_points_less_flat += downsampled;
+}
+/*//}*/
+
+}  // namespace aloam_slam
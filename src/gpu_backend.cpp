@@ -0,0 +1,239 @@
+#include "aloam_slam/gpu_backend.h"
+
+namespace aloam_slam
+{
+
+namespace
+{
+
+#ifdef ALOAM_WITH_CUDA
+
+// x, y, z of the i-th point at points[i * POINT_STRIDE]
+constexpr std::size_t POINT_STRIDE = sizeof(PointType) / sizeof(float);
+
+// as the voxel size of the hash maps, all the 5 neighbors accepted by the CPU association are closer than the radius
+constexpr float SEARCH_RADIUS = 1.0f;
+
+/*//{ pointData() */
+const float *pointData(const pcl::PointCloud<PointType> &cloud) {
+  return cloud.points.empty() ? nullptr : &cloud.points.front().x;
+}
+/*//}*/
+
+#else
+
+const std::string NOT_BUILT = "built without the CUDA backend (ALOAM_ENABLE_CUDA)";
+
+#endif
+
+}  // namespace
+
+/*//{ gpuBackendAvailable() */
+bool gpuBackendAvailable(std::string &error) {
+#ifdef ALOAM_WITH_CUDA
+  return gpu::deviceAvailable(error);
+#else
+  error = NOT_BUILT;
+  return false;
+#endif
+}
+/*//}*/
+
+/*//{ GpuFeatureSelector() */
+GpuFeatureSelector::GpuFeatureSelector() {
+#ifdef ALOAM_WITH_CUDA
+  _kernels = std::make_shared<gpu::FeatureKernels>();
+#endif
+  _surf_points_less_flat_scan = boost::make_shared<pcl::PointCloud<PointType>>();
+}
+/*//}*/
+
+/*//{ GpuFeatureSelector::selectFeatures() */
+bool GpuFeatureSelector::selectFeatures(FeatureCloud &cloud, const std::vector<int> &rows_start_indices, const std::vector<int> &rows_end_indices,
+                                        const FeatureSelectionParams &params, pcl::PointCloud<PointType> &corner_points_sharp,
+                                        pcl::PointCloud<PointType> &corner_points_less_sharp, pcl::PointCloud<PointType> &surf_points_flat,
+                                        pcl::PointCloud<PointType> &surf_points_less_flat, FeatureChannels &corner_channels_sharp,
+                                        FeatureChannels &corner_channels_less_sharp, FeatureChannels &surf_channels_flat,
+                                        FeatureChannels &surf_channels_less_flat, std::string &error) {
+#ifdef ALOAM_WITH_CUDA
+  // the regions of FeatureSelector::selectFeatures(), the rings with fewer than 6 points are skipped
+  _regions.clear();
+  _ring_regions.clear();
+  const int number_of_rings = int(std::min(rows_start_indices.size(), rows_end_indices.size()));
+  for (int i = 0; i < number_of_rings; i++) {
+    if (rows_end_indices.at(i) - rows_start_indices.at(i) < 6) {
+      continue;
+    }
+    _ring_regions.push_back(int(_regions.size()));
+    for (int j = 0; j < params.regions_per_ring; j++) {
+      const int sp = rows_start_indices.at(i) + (rows_end_indices.at(i) - rows_start_indices.at(i)) * j / params.regions_per_ring;
+      const int ep = rows_start_indices.at(i) + (rows_end_indices.at(i) - rows_start_indices.at(i)) * (j + 1) / params.regions_per_ring - 1;
+      if (ep < sp) {
+        continue;
+      }
+      if (ep + 1 - sp > gpu::MAX_REGION_SIZE) {
+        error = "region of " + std::to_string(ep + 1 - sp) + " points is larger than " + std::to_string(gpu::MAX_REGION_SIZE);
+        return false;
+      }
+      _regions.push_back({sp, ep + 1});
+    }
+  }
+  const int rings_count = int(_ring_regions.size());
+  _ring_regions.push_back(int(_regions.size()));
+
+  gpu::SelectionParams gpu_params;
+  gpu_params.sharp_points_per_region      = params.sharp_points_per_region;
+  gpu_params.less_sharp_points_per_region = params.less_sharp_points_per_region;
+  gpu_params.flat_points_per_region       = params.flat_points_per_region;
+  gpu_params.curvature_threshold          = params.curvature_threshold;
+
+  const int         sharp_stride  = gpu::sharpStride(gpu_params);
+  const int         flat_stride   = gpu::flatStride(gpu_params);
+  const std::size_t regions_count = _regions.size();
+  _sharp_indices.resize(regions_count * sharp_stride);
+  _sharp_counts.resize(regions_count);
+  _flat_indices.resize(regions_count * flat_stride);
+  _flat_counts.resize(regions_count);
+  _labels.resize(cloud.size());
+  cloud.curvature.resize(cloud.size());
+
+  if (!_kernels->selectFeatures(cloud.x.data(), cloud.y.data(), cloud.z.data(), cloud.size(), _regions.data(), int(regions_count),
+                                _ring_regions.data(), rings_count, gpu_params, cloud.curvature.data(), _sharp_indices.data(), _sharp_counts.data(),
+                                _flat_indices.data(), _flat_counts.data(), _labels.data(), error)) {
+    return false;
+  }
+
+  _filter_less_flat.setLeafSize(params.less_flat_resolution, params.less_flat_resolution, params.less_flat_resolution);
+
+  for (int ring = 0; ring < rings_count; ring++) {
+    for (int r = _ring_regions[ring]; r < _ring_regions[ring + 1]; r++) {
+      const int *const sharp = _sharp_indices.data() + r * sharp_stride;
+      for (int k = 0; k < _sharp_counts[r]; k++) {
+        if (k < params.sharp_points_per_region) {
+          cloud.appendTo(sharp[k], corner_points_sharp, corner_channels_sharp);
+        }
+        cloud.appendTo(sharp[k], corner_points_less_sharp, corner_channels_less_sharp);
+      }
+
+      const int *const flat = _flat_indices.data() + r * flat_stride;
+      for (int k = 0; k < _flat_counts[r]; k++) {
+        cloud.appendTo(flat[k], surf_points_flat, surf_channels_flat);
+      }
+
+      for (int k = _regions[r].begin; k < _regions[r].end; k++) {
+        if (_labels[k] <= 0) {
+          _surf_points_less_flat_scan->push_back(cloud.toPoint(k));
+          _surf_points_less_flat_scan->points.back().intensity = cloud.time[k];
+        }
+      }
+    }
+
+    // the less flat features are downsampled per ring
+    if (_ring_regions[ring] < _ring_regions[ring + 1]) {
+      downsampleLessFlat(_filter_less_flat, _surf_points_less_flat_scan, cloud.ring.at(_regions[_ring_regions[ring]].begin), cloud.scan_period_sec,
+                         _surf_points_less_flat_scan_ds, surf_points_less_flat, surf_channels_less_flat);
+    }
+    _surf_points_less_flat_scan->clear();
+  }
+
+  return true;
+#else
+  error = NOT_BUILT;
+  return false;
+#endif
+}
+/*//}*/
+
+/*//{ GpuMapAssociation() */
+GpuMapAssociation::GpuMapAssociation() {
+#ifdef ALOAM_WITH_CUDA
+  _map_corners = std::make_shared<gpu::VoxelHashMap>(SEARCH_RADIUS);
+  _map_surfs   = std::make_shared<gpu::VoxelHashMap>(SEARCH_RADIUS);
+#endif
+}
+/*//}*/
+
+/*//{ setMap() */
+bool GpuMapAssociation::setMap(const pcl::PointCloud<PointType>::ConstPtr &map_corners, const pcl::PointCloud<PointType>::ConstPtr &map_surfs,
+                               const bool is_static, std::string &error) {
+#ifdef ALOAM_WITH_CUDA
+  if (is_static && map_corners == _static_corners && map_surfs == _static_surfs) {
+    return true;
+  }
+
+  _static_corners.reset();
+  _static_surfs.reset();
+
+  if (!_map_corners->build(pointData(*map_corners), map_corners->points.size(), POINT_STRIDE, error) ||
+      !_map_surfs->build(pointData(*map_surfs), map_surfs->points.size(), POINT_STRIDE, error)) {
+    return false;
+  }
+
+  if (is_static) {
+    _static_corners = map_corners;
+    _static_surfs   = map_surfs;
+  }
+  return true;
+#else
+  error = NOT_BUILT;
+  return false;
+#endif
+}
+/*//}*/
+
+/*//{ findCorrespondences() */
+bool GpuMapAssociation::findCorrespondences(const pcl::PointCloud<PointType> &corners_ori, const pcl::PointCloud<PointType> &corners_sel,
+                                            const pcl::PointCloud<PointType> &surfs_ori, const pcl::PointCloud<PointType> &surfs_sel,
+                                            std::vector<EdgeCorrespondence> &corner_correspondences,
+                                            std::vector<PlaneNormCorrespondence> &surf_correspondences, std::string &error) {
+#ifdef ALOAM_WITH_CUDA
+  _edge_fits.resize(corners_sel.points.size());
+  _plane_fits.resize(surfs_sel.points.size());
+
+  if (!_map_corners->fitEdges(pointData(corners_sel), corners_sel.points.size(), POINT_STRIDE, _edge_fits.data(), error) ||
+      !_map_surfs->fitPlanes(pointData(surfs_sel), surfs_sel.points.size(), POINT_STRIDE, _plane_fits.data(), error)) {
+    return false;
+  }
+
+  corner_correspondences.clear();
+  for (std::size_t i = 0; i < _edge_fits.size(); i++) {
+    const gpu::EdgeFit &fit = _edge_fits[i];
+    if (!fit.valid) {
+      continue;
+    }
+    const Eigen::Vector3d center(fit.center[0], fit.center[1], fit.center[2]);
+    const Eigen::Vector3d unit_direction(fit.direction[0], fit.direction[1], fit.direction[2]);
+
+    EdgeCorrespondence corr;
+    corr.curr_point = Eigen::Vector3d(corners_ori.points.at(i).x, corners_ori.points.at(i).y, corners_ori.points.at(i).z);
+    corr.point_a    = 0.1 * unit_direction + center;
+    corr.point_b    = -0.1 * unit_direction + center;
+    corr.s          = 1.0;
+    corner_correspondences.push_back(corr);
+  }
+
+  surf_correspondences.clear();
+  for (std::size_t i = 0; i < _plane_fits.size(); i++) {
+    const gpu::PlaneFit &fit = _plane_fits[i];
+    if (!fit.valid) {
+      continue;
+    }
+    // oriented as by fitPlaneCorrespondence(), the offset is positive (the plane does not pass through the origin)
+    const double sign = fit.offset < 0.0f ? -1.0 : 1.0;
+
+    PlaneNormCorrespondence corr;
+    corr.curr_point           = Eigen::Vector3d(surfs_ori.points.at(i).x, surfs_ori.points.at(i).y, surfs_ori.points.at(i).z);
+    corr.plane_unit_norm      = sign * Eigen::Vector3d(fit.normal[0], fit.normal[1], fit.normal[2]);
+    corr.negative_OA_dot_norm = sign * fit.offset;
+    surf_correspondences.push_back(corr);
+  }
+
+  return true;
+#else
+  error = NOT_BUILT;
+  return false;
+#endif
+}
+/*//}*/
+
+}  // namespace aloam_slam
@@ -0,0 +1,124 @@
+#include "aloam_slam/keyframes.h"
+
+namespace aloam_slam
+{
+
+/*//{ KeyframePolicy() */
+KeyframePolicy::KeyframePolicy(const KeyframePolicyOptions &options) : _options(options) {
+}
+/*//}*/
+
+/*//{ enabled() */
+bool KeyframePolicy::enabled() const {
+  return _options.enable;
+}
+/*//}*/
+
+/*//{ update() */
+bool KeyframePolicy::update(const ros::Time &stamp, const Eigen::Quaterniond &q_w_curr, const Eigen::Vector3d &t_w_curr) {
+  std::scoped_lock lock(_mutex);
+
+  if (_options.enable && _has_keyframe) {
+    const double translation = (t_w_curr - _t_w_keyframe).norm();
+    const double rotation    = _q_w_keyframe.angularDistance(q_w_curr);
+    const double interval    = (stamp - _stamp).toSec();
+
+    const bool moved   = translation >= _options.translation || rotation >= _options.rotation;
+    const bool expired = _options.max_interval > 0.0 && interval >= _options.max_interval;
+    if (!moved && !expired) {
+      return false;
+    }
+  }
+
+  _has_keyframe = true;
+  _stamp        = stamp;
+  _q_w_keyframe = q_w_curr;
+  _t_w_keyframe = t_w_curr;
+  return true;
+}
+/*//}*/
+
+/*//{ reset() */
+void KeyframePolicy::reset() {
+  std::scoped_lock lock(_mutex);
+  _has_keyframe = false;
+}
+/*//}*/
+
+/*//{ KeyframeWindow() */
+KeyframeWindow::KeyframeWindow(const int size, const float resolution_line, const float resolution_plane) : _size(std::max(size, 1)) {
+  _filter_corners.setLeafSize(resolution_line, resolution_line, resolution_line);
+  _filter_surfs.setLeafSize(resolution_plane, resolution_plane, resolution_plane);
+}
+/*//}*/
+
+/*//{ add() */
+void KeyframeWindow::add(const pcl::PointCloud<PointType>::Ptr &corners_w, const pcl::PointCloud<PointType>::Ptr &surfs_w) {
+  std::deque<Keyframe> keyframes;
+  unsigned long        generation;
+  {
+    std::scoped_lock lock(_mutex);
+    _keyframes.push_back({corners_w, surfs_w});
+    while (int(_keyframes.size()) > _size) {
+      _keyframes.pop_front();
+    }
+    keyframes  = _keyframes;
+    generation = _generation;
+  }
+
+  // the snapshot is built without the lock, the registration keeps using the previous one until it is replaced
+  const pcl::PointCloud<PointType>::Ptr corners = boost::make_shared<pcl::PointCloud<PointType>>();
+  const pcl::PointCloud<PointType>::Ptr surfs   = boost::make_shared<pcl::PointCloud<PointType>>();
+  for (const auto &keyframe : keyframes) {
+    *corners += *keyframe.corners;
+    *surfs += *keyframe.surfs;
+  }
+
+  const std::shared_ptr<StaticMap> map = std::make_shared<StaticMap>();
+  map->corners                         = boost::make_shared<pcl::PointCloud<PointType>>();
+  map->surfs                           = boost::make_shared<pcl::PointCloud<PointType>>();
+  _filter_corners.setInputCloud(corners);
+  _filter_corners.filter(*map->corners);
+  _filter_surfs.setInputCloud(surfs);
+  _filter_surfs.filter(*map->surfs);
+
+  map->kdtree_corners = boost::make_shared<pcl::KdTreeFLANN<PointType>>();
+  map->kdtree_surfs   = boost::make_shared<pcl::KdTreeFLANN<PointType>>();
+  if (!map->corners->empty()) {
+    map->kdtree_corners->setInputCloud(map->corners);
+  }
+  if (!map->surfs->empty()) {
+    map->kdtree_surfs->setInputCloud(map->surfs);
+  }
+
+  std::scoped_lock lock(_mutex);
+  if (generation == _generation) {
+    _map = map;
+  }
+}
+/*//}*/
+
+/*//{ map() */
+std::shared_ptr<const StaticMap> KeyframeWindow::map() const {
+  std::scoped_lock lock(_mutex);
+  return _map;
+}
+/*//}*/
+
+/*//{ keyframes() */
+int KeyframeWindow::keyframes() const {
+  std::scoped_lock lock(_mutex);
+  return int(_keyframes.size());
+}
+/*//}*/
+
+/*//{ clear() */
+void KeyframeWindow::clear() {
+  std::scoped_lock lock(_mutex);
+  _keyframes.clear();
+  _map.reset();
+  _generation++;
+}
+/*//}*/
+
+}  // namespace aloam_slam
@@ -0,0 +1,76 @@
+#include "aloam_slam/latency_controller.h"
+
+namespace aloam_slam
+{
+
+/*//{ LatencyController() */
+LatencyController::LatencyController(const LatencyControllerOptions &options) : _options(options) {
+  _options.budget_ms            = std::max(_options.budget_ms, 1.0f);
+  _options.smoothing            = std::clamp(_options.smoothing, 0.0f, 1.0f);
+  _options.min_feature_ratio    = std::clamp(_options.min_feature_ratio, 0.0f, 1.0f);
+  _options.max_resolution_ratio = std::max(_options.max_resolution_ratio, 1.0f);
+}
+/*//}*/
+
+/*//{ enabled() */
+bool LatencyController::enabled() const {
+  return _options.enable;
+}
+/*//}*/
+
+/*//{ update() */
+void LatencyController::update(const float latency_ms) {
+  if (!_options.enable) {
+    return;
+  }
+
+  float smoothed = latency_ms;
+  if (_has_latency) {
+    smoothed = _options.smoothing * latency_ms + (1.0f - _options.smoothing) * _smoothed_latency_ms.load(std::memory_order_relaxed);
+  }
+  _has_latency = true;
+  _smoothed_latency_ms.store(smoothed, std::memory_order_relaxed);
+
+  const float error = (smoothed - _options.budget_ms) / _options.budget_ms;
+  if (std::fabs(error) <= _options.deadband) {
+    return;
+  }
+
+  const float degradation = std::clamp(_degradation.load(std::memory_order_relaxed) + _options.gain * error, 0.0f, 1.0f);
+  _degradation.store(degradation, std::memory_order_relaxed);
+}
+/*//}*/
+
+/*//{ degradation() */
+float LatencyController::degradation() const {
+  return _degradation.load(std::memory_order_relaxed);
+}
+/*//}*/
+
+/*//{ smoothedLatency() */
+float LatencyController::smoothedLatency() const {
+  return _smoothed_latency_ms.load(std::memory_order_relaxed);
+}
+/*//}*/
+
+/*//{ scaleFeatureCount() */
+int LatencyController::scaleFeatureCount(const int count) const {
+  const float ratio = 1.0f - degradation() * (1.0f - _options.min_feature_ratio);
+  return std::max(int(std::round(count * ratio)), std::min(count, 1));
+}
+/*//}*/
+
+/*//{ scaleResolution() */
+float LatencyController::scaleResolution(const float resolution) const {
+  return resolution * (1.0f + degradation() * (_options.max_resolution_ratio - 1.0f));
+}
+/*//}*/
+
+/*//{ scaleNeighborhood() */
+int LatencyController::scaleNeighborhood(const int radius) const {
+  const int min_radius = std::min(_options.min_neighborhood_xy, radius);
+  return int(std::round(radius - degradation() * (radius - min_radius)));
+}
+/*//}*/
+
+}  // namespace aloam_slam
@@ -0,0 +1,341 @@
+#include "aloam_slam/map_file.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <iomanip>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace aloam_slam
+{
+
+namespace
+{
+
+constexpr char     MAP_FILE_MAGIC[8]  = {'A', 'L', 'O', 'A', 'M', 'M', 'A', 'P'};
+constexpr uint32_t MAP_FILE_VERSION   = 1;
+constexpr int      MAP_FILE_POINT_LEN = 4;  // floats per point
+
+/*//{ syncFile() */
+// flushes the written file to the disk, so the rename never replaces the previous file by an incomplete one after a crash
+bool syncFile(const std::string &path, std::string &error) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    error = "cannot open " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  const bool synced = ::fsync(fd) == 0;
+  if (!synced) {
+    error = "cannot sync " + path + ": " + std::strerror(errno);
+  }
+  ::close(fd);
+  return synced;
+}
+/*//}*/
+
+}  // namespace
+
+/*//{ saveMapFile() */
+bool saveMapFile(const std::string &path, const float cube_size, const std::vector<std::pair<CubeKey, MapCube>> &cubes, std::string &error) {
+  MapFileHeader header;
+  std::memcpy(header.magic, MAP_FILE_MAGIC, sizeof(header.magic));
+  header.version   = MAP_FILE_VERSION;
+  header.cube_size = cube_size;
+  header.num_tiles = cubes.size();
+
+  std::vector<MapFileTile> tiles(cubes.size());
+  uint64_t                 offset = sizeof(MapFileHeader) + tiles.size() * sizeof(MapFileTile);
+  for (std::size_t c = 0; c < cubes.size(); c++) {
+    const auto &[key, cube] = cubes.at(c);
+    MapFileTile &tile       = tiles.at(c);
+    tile.i                  = key.i;
+    tile.j                  = key.j;
+    tile.k                  = key.k;
+    tile.num_corners        = uint32_t(cube.corners->size());
+    tile.num_surfs          = uint32_t(cube.surfs->size());
+    tile.reserved           = 0;
+    tile.offset             = offset;
+    offset += (uint64_t(tile.num_corners) + tile.num_surfs) * MAP_FILE_POINT_LEN * sizeof(float);
+  }
+
+  const std::string path_tmp = path + ".tmp";
+  std::ofstream     file(path_tmp, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    error = "cannot open " + path_tmp + " for writing";
+    return false;
+  }
+
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(tiles.data()), std::streamsize(tiles.size() * sizeof(MapFileTile)));
+
+  std::vector<float> buffer;
+  const auto         writePoints = [&](const pcl::PointCloud<PointType> &cloud) {
+    buffer.resize(cloud.size() * MAP_FILE_POINT_LEN);
+    for (std::size_t i = 0; i < cloud.size(); i++) {
+      const PointType &point  = cloud.points[i];
+      float *          values = buffer.data() + i * MAP_FILE_POINT_LEN;
+      values[0]               = point.x;
+      values[1]               = point.y;
+      values[2]               = point.z;
+      values[3]               = point.intensity;
+    }
+    file.write(reinterpret_cast<const char *>(buffer.data()), std::streamsize(buffer.size() * sizeof(float)));
+  };
+
+  for (const auto &[key, cube] : cubes) {
+    writePoints(*cube.corners);
+    writePoints(*cube.surfs);
+  }
+
+  file.close();
+  if (!file) {
+    error = "failed writing " + path_tmp;
+    std::remove(path_tmp.c_str());
+    return false;
+  }
+
+  if (!syncFile(path_tmp, error)) {
+    std::remove(path_tmp.c_str());
+    return false;
+  }
+
+  if (std::rename(path_tmp.c_str(), path.c_str()) != 0) {
+    error = "cannot rename " + path_tmp + " to " + path + ": " + std::strerror(errno);
+    std::remove(path_tmp.c_str());
+    return false;
+  }
+
+  return true;
+}
+/*//}*/
+
+/*//{ savePoseFile() */
+bool savePoseFile(const std::string &path, const PersistedPose &pose, std::string &error) {
+  const std::string path_tmp = path + ".tmp";
+  std::ofstream     file(path_tmp, std::ios::trunc);
+  if (!file) {
+    error = "cannot open " + path_tmp + " for writing";
+    return false;
+  }
+
+  file << std::setprecision(17) << pose.stamp.sec << " " << pose.stamp.nsec << " " << pose.t_wodom_curr.x() << " " << pose.t_wodom_curr.y() << " "
+       << pose.t_wodom_curr.z() << " " << pose.q_wodom_curr.x() << " " << pose.q_wodom_curr.y() << " " << pose.q_wodom_curr.z() << " "
+       << pose.q_wodom_curr.w() << " " << pose.t_wmap_wodom.x() << " " << pose.t_wmap_wodom.y() << " " << pose.t_wmap_wodom.z() << " "
+       << pose.q_wmap_wodom.x() << " " << pose.q_wmap_wodom.y() << " " << pose.q_wmap_wodom.z() << " " << pose.q_wmap_wodom.w() << "\n";
+
+  file.close();
+  if (!file) {
+    error = "failed writing " + path_tmp;
+    std::remove(path_tmp.c_str());
+    return false;
+  }
+
+  if (!syncFile(path_tmp, error)) {
+    std::remove(path_tmp.c_str());
+    return false;
+  }
+
+  if (std::rename(path_tmp.c_str(), path.c_str()) != 0) {
+    error = "cannot rename " + path_tmp + " to " + path + ": " + std::strerror(errno);
+    std::remove(path_tmp.c_str());
+    return false;
+  }
+
+  return true;
+}
+/*//}*/
+
+/*//{ loadPoseFile() */
+bool loadPoseFile(const std::string &path, PersistedPose &pose, std::string &error) {
+  std::ifstream file(path);
+  if (!file) {
+    error = "cannot open " + path;
+    return false;
+  }
+
+  uint32_t sec;
+  uint32_t nsec;
+  double   t_odom[3];
+  double   q_odom[4];
+  double   t_map[3];
+  double   q_map[4];
+  file >> sec >> nsec >> t_odom[0] >> t_odom[1] >> t_odom[2] >> q_odom[0] >> q_odom[1] >> q_odom[2] >> q_odom[3] >> t_map[0] >> t_map[1] >> t_map[2] >>
+      q_map[0] >> q_map[1] >> q_map[2] >> q_map[3];
+  if (!file) {
+    error = path + " is not a pose file";
+    return false;
+  }
+
+  pose.stamp        = ros::Time(sec, nsec);
+  pose.t_wodom_curr = Eigen::Vector3d(t_odom[0], t_odom[1], t_odom[2]);
+  pose.q_wodom_curr = Eigen::Quaterniond(q_odom[3], q_odom[0], q_odom[1], q_odom[2]).normalized();
+  pose.t_wmap_wodom = Eigen::Vector3d(t_map[0], t_map[1], t_map[2]);
+  pose.q_wmap_wodom = Eigen::Quaterniond(q_map[3], q_map[0], q_map[1], q_map[2]).normalized();
+  return true;
+}
+/*//}*/
+
+/*//{ ~MappedMapFile() */
+MappedMapFile::~MappedMapFile() {
+  close();
+}
+/*//}*/
+
+/*//{ open() */
+bool MappedMapFile::open(const std::string &path, std::string &error) {
+  close();
+
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    error = "cannot open " + path + ": " + std::strerror(errno);
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || std::size_t(st.st_size) < sizeof(MapFileHeader)) {
+    error = path + " is not a map file";
+    ::close(fd);
+    return false;
+  }
+
+  void *data = mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid after closing the descriptor
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    error = "cannot map " + path + ": " + std::strerror(errno);
+    return false;
+  }
+
+  _data = static_cast<const uint8_t *>(data);
+  _size = std::size_t(st.st_size);
+  _path = path;
+
+  MapFileHeader header;
+  std::memcpy(&header, _data, sizeof(header));
+  if (std::memcmp(header.magic, MAP_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != MAP_FILE_VERSION) {
+    error = path + " is not a map file of version " + std::to_string(MAP_FILE_VERSION);
+    close();
+    return false;
+  }
+
+  if (header.num_tiles > (_size - sizeof(MapFileHeader)) / sizeof(MapFileTile)) {
+    error = path + " is truncated";
+    close();
+    return false;
+  }
+
+  _cube_size = header.cube_size;
+  _tiles.reserve(header.num_tiles);
+
+  for (uint64_t t = 0; t < header.num_tiles; t++) {
+    MapFileTile tile;
+    std::memcpy(&tile, _data + sizeof(MapFileHeader) + t * sizeof(MapFileTile), sizeof(tile));
+
+    const uint64_t length = (uint64_t(tile.num_corners) + tile.num_surfs) * MAP_FILE_POINT_LEN * sizeof(float);
+    if (tile.offset > _size || length > _size - tile.offset) {
+      error = path + " is truncated";
+      close();
+      return false;
+    }
+
+    _tiles.emplace(CubeKey{tile.i, tile.j, tile.k}, tile);
+  }
+
+  // the tiles are read in random order as the vehicle moves
+  madvise(data, _size, MADV_RANDOM);
+
+  return true;
+}
+/*//}*/
+
+/*//{ close() */
+void MappedMapFile::close() {
+  if (_data) {
+    munmap(const_cast<uint8_t *>(_data), _size);
+  }
+  _data      = nullptr;
+  _size      = 0;
+  _cube_size = 0.0f;
+  _path.clear();
+  _tiles.clear();
+}
+/*//}*/
+
+/*//{ isOpen() */
+bool MappedMapFile::isOpen() const {
+  return _data != nullptr;
+}
+/*//}*/
+
+/*//{ path() */
+const std::string &MappedMapFile::path() const {
+  return _path;
+}
+/*//}*/
+
+/*//{ cubeSize() */
+float MappedMapFile::cubeSize() const {
+  return _cube_size;
+}
+/*//}*/
+
+/*//{ size() */
+std::size_t MappedMapFile::size() const {
+  return _tiles.size();
+}
+/*//}*/
+
+/*//{ keys() */
+std::vector<CubeKey> MappedMapFile::keys() const {
+  std::vector<CubeKey> keys;
+  keys.reserve(_tiles.size());
+  for (const auto &[key, tile] : _tiles) {
+    keys.push_back(key);
+  }
+  return keys;
+}
+/*//}*/
+
+/*//{ contains() */
+bool MappedMapFile::contains(const CubeKey &key) const {
+  return _tiles.find(key) != _tiles.end();
+}
+/*//}*/
+
+/*//{ readCube() */
+bool MappedMapFile::readCube(const CubeKey &key, CloudPool &cloud_pool, MapCube &cube) const {
+  const auto it = _tiles.find(key);
+  if (it == _tiles.end()) {
+    return false;
+  }
+  const MapFileTile &tile = it->second;
+
+  const uint8_t *ptr        = _data + tile.offset;
+  const auto     readPoints = [&ptr](pcl::PointCloud<PointType> &cloud, const uint32_t count) {
+    cloud.resize(count);
+    float values[MAP_FILE_POINT_LEN];
+    for (uint32_t i = 0; i < count; i++, ptr += sizeof(values)) {
+      std::memcpy(values, ptr, sizeof(values));
+      PointType &point = cloud.points[i];
+      point.x          = values[0];
+      point.y          = values[1];
+      point.z          = values[2];
+      point.intensity  = values[3];
+    }
+  };
+
+  cube.corners = cloud_pool.acquire();
+  cube.surfs   = cloud_pool.acquire();
+  readPoints(*cube.corners, tile.num_corners);
+  readPoints(*cube.surfs, tile.num_surfs);
+
+  return true;
+}
+/*//}*/
+
+}  // namespace aloam_slam
@@ -6,8 +6,10 @@ namespace aloam_slam
 /*//{ AloamMapping() */
 AloamMapping::AloamMapping(const ros::NodeHandle &parent_nh, mrs_lib::ParamLoader param_loader, const std::shared_ptr<mrs_lib::Profiler> profiler,
                            const std::string &frame_fcu, const std::string &frame_map, const tf::Transform &tf_lidar_to_fcu,
+                           const std::shared_ptr<LatencyController> latency_controller, const SharedWorkers &shared_workers,
                            const bool enable_scope_timer, const std::shared_ptr<mrs_lib::ScopeTimerLogger> scope_timer_logger)
     : _profiler(profiler),
+      _latency_controller(latency_controller),
       _frame_fcu(frame_fcu),
       _frame_map(frame_map),
       _tf_lidar_to_fcu(tf_lidar_to_fcu),
@@ -18,15 +20,122 @@ AloamMapping::AloamMapping(const ros::NodeHandle &parent_nh, mrs_lib::ParamLoade
 
   ros::NodeHandle nh_(parent_nh);
 
-  ros::Time::waitForValid();
-
   param_loader.loadParam("mapping/remap_tf", _remap_tf, false);
   param_loader.loadParam("mapping/line_resolution", _resolution_line, 0.2f);
   param_loader.loadParam("mapping/plane_resolution", _resolution_plane, 0.4f);
   param_loader.loadParam("mapping/rate", _mapping_frequency, 5.0f);
   param_loader.loadParam("mapping/publish_rate", _map_publish_period, 0.5f);
+  param_loader.loadParam("mapping/voxel_map/cube_size", _cube_size, 50.0f);
+  param_loader.loadParam("mapping/voxel_map/eviction_radius_xy", _cube_eviction_radius_xy, 0);
+  param_loader.loadParam("mapping/voxel_map/eviction_radius_z", _cube_eviction_radius_z, 0);
+  param_loader.loadParam("mapping/map_file/path", _map_file_path, std::string(""));
+  param_loader.loadParam("mapping/map_file/load_on_start", _map_file_load_on_start, false);
+  param_loader.loadParam("mapping/map_file/stream", _map_file_stream, false);
+  param_loader.loadParam("mapping/map_file/stream_radius_xy", _map_file_stream_radius_xy, 2);
+  param_loader.loadParam("mapping/map_file/stream_radius_z", _map_file_stream_radius_z, 1);
+  param_loader.loadParam("mapping/background_update", _background_map_update, false);
+  const auto scan_registered_frame = param_loader.loadParam2<std::string>("mapping/scan_registered/frame", std::string("map"));
+  _scan_registered_in_lidar_frame  = scan_registered_frame == "lidar";
+  if (!_scan_registered_in_lidar_frame && scan_registered_frame != "map") {
+    ROS_ERROR("[AloamMapping]: Unknown frame of the registered scan \"%s\", publishing in the map frame.", scan_registered_frame.c_str());
+  }
+  param_loader.loadParam("mapping/incremental_index/enable", _use_incremental_index, false);
+  param_loader.loadParam("mapping/incremental_index/resolution", _incremental_index_resolution, 1.0f);
+  param_loader.loadParam("mapping/localization_only", _localization_only, false);
+  if (_localization_only) {
+    // the whole map is loaded once and indexed by static kd-trees
+    _map_file_stream       = false;
+    _use_incremental_index = false;
+  }
+  KeyframePolicyOptions keyframe_options;
+  param_loader.loadParam("mapping/keyframes/enable", keyframe_options.enable, keyframe_options.enable);
+  param_loader.loadParam("mapping/keyframes/translation", keyframe_options.translation, keyframe_options.translation);
+  keyframe_options.rotation = deg2rad(param_loader.loadParam2<double>("mapping/keyframes/rotation", rad2deg(keyframe_options.rotation)));
+  param_loader.loadParam("mapping/keyframes/max_interval", keyframe_options.max_interval, keyframe_options.max_interval);
+  const auto keyframe_window_enable = param_loader.loadParam2<bool>("mapping/keyframes/window/enable", false);
+  const auto keyframe_window_size   = param_loader.loadParam2<int>("mapping/keyframes/window/size", 20);
+  _keyframe_policy                  = std::make_shared<KeyframePolicy>(keyframe_options);
+  if (keyframe_window_enable && !_localization_only) {
+    // the registration queries the kd-trees of the window
+    _keyframe_window       = std::make_shared<KeyframeWindow>(keyframe_window_size, _resolution_line, _resolution_plane);
+    _use_incremental_index = false;
+  }
+  const auto warm_start = param_loader.loadParam2<bool>("warm_start/enable", false);
+  param_loader.loadParam("warm_start/pose_file", _warm_start_pose_file, std::string(""));
+  param_loader.loadParam("warm_start/map_save_period", _warm_start_map_save_period, 0.0f);
+  param_loader.loadParam("warm_start/pose_save_period", _warm_start_pose_save_period, 1.0f);
+  if (!warm_start) {
+    _warm_start_pose_file.clear();
+  }
+  // the frozen map of the localization is not saved back
+  _warm_start_save_map = warm_start && !_localization_only && !_map_file_path.empty();
+  param_loader.loadParam("mapping/degeneracy/publish_eigenvalues", _degeneracy_publish_eigenvalues, true);
+  param_loader.loadParam("mapping/degeneracy/publish_rate", _degeneracy_publish_period, 0.0f);
+  param_loader.loadParam("mapping/degeneracy/aware_update", _degeneracy_aware_update, false);
+  param_loader.loadParam("mapping/degeneracy/eigenvalue_threshold", _degeneracy_eigenvalue_threshold, 100.0);
+
+  int association_threads;
+  param_loader.loadParam("mapping/association_threads", association_threads, 1);
+  _thread_pool = createThreadPool(association_threads, shared_workers);
+
+  if (param_loader.loadParam2<bool>("gpu/map_association", false)) {
+    std::string error;
+    if (_use_incremental_index) {
+      ROS_WARN("[AloamMapping]: GPU map association does not query the incremental index, associating on the CPU.");
+    } else if (!gpuBackendAvailable(error)) {
+      ROS_WARN("[AloamMapping]: GPU map association unavailable (%s), associating on the CPU.", error.c_str());
+    } else {
+      _gpu_association = std::make_shared<GpuMapAssociation>();
+    }
+  }
+
+  const auto factor_type = param_loader.loadParam2<std::string>("mapping/factor_type", std::string("autodiff"));
+  if (!parseFactorType(factor_type, _factor_type)) {
+    ROS_ERROR("[AloamMapping]: Unknown factor type \"%s\", using autodiff factors.", factor_type.c_str());
+    _factor_type = FactorType::AUTODIFF;
+  }
 
-  _map_publish_period = 1.0f / _map_publish_period;
+  const auto solver_type = param_loader.loadParam2<std::string>("mapping/solver/type", std::string("ceres"));
+  if (!parseSolverType(solver_type, _solver_type)) {
+    ROS_ERROR("[AloamMapping]: Unknown solver type \"%s\", using ceres.", solver_type.c_str());
+    _solver_type = SolverType::CERES;
+  }
+
+  int queue_size;
+  param_loader.loadParam("mapping/queue/size", queue_size, 1);
+  const auto queue_policy_name = param_loader.loadParam2<std::string>("mapping/queue/policy", std::string("latest"));
+  QueuePolicy queue_policy;
+  if (!parseQueuePolicy(queue_policy_name, queue_policy)) {
+    ROS_ERROR("[AloamMapping]: Unknown queue policy \"%s\", using latest.", queue_policy_name.c_str());
+    queue_policy = QueuePolicy::LATEST;
+  }
+  _queue_odometry = createFrameChannel<MappingFrame>(queue_size, queue_policy);
+
+  PoseSolverOptions pose_solver_options;
+  param_loader.loadParam("mapping/solver/levenberg_marquardt", pose_solver_options.levenberg_marquardt, pose_solver_options.levenberg_marquardt);
+  param_loader.loadParam("mapping/solver/max_iterations", pose_solver_options.max_iterations, pose_solver_options.max_iterations);
+  param_loader.loadParam("mapping/solver/huber_delta", pose_solver_options.huber_delta, pose_solver_options.huber_delta);
+  param_loader.loadParam("mapping/solver/min_update_norm", pose_solver_options.min_update_norm, pose_solver_options.min_update_norm);
+  param_loader.loadParam("mapping/solver/min_relative_cost_decrease", pose_solver_options.min_relative_cost_decrease,
+                         pose_solver_options.min_relative_cost_decrease);
+  _pose_solver = std::make_shared<PoseSolver>(pose_solver_options);
+
+  // 0: the map is not published
+  if (_map_publish_period < 0.0f) {
+    ROS_ERROR("[AloamMapping]: Negative map publish rate %.2f, the map is not published.", _map_publish_period);
+    _map_publish_period = 0.0f;
+  }
+  _map_publish_period = _map_publish_period > 0.0f ? 1.0f / _map_publish_period : 0.0f;
+
+  // the map-sized clouds (the local map of the association and the published map) have their own pool, so the per-frame clouds are not
+  // grown to the size of the map when recycled
+  _cloud_pool     = std::make_shared<CloudPool>(8);
+  _map_cloud_pool = std::make_shared<CloudPool>(3);
+
+  _kdtree_map_corners.reset(new pcl::KdTreeFLANN<PointType>());
+  _kdtree_map_surfs.reset(new pcl::KdTreeFLANN<PointType>());
+
+  _degeneracy_publish_period = _degeneracy_publish_period > 0.0f ? 1.0f / _degeneracy_publish_period : 0.0f;
 
   _q_wmap_wodom = Eigen::Quaterniond::Identity();
   _t_wmap_wodom = Eigen::Vector3d(0, 0, 0);
@@ -36,12 +145,21 @@ AloamMapping::AloamMapping(const ros::NodeHandle &parent_nh, mrs_lib::ParamLoade
 
   {
     std::scoped_lock lock(_mutex_cloud_features);
-    _cloud_corners.resize(_cloud_volume);
-    _cloud_surfs.resize(_cloud_volume);
-    for (int i = 0; i < _cloud_volume; i++) {
-      _cloud_corners.at(i) = boost::make_shared<pcl::PointCloud<PointType>>();
-      _cloud_surfs.at(i)   = boost::make_shared<pcl::PointCloud<PointType>>();
+    _voxel_map = std::make_shared<VoxelMap>(_cube_size, _cube_eviction_radius_xy, _cube_eviction_radius_z);
+    if (_use_incremental_index) {
+      _index_corners = std::make_shared<VoxelIndex>(_cube_size, _incremental_index_resolution);
+      _index_surfs   = std::make_shared<VoxelIndex>(_cube_size, _incremental_index_resolution);
+      _voxel_map->attachIndices(_index_corners, _index_surfs);
     }
+    // the features inserted into a cube of the streamed map file which is not loaded yet are merged into the stored cube
+    _voxel_map->setCubeLoader([this](const CubeKey &key, MapCube &cube) {
+      const auto it = _evicted_cubes.find(key);
+      if (it != _evicted_cubes.end()) {
+        cube = it->second;
+        return true;
+      }
+      return _map_file && _map_file->readCube(key, *_cloud_pool, cube);
+    });
   }
 
   _pub_laser_cloud_map        = nh_.advertise<sensor_msgs::PointCloud2>("map_out", 1);
@@ -49,16 +167,44 @@ AloamMapping::AloamMapping(const ros::NodeHandle &parent_nh, mrs_lib::ParamLoade
   _pub_odom_global            = nh_.advertise<nav_msgs::Odometry>("odom_global_out", 1);
   _pub_path                   = nh_.advertise<nav_msgs::Path>("path_out", 1);
   _pub_eigenvalue             = nh_.advertise<mrs_msgs::Float64ArrayStamped>("eigenvalues", 1);
+  _pub_map_delta              = nh_.advertise<aloam_slam::MapDelta>("map_delta_out", 10);
+  _pub_diagnostics            = nh_.advertise<aloam_slam::StageDiagnostics>("diagnostics_out", 10);
+
+  _filter_map_corners.setLeafSize(_resolution_line, _resolution_line, _resolution_line);
+  _filter_map_surfs.setLeafSize(_resolution_plane, _resolution_plane, _resolution_plane);
+
+  const auto map_output_mode = param_loader.loadParam2<std::string>("mapping/map_output/mode", std::string("full"));
+  _map_output_delta          = map_output_mode == "delta";
+  if (!_map_output_delta && map_output_mode != "full") {
+    ROS_ERROR("[AloamMapping]: Unknown map output mode \"%s\", publishing the full map.", map_output_mode.c_str());
+  }
+  {
+    // the full map output does not take the changes, they would accumulate
+    std::scoped_lock lock(_mutex_cloud_features);
+    _voxel_map->setTrackChanges(_map_output_delta);
+  }
 
   if (_mapping_frequency > 0.0f) {
-    _timer_mapping_loop = nh_.createTimer(ros::Rate(_mapping_frequency), &AloamMapping::timerMapping, this, true, true);
+    // the thread also saves the map periodically for the warm start
+    if (_map_publish_period > 0.0f || (_warm_start_save_map && _warm_start_map_save_period > 0.0f)) {
+      _thread_map_publisher = std::thread(&AloamMapping::threadMapPublisher, this);
+    }
+
+    if (_background_map_update) {
+      _queue_map_update  = std::make_shared<BoundedQueue<MapUpdate>>(1, QueuePolicy::BLOCK);
+      _thread_map_update = std::thread(&AloamMapping::threadMapUpdate, this);
+    }
+    _thread_mapping = std::thread(&AloamMapping::threadMapping, this);
   }
 
   _tf_broadcaster = std::make_shared<tf2_ros::TransformBroadcaster>();
 
-  _srv_reset_mapping = nh_.advertiseService("srv_reset_mapping_in", &AloamMapping::callbackResetMapping, this);
+  _srv_reset_mapping    = nh_.advertiseService("srv_reset_mapping_in", &AloamMapping::callbackResetMapping, this);
+  _srv_get_map_snapshot = nh_.advertiseService("srv_get_map_snapshot_in", &AloamMapping::callbackGetMapSnapshot, this);
+  _srv_save_map         = nh_.advertiseService("srv_save_map_in", &AloamMapping::callbackSaveMap, this);
+  _srv_load_map         = nh_.advertiseService("srv_load_map_in", &AloamMapping::callbackLoadMap, this);
 
-  _time_last_map_publish = ros::Time::now();
+  _time_map_update = ros::Time::now();
 }
 /*//}*/
 
@@ -68,437 +214,377 @@ void AloamMapping::setData(ros::Time time_of_data, tf::Transform aloam_odometry,
 
   mrs_lib::Routine profiler_routine = _profiler->createRoutine("aloamMappingSetData");
 
-  {
-    std::lock_guard lock(_mutex_odometry_data);
-    _has_new_data          = true;
-    _time_aloam_odometry   = time_of_data;
-    _aloam_odometry        = aloam_odometry;
-    _features_corners_last = features_corners_last;
-    _features_surfs_last   = features_surfs_last;
-    _cloud_full_res        = cloud_full_res;
-  }
-  _cv_odometry_data.notify_all();
-
-  /* if (!isfinite(*_features_corners_last)) */
-  /*   std::cerr << "                                                                [AloamMapping::setData]: _features_corners_last are not finite!!" << "\n";
-   */
-  /* if (!isfinite(*_features_surfs_last)) */
-  /*   std::cerr << "                                                                [AloamMapping::setData]: _features_surfs_last are not finite!!" << "\n"; */
-  /* if (!isfinite(*_cloud_full_res)) */
-  /*   std::cerr << "                                                                [AloamMapping::setData]: _cloud_full_res are not finite!!" << "\n"; */
+  if (!_thread_mapping.joinable()) {
+    if (_frame_observer) {
+      _frame_observer->onFrameDropped(PipelineStage::MAPPING, time_of_data);
+    }
+    return;
+  }
+
+  MappingFrame frame;
+  frame.stamp                 = time_of_data;
+  frame.odometry              = aloam_odometry;
+  frame.features_corners_last = features_corners_last;
+  frame.features_surfs_last   = features_surfs_last;
+  frame.cloud_full_res        = cloud_full_res;
+  _queue_odometry->push(std::move(frame));
 }
 /*//}*/
 
-/*//{ timerMapping() */
-void AloamMapping::timerMapping([[maybe_unused]] const ros::TimerEvent &event) {
-  while (ros::ok()) {
+/*//{ ~AloamMapping() */
+AloamMapping::~AloamMapping() {
+  _queue_odometry->close();
+  if (_thread_mapping.joinable()) {
+    _thread_mapping.join();
+  }
+
+  if (_thread_map_update.joinable()) {
+    _queue_map_update->close();
+    _thread_map_update.join();
+  }
+
+  if (_thread_map_publisher.joinable()) {
+    {
+      std::scoped_lock lock(_mutex_map_publisher);
+      _stop_map_publisher = true;
+    }
+    _cv_map_publisher.notify_all();
+    _thread_map_publisher.join();
+  }
+
+  if (_warm_start_save_map && is_initialized) {
+    std::string message;
+    if (saveMap("", message)) {
+      ROS_INFO("[AloamMapping]: %s", message.c_str());
+    } else {
+      ROS_ERROR("[AloamMapping]: Failed saving the map: %s", message.c_str());
+    }
+  }
+}
+/*//}*/
+
+/*//{ threadMapping() */
+void AloamMapping::threadMapping() {
+  // the pose file is rewritten at most once per period, the last pose is saved when the thread stops
+  PersistedPose pose_last;
+  bool          pose_last_saved     = true;
+  auto          time_last_pose_save = std::chrono::steady_clock::time_point();
+
+  MappingFrame frame;
+  while (_queue_odometry->pop(frame)) {
     if (!is_initialized) {
-      ros::Rate(_mapping_frequency).sleep();
+      _frames_dropped++;
+      if (_frame_observer) {
+        _frame_observer->onFrameDropped(PipelineStage::MAPPING, frame.stamp);
+      }
       continue;
     }
 
-    mrs_lib::ScopeTimer timer = mrs_lib::ScopeTimer("ALOAM::FeatureExtraction::timerMapping", _scope_timer_logger, _enable_scope_timer);
+    mrs_lib::ScopeTimer timer = mrs_lib::ScopeTimer("ALOAM::FeatureExtraction::processMapping", _scope_timer_logger, _enable_scope_timer);
 
-    /*//{ Load latest odometry data (blocks for _cv_odometry_data and timeouts if blocking takes longer than 1.0/_mapping_frequency) */
-    ros::Time                       time_aloam_odometry;
-    tf::Transform                   aloam_odometry;
-    pcl::PointCloud<PointType>::Ptr features_corners_last;
-    pcl::PointCloud<PointType>::Ptr features_surfs_last;
-    pcl::PointCloud<PointType>::Ptr cloud_full_res;
-    {
-      std::unique_lock             lock(_mutex_odometry_data);
-      bool                         has_new_data;
-      std::chrono::duration<float> timeout(1.0 / _mapping_frequency);
-      if (_cv_odometry_data.wait_for(lock, timeout) == std::cv_status::no_timeout)
-        has_new_data = _has_new_data;
-      else
-        continue;
-
-      if (!has_new_data)
-        continue;
-
-      _has_new_data         = false;
-      time_aloam_odometry   = _time_aloam_odometry;
-      aloam_odometry        = _aloam_odometry;
-      features_corners_last = _features_corners_last;
-      features_surfs_last   = _features_surfs_last;
-      cloud_full_res        = _cloud_full_res;
-    }
-    /*//}*/
+    const auto time_frame_start = std::chrono::steady_clock::now();
+
+    const ros::Time                       time_aloam_odometry   = frame.stamp;
+    const tf::Transform                   aloam_odometry        = frame.odometry;
+    const pcl::PointCloud<PointType>::Ptr features_corners_last = frame.features_corners_last;
+    const pcl::PointCloud<PointType>::Ptr features_surfs_last   = frame.features_surfs_last;
+    const pcl::PointCloud<PointType>::Ptr cloud_full_res        = frame.cloud_full_res;
+
+    const QueueStats stats = _queue_odometry->stats();
+    ROS_DEBUG_THROTTLE(5.0, "[AloamMapping]: odometry queue: depth %lu (max %lu), received %lu, dropped %lu.", stats.depth, stats.max_depth, stats.pushed,
+                       stats.dropped);
 
     timer.checkpoint("loaded data");
 
-    mrs_lib::Routine profiler_routine = _profiler->createRoutine("timerMapping", _mapping_frequency, 0.1, event);
+    mrs_lib::Routine profiler_routine = _profiler->createRoutine("processMapping");
 
     tf::vectorTFToEigen(aloam_odometry.getOrigin(), _t_wodom_curr);
     tf::quaternionTFToEigen(aloam_odometry.getRotation(), _q_wodom_curr);
 
-    pcl::PointCloud<PointType>::Ptr map_features_corners = boost::make_shared<pcl::PointCloud<PointType>>();
-    pcl::PointCloud<PointType>::Ptr map_features_surfs   = boost::make_shared<pcl::PointCloud<PointType>>();
-
-    std::vector<int> cloud_valid_indices;
+    pcl::PointCloud<PointType>::Ptr map_features_corners = _map_cloud_pool->acquire();
+    pcl::PointCloud<PointType>::Ptr map_features_surfs   = _map_cloud_pool->acquire();
 
     /*//{ Associate odometry features to map features */
 
-    int    center_cube_I = int((_t_w_curr.x() + 25.0) / 50.0) + _cloud_center_width;
-    int    center_cube_J = int((_t_w_curr.y() + 25.0) / 50.0) + _cloud_center_height;
-    int    center_cube_K = int((_t_w_curr.z() + 25.0) / 50.0) + _cloud_center_depth;
-
-    if (_t_w_curr.x() + 25.0 < 0) {
-      center_cube_I--;
-    }
-    if (_t_w_curr.y() + 25.0 < 0) {
-      center_cube_J--;
-    }
-    if (_t_w_curr.z() + 25.0 < 0) {
-      center_cube_K--;
-    }
+    // cube of the vehicle position from the previous mapping frame
+    const CubeKey center_cube = _voxel_map->getKey(_t_w_curr.x(), _t_w_curr.y(), _t_w_curr.z());
 
+    std::shared_ptr<const StaticMap>         static_map;
+    std::vector<std::pair<CubeKey, MapCube>> evicted_modified;
+    std::string                              write_back_path;
     {
       std::scoped_lock lock(_mutex_cloud_features);
 
       transformAssociateToMap();
 
-      while (center_cube_I < 3) {
-        for (int j = 0; j < _cloud_height; j++) {
-          for (int k = 0; k < _cloud_depth; k++) {
-            int                             i             = _cloud_width - 1;
-            pcl::PointCloud<PointType>::Ptr local_corners = _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * k);
-            pcl::PointCloud<PointType>::Ptr local_surfs   = _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * k);
-            for (; i >= 1; i--) {
-              _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * k) =
-                  _cloud_corners.at(i - 1 + _cloud_width * j + _cloud_width * _cloud_height * k);
-              _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * k) =
-                  _cloud_surfs.at(i - 1 + _cloud_width * j + _cloud_width * _cloud_height * k);
-            }
-            _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * k) = local_corners;
-            _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * k)   = local_surfs;
-            local_corners->clear();
-            local_surfs->clear();
+      if (_localization_only) {
+        static_map = _static_map;
+      } else {
+        _voxel_map->evict(center_cube, evicted_modified);
+        // the modified cubes of a streamed map are written back to the map file, their changes would be lost otherwise
+        if (_map_file && !evicted_modified.empty()) {
+          for (const auto &[key, cube] : evicted_modified) {
+            _evicted_cubes[key] = cube;
           }
+          write_back_path = _map_file->path();
         }
+      }
+    }
 
-        center_cube_I++;
-        _cloud_center_width++;
+    if (!write_back_path.empty()) {
+      std::string message;
+      if (!saveMap(write_back_path, message)) {
+        ROS_ERROR("[AloamMapping]: Failed writing the evicted cubes back to the map file, keeping them in memory: %s", message.c_str());
       }
+    }
 
-      while (center_cube_I >= _cloud_width - 3) {
-        for (int j = 0; j < _cloud_height; j++) {
-          for (int k = 0; k < _cloud_depth; k++) {
-            int                             i             = 0;
-            pcl::PointCloud<PointType>::Ptr local_corners = _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * k);
-            pcl::PointCloud<PointType>::Ptr local_surfs   = _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * k);
-            for (; i < _cloud_width - 1; i++) {
-              _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * k) =
-                  _cloud_corners.at(i + 1 + _cloud_width * j + _cloud_width * _cloud_height * k);
-              _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * k) =
-                  _cloud_surfs.at(i + 1 + _cloud_width * j + _cloud_width * _cloud_height * k);
-            }
-            _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * k) = local_corners;
-            _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * k)   = local_surfs;
-            local_corners->clear();
-            local_surfs->clear();
-          }
-        }
+    // the window of keyframes replaces the cube neighborhood once the first keyframe is inserted
+    if (!static_map && _keyframe_window) {
+      static_map = _keyframe_window->map();
+    }
 
-        center_cube_I--;
-        _cloud_center_width--;
-      }
+    if (static_map) {
+      map_features_corners = static_map->corners;
+      map_features_surfs   = static_map->surfs;
+    } else {
+      streamMap(center_cube);
 
-      while (center_cube_J < 3) {
-        for (int i = 0; i < _cloud_width; i++) {
-          for (int k = 0; k < _cloud_depth; k++) {
-            int                             j             = _cloud_height - 1;
-            pcl::PointCloud<PointType>::Ptr local_corners = _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * k);
-            pcl::PointCloud<PointType>::Ptr local_surfs   = _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * k);
-            for (; j >= 1; j--) {
-              _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * k) =
-                  _cloud_corners.at(i + _cloud_width * (j - 1) + _cloud_width * _cloud_height * k);
-              _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * k) =
-                  _cloud_surfs.at(i + _cloud_width * (j - 1) + _cloud_width * _cloud_height * k);
-            }
-            _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * k) = local_corners;
-            _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * k)   = local_surfs;
-            local_corners->clear();
-            local_surfs->clear();
-          }
-        }
+      std::scoped_lock lock(_mutex_cloud_features);
 
-        center_cube_J++;
-        _cloud_center_height++;
+      if (!_use_incremental_index) {
+        const int                  neighborhood_xy    = _latency_controller->scaleNeighborhood(_cube_neighborhood_xy);
+        const std::vector<CubeKey> cubes_neighborhood = _voxel_map->getNeighborhood(center_cube, neighborhood_xy, _cube_neighborhood_z);
+        _voxel_map->getFeatures(cubes_neighborhood, *map_features_corners, *map_features_surfs);
       }
+    }
+    /*//}*/
 
-      while (center_cube_J >= _cloud_height - 3) {
-        for (int i = 0; i < _cloud_width; i++) {
-          for (int k = 0; k < _cloud_depth; k++) {
-            int                             j             = 0;
-            pcl::PointCloud<PointType>::Ptr local_corners = _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * k);
-            pcl::PointCloud<PointType>::Ptr local_surfs   = _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * k);
-            for (; j < _cloud_height - 1; j++) {
-              _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * k) =
-                  _cloud_corners.at(i + _cloud_width * (j + 1) + _cloud_width * _cloud_height * k);
-              _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * k) =
-                  _cloud_surfs.at(i + _cloud_width * (j + 1) + _cloud_width * _cloud_height * k);
-            }
-            _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * k) = local_corners;
-            _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * k)   = local_surfs;
-            local_corners->clear();
-            local_surfs->clear();
-          }
-        }
+    // the frame is downsampled more coarsely when the mapping does not keep up with the latency budget (the map keeps its resolution)
+    const float               resolution_line  = _latency_controller->scaleResolution(_resolution_line);
+    const float               resolution_plane = _latency_controller->scaleResolution(_resolution_plane);
+    _filter_downsize_corners.setLeafSize(resolution_line, resolution_line, resolution_line);
+    _filter_downsize_surfs.setLeafSize(resolution_plane, resolution_plane, resolution_plane);
 
-        center_cube_J--;
-        _cloud_center_height--;
-      }
+    /*//{*/
+    pcl::PointCloud<PointType>::Ptr features_corners_stack = _cloud_pool->acquire();
+    _filter_downsize_corners.setInputCloud(features_corners_last);
+    _filter_downsize_corners.filter(*features_corners_stack);
+
+    pcl::PointCloud<PointType>::Ptr features_surfs_stack = _cloud_pool->acquire();
+    _filter_downsize_surfs.setInputCloud(features_surfs_last);
+    _filter_downsize_surfs.filter(*features_surfs_stack);
+
+    // the incremental index is queried in place, so it is read under the shared lock, which is held only around the queries (not the solver)
+    std::shared_lock lock_index(_mutex_cloud_features, std::defer_lock);
+    if (_use_incremental_index) {
+      lock_index.lock();
+    }
 
-      while (center_cube_K < 3) {
-        for (int i = 0; i < _cloud_width; i++) {
-          for (int j = 0; j < _cloud_height; j++) {
-            int                             k             = _cloud_depth - 1;
-            pcl::PointCloud<PointType>::Ptr local_corners = _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * k);
-            pcl::PointCloud<PointType>::Ptr local_surfs   = _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * k);
-            for (; k >= 1; k--) {
-              _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * k) =
-                  _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * (k - 1));
-              _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * k) =
-                  _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * (k - 1));
-            }
-            _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * k) = local_corners;
-            _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * k)   = local_surfs;
-            local_corners->clear();
-            local_surfs->clear();
-          }
+    const std::size_t map_corners_count = _use_incremental_index ? _index_corners->size() : map_features_corners->points.size();
+    const std::size_t map_surfs_count   = _use_incremental_index ? _index_surfs->size() : map_features_surfs->points.size();
+
+    if (lock_index.owns_lock()) {
+      lock_index.unlock();
+    }
+
+    // reported in the diagnostics
+    std::size_t correspondences_corners = 0;
+    std::size_t correspondences_surfs   = 0;
+    int         solver_iterations       = 0;
+    double      solver_final_cost       = 0.0;
+
+    if (map_corners_count > 10 && map_surfs_count > 50) {
+      // the map is uploaded to the GPU instead of building the kd-trees, they are built only if the GPU association fails
+      bool use_gpu_association = false;
+      if (_gpu_association) {
+        std::string error;
+        use_gpu_association = _gpu_association->setMap(map_features_corners, map_features_surfs, static_map != nullptr, error);
+        if (!use_gpu_association) {
+          ROS_WARN_THROTTLE(1.0, "[AloamMapping]: GPU map association failed (%s), associating on the CPU.", error.c_str());
         }
+      }
 
-        center_cube_K++;
-        _cloud_center_depth++;
+      pcl::KdTreeFLANN<PointType>::Ptr kdtree_map_corners = _kdtree_map_corners;
+      pcl::KdTreeFLANN<PointType>::Ptr kdtree_map_surfs   = _kdtree_map_surfs;
+      const auto buildKdTrees = [&]() {
+        if (static_map) {
+          kdtree_map_corners = static_map->kdtree_corners;
+          kdtree_map_surfs   = static_map->kdtree_surfs;
+        } else if (!_use_incremental_index) {
+          kdtree_map_corners->setInputCloud(map_features_corners);
+          kdtree_map_surfs->setInputCloud(map_features_surfs);
+        }
+      };
+      if (!use_gpu_association) {
+        buildKdTrees();
       }
 
-      while (center_cube_K >= _cloud_depth - 3) {
-        for (int i = 0; i < _cloud_width; i++) {
-          for (int j = 0; j < _cloud_height; j++) {
-            int                             k             = 0;
-            pcl::PointCloud<PointType>::Ptr local_corners = _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * k);
-            pcl::PointCloud<PointType>::Ptr local_surfs   = _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * k);
-            for (; k < _cloud_depth - 1; k++) {
-              _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * k) =
-                  _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * (k + 1));
-              _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * k) =
-                  _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * (k + 1));
+      // finds 5 nearest map features either in the incremental index or in the kd-tree of the local map
+      const auto searchMap = [&](const std::shared_ptr<VoxelIndex> &index, const pcl::KdTreeFLANN<PointType>::Ptr &kdtree,
+                                 const pcl::PointCloud<PointType>::Ptr &map_features, const PointType &point, std::vector<int> &point_search_indices,
+                                 std::vector<float> &point_search_sq_dist, std::vector<PointType> &point_search_neighbors) {
+        if (_use_incremental_index) {
+          return index->nearestKSearch(point, 5, point_search_neighbors, point_search_sq_dist) == 5;
+        }
+
+        if (kdtree->nearestKSearch(point, 5, point_search_indices, point_search_sq_dist) < 5) {
+          return false;
+        }
+        point_search_neighbors.clear();
+        for (const int ind : point_search_indices) {
+          point_search_neighbors.push_back(map_features->points.at(ind));
+        }
+        return true;
+      };
+
+      // the features transformed to the map by the current estimate of the pose, updated at the beginning of every iteration
+      const pcl::PointCloud<PointType>::Ptr features_corners_sel = _cloud_pool->acquire();
+      const pcl::PointCloud<PointType>::Ptr features_surfs_sel   = _cloud_pool->acquire();
+
+      // the search buffers are reused by every thread of the pool between the chunks and the frames
+      const auto findCornerCorrespondences = [&](const std::size_t begin, const std::size_t end, std::vector<EdgeCorrespondence> &correspondences) {
+        thread_local std::vector<int>       point_search_indices;
+        thread_local std::vector<float>     point_search_sq_dist;
+        thread_local std::vector<PointType> point_search_neighbors;
+
+        for (std::size_t i = begin; i < end; i++) {
+          const PointType &point_ori = features_corners_stack->points.at(i);
+          const PointType &point_sel = features_corners_sel->points.at(i);
+          if (searchMap(_index_corners, kdtree_map_corners, map_features_corners, point_sel, point_search_indices, point_search_sq_dist,
+                        point_search_neighbors) &&
+              point_search_sq_dist.at(4) < 1.0) {
+            EdgeCorrespondence corr;
+            if (fitEdgeCorrespondence(Eigen::Vector3d(point_ori.x, point_ori.y, point_ori.z), point_search_neighbors, corr)) {
+              correspondences.push_back(corr);
             }
-            _cloud_corners.at(i + _cloud_width * j + _cloud_width * _cloud_height * k) = local_corners;
-            _cloud_surfs.at(i + _cloud_width * j + _cloud_width * _cloud_height * k)   = local_surfs;
-            local_corners->clear();
-            local_surfs->clear();
           }
         }
-
-        center_cube_K--;
-        _cloud_center_depth--;
-      }
-
-      for (int i = center_cube_I - 2; i <= center_cube_I + 2; i++) {
-        for (int j = center_cube_J - 2; j <= center_cube_J + 2; j++) {
-          for (int k = center_cube_K - 1; k <= center_cube_K + 1; k++) {
-            if (i >= 0 && i < _cloud_width && j >= 0 && j < _cloud_height && k >= 0 && k < _cloud_depth) {
-              cloud_valid_indices.push_back(i + _cloud_width * j + _cloud_width * _cloud_height * k);
+      };
+
+      const auto findSurfCorrespondences = [&](const std::size_t begin, const std::size_t end, std::vector<PlaneNormCorrespondence> &correspondences) {
+        thread_local std::vector<int>       point_search_indices;
+        thread_local std::vector<float>     point_search_sq_dist;
+        thread_local std::vector<PointType> point_search_neighbors;
+
+        for (std::size_t i = begin; i < end; i++) {
+          const PointType &point_ori = features_surfs_stack->points.at(i);
+          const PointType &point_sel = features_surfs_sel->points.at(i);
+          if (searchMap(_index_surfs, kdtree_map_surfs, map_features_surfs, point_sel, point_search_indices, point_search_sq_dist, point_search_neighbors) &&
+              point_search_sq_dist.at(4) < 1.0) {
+            PlaneNormCorrespondence corr;
+            if (fitPlaneCorrespondence(Eigen::Vector3d(point_ori.x, point_ori.y, point_ori.z), point_search_neighbors, corr)) {
+              correspondences.push_back(corr);
             }
           }
         }
-      }
+      };
 
-      for (unsigned int i = 0; i < cloud_valid_indices.size(); i++) {
-        *map_features_corners += *_cloud_corners.at(cloud_valid_indices.at(i));
-        *map_features_surfs += *_cloud_surfs.at(cloud_valid_indices.at(i));
+      const bool publish_eigenvalues =
+          _degeneracy_publish_eigenvalues && (time_aloam_odometry - _time_last_eigenvalues_publish).toSec() >= _degeneracy_publish_period;
+      if (publish_eigenvalues) {
+        _time_last_eigenvalues_publish = time_aloam_odometry;
       }
-    }
-    /*//}*/
-
-    pcl::VoxelGrid<PointType> filter_downsize_corners;
-    pcl::VoxelGrid<PointType> filter_downsize_surfs;
-    filter_downsize_corners.setLeafSize(_resolution_line, _resolution_line, _resolution_line);
-    filter_downsize_surfs.setLeafSize(_resolution_plane, _resolution_plane, _resolution_plane);
-
-    /*//{*/
-    pcl::PointCloud<PointType>::Ptr features_corners_stack = boost::make_shared<pcl::PointCloud<PointType>>();
-    filter_downsize_corners.setInputCloud(features_corners_last);
-    filter_downsize_corners.filter(*features_corners_stack);
-
-    pcl::PointCloud<PointType>::Ptr features_surfs_stack = boost::make_shared<pcl::PointCloud<PointType>>();
-    filter_downsize_surfs.setInputCloud(features_surfs_last);
-    filter_downsize_surfs.filter(*features_surfs_stack);
-
-    /* printf("map prepare time %f ms\n", t_shift.toc()); */
-    /* printf("map corner num %d  surf num %d \n", laserCloudCornerFromMapNum, laserCloudSurfFromMapNum); */
-    if (map_features_corners->points.size() > 10 && map_features_surfs->points.size() > 50) {
-      pcl::KdTreeFLANN<PointType>::Ptr kdtree_map_corners(new pcl::KdTreeFLANN<PointType>());
-      pcl::KdTreeFLANN<PointType>::Ptr kdtree_map_surfs(new pcl::KdTreeFLANN<PointType>());
-      kdtree_map_corners->setInputCloud(map_features_corners);
-      kdtree_map_surfs->setInputCloud(map_features_surfs);
-
-      std::vector<int>   point_search_indices;
-      std::vector<float> point_search_sq_dist;
 
       for (int iterCount = 0; iterCount < 2; iterCount++) {
-        // ceres::LossFunction *loss_function = NULL;
-        ceres::LossFunction *         loss_function      = new ceres::HuberLoss(0.1);
-        ceres::LocalParameterization *q_parameterization = new ceres::EigenQuaternionParameterization();
-        ceres::Problem::Options       problem_options;
-
-        ceres::Problem problem(problem_options);
-        problem.AddParameterBlock(_parameters, 4, q_parameterization);
-        problem.AddParameterBlock(_parameters + 4, 3);
-
-        int corner_num = 0;
-
-        for (unsigned int i = 0; i < features_corners_stack->points.size(); i++) {
-          const PointType point_ori = features_corners_stack->points.at(i);
-          PointType       point_sel;
-          // double sqrtDis = point_ori.x * point_ori.x + point_ori.y * point_ori.y + point_ori.z * point_ori.z;
-          pointAssociateToMap(&point_ori, &point_sel);
-          kdtree_map_corners->nearestKSearch(point_sel, 5, point_search_indices, point_search_sq_dist);
-
-          if (point_search_sq_dist.at(4) < 1.0) {
-            std::vector<Eigen::Vector3d> nearCorners;
-            Eigen::Vector3d              center(0, 0, 0);
-            for (int j = 0; j < 5; j++) {
-              const Eigen::Vector3d tmp(map_features_corners->points.at(point_search_indices.at(j)).x,
-                                        map_features_corners->points.at(point_search_indices.at(j)).y,
-                                        map_features_corners->points.at(point_search_indices.at(j)).z);
-              center = center + tmp;
-              nearCorners.push_back(tmp);
-            }
-            center = center / 5.0;
-
-            Eigen::Matrix3d covMat = Eigen::Matrix3d::Zero();
-            for (int j = 0; j < 5; j++) {
-              const Eigen::Matrix<double, 3, 1> tmpZeroMean = nearCorners.at(j) - center;
-              covMat                                        = covMat + tmpZeroMean * tmpZeroMean.transpose();
-            }
-
-            Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> saes(covMat);
-
-            // if is indeed line feature
-            // note Eigen library sort eigenvalues in increasing order
-            if (saes.eigenvalues()[2] > 3 * saes.eigenvalues()[1]) {
-              const Eigen::Vector3d unit_direction = saes.eigenvectors().col(2);
-              const Eigen::Vector3d curr_point(point_ori.x, point_ori.y, point_ori.z);
-              const Eigen::Vector3d point_a = 0.1 * unit_direction + center;
-              const Eigen::Vector3d point_b = -0.1 * unit_direction + center;
-
-              ceres::CostFunction *cost_function = LidarEdgeFactor::Create(curr_point, point_a, point_b, 1.0);
-              problem.AddResidualBlock(cost_function, loss_function, _parameters, _parameters + 4);
-              corner_num++;
-            }
+        const Eigen::Matrix4f transform_w_curr = toTransform(_q_w_curr, _t_w_curr);
+        transformPoints(*features_corners_stack, transform_w_curr, *features_corners_sel);
+        transformPoints(*features_surfs_stack, transform_w_curr, *features_surfs_sel);
+
+        // correspondences are searched in parallel and added to the problem in the original order of the features
+        if (use_gpu_association) {
+          std::string error;
+          use_gpu_association = _gpu_association->findCorrespondences(*features_corners_stack, *features_corners_sel, *features_surfs_stack,
+                                                                      *features_surfs_sel, _corner_correspondences, _surf_correspondences, error);
+          if (!use_gpu_association) {
+            ROS_WARN_THROTTLE(1.0, "[AloamMapping]: GPU map association failed (%s), associating on the CPU.", error.c_str());
+            buildKdTrees();
           }
         }
-
-        int surf_num = 0;
-        for (unsigned int i = 0; i < features_surfs_stack->points.size(); i++) {
-          const PointType point_ori = features_surfs_stack->points.at(i);
-          PointType       point_sel;
-          pointAssociateToMap(&point_ori, &point_sel);
-          kdtree_map_surfs->nearestKSearch(point_sel, 5, point_search_indices, point_search_sq_dist);
-
-          Eigen::Matrix<double, 5, 3> matA0;
-          Eigen::Matrix<double, 5, 1> matB0 = -1 * Eigen::Matrix<double, 5, 1>::Ones();
-          if (point_search_sq_dist.at(4) < 1.0) {
-            for (int j = 0; j < 5; j++) {
-              matA0(j, 0) = map_features_surfs->points.at(point_search_indices.at(j)).x;
-              matA0(j, 1) = map_features_surfs->points.at(point_search_indices.at(j)).y;
-              matA0(j, 2) = map_features_surfs->points.at(point_search_indices.at(j)).z;
-              // printf(" pts %f %f %f ", matA0(j, 0), matA0(j, 1), matA0(j, 2));
-            }
-            // find the norm of plane
-            Eigen::Vector3d norm                 = matA0.colPivHouseholderQr().solve(matB0);
-            const double    negative_OA_dot_norm = 1 / norm.norm();
-            norm.normalize();
-
-            // Here n(pa, pb, pc) is unit norm of plane
-            bool planeValid = true;
-            for (int j = 0; j < 5; j++) {
-              // if OX * n > 0.2, then plane is not fit well
-              if (fabs(norm(0) * map_features_surfs->points.at(point_search_indices.at(j)).x +
-                       norm(1) * map_features_surfs->points.at(point_search_indices.at(j)).y +
-                       norm(2) * map_features_surfs->points.at(point_search_indices.at(j)).z + negative_OA_dot_norm) > 0.2) {
-                planeValid = false;
-                break;
-              }
-            }
-            if (planeValid) {
-              const Eigen::Vector3d curr_point(point_ori.x, point_ori.y, point_ori.z);
-              ceres::CostFunction * cost_function = LidarPlaneNormFactor::Create(curr_point, norm, negative_OA_dot_norm);
-              problem.AddResidualBlock(cost_function, loss_function, _parameters, _parameters + 4);
-              surf_num++;
-            }
+        if (!use_gpu_association) {
+          if (_use_incremental_index) {
+            lock_index.lock();
+          }
+          parallelCollect(*_thread_pool, features_corners_stack->points.size(), _corner_correspondences, _corner_chunk_correspondences,
+                          findCornerCorrespondences);
+          parallelCollect(*_thread_pool, features_surfs_stack->points.size(), _surf_correspondences, _surf_chunk_correspondences,
+                          findSurfCorrespondences);
+          if (lock_index.owns_lock()) {
+            lock_index.unlock();
           }
         }
+        correspondences_corners = _corner_correspondences.size();
+        correspondences_surfs   = _surf_correspondences.size();
+
+        // pose before the optimization, the information matrix is evaluated here
+        double parameters_prior[7];
+        std::copy(_parameters, _parameters + 7, parameters_prior);
+
+        Eigen::Matrix<double, 6, 6> information;
+        bool                        has_information = false;
+
+        if (_solver_type == SolverType::GAUSS_NEWTON) {
+          BatchedLidarFactor factor(nullptr);
+          addCorrespondences(factor, _corner_correspondences, _surf_correspondences);
+          const PoseSolverSummary summary = _pose_solver->solve(factor, _parameters, _parameters + 4);
+          information                     = summary.information;
+          has_information                 = true;
+          solver_iterations += summary.iterations;
+          solver_final_cost = summary.final_cost;
+        } else {
+          if (publish_eigenvalues || _degeneracy_aware_update) {
+            BatchedLidarFactor factor(nullptr);
+            addCorrespondences(factor, _corner_correspondences, _surf_correspondences);
+            information     = _pose_solver->information(factor, _parameters, _parameters + 4);
+            has_information = true;
+          }
 
-        ceres::Solver::Options options;
-        options.linear_solver_type                = ceres::DENSE_QR;
-        options.max_num_iterations                = 4;
-        options.minimizer_progress_to_stdout      = false;
-        options.check_gradients                   = false;
-        options.gradient_check_relative_precision = 1e-4;
-        ceres::Solver::Summary summary;
-
-        // Get eigenvalues to measure problem degradation //{
-        TicToc t_eigenvalues;
-        // Get Jacobian
-        ceres::CRSMatrix jacobian;
-        problem.Evaluate(ceres::Problem::EvaluateOptions(), nullptr, nullptr, nullptr, &jacobian);
+          // ceres::LossFunction *loss_function = NULL;
+          ceres::LossFunction *         loss_function      = new ceres::HuberLoss(0.1);
+          ceres::LocalParameterization *q_parameterization = new ceres::EigenQuaternionParameterization();
+          ceres::Problem::Options       problem_options;
+
+          ceres::Problem problem(problem_options);
+          problem.AddParameterBlock(_parameters, 4, q_parameterization);
+          problem.AddParameterBlock(_parameters + 4, 3);
+
+          addResidualBlocks(problem, _corner_correspondences, _surf_correspondences, _factor_type, loss_function, _parameters, _parameters + 4);
+
+          ceres::Solver::Options options;
+          options.linear_solver_type                = ceres::DENSE_QR;
+          options.max_num_iterations                = 4;
+          options.minimizer_progress_to_stdout      = false;
+          options.check_gradients                   = false;
+          options.gradient_check_relative_precision = 1e-4;
+          ceres::Solver::Summary summary;
+          ceres::Solve(options, &problem, &summary);
+          solver_iterations += summary.num_successful_steps + summary.num_unsuccessful_steps;
+          solver_final_cost = summary.final_cost;
+        }
 
-        // Convert it to eigen matrix
-        Eigen::MatrixXd eigen_matrix;
-        eigen_matrix.resize(jacobian.num_rows, jacobian.num_cols);
-        eigen_matrix.setZero();
+        if (!has_information) {
+          continue;
+        }
 
-        for (int row = 0; row < jacobian.num_rows; ++row) {
-          int start = jacobian.rows[row];
-          int end   = jacobian.rows[row + 1] - 1;
+        // Get eigenvalues to measure problem degradation //{
+        if (publish_eigenvalues) {
+          // the order is theta_x, theta_y, theta_z, x, y, z
+          const Eigen::Matrix<double, 6, 1> eigenvalues = axisEigenvalues(information);
 
-          for (int i = start; i <= end; i++) {
-            int    col   = jacobian.cols[i];
-            double value = jacobian.values[i];
+          mrs_msgs::Float64ArrayStamped msg_eigenvalue;
+          msg_eigenvalue.header.stamp = time_aloam_odometry;
+          msg_eigenvalue.values.assign(eigenvalues.data(), eigenvalues.data() + 6);
 
-            eigen_matrix(row, col) = value;
-          }
+          // Publish eigenvalues
+          _pub_eigenvalue.publish(msg_eigenvalue);
         }
+        /*//}*/
 
-        // calculate matrix J^T*J
-        eigen_matrix = eigen_matrix.transpose() * eigen_matrix;
-
-        // get eigenvalues and eigenvectors
-        Eigen::EigenSolver<Eigen::MatrixXd> eigensolver;
-        eigensolver.compute(eigen_matrix);
-        Eigen::VectorXd eigen_values  = eigensolver.eigenvalues().real();
-        Eigen::MatrixXd eigen_vectors = eigensolver.eigenvectors().real();
-
-        mrs_msgs::Float64ArrayStamped msg_eigenvalue;
-        msg_eigenvalue.header.stamp = time_aloam_odometry;
-        msg_eigenvalue.values.clear();
-
-        // Find eigenvalues corresponding to respective state elements
-        // the order should be theta_x, theta_y, theta_z, x, y, z
-        for (int i = 0; i < 6; i++) {
-          double eig = 0;
-          double vec = 0;
-          for (int j = 0; j < eigen_vectors.cols(); j++) {
-            if (abs(eigen_vectors(i, j)) > vec) {
-              vec = abs(eigen_vectors(i, j));
-              eig = eigen_values(j);
-            }
-          }
-          msg_eigenvalue.values.push_back(eig);
+        // keep the pose update only in the well-constrained directions
+        if (_degeneracy_aware_update) {
+          const Eigen::Matrix<double, 6, 1> dx = poseDifference(parameters_prior, parameters_prior + 4, _parameters, _parameters + 4);
+          std::copy(parameters_prior, parameters_prior + 7, _parameters);
+          applyPoseUpdate(degeneracyProjection(information, _degeneracy_eigenvalue_threshold) * dx, _parameters, _parameters + 4);
         }
-
-        // Publish eigenvalues
-        _pub_eigenvalue.publish(msg_eigenvalue);
-
-        float time_eigenvalues = t_eigenvalues.toc();
-        /* ROS_INFO("[AloamMapping] Eigenvalue calculation took %.3f ms.", time_eigenvalues); */
-        /*//}*/
-        ceres::Solve(options, &problem, &summary);
       }
     } else {
       ROS_WARN("[AloamMapping] Not enough map correspondences. Skipping mapping frame.");
@@ -509,68 +595,9 @@ void AloamMapping::timerMapping([[maybe_unused]] const ros::TimerEvent &event) {
 
     {
       std::scoped_lock lock(_mutex_cloud_features);
-
       transformUpdate();
-
-      for (unsigned int i = 0; i < features_corners_stack->points.size(); i++) {
-        PointType point_sel;
-        pointAssociateToMap(&features_corners_stack->points.at(i), &point_sel);
-
-        int cubeI = int((point_sel.x + 25.0) / 50.0) + _cloud_center_width;
-        int cubeJ = int((point_sel.y + 25.0) / 50.0) + _cloud_center_height;
-        int cubeK = int((point_sel.z + 25.0) / 50.0) + _cloud_center_depth;
-
-        if (point_sel.x + 25.0 < 0)
-          cubeI--;
-        if (point_sel.y + 25.0 < 0)
-          cubeJ--;
-        if (point_sel.z + 25.0 < 0)
-          cubeK--;
-
-        if (cubeI >= 0 && cubeI < _cloud_width && cubeJ >= 0 && cubeJ < _cloud_height && cubeK >= 0 && cubeK < _cloud_depth) {
-          const int cubeInd = cubeI + _cloud_width * cubeJ + _cloud_width * _cloud_height * cubeK;
-          _cloud_corners.at(cubeInd)->push_back(point_sel);
-        }
-      }
-
-      for (unsigned int i = 0; i < features_surfs_stack->points.size(); i++) {
-        PointType point_sel;
-        pointAssociateToMap(&features_surfs_stack->points.at(i), &point_sel);
-
-        int cubeI = int((point_sel.x + 25.0) / 50.0) + _cloud_center_width;
-        int cubeJ = int((point_sel.y + 25.0) / 50.0) + _cloud_center_height;
-        int cubeK = int((point_sel.z + 25.0) / 50.0) + _cloud_center_depth;
-
-        if (point_sel.x + 25.0 < 0)
-          cubeI--;
-        if (point_sel.y + 25.0 < 0)
-          cubeJ--;
-        if (point_sel.z + 25.0 < 0)
-          cubeK--;
-
-        if (cubeI >= 0 && cubeI < _cloud_width && cubeJ >= 0 && cubeJ < _cloud_height && cubeK >= 0 && cubeK < _cloud_depth) {
-          const int cubeInd = cubeI + _cloud_width * cubeJ + _cloud_width * _cloud_height * cubeK;
-          _cloud_surfs.at(cubeInd)->push_back(point_sel);
-        }
-      }
-
-      for (unsigned int i = 0; i < cloud_valid_indices.size(); i++) {
-        const int ind = cloud_valid_indices.at(i);
-
-        const pcl::PointCloud<PointType>::Ptr tmpCorner = boost::make_shared<pcl::PointCloud<PointType>>();
-        filter_downsize_corners.setInputCloud(_cloud_corners.at(ind));
-        filter_downsize_corners.filter(*tmpCorner);
-        _cloud_corners.at(ind) = tmpCorner;
-
-        const pcl::PointCloud<PointType>::Ptr tmpSurf = boost::make_shared<pcl::PointCloud<PointType>>();
-        filter_downsize_surfs.setInputCloud(_cloud_surfs.at(ind));
-        filter_downsize_surfs.filter(*tmpSurf);
-        _cloud_surfs.at(ind) = tmpSurf;
-      }
     }
 
-    timer.checkpoint("adding features to map");
-
     /*//{ Publish data */
 
     // Publish TF
@@ -641,56 +668,566 @@ void AloamMapping::timerMapping([[maybe_unused]] const ros::TimerEvent &event) {
       }
     }
 
-    // Publish entire map
-    if (_pub_laser_cloud_map.getNumSubscribers() > 0 && (ros::Time::now() - _time_last_map_publish).toSec() > _map_publish_period) {
-      pcl::PointCloud<PointType> map_pcl;
+    /*//}*/
+
+    timer.checkpoint("publishing pose");
+
+    if (!_warm_start_pose_file.empty()) {
+      pose_last.stamp        = time_aloam_odometry;
+      pose_last.q_wodom_curr = _q_wodom_curr;
+      pose_last.t_wodom_curr = _t_wodom_curr;
+      pose_last.q_wmap_wodom = _q_wmap_wodom;
+      pose_last.t_wmap_wodom = _t_wmap_wodom;
+      pose_last_saved        = false;
+
+      const auto now = std::chrono::steady_clock::now();
+      if (std::chrono::duration<float>(now - time_last_pose_save).count() >= _warm_start_pose_save_period) {
+        time_last_pose_save = now;
+        pose_last_saved     = true;
+        std::string error;
+        if (!savePoseFile(_warm_start_pose_file, pose_last, error)) {
+          ROS_WARN_THROTTLE(5.0, "[AloamMapping]: Failed saving the pose: %s", error.c_str());
+        }
+      }
+    }
+
+    /*//{ Update the map */
+    const bool keyframe = _keyframe_policy->update(time_aloam_odometry, _q_w_curr, _t_w_curr);
+
+    MapUpdate update;
+    update.stamp            = time_aloam_odometry;
+    update.q_w_curr         = _q_w_curr;
+    update.t_w_curr         = _t_w_curr;
+    update.features_corners = features_corners_stack;
+    update.features_surfs   = features_surfs_stack;
+    update.cloud_full_res   = cloud_full_res;
+    update.keyframe         = keyframe;
+
+    if (_thread_map_update.joinable()) {
+      // the next frame is registered while the map is updated, blocks only if the previous update is still waiting in the queue
+      _queue_map_update->push(std::move(update));
+    } else {
+      updateMap(update);
+    }
+    /*//}*/
+
+    const float latency_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - time_frame_start).count();
+    _frames_processed++;
+
+    if (_frame_observer) {
+      _frame_observer->onPose(PipelineStage::MAPPING, time_aloam_odometry, tf_fcu);
+      _frame_observer->onStageFinished(PipelineStage::MAPPING, time_aloam_odometry, latency_ms);
+    }
+
+    if (_latency_controller->enabled()) {
+      _latency_controller->update(latency_ms);
+      ROS_DEBUG_THROTTLE(5.0, "[AloamMapping]: frame latency %.1f ms (smoothed %.1f ms), degradation %.2f.", latency_ms,
+                         _latency_controller->smoothedLatency(), _latency_controller->degradation());
+    }
+
+    /*//{ Publish diagnostics */
+    if (_pub_diagnostics.getNumSubscribers() > 0) {
+      const QueueStats stats = _queue_odometry->stats();
+
+      const aloam_slam::StageDiagnostics::Ptr diag_msg = boost::make_shared<aloam_slam::StageDiagnostics>();
+      diag_msg->header.stamp                           = time_aloam_odometry;
+      diag_msg->header.frame_id                        = _frame_map;
+      diag_msg->stage                                  = aloam_slam::StageDiagnostics::STAGE_MAPPING;
+      diag_msg->duration_ms                            = latency_ms;
+      diag_msg->latency_ms                             = (ros::Time::now() - time_aloam_odometry).toSec() * 1000.0;
+      diag_msg->features_corners                       = features_corners_stack->size();
+      diag_msg->features_surfs                         = features_surfs_stack->size();
+      diag_msg->correspondences_corners                = correspondences_corners;
+      diag_msg->correspondences_surfs                  = correspondences_surfs;
+      diag_msg->solver_iterations                      = solver_iterations;
+      diag_msg->solver_final_cost                      = solver_final_cost;
+      diag_msg->queue_depth                            = stats.depth;
+      diag_msg->queue_max_depth                        = stats.max_depth;
+      diag_msg->frames_processed                       = _frames_processed;
+      diag_msg->frames_dropped                         = _frames_dropped + stats.dropped;
+      diag_msg->map_corners                            = map_corners_count;
+      diag_msg->map_surfs                              = map_surfs_count;
+      diag_msg->keyframe                               = keyframe;
+      diag_msg->map_keyframes                          = _keyframe_window ? _keyframe_window->keyframes() : 0;
       {
         std::scoped_lock lock(_mutex_cloud_features);
-        for (int i = 0; i < _cloud_volume; i++) {
-          map_pcl += *_cloud_corners.at(i);
-          map_pcl += *_cloud_surfs.at(i);
-        }
+        diag_msg->map_cubes = _voxel_map->size();
       }
-      const sensor_msgs::PointCloud2::Ptr map_msg = boost::make_shared<sensor_msgs::PointCloud2>();
-      pcl::toROSMsg(map_pcl, *map_msg);
-      map_msg->header.stamp    = time_aloam_odometry;
-      map_msg->header.frame_id = _frame_map;
 
       try {
-        _pub_laser_cloud_map.publish(map_msg);
-        _time_last_map_publish = ros::Time::now();
+        _pub_diagnostics.publish(diag_msg);
       }
       catch (...) {
-        ROS_ERROR("[AloamMapping]: Exception caught during publishing topic %s.", _pub_laser_cloud_map.getTopic().c_str());
+        ROS_ERROR("[AloamMapping]: Exception caught during publishing topic %s.", _pub_diagnostics.getTopic().c_str());
       }
     }
+    /*//}*/
+
+    _frame_count++;
+  }
+
+  if (!pose_last_saved) {
+    std::string error;
+    if (!savePoseFile(_warm_start_pose_file, pose_last, error)) {
+      ROS_ERROR("[AloamMapping]: Failed saving the pose: %s", error.c_str());
+    }
+  }
+}
+/*//}*/
+
+/*//{ threadMapUpdate() */
+void AloamMapping::threadMapUpdate() {
+  MapUpdate update;
+  while (_queue_map_update->pop(update)) {
+    updateMap(update);
+  }
+}
+/*//}*/
+
+/*//{ updateMap() */
+void AloamMapping::updateMap(const MapUpdate &update) {
+  mrs_lib::ScopeTimer timer = mrs_lib::ScopeTimer("ALOAM::FeatureExtraction::updateMap", _scope_timer_logger, _enable_scope_timer);
 
-    // Publish registered sensor data
-    if (_pub_laser_cloud_registered.getNumSubscribers() > 0) {
-      // TODO: this pcl might be published in lidar frame instead of map saving some load.
-      // or it might not be published at all as the data are already published by sensor and TFs are published above
-      const int cloud_full_resNum = cloud_full_res->points.size();
-      for (int i = 0; i < cloud_full_resNum; i++) {
-        pointAssociateToMap(&cloud_full_res->points.at(i), &cloud_full_res->points.at(i));
+  const Eigen::Matrix4f transform_w_curr = toTransform(update.q_w_curr, update.t_w_curr);
+
+  /*//{ Add features to the map */
+  // the map is frozen in the localization-only mode, the other frames than keyframes are only registered
+  if (!_localization_only && update.keyframe) {
+    // the features are transformed before the map is locked
+    const pcl::PointCloud<PointType>::Ptr features_corners_w = _cloud_pool->acquire();
+    const pcl::PointCloud<PointType>::Ptr features_surfs_w   = _cloud_pool->acquire();
+    transformPoints(*update.features_corners, transform_w_curr, *features_corners_w);
+    transformPoints(*update.features_surfs, transform_w_curr, *features_surfs_w);
+
+    std::vector<CubeUpdate> modified_cubes;
+    {
+      std::scoped_lock lock(_mutex_cloud_features);
+
+      for (const auto &point : features_corners_w->points) {
+        _voxel_map->insertCorner(point);
+      }
+      for (const auto &point : features_surfs_w->points) {
+        _voxel_map->insertSurf(point);
       }
 
-      const sensor_msgs::PointCloud2::Ptr cloud_full_res_msg = boost::make_shared<sensor_msgs::PointCloud2>();
-      pcl::toROSMsg(*cloud_full_res, *cloud_full_res_msg);
-      cloud_full_res_msg->header.stamp    = time_aloam_odometry;
-      cloud_full_res_msg->header.frame_id = _frame_map;
+      modified_cubes = _voxel_map->takeModified();
+    }
 
-      try {
-        _pub_laser_cloud_registered.publish(cloud_full_res_msg);
+    // the modified cubes are downsampled without holding the map lock, the registration keeps reading the previous clouds of the cubes until
+    // they are replaced
+    _voxel_map->downsample(modified_cubes, _filter_map_corners, _filter_map_surfs);
+
+    {
+      std::scoped_lock lock(_mutex_cloud_features);
+      _voxel_map->replaceCubes(modified_cubes);
+      _time_map_update = update.stamp;
+    }
+
+    if (_keyframe_window) {
+      _keyframe_window->add(features_corners_w, features_surfs_w);
+    }
+  }
+  /*//}*/
+
+  timer.checkpoint("adding features to map");
+
+  // Publish registered sensor data
+  if (_pub_laser_cloud_registered.getNumSubscribers() > 0) {
+    // the previous message is reused unless it is still referenced by the publisher (or by a nodelet subscriber)
+    if (!_msg_scan_registered || !_msg_scan_registered.unique()) {
+      _msg_scan_registered = boost::make_shared<sensor_msgs::PointCloud2>();
+    }
+
+    _msg_scan_registered->header.stamp = update.stamp;
+    if (_scan_registered_in_lidar_frame) {
+      // the pose of the scan is given by the TF published with the same stamp
+      toCloudMsg(*update.cloud_full_res, *_msg_scan_registered);
+      _msg_scan_registered->header.frame_id = update.cloud_full_res->header.frame_id;
+    } else {
+      transformToCloudMsg(*update.cloud_full_res, transform_w_curr, *_msg_scan_registered);
+      _msg_scan_registered->header.frame_id = _frame_map;
+    }
+
+    try {
+      _pub_laser_cloud_registered.publish(_msg_scan_registered);
+    }
+    catch (...) {
+      ROS_ERROR("[AloamMapping]: Exception caught during publishing topic %s.", _pub_laser_cloud_registered.getTopic().c_str());
+    }
+  }
+}
+/*//}*/
+
+/*//{ threadMapPublisher() */
+void AloamMapping::threadMapPublisher() {
+  const bool publish_map    = _map_publish_period > 0.0f;
+  const bool save_map       = _warm_start_save_map && _warm_start_map_save_period > 0.0f;
+  auto       time_last_save = std::chrono::steady_clock::now();
+
+  // started only if the map is published or saved, so the period is finite
+  const std::chrono::duration<float> period(publish_map ? _map_publish_period : _warm_start_map_save_period);
+
+  std::unique_lock lock(_mutex_map_publisher);
+  while (!_cv_map_publisher.wait_for(lock, period, [this] { return _stop_map_publisher; })) {
+    lock.unlock();
+    if (publish_map) {
+      publishMap();
+    }
+
+    // the map for the warm start, saved by the same thread as it is serialized without the lock of the map as well
+    const auto now = std::chrono::steady_clock::now();
+    if (save_map && is_initialized && std::chrono::duration<float>(now - time_last_save).count() >= _warm_start_map_save_period) {
+      time_last_save = now;
+      std::string message;
+      if (!saveMap("", message)) {
+        ROS_ERROR("[AloamMapping]: Failed saving the map: %s", message.c_str());
       }
-      catch (...) {
-        ROS_ERROR("[AloamMapping]: Exception caught during publishing topic %s.", _pub_laser_cloud_registered.getTopic().c_str());
+    }
+    lock.lock();
+  }
+}
+/*//}*/
+
+/*//{ publishMap() */
+// the cube clouds are copied (by reference) under the lock of the map and serialized without it
+void AloamMapping::publishMap() {
+  std::vector<std::pair<CubeKey, MapCube>> cubes;
+  std::vector<CubeKey>                     removed;
+  ros::Time                                stamp;
+
+  if (_map_output_delta) {
+    {
+      std::scoped_lock lock(_mutex_cloud_features);
+      // the changes are taken even without subscribers, a late-joining subscriber gets the rest of the map by the snapshot service
+      _voxel_map->takeChanges(cubes, removed);
+      stamp = _time_map_update;
+    }
+
+    if (_pub_map_delta.getNumSubscribers() == 0 || (cubes.empty() && removed.empty())) {
+      return;
+    }
+
+    const aloam_slam::MapDelta::Ptr msg = boost::make_shared<aloam_slam::MapDelta>();
+    fillMapDelta(cubes, removed, stamp, false, *msg);
+
+    try {
+      _pub_map_delta.publish(msg);
+    }
+    catch (...) {
+      ROS_ERROR("[AloamMapping]: Exception caught during publishing topic %s.", _pub_map_delta.getTopic().c_str());
+    }
+    return;
+  }
+
+  if (_pub_laser_cloud_map.getNumSubscribers() == 0) {
+    return;
+  }
+
+  {
+    std::scoped_lock lock(_mutex_cloud_features);
+    _voxel_map->getCubes(cubes);
+    stamp = _time_map_update;
+  }
+
+  const pcl::PointCloud<PointType>::Ptr map_pcl = _map_cloud_pool->acquire();
+  for (const auto &[key, cube] : cubes) {
+    *map_pcl += *cube.corners;
+    *map_pcl += *cube.surfs;
+  }
+
+  const sensor_msgs::PointCloud2::Ptr map_msg = boost::make_shared<sensor_msgs::PointCloud2>();
+  pcl::toROSMsg(*map_pcl, *map_msg);
+  map_msg->header.stamp    = stamp;
+  map_msg->header.frame_id = _frame_map;
+
+  try {
+    _pub_laser_cloud_map.publish(map_msg);
+  }
+  catch (...) {
+    ROS_ERROR("[AloamMapping]: Exception caught during publishing topic %s.", _pub_laser_cloud_map.getTopic().c_str());
+  }
+}
+/*//}*/
+
+/*//{ fillMapDelta() */
+void AloamMapping::fillMapDelta(const std::vector<std::pair<CubeKey, MapCube>> &cubes, const std::vector<CubeKey> &removed, const ros::Time &stamp,
+                                const bool full_snapshot, aloam_slam::MapDelta &msg) {
+  msg.header.stamp    = stamp;
+  msg.header.frame_id = _frame_map;
+  msg.cube_size       = _cube_size;
+  msg.full_snapshot   = full_snapshot;
+  msg.chunks.resize(cubes.size() + removed.size());
+
+  const pcl::PointCloud<PointType>::Ptr cloud = _cloud_pool->acquire();
+
+  std::size_t c = 0;
+  for (const auto &[key, cube] : cubes) {
+    aloam_slam::MapChunk &chunk = msg.chunks.at(c++);
+    chunk.i                     = key.i;
+    chunk.j                     = key.j;
+    chunk.k                     = key.k;
+    chunk.version               = cube.version;
+    chunk.removed               = false;
+
+    *cloud = *cube.corners;
+    *cloud += *cube.surfs;
+    pcl::toROSMsg(*cloud, chunk.cloud);
+    chunk.cloud.header = msg.header;
+  }
+
+  for (const auto &key : removed) {
+    aloam_slam::MapChunk &chunk = msg.chunks.at(c++);
+    chunk.i                     = key.i;
+    chunk.j                     = key.j;
+    chunk.k                     = key.k;
+    chunk.removed               = true;
+    chunk.cloud.header          = msg.header;
+  }
+}
+/*//}*/
+
+/*//{ callbackGetMapSnapshot() */
+bool AloamMapping::callbackGetMapSnapshot([[maybe_unused]] aloam_slam::GetMapSnapshot::Request &req, aloam_slam::GetMapSnapshot::Response &res) {
+  std::vector<std::pair<CubeKey, MapCube>> cubes;
+  ros::Time                                stamp;
+  {
+    std::scoped_lock lock(_mutex_cloud_features);
+    _voxel_map->getCubes(cubes);
+    stamp = _time_map_update;
+  }
+
+  fillMapDelta(cubes, {}, stamp, true, res.map);
+
+  res.success = true;
+  res.message = "Map snapshot of " + std::to_string(cubes.size()) + " cubes.";
+  return true;
+}
+/*//}*/
+
+/*//{ callbackSaveMap() */
+bool AloamMapping::callbackSaveMap(aloam_slam::MapFile::Request &req, aloam_slam::MapFile::Response &res) {
+  res.success = saveMap(req.path, res.message);
+  if (res.success) {
+    ROS_INFO("[AloamMapping]: %s", res.message.c_str());
+  } else {
+    ROS_ERROR("[AloamMapping]: Failed saving the map: %s", res.message.c_str());
+  }
+  return true;
+}
+/*//}*/
+
+/*//{ callbackLoadMap() */
+bool AloamMapping::callbackLoadMap(aloam_slam::MapFile::Request &req, aloam_slam::MapFile::Response &res) {
+  res.success = loadMap(req.path, res.message);
+  if (res.success) {
+    ROS_INFO("[AloamMapping]: %s", res.message.c_str());
+  } else {
+    ROS_ERROR("[AloamMapping]: Failed loading the map: %s", res.message.c_str());
+  }
+  return true;
+}
+/*//}*/
+
+/*//{ saveMap() */
+// the cube clouds are copied (by reference) under the lock of the map and written without it
+bool AloamMapping::saveMap(const std::string &path, std::string &message) {
+  const std::string file_path = path.empty() ? _map_file_path : path;
+  if (file_path.empty()) {
+    message = "No path of the map file given.";
+    return false;
+  }
+
+  std::scoped_lock lock_write(_mutex_map_file_write);
+
+  std::vector<std::pair<CubeKey, MapCube>> cubes;
+  std::vector<std::pair<CubeKey, MapCube>> evicted;
+  std::shared_ptr<MappedMapFile>           map_file;
+  {
+    std::scoped_lock lock(_mutex_cloud_features);
+    _voxel_map->getCubes(cubes);
+    evicted.assign(_evicted_cubes.begin(), _evicted_cubes.end());
+    map_file = _map_file;
+  }
+
+  // cubes of the streamed map file which are not loaded in the map are saved as well, the evicted cubes replace their tiles in the file
+  if (map_file) {
+    std::unordered_set<CubeKey, CubeKeyHash> saved;
+    for (const auto &[key, cube] : cubes) {
+      saved.insert(key);
+    }
+    for (const auto &[key, cube] : evicted) {
+      if (saved.insert(key).second) {
+        cubes.emplace_back(key, cube);
       }
     }
+    for (const auto &key : map_file->keys()) {
+      MapCube cube;
+      if (saved.find(key) == saved.end() && map_file->readCube(key, *_cloud_pool, cube)) {
+        cubes.emplace_back(key, cube);
+      }
+    }
+  }
 
-    /*//}*/
+  if (!saveMapFile(file_path, _cube_size, cubes, message)) {
+    return false;
+  }
 
-    _frame_count++;
+  // the saved file replaces the streamed one (the previous file stays mapped until it is not read anymore)
+  if (map_file) {
+    const auto  saved_file = std::make_shared<MappedMapFile>();
+    std::string error;
+    if (saved_file->open(file_path, error)) {
+      std::scoped_lock lock(_mutex_cloud_features);
+      if (_map_file == map_file) {
+        _map_file = saved_file;
+        // the written evicted cubes are streamed from the saved file from now on (unless evicted again in the meantime)
+        for (const auto &[key, cube] : evicted) {
+          const auto it = _evicted_cubes.find(key);
+          if (it != _evicted_cubes.end() && it->second.version == cube.version) {
+            _evicted_cubes.erase(it);
+          }
+        }
+      }
+    } else {
+      ROS_WARN("[AloamMapping]: Streaming from the saved map file failed, keeping the previous one: %s", error.c_str());
+    }
+  }
+
+  message = "Saved " + std::to_string(cubes.size()) + " cubes to " + file_path + ".";
+  return true;
+}
+/*//}*/
+
+/*//{ loadMap() */
+// replaces the map by the cubes of the map file, either all at once or streamed around the vehicle
+bool AloamMapping::loadMap(const std::string &path, std::string &message) {
+  const std::string file_path = path.empty() ? _map_file_path : path;
+  if (file_path.empty()) {
+    message = "No path of the map file given.";
+    return false;
+  }
+
+  const auto map_file = std::make_shared<MappedMapFile>();
+  if (!map_file->open(file_path, message)) {
+    return false;
+  }
+
+  if (std::fabs(map_file->cubeSize() - _cube_size) > 1e-3f) {
+    message = "The cube size of " + file_path + " (" + std::to_string(map_file->cubeSize()) + " m) differs from mapping/voxel_map/cube_size (" +
+              std::to_string(_cube_size) + " m).";
+    return false;
+  }
+
+  std::vector<std::pair<CubeKey, MapCube>> cubes;
+  if (!_map_file_stream) {
+    for (const auto &key : map_file->keys()) {
+      MapCube cube;
+      map_file->readCube(key, *_cloud_pool, cube);
+      cubes.emplace_back(key, cube);
+    }
   }
+
+  const std::shared_ptr<const StaticMap> static_map = _localization_only ? buildStaticMap(cubes) : nullptr;
+
+  {
+    std::scoped_lock lock(_mutex_cloud_features);
+    _voxel_map->clear();
+    _voxel_map->addCubes(cubes);
+    _map_file          = _map_file_stream ? map_file : nullptr;
+    _has_stream_center = false;
+    _evicted_cubes.clear();
+    _static_map        = static_map;
+  }
+
+  if (_map_file_stream) {
+    message = "Streaming " + std::to_string(map_file->size()) + " cubes from " + file_path + ".";
+  } else {
+    message = "Loaded " + std::to_string(cubes.size()) + " cubes from " + file_path + ".";
+  }
+  return true;
+}
+/*//}*/
+
+/*//{ streamMap() */
+// loads the cubes of the streamed map file in the stream radius around cube `center` which are not in the map yet, the evicted cubes not written
+// back to the file yet are taken from memory
+void AloamMapping::streamMap(const CubeKey &center) {
+  std::shared_ptr<MappedMapFile>           map_file;
+  std::vector<CubeKey>                     keys;
+  std::vector<std::pair<CubeKey, MapCube>> cubes;
+  {
+    std::scoped_lock lock(_mutex_cloud_features);
+    if (!_map_file || (_has_stream_center && center == _stream_center)) {
+      return;
+    }
+    _has_stream_center = true;
+    _stream_center     = center;
+    map_file           = _map_file;
+
+    for (int i = center.i - _map_file_stream_radius_xy; i <= center.i + _map_file_stream_radius_xy; i++) {
+      for (int j = center.j - _map_file_stream_radius_xy; j <= center.j + _map_file_stream_radius_xy; j++) {
+        for (int k = center.k - _map_file_stream_radius_z; k <= center.k + _map_file_stream_radius_z; k++) {
+          const CubeKey key{i, j, k};
+          if (_voxel_map->contains(key)) {
+            continue;
+          }
+          const auto it = _evicted_cubes.find(key);
+          if (it != _evicted_cubes.end()) {
+            cubes.emplace_back(key, it->second);
+          } else if (map_file->contains(key)) {
+            keys.push_back(key);
+          }
+        }
+      }
+    }
+  }
+
+  if (keys.empty() && cubes.empty()) {
+    return;
+  }
+
+  // the tiles are read from the mapped file without holding the lock of the map
+  cubes.reserve(cubes.size() + keys.size());
+  for (const auto &key : keys) {
+    MapCube cube;
+    map_file->readCube(key, *_cloud_pool, cube);
+    cubes.emplace_back(key, cube);
+  }
+
+  {
+    std::scoped_lock lock(_mutex_cloud_features);
+    // another map might have been loaded (or the map reset) in the meantime
+    if (_map_file == map_file) {
+      _voxel_map->addCubes(cubes);
+    }
+  }
+
+  ROS_DEBUG("[AloamMapping]: Streamed %lu cubes from the map file.", cubes.size());
+}
+/*//}*/
+
+/*//{ buildStaticMap() */
+std::shared_ptr<const StaticMap> AloamMapping::buildStaticMap(const std::vector<std::pair<CubeKey, MapCube>> &cubes) {
+  const auto static_map      = std::make_shared<StaticMap>();
+  static_map->corners        = boost::make_shared<pcl::PointCloud<PointType>>();
+  static_map->surfs          = boost::make_shared<pcl::PointCloud<PointType>>();
+  static_map->kdtree_corners = boost::make_shared<pcl::KdTreeFLANN<PointType>>();
+  static_map->kdtree_surfs   = boost::make_shared<pcl::KdTreeFLANN<PointType>>();
+
+  for (const auto &[key, cube] : cubes) {
+    *static_map->corners += *cube.corners;
+    *static_map->surfs += *cube.surfs;
+  }
+
+  // empty maps are never queried (not enough map features for the registration)
+  if (!static_map->corners->empty()) {
+    static_map->kdtree_corners->setInputCloud(static_map->corners);
+  }
+  if (!static_map->surfs->empty()) {
+    static_map->kdtree_surfs->setInputCloud(static_map->surfs);
+  }
+
+  return static_map;
 }
 /*//}*/
 
@@ -708,26 +1245,22 @@ void AloamMapping::transformUpdate() {
 }
 /*//}*/
 
-/*//{ pointAssociateToMap() */
-void AloamMapping::pointAssociateToMap(PointType const *const pi, PointType *const po) {
-  const Eigen::Vector3d point_curr(pi->x, pi->y, pi->z);
-  const Eigen::Vector3d point_w = _q_w_curr * point_curr + _t_w_curr;
-  po->x                         = point_w.x();
-  po->y                         = point_w.y();
-  po->z                         = point_w.z();
-  po->intensity                 = pi->intensity;
-  // po->intensity = 1.0;
-}
-/*//}*/
-
 /*//{ callbackResetMapping() */
 bool AloamMapping::callbackResetMapping([[maybe_unused]] std_srvs::Trigger::Request &req, std_srvs::Trigger::Response &res) {
+  if (_localization_only) {
+    res.success = false;
+    res.message = "The map is frozen in the localization-only mode, load another map instead.";
+    return true;
+  }
+
   std::scoped_lock lock(_mutex_cloud_features);
-  _cloud_corners.resize(_cloud_volume);
-  _cloud_surfs.resize(_cloud_volume);
-  for (int i = 0; i < _cloud_volume; i++) {
-    _cloud_corners.at(i) = boost::make_shared<pcl::PointCloud<PointType>>();
-    _cloud_surfs.at(i)   = boost::make_shared<pcl::PointCloud<PointType>>();
+  _voxel_map->clear();
+  // the cleared map is not filled again from a streamed map file
+  _map_file.reset();
+  _evicted_cubes.clear();
+  _keyframe_policy->reset();
+  if (_keyframe_window) {
+    _keyframe_window->clear();
   }
   ROS_INFO("[AloamMapping] Reset: map features were cleared.");
 
@@ -737,6 +1270,30 @@ bool AloamMapping::callbackResetMapping([[maybe_unused]] std_srvs::Trigger::Requ
 }
 /*//}*/
 
+/*//{ loadStartupMap() */
+void AloamMapping::loadStartupMap(const bool warm_start) {
+  if (!_map_file_load_on_start && !_localization_only && !warm_start) {
+    return;
+  }
+
+  std::string message;
+  if (loadMap(_map_file_path, message)) {
+    ROS_INFO("[AloamMapping]: %s", message.c_str());
+  } else {
+    ROS_ERROR("[AloamMapping]: Failed loading the map: %s", message.c_str());
+  }
+}
+/*//}*/
+
+/* setMapCorrection() //{ */
+
+void AloamMapping::setMapCorrection(const Eigen::Vector3d &t_wmap_wodom, const Eigen::Quaterniond &q_wmap_wodom) {
+  _q_wmap_wodom = q_wmap_wodom;
+  _t_wmap_wodom = t_wmap_wodom;
+}
+
+//}
+
 /* setTransform() //{ */
 
 void AloamMapping::setTransform(const Eigen::Vector3d &t, const Eigen::Quaterniond &q, const ros::Time &stamp) {
@@ -816,5 +1373,10 @@ void AloamMapping::setTransform(const Eigen::Vector3d &t, const Eigen::Quaternio
 
 //}
 
-}  // namespace aloam_slam
+/*//{ setFrameObserver() */
+void AloamMapping::setFrameObserver(const std::shared_ptr<FrameObserver> &observer) {
+  _frame_observer = observer;
+}
+/*//}*/
 
+}  // namespace aloam_slam
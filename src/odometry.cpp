@@ -5,9 +5,10 @@ namespace aloam_slam
 {
 
 /* //{ AloamOdometry() */
-AloamOdometry::AloamOdometry(const ros::NodeHandle &parent_nh, const std::string uav_name, const std::shared_ptr<mrs_lib::Profiler> profiler,
-                             const std::shared_ptr<AloamMapping> aloam_mapping, const std::string &frame_fcu, const std::string &frame_lidar,
-                             const std::string &frame_odom, const float scan_period_sec, const tf::Transform &tf_lidar_to_fcu, const bool enable_scope_timer,
+AloamOdometry::AloamOdometry(const ros::NodeHandle &parent_nh, mrs_lib::ParamLoader param_loader, const std::string uav_name,
+                             const std::shared_ptr<mrs_lib::Profiler> profiler, const std::shared_ptr<AloamMapping> aloam_mapping, const std::string &frame_fcu,
+                             const std::string &frame_lidar, const std::string &frame_odom, const float scan_period_sec, const tf::Transform &tf_lidar_to_fcu,
+                             const SharedWorkers &shared_workers, const bool enable_scope_timer,
                              const std::shared_ptr<mrs_lib::ScopeTimerLogger> scope_timer_logger)
     : _profiler(profiler),
       _aloam_mapping(aloam_mapping),
@@ -23,15 +24,53 @@ AloamOdometry::AloamOdometry(const ros::NodeHandle &parent_nh, const std::string
 
   ros::NodeHandle nh_(parent_nh);
 
-  ros::Time::waitForValid();
+  int association_threads;
+  param_loader.loadParam("odometry/association_threads", association_threads, 1);
+
+  const auto factor_type = param_loader.loadParam2<std::string>("odometry/factor_type", std::string("autodiff"));
+  if (!parseFactorType(factor_type, _factor_type)) {
+    ROS_ERROR("[AloamOdometry]: Unknown factor type \"%s\", using autodiff factors.", factor_type.c_str());
+    _factor_type = FactorType::AUTODIFF;
+  }
+
+  const auto solver_type = param_loader.loadParam2<std::string>("odometry/solver/type", std::string("ceres"));
+  if (!parseSolverType(solver_type, _solver_type)) {
+    ROS_ERROR("[AloamOdometry]: Unknown solver type \"%s\", using ceres.", solver_type.c_str());
+    _solver_type = SolverType::CERES;
+  }
+
+  param_loader.loadParam("odometry/solver/outer_iterations", _outer_iterations, 2);
+  param_loader.loadParam("odometry/solver/ceres_max_iterations", _ceres_max_iterations, 4);
+
+  int queue_size;
+  param_loader.loadParam("odometry/queue/size", queue_size, 1);
+  const auto queue_policy_name = param_loader.loadParam2<std::string>("odometry/queue/policy", std::string("latest"));
+  QueuePolicy queue_policy;
+  if (!parseQueuePolicy(queue_policy_name, queue_policy)) {
+    ROS_ERROR("[AloamOdometry]: Unknown queue policy \"%s\", using latest.", queue_policy_name.c_str());
+    queue_policy = QueuePolicy::LATEST;
+  }
+  _queue_features = createFrameChannel<OdometryFrame>(queue_size, queue_policy);
+
+  PoseSolverOptions pose_solver_options;
+  param_loader.loadParam("odometry/solver/levenberg_marquardt", pose_solver_options.levenberg_marquardt, pose_solver_options.levenberg_marquardt);
+  param_loader.loadParam("odometry/solver/max_iterations", pose_solver_options.max_iterations, pose_solver_options.max_iterations);
+  param_loader.loadParam("odometry/solver/huber_delta", pose_solver_options.huber_delta, pose_solver_options.huber_delta);
+  param_loader.loadParam("odometry/solver/min_update_norm", pose_solver_options.min_update_norm, pose_solver_options.min_update_norm);
+  param_loader.loadParam("odometry/solver/min_relative_cost_decrease", pose_solver_options.min_relative_cost_decrease,
+                         pose_solver_options.min_relative_cost_decrease);
+  _pose_solver = std::make_shared<PoseSolver>(pose_solver_options);
 
   // Objects initialization
   _tf_broadcaster = std::make_shared<tf2_ros::TransformBroadcaster>();
+  _thread_pool    = createThreadPool(association_threads, shared_workers);
 
   {
     std::scoped_lock lock(_mutex_odometry_process);
     _features_corners_last = boost::make_shared<pcl::PointCloud<PointType>>();
     _features_surfs_last   = boost::make_shared<pcl::PointCloud<PointType>>();
+    _index_corners_last    = std::make_shared<ScanLineIndex>();
+    _index_surfs_last      = std::make_shared<ScanLineIndex>();
   }
 
   _q_w_curr = Eigen::Quaterniond::Identity();  // eigen has qw, qx, qy, qz notation
@@ -47,75 +86,124 @@ AloamOdometry::AloamOdometry(const ros::NodeHandle &parent_nh, const std::string
   /* _sub_handler_orientation = mrs_lib::SubscribeHandler<nav_msgs::Odometry>(shopts, "orientation_in", mrs_lib::no_timeout); */
 
   _pub_odometry_local = nh_.advertise<nav_msgs::Odometry>("odom_local_out", 1);
+  _pub_diagnostics    = nh_.advertise<aloam_slam::StageDiagnostics>("diagnostics_out", 10);
 
-  _timer_odometry_loop = nh_.createTimer(ros::Rate(1000), &AloamOdometry::timerOdometry, this, false, true);
+  _thread_odometry = std::thread(&AloamOdometry::threadOdometry, this);
 }
 //}
 
-/*//{ timerOdometry() */
-void AloamOdometry::timerOdometry([[maybe_unused]] const ros::TimerEvent &event) {
-  if (!is_initialized) {
-    return;
+/*//{ ~AloamOdometry() */
+AloamOdometry::~AloamOdometry() {
+  _queue_features->close();
+  if (_thread_odometry.joinable()) {
+    _thread_odometry.join();
   }
+}
+/*//}*/
 
-  /*//{ Load latest features */
-  bool has_new_data;
-  {
-    std::scoped_lock lock(_mutex_extracted_features);
-    has_new_data = _has_new_data;
-  }
+/*//{ threadOdometry() */
+void AloamOdometry::threadOdometry() {
+  OdometryFrame frame;
+  while (_queue_features->pop(frame)) {
+    if (!is_initialized) {
+      _frames_dropped++;
+      if (_frame_observer) {
+        ros::Time stamp;
+        pcl_conversions::fromPCL(frame.cloud_full_res->header.stamp, stamp);
+        _frame_observer->onFrameDropped(PipelineStage::ODOMETRY, stamp);
+      }
+      continue;
+    }
 
-  if (!has_new_data) {
-    return;
+    processFrame(frame);
+
+    const QueueStats stats = _queue_features->stats();
+    ROS_DEBUG_THROTTLE(5.0, "[AloamOdometry]: feature queue: depth %lu (max %lu), received %lu, dropped %lu.", stats.depth, stats.max_depth, stats.pushed,
+                       stats.dropped);
   }
+}
+/*//}*/
 
-  mrs_lib::ScopeTimer timer = mrs_lib::ScopeTimer("ALOAM::FeatureExtraction::timerOdometry", _scope_timer_logger, _enable_scope_timer);
+/*//{ processFrame() */
+void AloamOdometry::processFrame(OdometryFrame &frame) {
 
-  pcl::PointCloud<PointType>::Ptr corner_points_sharp;
-  pcl::PointCloud<PointType>::Ptr corner_points_less_sharp;
-  pcl::PointCloud<PointType>::Ptr surf_points_flat;
-  pcl::PointCloud<PointType>::Ptr surf_points_less_flat;
-  pcl::PointCloud<PointType>::Ptr laser_cloud_full_res;
-  {
-    std::scoped_lock lock(_mutex_extracted_features);
-    _has_new_data            = false;
-    corner_points_sharp      = _corner_points_sharp;
-    corner_points_less_sharp = _corner_points_less_sharp;
-    surf_points_flat         = _surf_points_flat;
-    surf_points_less_flat    = _surf_points_less_flat;
-    laser_cloud_full_res     = _cloud_full_ress;
-  }
-  /*//}*/
+  mrs_lib::ScopeTimer timer = mrs_lib::ScopeTimer("ALOAM::FeatureExtraction::processOdometry", _scope_timer_logger, _enable_scope_timer);
+
+  const auto time_frame_start = std::chrono::steady_clock::now();
+
+  pcl::PointCloud<PointType>::Ptr corner_points_sharp      = frame.corner_points_sharp;
+  pcl::PointCloud<PointType>::Ptr corner_points_less_sharp = frame.corner_points_less_sharp;
+  pcl::PointCloud<PointType>::Ptr surf_points_flat         = frame.surf_points_flat;
+  pcl::PointCloud<PointType>::Ptr surf_points_less_flat    = frame.surf_points_less_flat;
+  pcl::PointCloud<PointType>::Ptr laser_cloud_full_res     = frame.cloud_full_res;
 
   if (laser_cloud_full_res->empty()) {
     ROS_WARN_THROTTLE(1.0, "[AloamOdometry]: Received an empty input cloud, skipping!");
+    _frames_dropped++;
+    if (_frame_observer) {
+      ros::Time stamp;
+      pcl_conversions::fromPCL(laser_cloud_full_res->header.stamp, stamp);
+      _frame_observer->onFrameDropped(PipelineStage::ODOMETRY, stamp);
+    }
     return;
   }
 
   timer.checkpoint("loaded data");
 
-  mrs_lib::Routine profiler_routine = _profiler->createRoutine("timerOdometry", 1.0f / _scan_period_sec, 0.05, event);
+  mrs_lib::Routine profiler_routine = _profiler->createRoutine("processOdometry");
 
   ros::Time stamp;
   pcl_conversions::fromPCL(laser_cloud_full_res->header.stamp, stamp);
 
   /*//{ Find features correspondences and compute local odometry */
 
+  // reported in the diagnostics
+  std::size_t correspondences_corners = 0;
+  std::size_t correspondences_surfs   = 0;
+  int         solver_iterations       = 0;
+  double      solver_final_cost       = 0.0;
+
   if (_frame_count > 0) {
     std::scoped_lock lock(_mutex_odometry_process);
 
-    const int cornerPointsSharpNum = corner_points_sharp->points.size();
-    const int surfPointsFlatNum    = surf_points_flat->points.size();
-
-    pcl::KdTreeFLANN<pcl::PointXYZI> _kdtree_corners_last;
-    pcl::KdTreeFLANN<pcl::PointXYZI> _kdtree_surfs_last;
-
     _kdtree_corners_last.setInputCloud(_features_corners_last);
     _kdtree_surfs_last.setInputCloud(_features_surfs_last);
-
-    for (size_t opti_counter = 0; opti_counter < 2; ++opti_counter) {
-      int corner_correspondence = 0;
-      int plane_correspondence  = 0;
+    _index_corners_last->build(*_features_corners_last, _channels_corners_last);
+    _index_surfs_last->build(*_features_surfs_last, _channels_surfs_last);
+
+    ScanLineSearchParams search_params;
+    search_params.distance_sq_threshold = DISTANCE_SQ_THRESHOLD;
+    search_params.nearby_scan           = NEARBY_SCAN;
+    search_params.distortion            = DISTORTION;
+
+    for (int opti_counter = 0; opti_counter < _outer_iterations; ++opti_counter) {
+      // find correspondences for corner and plane features
+      _motion_bins.sample(_q_last_curr, _t_last_curr, search_params);
+      parallelCollect(*_thread_pool, corner_points_sharp->points.size(), _corner_correspondences, _corner_chunk_correspondences,
+                      [&](const std::size_t begin, const std::size_t end, std::vector<EdgeCorrespondence> &correspondences) {
+                        findEdgeCorrespondences(_kdtree_corners_last, *_index_corners_last, *corner_points_sharp, frame.corner_channels_sharp,
+                                                _motion_bins, search_params, begin, end, correspondences);
+                      });
+      parallelCollect(*_thread_pool, surf_points_flat->points.size(), _plane_correspondences, _plane_chunk_correspondences,
+                      [&](const std::size_t begin, const std::size_t end, std::vector<PlaneCorrespondence> &correspondences) {
+                        findPlaneCorrespondences(_kdtree_surfs_last, *_index_surfs_last, *surf_points_flat, frame.surf_channels_flat, _motion_bins,
+                                                 search_params, begin, end, correspondences);
+                      });
+
+      if ((_corner_correspondences.size() + _plane_correspondences.size()) < 10) {
+        ROS_WARN_STREAM("[AloamOdometry] low number of correspondence!");
+      }
+      correspondences_corners = _corner_correspondences.size();
+      correspondences_surfs   = _plane_correspondences.size();
+
+      if (_solver_type == SolverType::GAUSS_NEWTON) {
+        BatchedLidarFactor factor(nullptr);
+        addCorrespondences(factor, _corner_correspondences, _plane_correspondences);
+        const PoseSolverSummary summary = _pose_solver->solve(factor, _para_q, _para_t);
+        solver_iterations += summary.iterations;
+        solver_final_cost = summary.final_cost;
+        continue;
+      }
 
       // ceres::LossFunction *loss_function = NULL;
       ceres::LossFunction *         loss_function      = new ceres::HuberLoss(0.1);
@@ -126,176 +214,29 @@ void AloamOdometry::timerOdometry([[maybe_unused]] const ros::TimerEvent &event)
       problem.AddParameterBlock(_para_q, 4, q_parameterization);
       problem.AddParameterBlock(_para_t, 3);
 
-      pcl::PointXYZI     pointSel;
-      std::vector<int>   pointSearchInd;
-      std::vector<float> pointSearchSqDis;
-
-      // find correspondence for corner features
-      for (int i = 0; i < cornerPointsSharpNum; ++i) {
-        TransformToStart(&(corner_points_sharp->points.at(i)), &pointSel);
-        _kdtree_corners_last.nearestKSearch(pointSel, 1, pointSearchInd, pointSearchSqDis);
-
-        int closestPointInd = -1, minPointInd2 = -1;
-        if (pointSearchSqDis.at(0) < DISTANCE_SQ_THRESHOLD) {
-          closestPointInd        = pointSearchInd.at(0);
-          int closestPointScanID = int(_features_corners_last->points.at(closestPointInd).intensity);
-
-          double minPointSqDis2 = DISTANCE_SQ_THRESHOLD;
-          // search in the direction of increasing scan line
-          for (int j = closestPointInd + 1; j < (int)_features_corners_last->points.size(); ++j) {
-            // if in the same scan line, continue
-            if (int(_features_corners_last->points.at(j).intensity) <= closestPointScanID)
-              continue;
-
-            // if not in nearby scans, end the loop
-            if (int(_features_corners_last->points.at(j).intensity) > (closestPointScanID + NEARBY_SCAN))
-              break;
-
-            double pointSqDis = (_features_corners_last->points.at(j).x - pointSel.x) * (_features_corners_last->points.at(j).x - pointSel.x) +
-                                (_features_corners_last->points.at(j).y - pointSel.y) * (_features_corners_last->points.at(j).y - pointSel.y) +
-                                (_features_corners_last->points.at(j).z - pointSel.z) * (_features_corners_last->points.at(j).z - pointSel.z);
-
-            if (pointSqDis < minPointSqDis2) {
-              // find nearer point
-              minPointSqDis2 = pointSqDis;
-              minPointInd2   = j;
-            }
-          }
-
-          // search in the direction of decreasing scan line
-          for (int j = closestPointInd - 1; j >= 0; --j) {
-            // if in the same scan line, continue
-            if (int(_features_corners_last->points.at(j).intensity) >= closestPointScanID) {
-              continue;
-            }
-
-            // if not in nearby scans, end the loop
-            if (int(_features_corners_last->points.at(j).intensity) < (closestPointScanID - NEARBY_SCAN)) {
-              break;
-            }
-
-            double pointSqDis = (_features_corners_last->points.at(j).x - pointSel.x) * (_features_corners_last->points.at(j).x - pointSel.x) +
-                                (_features_corners_last->points.at(j).y - pointSel.y) * (_features_corners_last->points.at(j).y - pointSel.y) +
-                                (_features_corners_last->points.at(j).z - pointSel.z) * (_features_corners_last->points.at(j).z - pointSel.z);
-
-            if (pointSqDis < minPointSqDis2) {
-              // find nearer point
-              minPointSqDis2 = pointSqDis;
-              minPointInd2   = j;
-            }
-          }
-        }
-        if (minPointInd2 >= 0)  // both closestPointInd and minPointInd2 is valid
-        {
-          const Eigen::Vector3d curr_point(corner_points_sharp->points.at(i).x, corner_points_sharp->points.at(i).y, corner_points_sharp->points.at(i).z);
-          const Eigen::Vector3d last_point_a(_features_corners_last->points.at(closestPointInd).x, _features_corners_last->points.at(closestPointInd).y,
-                                             _features_corners_last->points.at(closestPointInd).z);
-          const Eigen::Vector3d last_point_b(_features_corners_last->points.at(minPointInd2).x, _features_corners_last->points.at(minPointInd2).y,
-                                             _features_corners_last->points.at(minPointInd2).z);
-
-          double s = 1.0;
-          if (DISTORTION) {
-            s = (corner_points_sharp->points.at(i).intensity - int(corner_points_sharp->points.at(i).intensity)) / _scan_period_sec;
-          }
-          ceres::CostFunction *cost_function = LidarEdgeFactor::Create(curr_point, last_point_a, last_point_b, s);
-          problem.AddResidualBlock(cost_function, loss_function, _para_q, _para_t);
-          corner_correspondence++;
-        }
-      }
-
-      // find correspondence for plane features
-      for (int i = 0; i < surfPointsFlatNum; ++i) {
-        TransformToStart(&(surf_points_flat->points.at(i)), &pointSel);
-        _kdtree_surfs_last.nearestKSearch(pointSel, 1, pointSearchInd, pointSearchSqDis);
-
-        int closestPointInd = -1, minPointInd2 = -1, minPointInd3 = -1;
-        if (pointSearchSqDis.at(0) < DISTANCE_SQ_THRESHOLD) {
-          closestPointInd = pointSearchInd.at(0);
-
-          // get closest point's scan ID
-          const int closestPointScanID = int(_features_surfs_last->points.at(closestPointInd).intensity);
-          double    minPointSqDis2 = DISTANCE_SQ_THRESHOLD, minPointSqDis3 = DISTANCE_SQ_THRESHOLD;
-
-          // search in the direction of increasing scan line
-          for (int j = closestPointInd + 1; j < (int)_features_surfs_last->points.size(); ++j) {
-            // if not in nearby scans, end the loop
-            if (int(_features_surfs_last->points.at(j).intensity) > (closestPointScanID + NEARBY_SCAN))
-              break;
-
-            const double pointSqDis = (_features_surfs_last->points.at(j).x - pointSel.x) * (_features_surfs_last->points.at(j).x - pointSel.x) +
-                                      (_features_surfs_last->points.at(j).y - pointSel.y) * (_features_surfs_last->points.at(j).y - pointSel.y) +
-                                      (_features_surfs_last->points.at(j).z - pointSel.z) * (_features_surfs_last->points.at(j).z - pointSel.z);
-
-            // if in the same or lower scan line
-            if (int(_features_surfs_last->points.at(j).intensity) <= closestPointScanID && pointSqDis < minPointSqDis2) {
-              minPointSqDis2 = pointSqDis;
-              minPointInd2   = j;
-            }
-            // if in the higher scan line
-            else if (int(_features_surfs_last->points.at(j).intensity) > closestPointScanID && pointSqDis < minPointSqDis3) {
-              minPointSqDis3 = pointSqDis;
-              minPointInd3   = j;
-            }
-          }
-
-          // search in the direction of decreasing scan line
-          for (int j = closestPointInd - 1; j >= 0; --j) {
-            // if not in nearby scans, end the loop
-            if (int(_features_surfs_last->points.at(j).intensity) < (closestPointScanID - NEARBY_SCAN))
-              break;
-
-            const double pointSqDis = (_features_surfs_last->points.at(j).x - pointSel.x) * (_features_surfs_last->points.at(j).x - pointSel.x) +
-                                      (_features_surfs_last->points.at(j).y - pointSel.y) * (_features_surfs_last->points.at(j).y - pointSel.y) +
-                                      (_features_surfs_last->points.at(j).z - pointSel.z) * (_features_surfs_last->points.at(j).z - pointSel.z);
-
-            // if in the same or higher scan line
-            if (int(_features_surfs_last->points.at(j).intensity) >= closestPointScanID && pointSqDis < minPointSqDis2) {
-              minPointSqDis2 = pointSqDis;
-              minPointInd2   = j;
-            } else if (int(_features_surfs_last->points.at(j).intensity) < closestPointScanID && pointSqDis < minPointSqDis3) {
-              // find nearer point
-              minPointSqDis3 = pointSqDis;
-              minPointInd3   = j;
-            }
-          }
-
-          if (minPointInd2 >= 0 && minPointInd3 >= 0) {
-
-            const Eigen::Vector3d curr_point(surf_points_flat->points.at(i).x, surf_points_flat->points.at(i).y, surf_points_flat->points.at(i).z);
-            const Eigen::Vector3d last_point_a(_features_surfs_last->points.at(closestPointInd).x, _features_surfs_last->points.at(closestPointInd).y,
-                                               _features_surfs_last->points.at(closestPointInd).z);
-            const Eigen::Vector3d last_point_b(_features_surfs_last->points.at(minPointInd2).x, _features_surfs_last->points.at(minPointInd2).y,
-                                               _features_surfs_last->points.at(minPointInd2).z);
-            const Eigen::Vector3d last_point_c(_features_surfs_last->points.at(minPointInd3).x, _features_surfs_last->points.at(minPointInd3).y,
-                                               _features_surfs_last->points.at(minPointInd3).z);
-
-            double s = 1.0;
-            if (DISTORTION) {
-              s = (surf_points_flat->points.at(i).intensity - int(surf_points_flat->points.at(i).intensity)) / _scan_period_sec;
-            }
-            ceres::CostFunction *cost_function = LidarPlaneFactor::Create(curr_point, last_point_a, last_point_b, last_point_c, s);
-            problem.AddResidualBlock(cost_function, loss_function, _para_q, _para_t);
-            plane_correspondence++;
-          }
-        }
-      }
-
-      if ((corner_correspondence + plane_correspondence) < 10) {
-        ROS_WARN_STREAM("[AloamOdometry] low number of correspondence!");
-      }
+      addResidualBlocks(problem, _corner_correspondences, _plane_correspondences, _factor_type, loss_function, _para_q, _para_t);
 
       ceres::Solver::Options options;
       options.linear_solver_type           = ceres::DENSE_QR;
-      options.max_num_iterations           = 4;
+      options.max_num_iterations           = _ceres_max_iterations;
       options.minimizer_progress_to_stdout = false;
       ceres::Solver::Summary summary;
       ceres::Solve(options, &problem, &summary);
-      /* printf("solver time %f ms \n", t_solver.toc()); */
+      solver_iterations += summary.num_successful_steps + summary.num_unsuccessful_steps;
+      solver_final_cost = summary.final_cost;
     }
 
     _t_w_curr = _t_w_curr + _q_w_curr * _t_last_curr;
     _q_w_curr = _q_w_curr * _q_last_curr;
+
+    // the motion is used to deskew the next scans
+    std::scoped_lock lock_motion(_mutex_last_motion);
+    _last_motion_q   = _q_last_curr;
+    _last_motion_t   = _t_last_curr;
+    _last_motion_dt  = (stamp - _stamp_last_frame).toSec();
+    _has_last_motion = true;
   }
+  _stamp_last_frame = stamp;
 
   /*//}*/
 
@@ -339,6 +280,8 @@ void AloamOdometry::timerOdometry([[maybe_unused]] const ros::TimerEvent &event)
   tf_lidar.setRotation(tf_q);
 
   /*//{ Save odometry data to AloamMapping */
+  pcl::PointCloud<PointType>::Ptr features_corners_last;
+  pcl::PointCloud<PointType>::Ptr features_surfs_last;
   {
     std::scoped_lock                lock(_mutex_odometry_process);
     pcl::PointCloud<PointType>::Ptr laserCloudTemp = corner_points_less_sharp;
@@ -349,6 +292,9 @@ void AloamOdometry::timerOdometry([[maybe_unused]] const ros::TimerEvent &event)
     surf_points_less_flat = _features_surfs_last;
     _features_surfs_last  = laserCloudTemp;
 
+    std::swap(_channels_corners_last, frame.corner_channels_less_sharp);
+    std::swap(_channels_surfs_last, frame.surf_channels_less_flat);
+
     _features_corners_last->header.stamp = laser_cloud_full_res->header.stamp;
     _features_surfs_last->header.stamp   = laser_cloud_full_res->header.stamp;
     laser_cloud_full_res->header.stamp   = laser_cloud_full_res->header.stamp;
@@ -357,8 +303,20 @@ void AloamOdometry::timerOdometry([[maybe_unused]] const ros::TimerEvent &event)
     _features_surfs_last->header.frame_id   = _frame_lidar;
     laser_cloud_full_res->header.frame_id   = _frame_lidar;
 
-    _aloam_mapping->setData(stamp, tf_lidar, _features_corners_last, _features_surfs_last, laser_cloud_full_res);
+    features_corners_last = _features_corners_last;
+    features_surfs_last   = _features_surfs_last;
+  }
+
+  const double duration_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time_frame_start).count();
+  _frames_processed++;
+
+  if (_frame_observer) {
+    _frame_observer->onPose(PipelineStage::ODOMETRY, stamp, tf_lidar * _tf_lidar_to_fcu);
+    _frame_observer->onStageFinished(PipelineStage::ODOMETRY, stamp, duration_ms);
   }
+
+  // the clouds are not modified by the odometry after this point, the mapping gets them without holding the odometry lock
+  _aloam_mapping->setData(stamp, tf_lidar, features_corners_last, features_surfs_last, laser_cloud_full_res);
   /*//}*/
 
   /*//{ Publish odometry */
@@ -401,46 +359,46 @@ void AloamOdometry::timerOdometry([[maybe_unused]] const ros::TimerEvent &event)
 
   /*//}*/
 
-  _frame_count++;
+  /*//{ Publish diagnostics */
+  if (_pub_diagnostics.getNumSubscribers() > 0) {
+    const QueueStats stats = _queue_features->stats();
+
+    const aloam_slam::StageDiagnostics::Ptr diag_msg = boost::make_shared<aloam_slam::StageDiagnostics>();
+    diag_msg->header.stamp                           = stamp;
+    diag_msg->header.frame_id                        = _frame_lidar;
+    diag_msg->stage                                  = aloam_slam::StageDiagnostics::STAGE_ODOMETRY;
+    diag_msg->duration_ms                            = duration_ms;
+    diag_msg->latency_ms                             = (ros::Time::now() - stamp).toSec() * 1000.0;
+    diag_msg->features_corners                       = corner_points_sharp->size();
+    diag_msg->features_surfs                         = surf_points_flat->size();
+    diag_msg->correspondences_corners                = correspondences_corners;
+    diag_msg->correspondences_surfs                  = correspondences_surfs;
+    diag_msg->solver_iterations                      = solver_iterations;
+    diag_msg->solver_final_cost                      = solver_final_cost;
+    diag_msg->queue_depth                            = stats.depth;
+    diag_msg->queue_max_depth                        = stats.max_depth;
+    diag_msg->frames_processed                       = _frames_processed;
+    diag_msg->frames_dropped                         = _frames_dropped + stats.dropped;
+
+    try {
+      _pub_diagnostics.publish(diag_msg);
+    }
+    catch (...) {
+      ROS_ERROR("[AloamOdometry]: Exception caught during publishing topic %s.", _pub_diagnostics.getTopic().c_str());
+    }
+  }
+  /*//}*/
 
-  // Print diagnostics
-  /* ROS_INFO_THROTTLE(1.0, "[AloamOdometry] Run time: %0.1f ms (%0.1f Hz)", time_whole, std::min(1.0f / _scan_period_sec, 1000.0f / time_whole)); */
-  /* ROS_DEBUG_THROTTLE(1.0, */
-  /*                    "[AloamOdometry] feature registration: %0.1f ms; solver time: %0.1f ms; double optimization time: %0.1f ms; publishing time: %0.1f ms",
-   */
-  /*                    time_data_association, time_solver, time_opt, t_pub.toc()); */
-  /* ROS_WARN_COND(time_whole > _scan_period_sec * 1000.0f, "[AloamOdometry] Odometry process took over %0.2f ms", _scan_period_sec * 1000.0f); */
+  _frame_count++;
 }
 /*//}*/
 
 /*//{ setData() */
-void AloamOdometry::setData(pcl::PointCloud<PointType>::Ptr corner_points_sharp, pcl::PointCloud<PointType>::Ptr corner_points_less_sharp,
-                            pcl::PointCloud<PointType>::Ptr surf_points_flat, pcl::PointCloud<PointType>::Ptr surf_points_less_flat,
-                            pcl::PointCloud<PointType>::Ptr laser_cloud_full_res) {
+void AloamOdometry::setData(OdometryFrame frame) {
 
   mrs_lib::Routine profiler_routine = _profiler->createRoutine("aloamOdometrySetData");
 
-  std::scoped_lock lock(_mutex_extracted_features);
-  _has_new_data             = true;
-  _corner_points_sharp      = corner_points_sharp;
-  _corner_points_less_sharp = corner_points_less_sharp;
-  _surf_points_flat         = surf_points_flat;
-  _surf_points_less_flat    = surf_points_less_flat;
-  _cloud_full_ress          = laser_cloud_full_res;
-
-  /* if (!isfinite(*_corner_points_sharp)) */
-  /*   std::cerr << "                                                                [AloamOdometry::setData]: _corner_points_sharp are not finite!!" << "\n";
-   */
-  /* if (!isfinite(*_corner_points_less_sharp)) */
-  /*   std::cerr << "                                                                [AloamOdometry::setData]: _corner_points_less_sharp are not finite!!" <<
-   * "\n"; */
-  /* if (!isfinite(*_surf_points_flat)) */
-  /*   std::cerr << "                                                                [AloamOdometry::setData]: _surf_points_flat are not finite!!" << "\n"; */
-  /* if (!isfinite(*_surf_points_less_flat)) */
-  /*   std::cerr << "                                                                [AloamOdometry::setData]: _surf_points_less_flat are not finite!!" << "\n";
-   */
-  /* if (!isfinite(*_cloud_full_ress)) */
-  /*   std::cerr << "                                                                [AloamOdometry::setData]: _cloud_full_ress are not finite!!" << "\n"; */
+  _queue_features->push(std::move(frame));
 }
 /*//}*/
 
@@ -500,22 +458,22 @@ void AloamOdometry::setTransform(const Eigen::Vector3d &t, const Eigen::Quaterni
 
 //}
 
-/*//{ TransformToStart() */
-void AloamOdometry::TransformToStart(PointType const *const pi, PointType *const po) {
-  // interpolation ratio
-  double s = 1.0;
-  if (DISTORTION) {
-    s = (pi->intensity - int(pi->intensity)) / _scan_period_sec;
+/*//{ getLastMotion() */
+bool AloamOdometry::getLastMotion(Eigen::Quaterniond &q_last_curr, Eigen::Vector3d &t_last_curr, double &dt) {
+  std::scoped_lock lock(_mutex_last_motion);
+  if (!_has_last_motion) {
+    return false;
   }
-  const Eigen::Quaterniond q_point_last = Eigen::Quaterniond::Identity().slerp(s, _q_last_curr);
-  const Eigen::Vector3d    t_point_last = s * _t_last_curr;
-  const Eigen::Vector3d    point(pi->x, pi->y, pi->z);
-  const Eigen::Vector3d    un_point = q_point_last * point + t_point_last;
-
-  po->x         = un_point.x();
-  po->y         = un_point.y();
-  po->z         = un_point.z();
-  po->intensity = pi->intensity;
+  q_last_curr = _last_motion_q;
+  t_last_curr = _last_motion_t;
+  dt          = _last_motion_dt;
+  return true;
+}
+/*//}*/
+
+/*//{ setFrameObserver() */
+void AloamOdometry::setFrameObserver(const std::shared_ptr<FrameObserver> &observer) {
+  _frame_observer = observer;
 }
 /*//}*/
 
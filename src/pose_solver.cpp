@@ -0,0 +1,238 @@
+#include "aloam_slam/pose_solver.h"
+
+namespace aloam_slam
+{
+
+/*//{ PoseSolver() */
+PoseSolver::PoseSolver(const PoseSolverOptions &options) : _options(options) {
+}
+/*//}*/
+
+/*//{ solve() */
+PoseSolverSummary PoseSolver::solve(const BatchedLidarFactor &factor, double *q, double *t) const {
+  PoseSolverSummary summary;
+
+  if (factor.num_residuals() == 0) {
+    return summary;
+  }
+
+  std::vector<double> residuals(factor.num_residuals());
+  std::vector<double> jacobian_q(factor.num_residuals() * 4);
+  std::vector<double> jacobian_t(factor.num_residuals() * 3);
+
+  Eigen::Matrix<double, 6, 6> H;
+  Eigen::Matrix<double, 6, 1> g;
+
+  double cost          = linearize(factor, q, t, residuals, jacobian_q, jacobian_t, &H, &g);
+  summary.initial_cost = cost;
+  summary.information  = H;
+
+  double lambda = 1e-4;
+
+  Eigen::Map<Eigen::Quaterniond> q_curr(q);
+  Eigen::Map<Eigen::Vector3d>    t_curr(t);
+
+  while (summary.iterations < _options.max_iterations) {
+    summary.iterations++;
+
+    Eigen::Matrix<double, 6, 6> A = H;
+    if (_options.levenberg_marquardt) {
+      A.diagonal() += lambda * H.diagonal().cwiseMax(1e-6);
+    }
+    const Eigen::Matrix<double, 6, 1> dx = A.ldlt().solve(-g);
+
+    if (!dx.allFinite()) {
+      break;
+    }
+
+    if (dx.norm() < _options.min_update_norm) {
+      summary.converged = true;
+      break;
+    }
+
+    Eigen::Quaterniond q_new = q_curr;
+    Eigen::Vector3d    t_new = t_curr;
+    applyPoseUpdate(dx, q_new.coeffs().data(), t_new.data());
+
+    if (_options.levenberg_marquardt) {
+      const double cost_new = linearize(factor, q_new.coeffs().data(), t_new.data(), residuals, jacobian_q, jacobian_t, nullptr, nullptr);
+
+      if (!(cost_new < cost)) {
+        // reject the step and increase the damping
+        lambda *= 10.0;
+        continue;
+      }
+      lambda = std::max(lambda / 10.0, 1e-10);
+    }
+
+    q_curr = q_new;
+    t_curr = t_new;
+
+    const double cost_prev = cost;
+    cost                   = linearize(factor, q, t, residuals, jacobian_q, jacobian_t, &H, &g);
+
+    if (cost_prev - cost < _options.min_relative_cost_decrease * cost_prev) {
+      summary.converged = true;
+      break;
+    }
+  }
+
+  summary.final_cost = cost;
+  return summary;
+}
+/*//}*/
+
+/*//{ information() */
+Eigen::Matrix<double, 6, 6> PoseSolver::information(const BatchedLidarFactor &factor, const double *q, const double *t) const {
+  Eigen::Matrix<double, 6, 6> H = Eigen::Matrix<double, 6, 6>::Zero();
+  Eigen::Matrix<double, 6, 1> g;
+
+  if (factor.num_residuals() == 0) {
+    return H;
+  }
+
+  std::vector<double> residuals(factor.num_residuals());
+  std::vector<double> jacobian_q(factor.num_residuals() * 4);
+  std::vector<double> jacobian_t(factor.num_residuals() * 3);
+  linearize(factor, q, t, residuals, jacobian_q, jacobian_t, &H, &g);
+
+  return H;
+}
+/*//}*/
+
+/*//{ linearize() */
+double PoseSolver::linearize(const BatchedLidarFactor &factor, const double *q, const double *t, std::vector<double> &residuals,
+                             std::vector<double> &jacobian_q, std::vector<double> &jacobian_t, Eigen::Matrix<double, 6, 6> *H,
+                             Eigen::Matrix<double, 6, 1> *g) const {
+
+  const double *parameters[2] = {q, t};
+  double *      jacobians[2]  = {jacobian_q.data(), jacobian_t.data()};
+  factor.Evaluate(parameters, residuals.data(), H ? jacobians : nullptr);
+
+  // Jacobian of the ceres::EigenQuaternionParameterization plus operation at zero (ambient [x, y, z, w] x tangent)
+  Eigen::Matrix<double, 4, 3> plus_jacobian;
+  plus_jacobian << q[3], q[2], -q[1], -q[2], q[3], q[0], q[1], -q[0], q[3], -q[0], -q[1], -q[2];
+
+  if (H) {
+    H->setZero();
+    g->setZero();
+  }
+
+  const auto accumulate = [&](const int row, const int size) {
+    double sq_norm = 0.0;
+    for (int i = 0; i < size; i++) {
+      sq_norm += residuals[row + i] * residuals[row + i];
+    }
+
+    // Huber: rho(s) = s for s <= delta^2, 2 * delta * sqrt(s) - delta^2 otherwise, the weight is rho'(s)
+    double rho    = sq_norm;
+    double weight = 1.0;
+    if (_options.huber_delta > 0.0 && sq_norm > _options.huber_delta * _options.huber_delta) {
+      const double norm = std::sqrt(sq_norm);
+      rho               = 2.0 * _options.huber_delta * norm - _options.huber_delta * _options.huber_delta;
+      weight            = _options.huber_delta / norm;
+    }
+
+    if (H) {
+      for (int i = 0; i < size; i++) {
+        const Eigen::Map<const Eigen::Matrix<double, 1, 4>> J_q(jacobian_q.data() + (row + i) * 4);
+        const Eigen::Map<const Eigen::Matrix<double, 1, 3>> J_t(jacobian_t.data() + (row + i) * 3);
+
+        Eigen::Matrix<double, 1, 6> J;
+        J.head<3>() = J_q * plus_jacobian;
+        J.tail<3>() = J_t;
+
+        H->noalias() += weight * J.transpose() * J;
+        g->noalias() += weight * residuals[row + i] * J.transpose();
+      }
+    }
+
+    return 0.5 * rho;
+  };
+
+  double cost = 0.0;
+  int    row  = 0;
+  for (std::size_t i = 0; i < factor.numEdges(); i++, row += 3) {
+    cost += accumulate(row, 3);
+  }
+  for (std::size_t i = 0; i < factor.numPlanes(); i++, row++) {
+    cost += accumulate(row, 1);
+  }
+
+  return cost;
+}
+/*//}*/
+
+/*//{ applyPoseUpdate() */
+void applyPoseUpdate(const Eigen::Matrix<double, 6, 1> &dx, double *q, double *t) {
+  // same plus operation as ceres::EigenQuaternionParameterization
+  const Eigen::Vector3d d_theta    = dx.head<3>();
+  const double          norm_theta = d_theta.norm();
+  Eigen::Quaterniond    q_delta    = Eigen::Quaterniond::Identity();
+  if (norm_theta > 0.0) {
+    const double sin_by_norm = std::sin(norm_theta) / norm_theta;
+    q_delta.coeffs() << sin_by_norm * d_theta.x(), sin_by_norm * d_theta.y(), sin_by_norm * d_theta.z(), std::cos(norm_theta);
+  }
+
+  Eigen::Map<Eigen::Quaterniond> q_curr(q);
+  Eigen::Map<Eigen::Vector3d>    t_curr(t);
+  q_curr = q_delta * q_curr;
+  t_curr += dx.tail<3>();
+}
+/*//}*/
+
+/*//{ poseDifference() */
+Eigen::Matrix<double, 6, 1> poseDifference(const double *q_from, const double *t_from, const double *q_to, const double *t_to) {
+  const Eigen::Map<const Eigen::Quaterniond> q_a(q_from);
+  const Eigen::Map<const Eigen::Quaterniond> q_b(q_to);
+
+  Eigen::Quaterniond q_delta = q_b * q_a.inverse();
+  if (q_delta.w() < 0.0) {
+    q_delta.coeffs() = -q_delta.coeffs();
+  }
+
+  Eigen::Matrix<double, 6, 1> dx;
+  const double                norm_vec = q_delta.vec().norm();
+  if (norm_vec > 0.0) {
+    dx.head<3>() = std::atan2(norm_vec, q_delta.w()) / norm_vec * q_delta.vec();
+  } else {
+    dx.head<3>().setZero();
+  }
+  dx.tail<3>() = Eigen::Map<const Eigen::Vector3d>(t_to) - Eigen::Map<const Eigen::Vector3d>(t_from);
+
+  return dx;
+}
+/*//}*/
+
+/*//{ axisEigenvalues() */
+Eigen::Matrix<double, 6, 1> axisEigenvalues(const Eigen::Matrix<double, 6, 6> &information) {
+  const Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 6, 6>> eigensolver(information);
+
+  Eigen::Matrix<double, 6, 1> eigenvalues;
+  for (int i = 0; i < 6; i++) {
+    int col;
+    eigensolver.eigenvectors().row(i).cwiseAbs().maxCoeff(&col);
+    eigenvalues(i) = eigensolver.eigenvalues()(col);
+  }
+
+  return eigenvalues;
+}
+/*//}*/
+
+/*//{ degeneracyProjection() */
+Eigen::Matrix<double, 6, 6> degeneracyProjection(const Eigen::Matrix<double, 6, 6> &information, const double eigenvalue_threshold) {
+  const Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 6, 6>> eigensolver(information);
+
+  Eigen::Matrix<double, 6, 6> projection = Eigen::Matrix<double, 6, 6>::Zero();
+  for (int i = 0; i < 6; i++) {
+    if (eigensolver.eigenvalues()(i) >= eigenvalue_threshold) {
+      const Eigen::Matrix<double, 6, 1> v = eigensolver.eigenvectors().col(i);
+      projection += v * v.transpose();
+    }
+  }
+
+  return projection;
+}
+/*//}*/
+
+}  // namespace aloam_slam
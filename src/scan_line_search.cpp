@@ -0,0 +1,325 @@
+#include "aloam_slam/scan_line_search.h"
+#include "aloam_slam/transform_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace aloam_slam
+{
+
+namespace
+{
+
+/*//{ interpolationRatio() */
+// share of the motion of the scan applied to the point at the time (relative to the scan period)
+double interpolationRatio(const float time, const ScanLineSearchParams &params) {
+  if (!params.distortion) {
+    return 1.0;
+  }
+  return time;
+}
+/*//}*/
+
+/*//{ transformToLast() */
+// the points [begin, end) transformed to the previous scan, the consecutive points of the same time bin by a single batch transformation
+void transformToLast(const pcl::PointCloud<PointType> &points, const FeatureChannels &channels, const MotionBins &motion, const std::size_t begin,
+                     const std::size_t end, pcl::PointCloud<PointType>::VectorType &points_sel) {
+  points_sel.resize(end - begin);
+  if (begin >= end) {
+    return;
+  }
+
+  if (motion.bins() == 1) {
+    transformPoints(points.points.data() + begin, end - begin, motion.transform(0), points_sel.data());
+    return;
+  }
+
+  std::size_t run_begin = begin;
+  while (run_begin < end) {
+    const int   bin     = motion.binOf(channels.time[run_begin]);
+    std::size_t run_end = run_begin + 1;
+    while (run_end < end && motion.binOf(channels.time[run_end]) == bin) {
+      run_end++;
+    }
+    transformPoints(points.points.data() + run_begin, run_end - run_begin, motion.transform(bin), points_sel.data() + (run_begin - begin));
+    run_begin = run_end;
+  }
+}
+/*//}*/
+
+}  // namespace
+
+/*//{ MotionBins::sample() */
+void MotionBins::sample(const Eigen::Quaterniond &q_last_curr, const Eigen::Vector3d &t_last_curr, const ScanLineSearchParams &params) {
+  if (!params.distortion) {
+    _transforms.assign(1, toTransform(q_last_curr, t_last_curr));
+    return;
+  }
+
+  const int time_bins = std::max(params.time_bins, 1);
+  _transforms.resize(time_bins);
+  for (int b = 0; b < time_bins; b++) {
+    const double s = (b + 0.5) / time_bins;
+    _transforms[b] = toTransform(Eigen::Quaterniond::Identity().slerp(s, q_last_curr), s * t_last_curr);
+  }
+}
+/*//}*/
+
+/*//{ MotionBins::bins() */
+int MotionBins::bins() const {
+  return int(_transforms.size());
+}
+/*//}*/
+
+/*//{ MotionBins::binOf() */
+int MotionBins::binOf(const float time) const {
+  return std::min(std::max(int(time * bins()), 0), bins() - 1);
+}
+/*//}*/
+
+/*//{ MotionBins::transform() */
+const Eigen::Matrix4f &MotionBins::transform(const int bin) const {
+  return _transforms[bin];
+}
+/*//}*/
+
+/*//{ ScanLineIndex::build() */
+void ScanLineIndex::build(const pcl::PointCloud<PointType> &cloud, const FeatureChannels &channels) {
+  const int cloud_size = std::min(cloud.points.size(), channels.size());
+
+  int rings = 0;
+  _ring_of_point.resize(cloud_size);
+  _azimuth_of_point.resize(cloud_size);
+  for (int i = 0; i < cloud_size; i++) {
+    const PointType &point = cloud.points[i];
+    _ring_of_point[i]      = channels.ring[i];
+    _azimuth_of_point[i]   = std::atan2(point.y, point.x);
+    rings                  = std::max(rings, _ring_of_point[i] + 1);
+  }
+
+  // points grouped by the ring (counting sort) and sorted by the azimuth within the ring
+  _ring_offsets.assign(rings + 1, 0);
+  for (int i = 0; i < cloud_size; i++) {
+    _ring_offsets[_ring_of_point[i] + 1]++;
+  }
+  for (int r = 0; r < rings; r++) {
+    _ring_offsets[r + 1] += _ring_offsets[r];
+  }
+
+  _cloud_index.resize(cloud_size);
+  _sorted_of_point.assign(_ring_offsets.begin(), _ring_offsets.end() - 1);  // write position of every ring
+  for (int i = 0; i < cloud_size; i++) {
+    _cloud_index[_sorted_of_point[_ring_of_point[i]]++] = i;
+  }
+  for (int r = 0; r < rings; r++) {
+    std::sort(_cloud_index.begin() + _ring_offsets[r], _cloud_index.begin() + _ring_offsets[r + 1],
+              [this](const int a, const int b) { return _azimuth_of_point[a] < _azimuth_of_point[b]; });
+  }
+
+  _x.resize(cloud_size);
+  _y.resize(cloud_size);
+  _z.resize(cloud_size);
+  _azimuth.resize(cloud_size);
+  _sorted_of_point.resize(cloud_size);
+  for (int s = 0; s < cloud_size; s++) {
+    const int        i     = _cloud_index[s];
+    const PointType &point = cloud.points[i];
+    _x[s]                  = point.x;
+    _y[s]                  = point.y;
+    _z[s]                  = point.z;
+    _azimuth[s]            = _azimuth_of_point[i];
+    _sorted_of_point[i]    = s;
+  }
+}
+/*//}*/
+
+/*//{ ScanLineIndex::rings() */
+int ScanLineIndex::rings() const {
+  return int(_ring_offsets.size()) - 1;
+}
+/*//}*/
+
+/*//{ ScanLineIndex::ringOf() */
+int ScanLineIndex::ringOf(const int index) const {
+  return _ring_of_point[index];
+}
+/*//}*/
+
+/*//{ ScanLineIndex::point() */
+Eigen::Vector3d ScanLineIndex::point(const int index) const {
+  const int s = _sorted_of_point[index];
+  return Eigen::Vector3d(_x[s], _y[s], _z[s]);
+}
+/*//}*/
+
+/*//{ ScanLineIndex::nearestInRing() */
+int ScanLineIndex::nearestInRing(const int ring, const Eigen::Vector3f &point, const float azimuth, const int exclude, float &sq_dist) const {
+  if (ring < 0 || ring >= rings()) {
+    return -1;
+  }
+
+  const int begin = _ring_offsets[ring];
+  const int count = _ring_offsets[ring + 1] - begin;
+  if (count == 0) {
+    return -1;
+  }
+
+  const float range_sq = point.x() * point.x() + point.y() * point.y();
+  const float two_pi   = 2.0f * float(M_PI);
+
+  // lower bound of the squared distance of the points at the azimuth difference d in [0, pi]
+  const auto bound = [range_sq](const float d) {
+    if (d >= float(M_PI_2)) {
+      return range_sq;
+    }
+    const float sin_d = std::sin(d);
+    return range_sq * sin_d * sin_d;
+  };
+
+  int        nearest = -1;
+  const auto visit   = [&](const int s) {
+    if (_cloud_index[s] == exclude) {
+      return;
+    }
+    const float dx = _x[s] - point.x();
+    const float dy = _y[s] - point.y();
+    const float dz = _z[s] - point.z();
+    const float d2 = dx * dx + dy * dy + dz * dz;
+    if (d2 < sq_dist) {
+      sq_dist = d2;
+      nearest = _cloud_index[s];
+    }
+  };
+
+  // towards the higher azimuths (wrapping around) up to the opposite azimuth, then towards the lower azimuths over the rest of the ring
+  const int start   = std::lower_bound(_azimuth.begin() + begin, _azimuth.begin() + begin + count, azimuth) - _azimuth.begin() - begin;
+  int       visited = 0;
+  for (; visited < count; visited++) {
+    const int s = begin + (start + visited) % count;
+    float     d = _azimuth[s] - azimuth;
+    if (d < 0.0f) {
+      d += two_pi;
+    }
+    if (d > float(M_PI) || bound(d) >= sq_dist) {
+      break;
+    }
+    visit(s);
+  }
+
+  for (int k = 1; k <= count - visited; k++) {
+    const int s = begin + ((start - k) % count + count) % count;
+    float     d = azimuth - _azimuth[s];
+    if (d < 0.0f) {
+      d += two_pi;
+    }
+    if (d > float(M_PI) || bound(d) >= sq_dist) {
+      break;
+    }
+    visit(s);
+  }
+
+  return nearest;
+}
+/*//}*/
+
+/*//{ findEdgeCorrespondences() */
+void findEdgeCorrespondences(const pcl::KdTreeFLANN<PointType> &kdtree_last, const ScanLineIndex &index_last, const pcl::PointCloud<PointType> &points,
+                             const FeatureChannels &channels, const MotionBins &motion, const ScanLineSearchParams &params, const std::size_t begin,
+                             const std::size_t end, std::vector<EdgeCorrespondence> &correspondences) {
+  // the chunks run in the threads of the pool, every thread reuses its buffers between the chunks and the frames
+  thread_local pcl::PointCloud<PointType>::VectorType pointsSel;
+  thread_local std::vector<int>                       pointSearchInd;
+  thread_local std::vector<float>                     pointSearchSqDis;
+
+  // the second point of the line is the nearest point of the other rings up to nearby_scan rings away
+  const int nearby_rings = int(std::floor(params.nearby_scan));
+
+  transformToLast(points, channels, motion, begin, end, pointsSel);
+
+  for (std::size_t i = begin; i < end; ++i) {
+    const PointType &pointSel = pointsSel[i - begin];
+    if (kdtree_last.nearestKSearch(pointSel, 1, pointSearchInd, pointSearchSqDis) < 1 || pointSearchSqDis[0] >= params.distance_sq_threshold) {
+      continue;
+    }
+
+    const int             closestPointInd    = pointSearchInd[0];
+    const int             closestPointScanID = index_last.ringOf(closestPointInd);
+    const Eigen::Vector3f point_sel(pointSel.x, pointSel.y, pointSel.z);
+    const float           azimuth = std::atan2(pointSel.y, pointSel.x);
+
+    int   minPointInd2   = -1;
+    float minPointSqDis2 = params.distance_sq_threshold;
+    for (int ring = closestPointScanID - nearby_rings; ring <= closestPointScanID + nearby_rings; ring++) {
+      if (ring == closestPointScanID) {
+        continue;
+      }
+      const int ind = index_last.nearestInRing(ring, point_sel, azimuth, -1, minPointSqDis2);
+      if (ind >= 0) {
+        minPointInd2 = ind;
+      }
+    }
+
+    if (minPointInd2 >= 0) {
+      const Eigen::Vector3d curr_point(points.points[i].x, points.points[i].y, points.points[i].z);
+      correspondences.push_back(
+          {curr_point, index_last.point(closestPointInd), index_last.point(minPointInd2), interpolationRatio(channels.time[i], params)});
+    }
+  }
+}
+/*//}*/
+
+/*//{ findPlaneCorrespondences() */
+void findPlaneCorrespondences(const pcl::KdTreeFLANN<PointType> &kdtree_last, const ScanLineIndex &index_last, const pcl::PointCloud<PointType> &points,
+                              const FeatureChannels &channels, const MotionBins &motion, const ScanLineSearchParams &params, const std::size_t begin,
+                              const std::size_t end, std::vector<PlaneCorrespondence> &correspondences) {
+  // reused by the thread as in findEdgeCorrespondences()
+  thread_local pcl::PointCloud<PointType>::VectorType pointsSel;
+  thread_local std::vector<int>                       pointSearchInd;
+  thread_local std::vector<float>                     pointSearchSqDis;
+
+  // the second point of the plane is the nearest other point of the same ring, the third one the nearest point of the other rings up to
+  // nearby_scan rings away
+  const int nearby_rings = int(std::floor(params.nearby_scan));
+
+  transformToLast(points, channels, motion, begin, end, pointsSel);
+
+  for (std::size_t i = begin; i < end; ++i) {
+    const PointType &pointSel = pointsSel[i - begin];
+    if (kdtree_last.nearestKSearch(pointSel, 1, pointSearchInd, pointSearchSqDis) < 1 || pointSearchSqDis[0] >= params.distance_sq_threshold) {
+      continue;
+    }
+
+    const int             closestPointInd    = pointSearchInd[0];
+    const int             closestPointScanID = index_last.ringOf(closestPointInd);
+    const Eigen::Vector3f point_sel(pointSel.x, pointSel.y, pointSel.z);
+    const float           azimuth = std::atan2(pointSel.y, pointSel.x);
+
+    float     minPointSqDis2 = params.distance_sq_threshold;
+    const int minPointInd2   = index_last.nearestInRing(closestPointScanID, point_sel, azimuth, closestPointInd, minPointSqDis2);
+    if (minPointInd2 < 0) {
+      continue;
+    }
+
+    int   minPointInd3   = -1;
+    float minPointSqDis3 = params.distance_sq_threshold;
+    for (int ring = closestPointScanID - nearby_rings; ring <= closestPointScanID + nearby_rings; ring++) {
+      if (ring == closestPointScanID) {
+        continue;
+      }
+      const int ind = index_last.nearestInRing(ring, point_sel, azimuth, -1, minPointSqDis3);
+      if (ind >= 0) {
+        minPointInd3 = ind;
+      }
+    }
+
+    if (minPointInd3 >= 0) {
+      const Eigen::Vector3d curr_point(points.points[i].x, points.points[i].y, points.points[i].z);
+      correspondences.push_back(
+          {curr_point, index_last.point(closestPointInd), index_last.point(minPointInd2), index_last.point(minPointInd3),
+           interpolationRatio(channels.time[i], params)});
+    }
+  }
+}
+/*//}*/
+
+}  // namespace aloam_slam
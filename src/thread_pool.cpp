@@ -0,0 +1,215 @@
+#include "aloam_slam/thread_pool.h"
+
+#include <atomic>
+
+namespace aloam_slam
+{
+
+/*//{ WorkerPool() */
+WorkerPool::WorkerPool(const int num_threads) {
+  const int threads = num_threads > 0 ? num_threads : std::max(1, int(std::thread::hardware_concurrency()));
+  for (int i = 0; i < threads; i++) {
+    _workers.emplace_back(&WorkerPool::workerLoop, this);
+  }
+}
+/*//}*/
+
+/*//{ ~WorkerPool() */
+WorkerPool::~WorkerPool() {
+  {
+    std::scoped_lock lock(_mutex);
+    _stop = true;
+  }
+  _cv_task.notify_all();
+
+  for (auto &worker : _workers) {
+    worker.join();
+  }
+}
+/*//}*/
+
+/*//{ shared() */
+std::shared_ptr<WorkerPool> WorkerPool::shared(const int num_threads) {
+  static std::mutex                mutex;
+  static std::weak_ptr<WorkerPool> pool;
+
+  // the pool lives as long as any of its users, the next user after that creates a new one
+  std::scoped_lock                  lock(mutex);
+  const std::shared_ptr<WorkerPool> existing = pool.lock();
+  if (existing) {
+    return existing;
+  }
+  const std::shared_ptr<WorkerPool> created = std::make_shared<WorkerPool>(num_threads);
+  pool                                      = created;
+  return created;
+}
+/*//}*/
+
+/*//{ size() */
+int WorkerPool::size() const {
+  return int(_workers.size());
+}
+/*//}*/
+
+/*//{ submit() */
+void WorkerPool::submit(const int priority, std::function<void()> task) {
+  {
+    std::scoped_lock lock(_mutex);
+    _tasks.push({priority, _sequence++, std::move(task)});
+  }
+  _cv_task.notify_one();
+}
+/*//}*/
+
+/*//{ workerLoop() */
+void WorkerPool::workerLoop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock lock(_mutex);
+      _cv_task.wait(lock, [this] { return _stop || !_tasks.empty(); });
+      if (_stop) {
+        return;
+      }
+      task = std::move(const_cast<Task &>(_tasks.top()).fn);
+      _tasks.pop();
+    }
+
+    task();
+  }
+}
+/*//}*/
+
+/*//{ ThreadPool() */
+ThreadPool::ThreadPool(const int num_threads) : _num_threads(std::max(1, num_threads)) {
+  for (int i = 1; i < _num_threads; i++) {
+    _workers.emplace_back(&ThreadPool::workerLoop, this, i);
+  }
+}
+
+ThreadPool::ThreadPool(const int num_chunks, const std::shared_ptr<WorkerPool> &workers, const int priority)
+    : _num_threads(std::max(1, num_chunks)), _shared_workers(workers), _priority(priority) {
+}
+/*//}*/
+
+/*//{ ~ThreadPool() */
+ThreadPool::~ThreadPool() {
+  {
+    std::scoped_lock lock(_mutex);
+    _stop = true;
+  }
+  _cv_job.notify_all();
+
+  for (auto &worker : _workers) {
+    worker.join();
+  }
+}
+/*//}*/
+
+/*//{ size() */
+int ThreadPool::size() const {
+  return _num_threads;
+}
+/*//}*/
+
+/*//{ parallelFor() */
+void ThreadPool::parallelFor(const std::size_t count, const std::function<void(const int, const std::size_t, const std::size_t)> &fn) {
+  if (_num_threads == 1) {
+    fn(0, 0, count);
+    return;
+  }
+
+  if (_shared_workers) {
+    parallelForShared(count, fn);
+    return;
+  }
+
+  {
+    std::scoped_lock lock(_mutex);
+    _fn      = &fn;
+    _count   = count;
+    _pending = _num_threads - 1;
+    _generation++;
+  }
+  _cv_job.notify_all();
+
+  runChunk(0, count, fn);
+
+  std::unique_lock lock(_mutex);
+  _cv_done.wait(lock, [this] { return _pending == 0; });
+  _fn = nullptr;
+}
+/*//}*/
+
+/*//{ parallelForShared() */
+void ThreadPool::parallelForShared(const std::size_t count, const std::function<void(const int, const std::size_t, const std::size_t)> &fn) {
+  struct Job
+  {
+    std::atomic<int>        next{0};
+    int                     done = 0;
+    std::mutex              mutex;
+    std::condition_variable cv_done;
+  };
+
+  // a task left in the queue after the job is finished finds no chunk to claim and does not touch fn
+  const std::shared_ptr<Job> job    = std::make_shared<Job>();
+  const int                  chunks = _num_threads;
+  const auto                 claim  = [this, job, chunks, count, &fn]() {
+    for (int t = job->next++; t < chunks; t = job->next++) {
+      runChunk(t, count, fn);
+
+      std::scoped_lock lock(job->mutex);
+      if (++job->done == chunks) {
+        job->cv_done.notify_all();
+      }
+    }
+  };
+
+  for (int t = 1; t < chunks; t++) {
+    _shared_workers->submit(_priority, claim);
+  }
+  claim();
+
+  std::unique_lock lock(job->mutex);
+  job->cv_done.wait(lock, [&job, chunks] { return job->done == chunks; });
+}
+/*//}*/
+
+/*//{ workerLoop() */
+void ThreadPool::workerLoop(const int thread_idx) {
+  unsigned long generation = 0;
+
+  while (true) {
+    const std::function<void(const int, const std::size_t, const std::size_t)> *fn;
+    std::size_t                                                                  count;
+    {
+      std::unique_lock lock(_mutex);
+      _cv_job.wait(lock, [&] { return _stop || _generation != generation; });
+      if (_stop) {
+        return;
+      }
+      generation = _generation;
+      fn         = _fn;
+      count      = _count;
+    }
+
+    runChunk(thread_idx, count, *fn);
+
+    {
+      std::scoped_lock lock(_mutex);
+      _pending--;
+    }
+    _cv_done.notify_one();
+  }
+}
+/*//}*/
+
+/*//{ runChunk() */
+void ThreadPool::runChunk(const int thread_idx, const std::size_t count, const std::function<void(const int, const std::size_t, const std::size_t)> &fn) const {
+  const std::size_t begin = count * thread_idx / _num_threads;
+  const std::size_t end   = count * (thread_idx + 1) / _num_threads;
+  fn(thread_idx, begin, end);
+}
+/*//}*/
+
+}  // namespace aloam_slam
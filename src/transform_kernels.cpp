@@ -0,0 +1,115 @@
+#include "aloam_slam/transform_kernels.h"
+
+namespace aloam_slam
+{
+
+namespace
+{
+
+constexpr int POINT_STRIDE = sizeof(PointType) / sizeof(float);
+
+using ConstPointsMap    = Eigen::Map<const Eigen::Matrix<float, 3, Eigen::Dynamic>, Eigen::Unaligned, Eigen::OuterStride<POINT_STRIDE>>;
+using ConstIntensityMap = Eigen::Map<const Eigen::Matrix<float, 1, Eigen::Dynamic>, Eigen::Unaligned, Eigen::InnerStride<POINT_STRIDE>>;
+using MsgPointsMap      = Eigen::Map<Eigen::Matrix<float, 4, Eigen::Dynamic>, Eigen::Unaligned>;
+
+/*//{ prepareMsg() */
+void prepareMsg(const pcl::PointCloud<PointType> &cloud, sensor_msgs::PointCloud2 &msg) {
+  static const char *names[4] = {"x", "y", "z", "intensity"};
+
+  msg.fields.resize(4);
+  for (int i = 0; i < 4; i++) {
+    msg.fields.at(i).name     = names[i];
+    msg.fields.at(i).offset   = i * sizeof(float);
+    msg.fields.at(i).datatype = sensor_msgs::PointField::FLOAT32;
+    msg.fields.at(i).count    = 1;
+  }
+
+  msg.height       = 1;
+  msg.width        = cloud.points.size();
+  msg.is_bigendian = false;
+  msg.is_dense     = cloud.is_dense;
+  msg.point_step   = 4 * sizeof(float);
+  msg.row_step     = msg.point_step * msg.width;
+  msg.data.resize(msg.row_step);
+}
+/*//}*/
+
+}  // namespace
+
+/*//{ toCloudMsg() */
+void toCloudMsg(const pcl::PointCloud<PointType> &cloud, sensor_msgs::PointCloud2 &msg) {
+  prepareMsg(cloud, msg);
+  if (cloud.points.empty()) {
+    return;
+  }
+
+  const Eigen::Index      n = cloud.points.size();
+  const ConstPointsMap    points(&cloud.points.front().x, 3, n);
+  const ConstIntensityMap intensities(&cloud.points.front().intensity, 1, n);
+  MsgPointsMap            out(reinterpret_cast<float *>(msg.data.data()), 4, n);
+
+  out.topRows<3>() = points;
+  out.row(3)       = intensities;
+}
+/*//}*/
+
+/*//{ toTransform() */
+Eigen::Matrix4f toTransform(const Eigen::Quaterniond &q, const Eigen::Vector3d &t) {
+  Eigen::Matrix4f transform        = Eigen::Matrix4f::Identity();
+  transform.topLeftCorner<3, 3>()  = q.toRotationMatrix().cast<float>();
+  transform.topRightCorner<3, 1>() = t.cast<float>();
+  return transform;
+}
+/*//}*/
+
+/*//{ transformPoints() */
+void transformPoints(const PointType *in, const std::size_t count, const Eigen::Matrix4f &transform, PointType *out) {
+  const Eigen::Vector4f c0 = transform.col(0);
+  const Eigen::Vector4f c1 = transform.col(1);
+  const Eigen::Vector4f c2 = transform.col(2);
+  const Eigen::Vector4f c3 = transform.col(3);
+
+  for (std::size_t i = 0; i < count; i++) {
+    const float x         = in[i].x;
+    const float y         = in[i].y;
+    const float z         = in[i].z;
+    const float intensity = in[i].intensity;
+
+    // the last row of the transformation is (0, 0, 0, 1), so the padding of the point is set to 1 as by the PointType constructor
+    Eigen::Map<Eigen::Vector4f, Eigen::Aligned16>(&out[i].x) = c0 * x + c1 * y + c2 * z + c3;
+    out[i].intensity                                         = intensity;
+  }
+}
+
+void transformPoints(const pcl::PointCloud<PointType> &cloud, const Eigen::Matrix4f &transform, pcl::PointCloud<PointType> &out) {
+  if (&cloud != &out) {
+    out.resize(cloud.points.size());
+    out.header   = cloud.header;
+    out.is_dense = cloud.is_dense;
+  }
+  if (cloud.points.empty()) {
+    return;
+  }
+  transformPoints(cloud.points.data(), cloud.points.size(), transform, out.points.data());
+}
+/*//}*/
+
+/*//{ transformToCloudMsg() */
+void transformToCloudMsg(const pcl::PointCloud<PointType> &cloud, const Eigen::Matrix4f &transform, sensor_msgs::PointCloud2 &msg) {
+  prepareMsg(cloud, msg);
+  if (cloud.points.empty()) {
+    return;
+  }
+
+  const Eigen::Index      n = cloud.points.size();
+  const ConstPointsMap    points(&cloud.points.front().x, 3, n);
+  const ConstIntensityMap intensities(&cloud.points.front().intensity, 1, n);
+  MsgPointsMap            out(reinterpret_cast<float *>(msg.data.data()), 4, n);
+
+  out.topRows<3>().noalias() = transform.topLeftCorner<3, 3>() * points;
+  out.topRows<3>().colwise() += transform.topRightCorner<3, 1>();
+  out.row(3) = intensities;
+}
+/*//}*/
+
+}  // namespace aloam_slam
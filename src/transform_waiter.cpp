@@ -0,0 +1,113 @@
+#include "aloam_slam/transform_waiter.h"
+
+namespace aloam_slam
+{
+
+namespace
+{
+
+// returned by tf2::BufferCore::addTransformableRequest() if the request can never be satisfied
+constexpr tf2::TransformableRequestHandle REQUEST_FAILED = 0xffffffffffffffffULL;
+
+}  // namespace
+
+/*//{ TransformWaiter() */
+TransformWaiter::TransformWaiter() {
+  _callback_handle = _buffer.addTransformableCallback(
+      [this](const tf2::TransformableRequestHandle handle, const std::string &, const std::string &, ros::Time, const tf2::TransformableResult) {
+        callbackTransformable(handle);
+      });
+  _listener = std::make_unique<tf2_ros::TransformListener>(_buffer);
+}
+/*//}*/
+
+/*//{ ~TransformWaiter() */
+TransformWaiter::~TransformWaiter() {
+  // the listener thread is stopped first, so no callback runs while the requests are dropped
+  _listener.reset();
+  cancel();
+  _buffer.removeTransformableCallback(_callback_handle);
+}
+/*//}*/
+
+/*//{ request() */
+std::shared_future<geometry_msgs::TransformStamped> TransformWaiter::request(const std::string &frame_from, const std::string &frame_to) {
+  Request request;
+  request.target_frame = frame_to;
+  request.source_frame = frame_from;
+
+  const std::shared_future<geometry_msgs::TransformStamped> future = request.promise.get_future().share();
+
+  std::scoped_lock lock(_mutex);
+  submit(std::move(request));
+  return future;
+}
+/*//}*/
+
+/*//{ cancel() */
+void TransformWaiter::cancel() {
+  std::scoped_lock lock(_mutex);
+  _cancelled = true;
+  for (auto &[handle, request] : _requests) {
+    _buffer.cancelTransformableRequest(handle);
+    request.promise.set_exception(std::make_exception_ptr(std::runtime_error("waiting for the transform was cancelled")));
+  }
+  _requests.clear();
+}
+/*//}*/
+
+/*//{ callbackTransformable() */
+// called by the tf listener thread once a transform of the request arrives
+void TransformWaiter::callbackTransformable(const tf2::TransformableRequestHandle handle) {
+  std::scoped_lock lock(_mutex);
+
+  const auto it = _requests.find(handle);
+  if (it == _requests.end()) {
+    return;
+  }
+  Request request = std::move(it->second);
+  _requests.erase(it);
+
+  // the latest transform of a chain with dynamic frames may be reported as a failure (it is older than the cache), it is requested again
+  if (!resolve(request)) {
+    submit(std::move(request));
+  }
+}
+/*//}*/
+
+/*//{ submit() */
+void TransformWaiter::submit(Request &&request) {
+  if (_cancelled) {
+    request.promise.set_exception(std::make_exception_ptr(std::runtime_error("waiting for the transform was cancelled")));
+    return;
+  }
+
+  const tf2::TransformableRequestHandle handle =
+      _buffer.addTransformableRequest(_callback_handle, request.target_frame, request.source_frame, ros::Time(0));
+
+  // 0: the transform is available already
+  if (handle == 0 || handle == REQUEST_FAILED) {
+    if (!resolve(request)) {
+      request.promise.set_exception(std::make_exception_ptr(
+          std::runtime_error("transform from " + request.source_frame + " to " + request.target_frame + " cannot become available")));
+    }
+    return;
+  }
+
+  _requests.emplace(handle, std::move(request));
+}
+/*//}*/
+
+/*//{ resolve() */
+bool TransformWaiter::resolve(Request &request) {
+  try {
+    request.promise.set_value(_buffer.lookupTransform(request.target_frame, request.source_frame, ros::Time(0)));
+    return true;
+  }
+  catch (const tf2::TransformException &e) {
+    return false;
+  }
+}
+/*//}*/
+
+}  // namespace aloam_slam
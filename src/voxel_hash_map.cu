@@ -0,0 +1,513 @@
+#include "aloam_slam/gpu_kernels.h"
+#include "aloam_slam/device_buffer.cuh"
+
+#include <cfloat>
+#include <exception>
+#include <vector>
+
+#include <thrust/execution_policy.h>
+#include <thrust/sort.h>
+
+namespace aloam_slam
+{
+
+namespace gpu
+{
+
+namespace
+{
+
+constexpr unsigned int       THREADS   = 256;
+constexpr int                NEIGHBORS = 5;
+constexpr unsigned long long EMPTY_KEY = ~0ULL;
+
+// 21 bits per voxel coordinate, i.e., +-1e6 voxels around the origin
+constexpr int                KEY_OFFSET = 1 << 20;
+constexpr unsigned long long KEY_MASK   = (1ULL << 21) - 1;
+
+/*//{ voxelKey() */
+__device__ unsigned long long voxelKey(const int i, const int j, const int k) {
+  return ((static_cast<unsigned long long>(i + KEY_OFFSET) & KEY_MASK) << 42) | ((static_cast<unsigned long long>(j + KEY_OFFSET) & KEY_MASK) << 21) |
+         (static_cast<unsigned long long>(k + KEY_OFFSET) & KEY_MASK);
+}
+/*//}*/
+
+/*//{ hashKey() */
+__device__ unsigned int hashKey(unsigned long long key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return static_cast<unsigned int>(key);
+}
+/*//}*/
+
+/*//{ findCell() */
+// slot of the voxel in the table, -1 if the voxel is empty (the table is never full)
+__device__ int findCell(const unsigned long long *table_keys, const unsigned int table_mask, const unsigned long long key) {
+  unsigned int slot = hashKey(key) & table_mask;
+  while (true) {
+    const unsigned long long slot_key = table_keys[slot];
+    if (slot_key == key) {
+      return int(slot);
+    }
+    if (slot_key == EMPTY_KEY) {
+      return -1;
+    }
+    slot = (slot + 1) & table_mask;
+  }
+}
+/*//}*/
+
+/*//{ insertCell() */
+__device__ unsigned int insertCell(unsigned long long *table_keys, const unsigned int table_mask, const unsigned long long key) {
+  unsigned int slot = hashKey(key) & table_mask;
+  while (true) {
+    const unsigned long long previous = atomicCAS(&table_keys[slot], EMPTY_KEY, key);
+    if (previous == EMPTY_KEY || previous == key) {
+      return slot;
+    }
+    slot = (slot + 1) & table_mask;
+  }
+}
+/*//}*/
+
+/*//{ keysKernel() */
+__global__ void keysKernel(const float4 *points, const int count, const float inv_voxel_size, unsigned long long *keys, int *order) {
+  const int i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i >= count) {
+    return;
+  }
+  const float4 p = points[i];
+  keys[i]        = voxelKey(__float2int_rd(p.x * inv_voxel_size), __float2int_rd(p.y * inv_voxel_size), __float2int_rd(p.z * inv_voxel_size));
+  order[i]       = i;
+}
+/*//}*/
+
+/*//{ gatherKernel() */
+__global__ void gatherKernel(const float4 *points, const int *order, const int count, float4 *sorted) {
+  const int i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i < count) {
+    sorted[i] = points[order[i]];
+  }
+}
+/*//}*/
+
+/*//{ insertKernel() */
+// the points of a voxel are consecutive after the sort, the first and the last point of every voxel write the range of the voxel
+__global__ void insertKernel(const unsigned long long *keys, const int count, const unsigned int table_mask, unsigned long long *table_keys,
+                             int *table_begin, int *table_end) {
+  const int i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i >= count) {
+    return;
+  }
+  const unsigned long long key = keys[i];
+  if (i == 0 || keys[i - 1] != key) {
+    table_begin[insertCell(table_keys, table_mask, key)] = i;
+  }
+  if (i == count - 1 || keys[i + 1] != key) {
+    table_end[insertCell(table_keys, table_mask, key)] = i + 1;
+  }
+}
+/*//}*/
+
+/*//{ neighborsKernel() */
+// the 5 nearest map points closer than the radius (the voxel size) in the 27 voxels around the query, -1 if there are fewer
+__global__ void neighborsKernel(const float4 *queries, const int count, const float4 *points, const unsigned long long *table_keys,
+                                const int *table_begin, const int *table_end, const unsigned int table_mask, const float inv_voxel_size,
+                                const float radius_sq, int *neighbors) {
+  const int i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i >= count) {
+    return;
+  }
+
+  float best_sq_dist[NEIGHBORS];
+  int   best_index[NEIGHBORS];
+  for (int m = 0; m < NEIGHBORS; m++) {
+    best_sq_dist[m] = FLT_MAX;
+    best_index[m]   = -1;
+  }
+
+  const float4 q  = queries[i];
+  const int    vi = __float2int_rd(q.x * inv_voxel_size);
+  const int    vj = __float2int_rd(q.y * inv_voxel_size);
+  const int    vk = __float2int_rd(q.z * inv_voxel_size);
+
+  for (int di = -1; di <= 1; di++) {
+    for (int dj = -1; dj <= 1; dj++) {
+      for (int dk = -1; dk <= 1; dk++) {
+        const int cell = findCell(table_keys, table_mask, voxelKey(vi + di, vj + dj, vk + dk));
+        if (cell < 0) {
+          continue;
+        }
+        for (int p = table_begin[cell]; p < table_end[cell]; p++) {
+          const float4 point   = points[p];
+          const float  dx      = point.x - q.x;
+          const float  dy      = point.y - q.y;
+          const float  dz      = point.z - q.z;
+          const float  sq_dist = dx * dx + dy * dy + dz * dz;
+          if (sq_dist >= radius_sq || sq_dist >= best_sq_dist[NEIGHBORS - 1]) {
+            continue;
+          }
+          int m = NEIGHBORS - 1;
+          while (m > 0 && best_sq_dist[m - 1] > sq_dist) {
+            best_sq_dist[m] = best_sq_dist[m - 1];
+            best_index[m]   = best_index[m - 1];
+            m--;
+          }
+          best_sq_dist[m] = sq_dist;
+          best_index[m]   = p;
+        }
+      }
+    }
+  }
+
+  for (int m = 0; m < NEIGHBORS; m++) {
+    neighbors[NEIGHBORS * i + m] = best_index[m];
+  }
+}
+/*//}*/
+
+/*//{ symmetricEigen() */
+// cyclic Jacobi rotations of the symmetric 3x3 matrix `a`, the eigenvalues in the ascending order and the eigenvectors in the columns of `v`
+__device__ void symmetricEigen(float a[3][3], float eigenvalues[3], float v[3][3]) {
+  for (int r = 0; r < 3; r++) {
+    for (int c = 0; c < 3; c++) {
+      v[r][c] = r == c ? 1.0f : 0.0f;
+    }
+  }
+
+  const int pairs[3][2] = {{0, 1}, {0, 2}, {1, 2}};
+  for (int sweep = 0; sweep < 8; sweep++) {
+    for (int pair = 0; pair < 3; pair++) {
+      const int p = pairs[pair][0];
+      const int q = pairs[pair][1];
+      if (fabsf(a[p][q]) <= 1e-12f * (fabsf(a[p][p]) + fabsf(a[q][q]))) {
+        continue;
+      }
+
+      const float theta = (a[q][q] - a[p][p]) / (2.0f * a[p][q]);
+      const float t     = copysignf(1.0f, theta) / (fabsf(theta) + sqrtf(theta * theta + 1.0f));
+      const float c     = rsqrtf(t * t + 1.0f);
+      const float s     = t * c;
+
+      for (int k = 0; k < 3; k++) {
+        const float a_kp = a[k][p];
+        const float a_kq = a[k][q];
+        a[k][p]          = c * a_kp - s * a_kq;
+        a[k][q]          = s * a_kp + c * a_kq;
+      }
+      for (int k = 0; k < 3; k++) {
+        const float a_pk = a[p][k];
+        const float a_qk = a[q][k];
+        a[p][k]          = c * a_pk - s * a_qk;
+        a[q][k]          = s * a_pk + c * a_qk;
+      }
+      for (int k = 0; k < 3; k++) {
+        const float v_kp = v[k][p];
+        const float v_kq = v[k][q];
+        v[k][p]          = c * v_kp - s * v_kq;
+        v[k][q]          = s * v_kp + c * v_kq;
+      }
+    }
+  }
+
+  for (int k = 0; k < 3; k++) {
+    eigenvalues[k] = a[k][k];
+  }
+  // selection sort of the 3 eigenvalues with their columns
+  for (int k = 0; k < 2; k++) {
+    int smallest = k;
+    for (int l = k + 1; l < 3; l++) {
+      if (eigenvalues[l] < eigenvalues[smallest]) {
+        smallest = l;
+      }
+    }
+    if (smallest != k) {
+      const float value     = eigenvalues[k];
+      eigenvalues[k]        = eigenvalues[smallest];
+      eigenvalues[smallest] = value;
+      for (int r = 0; r < 3; r++) {
+        const float element = v[r][k];
+        v[r][k]             = v[r][smallest];
+        v[r][smallest]      = element;
+      }
+    }
+  }
+}
+/*//}*/
+
+/*//{ neighborhoodMoments() */
+// centroid and the scatter matrix of the 5 neighbors of the query, false if the query has fewer neighbors
+__device__ bool neighborhoodMoments(const float4 *points, const int *neighbors, float center[3], float scatter[3][3]) {
+  if (neighbors[NEIGHBORS - 1] < 0) {
+    return false;
+  }
+
+  center[0] = center[1] = center[2] = 0.0f;
+  for (int m = 0; m < NEIGHBORS; m++) {
+    const float4 p = points[neighbors[m]];
+    center[0] += p.x;
+    center[1] += p.y;
+    center[2] += p.z;
+  }
+  for (int k = 0; k < 3; k++) {
+    center[k] /= float(NEIGHBORS);
+  }
+
+  for (int r = 0; r < 3; r++) {
+    for (int c = 0; c < 3; c++) {
+      scatter[r][c] = 0.0f;
+    }
+  }
+  for (int m = 0; m < NEIGHBORS; m++) {
+    const float4 p    = points[neighbors[m]];
+    const float  d[3] = {p.x - center[0], p.y - center[1], p.z - center[2]};
+    for (int r = 0; r < 3; r++) {
+      for (int c = 0; c < 3; c++) {
+        scatter[r][c] += d[r] * d[c];
+      }
+    }
+  }
+  return true;
+}
+/*//}*/
+
+/*//{ edgeKernel() */
+// as fitEdgeCorrespondence(): a line if the largest eigenvalue of the scatter is larger than 3 times the middle one
+__global__ void edgeKernel(const float4 *points, const int *neighbors, const int count, EdgeFit *fits) {
+  const int i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i >= count) {
+    return;
+  }
+
+  EdgeFit fit;
+  fit.valid = 0;
+
+  float center[3];
+  float scatter[3][3];
+  if (neighborhoodMoments(points, neighbors + NEIGHBORS * i, center, scatter)) {
+    float eigenvalues[3];
+    float eigenvectors[3][3];
+    symmetricEigen(scatter, eigenvalues, eigenvectors);
+
+    fit.valid = eigenvalues[2] > 3.0f * eigenvalues[1];
+    for (int k = 0; k < 3; k++) {
+      fit.center[k]    = center[k];
+      fit.direction[k] = eigenvectors[k][2];
+    }
+  }
+  fits[i] = fit;
+}
+/*//}*/
+
+/*//{ planeKernel() */
+// as fitPlaneCorrespondence(): the normal is the eigenvector of the smallest eigenvalue of the scatter (instead of the least squares solution of
+// n * p = -1, which is ill-conditioned far from the origin), the plane is rejected if any neighbor is farther than 0.2 m from it
+__global__ void planeKernel(const float4 *points, const int *neighbors, const int count, PlaneFit *fits) {
+  const int i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i >= count) {
+    return;
+  }
+
+  PlaneFit fit;
+  fit.valid = 0;
+
+  float center[3];
+  float scatter[3][3];
+  if (neighborhoodMoments(points, neighbors + NEIGHBORS * i, center, scatter)) {
+    float eigenvalues[3];
+    float eigenvectors[3][3];
+    symmetricEigen(scatter, eigenvalues, eigenvectors);
+
+    const float n[3] = {eigenvectors[0][0], eigenvectors[1][0], eigenvectors[2][0]};
+
+    fit.valid = 1;
+    for (int m = 0; m < NEIGHBORS; m++) {
+      const float4 p = points[neighbors[NEIGHBORS * i + m]];
+      if (fabsf(n[0] * (p.x - center[0]) + n[1] * (p.y - center[1]) + n[2] * (p.z - center[2])) > 0.2f) {
+        fit.valid = 0;
+      }
+    }
+    for (int k = 0; k < 3; k++) {
+      fit.normal[k] = n[k];
+    }
+    fit.offset = -(n[0] * center[0] + n[1] * center[1] + n[2] * center[2]);
+  }
+  fits[i] = fit;
+}
+/*//}*/
+
+/*//{ gatherPoints() */
+void gatherPoints(const float *points, const std::size_t count, const std::size_t stride, std::vector<float4> &staging) {
+  staging.resize(count);
+  for (std::size_t i = 0; i < count; i++) {
+    const float *p = points + i * stride;
+    staging[i]     = make_float4(p[0], p[1], p[2], 0.0f);
+  }
+}
+/*//}*/
+
+}  // namespace
+
+/*//{ struct VoxelHashMap::Buffers */
+struct VoxelHashMap::Buffers
+{
+  DeviceBuffer<float4>             points;
+  DeviceBuffer<float4>             sorted;
+  DeviceBuffer<unsigned long long> keys;
+  DeviceBuffer<int>                order;
+  DeviceBuffer<unsigned long long> table_keys;
+  DeviceBuffer<int>                table_begin;
+  DeviceBuffer<int>                table_end;
+
+  DeviceBuffer<float4>   queries;
+  DeviceBuffer<int>      neighbors;
+  DeviceBuffer<EdgeFit>  edges;
+  DeviceBuffer<PlaneFit> planes;
+
+  std::vector<float4> staging;
+
+  std::size_t  size       = 0;
+  unsigned int table_mask = 0;
+};
+/*//}*/
+
+/*//{ VoxelHashMap() */
+VoxelHashMap::VoxelHashMap(const float radius) : _buffers(std::make_unique<Buffers>()), _radius(radius) {
+}
+/*//}*/
+
+/*//{ ~VoxelHashMap() */
+VoxelHashMap::~VoxelHashMap() = default;
+/*//}*/
+
+/*//{ build() */
+bool VoxelHashMap::build(const float *points, const std::size_t count, const std::size_t stride, std::string &error) {
+  Buffers &b = *_buffers;
+  b.size     = 0;
+  if (count == 0) {
+    return true;
+  }
+
+  // at most half of the slots are occupied (a voxel has at least one point)
+  std::size_t table_size = 1;
+  while (table_size < 2 * count) {
+    table_size <<= 1;
+  }
+
+  // clang-format off
+  const bool allocated =
+      cudaCheck(b.points.reserve(count), "cudaMalloc", error) &&
+      cudaCheck(b.sorted.reserve(count), "cudaMalloc", error) &&
+      cudaCheck(b.keys.reserve(count), "cudaMalloc", error) &&
+      cudaCheck(b.order.reserve(count), "cudaMalloc", error) &&
+      cudaCheck(b.table_keys.reserve(table_size), "cudaMalloc", error) &&
+      cudaCheck(b.table_begin.reserve(table_size), "cudaMalloc", error) &&
+      cudaCheck(b.table_end.reserve(table_size), "cudaMalloc", error);
+  // clang-format on
+  if (!allocated) {
+    return false;
+  }
+
+  gatherPoints(points, count, stride, b.staging);
+  if (!cudaCheck(cudaMemcpy(b.points.data(), b.staging.data(), count * sizeof(float4), cudaMemcpyHostToDevice), "cudaMemcpy", error) ||
+      !cudaCheck(cudaMemset(b.table_keys.data(), 0xff, table_size * sizeof(unsigned long long)), "cudaMemset", error)) {
+    return false;
+  }
+
+  const float inv_voxel_size = 1.0f / _radius;
+  keysKernel<<<blocks(count, THREADS), THREADS>>>(b.points.data(), int(count), inv_voxel_size, b.keys.data(), b.order.data());
+  try {
+    thrust::sort_by_key(thrust::device, b.keys.data(), b.keys.data() + count, b.order.data());
+  }
+  catch (const std::exception &e) {
+    error = std::string("sorting the map: ") + e.what();
+    return false;
+  }
+  gatherKernel<<<blocks(count, THREADS), THREADS>>>(b.points.data(), b.order.data(), int(count), b.sorted.data());
+  insertKernel<<<blocks(count, THREADS), THREADS>>>(b.keys.data(), int(count), (unsigned int)(table_size - 1), b.table_keys.data(), b.table_begin.data(),
+                                                    b.table_end.data());
+  if (!cudaCheck(cudaGetLastError(), "map kernels", error) || !cudaCheck(cudaDeviceSynchronize(), "map kernels", error)) {
+    return false;
+  }
+
+  b.size       = count;
+  b.table_mask = (unsigned int)(table_size - 1);
+  return true;
+}
+/*//}*/
+
+/*//{ size() */
+std::size_t VoxelHashMap::size() const {
+  return _buffers->size;
+}
+/*//}*/
+
+/*//{ findNeighbors() */
+bool VoxelHashMap::findNeighbors(const float *queries, const std::size_t count, const std::size_t stride, std::string &error) {
+  Buffers &b = *_buffers;
+
+  if (!cudaCheck(b.queries.reserve(count), "cudaMalloc", error) || !cudaCheck(b.neighbors.reserve(NEIGHBORS * count), "cudaMalloc", error)) {
+    return false;
+  }
+
+  gatherPoints(queries, count, stride, b.staging);
+  if (!cudaCheck(cudaMemcpy(b.queries.data(), b.staging.data(), count * sizeof(float4), cudaMemcpyHostToDevice), "cudaMemcpy", error)) {
+    return false;
+  }
+
+  neighborsKernel<<<blocks(count, THREADS), THREADS>>>(b.queries.data(), int(count), b.sorted.data(), b.table_keys.data(), b.table_begin.data(),
+                                                       b.table_end.data(), b.table_mask, 1.0f / _radius, _radius * _radius, b.neighbors.data());
+  return cudaCheck(cudaGetLastError(), "neighbors kernel", error);
+}
+/*//}*/
+
+/*//{ fitEdges() */
+bool VoxelHashMap::fitEdges(const float *queries, const std::size_t count, const std::size_t stride, EdgeFit *fits, std::string &error) {
+  Buffers &b = *_buffers;
+  if (count == 0) {
+    return true;
+  }
+  if (b.size == 0) {
+    for (std::size_t i = 0; i < count; i++) {
+      fits[i].valid = 0;
+    }
+    return true;
+  }
+
+  if (!cudaCheck(b.edges.reserve(count), "cudaMalloc", error) || !findNeighbors(queries, count, stride, error)) {
+    return false;
+  }
+  edgeKernel<<<blocks(count, THREADS), THREADS>>>(b.sorted.data(), b.neighbors.data(), int(count), b.edges.data());
+  return cudaCheck(cudaGetLastError(), "edge kernel", error) &&
+         cudaCheck(cudaMemcpy(fits, b.edges.data(), count * sizeof(EdgeFit), cudaMemcpyDeviceToHost), "cudaMemcpy", error);
+}
+/*//}*/
+
+/*//{ fitPlanes() */
+bool VoxelHashMap::fitPlanes(const float *queries, const std::size_t count, const std::size_t stride, PlaneFit *fits, std::string &error) {
+  Buffers &b = *_buffers;
+  if (count == 0) {
+    return true;
+  }
+  if (b.size == 0) {
+    for (std::size_t i = 0; i < count; i++) {
+      fits[i].valid = 0;
+    }
+    return true;
+  }
+
+  if (!cudaCheck(b.planes.reserve(count), "cudaMalloc", error) || !findNeighbors(queries, count, stride, error)) {
+    return false;
+  }
+  planeKernel<<<blocks(count, THREADS), THREADS>>>(b.sorted.data(), b.neighbors.data(), int(count), b.planes.data());
+  return cudaCheck(cudaGetLastError(), "plane kernel", error) &&
+         cudaCheck(cudaMemcpy(fits, b.planes.data(), count * sizeof(PlaneFit), cudaMemcpyDeviceToHost), "cudaMemcpy", error);
+}
+/*//}*/
+
+}  // namespace gpu
+
+}  // namespace aloam_slam
@@ -0,0 +1,161 @@
+#include "aloam_slam/voxel_index.h"
+
+namespace aloam_slam
+{
+
+/*//{ VoxelIndex() */
+VoxelIndex::VoxelIndex(const float cube_size, const float resolution) : _cube_size_half(cube_size / 2.0f) {
+  _voxels_per_cube = std::max(1, int(std::round(cube_size / resolution)));
+  _resolution      = cube_size / float(_voxels_per_cube);
+}
+/*//}*/
+
+/*//{ setCube() */
+void VoxelIndex::setCube(const CubeKey &cube, const pcl::PointCloud<PointType> &points) {
+  removeCube(cube);
+
+  // voxels of the cube (clamping keeps points rounded over the cube border inside of the cube)
+  const int i_min = cube.i * _voxels_per_cube;
+  const int j_min = cube.j * _voxels_per_cube;
+  const int k_min = cube.k * _voxels_per_cube;
+  const int i_max = i_min + _voxels_per_cube - 1;
+  const int j_max = j_min + _voxels_per_cube - 1;
+  const int k_max = k_min + _voxels_per_cube - 1;
+
+  std::vector<CubeKey> &cube_voxels = _cube_voxels[cube];
+
+  for (const auto &point : points.points) {
+    CubeKey key = getVoxelKey(point.x, point.y, point.z);
+    key.i       = std::clamp(key.i, i_min, i_max);
+    key.j       = std::clamp(key.j, j_min, j_max);
+    key.k       = std::clamp(key.k, k_min, k_max);
+
+    std::vector<PointType> &voxel = _voxels[key];
+    if (voxel.empty()) {
+      cube_voxels.push_back(key);
+    }
+    voxel.push_back(point);
+  }
+
+  _points_count += points.size();
+}
+/*//}*/
+
+/*//{ removeCube() */
+void VoxelIndex::removeCube(const CubeKey &cube) {
+  const auto it = _cube_voxels.find(cube);
+  if (it == _cube_voxels.end()) {
+    return;
+  }
+
+  for (const auto &key : it->second) {
+    const auto it_voxel = _voxels.find(key);
+    if (it_voxel != _voxels.end()) {
+      _points_count -= it_voxel->second.size();
+      _voxels.erase(it_voxel);
+    }
+  }
+
+  _cube_voxels.erase(it);
+}
+/*//}*/
+
+/*//{ clear() */
+void VoxelIndex::clear() {
+  _voxels.clear();
+  _cube_voxels.clear();
+  _points_count = 0;
+}
+/*//}*/
+
+/*//{ nearestKSearch() */
+int VoxelIndex::nearestKSearch(const PointType &point, const int k, std::vector<PointType> &neighbors, std::vector<float> &sq_distances) const {
+  neighbors.clear();
+  sq_distances.clear();
+
+  if (k <= 0) {
+    return 0;
+  }
+
+  const auto visitVoxel = [&](const CubeKey &key) {
+    const auto it = _voxels.find(key);
+    if (it == _voxels.end()) {
+      return;
+    }
+
+    for (const auto &candidate : it->second) {
+      const float diffX   = candidate.x - point.x;
+      const float diffY   = candidate.y - point.y;
+      const float diffZ   = candidate.z - point.z;
+      const float sq_dist = diffX * diffX + diffY * diffY + diffZ * diffZ;
+
+      if (int(sq_distances.size()) == k && sq_dist >= sq_distances.back()) {
+        continue;
+      }
+
+      // insertion into the sorted list of k best candidates
+      if (int(sq_distances.size()) < k) {
+        sq_distances.push_back(sq_dist);
+        neighbors.push_back(candidate);
+      }
+      int pos = int(sq_distances.size()) - 1;
+      while (pos > 0 && sq_distances.at(pos - 1) > sq_dist) {
+        sq_distances.at(pos) = sq_distances.at(pos - 1);
+        neighbors.at(pos)    = neighbors.at(pos - 1);
+        pos--;
+      }
+      sq_distances.at(pos) = sq_dist;
+      neighbors.at(pos)    = candidate;
+    }
+  };
+
+  const CubeKey center = getVoxelKey(point.x, point.y, point.z);
+  visitVoxel(center);
+
+  // squared distance of the point to the voxel boundaries in the negative and positive direction of each axis
+  const float lo_x = point.x + _cube_size_half - float(center.i) * _resolution;
+  const float lo_y = point.y + _cube_size_half - float(center.j) * _resolution;
+  const float lo_z = point.z + _cube_size_half - float(center.k) * _resolution;
+  const float d_x[3] = {lo_x * lo_x, 0.0f, (_resolution - lo_x) * (_resolution - lo_x)};
+  const float d_y[3] = {lo_y * lo_y, 0.0f, (_resolution - lo_y) * (_resolution - lo_y)};
+  const float d_z[3] = {lo_z * lo_z, 0.0f, (_resolution - lo_z) * (_resolution - lo_z)};
+
+  for (int i = -1; i <= 1; i++) {
+    for (int j = -1; j <= 1; j++) {
+      for (int l = -1; l <= 1; l++) {
+        if (i == 0 && j == 0 && l == 0) {
+          continue;
+        }
+
+        // skip voxels which cannot contain closer point than the current k-th neighbor
+        const float sq_dist_voxel = d_x[i + 1] + d_y[j + 1] + d_z[l + 1];
+        if (int(sq_distances.size()) == k && sq_dist_voxel >= sq_distances.back()) {
+          continue;
+        }
+
+        visitVoxel({center.i + i, center.j + j, center.k + l});
+      }
+    }
+  }
+
+  return int(neighbors.size());
+}
+/*//}*/
+
+/*//{ size() */
+std::size_t VoxelIndex::size() const {
+  return _points_count;
+}
+/*//}*/
+
+/*//{ getVoxelKey() */
+CubeKey VoxelIndex::getVoxelKey(const float x, const float y, const float z) const {
+  CubeKey key;
+  key.i = int(std::floor((x + _cube_size_half) / _resolution));
+  key.j = int(std::floor((y + _cube_size_half) / _resolution));
+  key.k = int(std::floor((z + _cube_size_half) / _resolution));
+  return key;
+}
+/*//}*/
+
+}  // namespace aloam_slam
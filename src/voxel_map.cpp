@@ -0,0 +1,355 @@
+#include "aloam_slam/voxel_map.h"
+#include "aloam_slam/voxel_index.h"
+
+namespace aloam_slam
+{
+
+/*//{ VoxelMap() */
+VoxelMap::VoxelMap(const float cube_size, const int eviction_radius_xy, const int eviction_radius_z)
+    : _cube_size(cube_size), _cube_size_half(cube_size / 2.0f), _eviction_radius_xy(eviction_radius_xy), _eviction_radius_z(eviction_radius_z) {
+  // downsampling replaces the clouds of the modified cubes, the replaced clouds are reused by the next downsampling
+  _cloud_pool = std::make_shared<CloudPool>(64);
+}
+/*//}*/
+
+/*//{ attachIndices() */
+void VoxelMap::attachIndices(const std::shared_ptr<VoxelIndex> &index_corners, const std::shared_ptr<VoxelIndex> &index_surfs) {
+  _index_corners = index_corners;
+  _index_surfs   = index_surfs;
+
+  for (const auto &[key, cube] : _cubes) {
+    if (_index_corners) {
+      _index_corners->setCube(key, *cube.corners);
+    }
+    if (_index_surfs) {
+      _index_surfs->setCube(key, *cube.surfs);
+    }
+  }
+}
+/*//}*/
+
+/*//{ setCubeLoader() */
+void VoxelMap::setCubeLoader(const CubeLoader &loader) {
+  _cube_loader = loader;
+}
+/*//}*/
+
+/*//{ getKey() */
+CubeKey VoxelMap::getKey(const float x, const float y, const float z) const {
+  CubeKey key;
+  key.i = int(std::floor((x + _cube_size_half) / _cube_size));
+  key.j = int(std::floor((y + _cube_size_half) / _cube_size));
+  key.k = int(std::floor((z + _cube_size_half) / _cube_size));
+  return key;
+}
+/*//}*/
+
+/*//{ insertCorner() */
+void VoxelMap::insertCorner(const PointType &point) {
+  const CubeKey key = getKey(point.x, point.y, point.z);
+  getOrCreatePending(key).corners->push_back(point);
+}
+/*//}*/
+
+/*//{ insertSurf() */
+void VoxelMap::insertSurf(const PointType &point) {
+  const CubeKey key = getKey(point.x, point.y, point.z);
+  getOrCreatePending(key).surfs->push_back(point);
+}
+/*//}*/
+
+/*//{ getNeighborhood() */
+std::vector<CubeKey> VoxelMap::getNeighborhood(const CubeKey &center, const int radius_xy, const int radius_z) const {
+  std::vector<CubeKey> keys;
+  keys.reserve((2 * radius_xy + 1) * (2 * radius_xy + 1) * (2 * radius_z + 1));
+
+  for (int i = center.i - radius_xy; i <= center.i + radius_xy; i++) {
+    for (int j = center.j - radius_xy; j <= center.j + radius_xy; j++) {
+      for (int k = center.k - radius_z; k <= center.k + radius_z; k++) {
+        const CubeKey key{i, j, k};
+        if (_cubes.find(key) != _cubes.end()) {
+          keys.push_back(key);
+        }
+      }
+    }
+  }
+
+  return keys;
+}
+/*//}*/
+
+/*//{ getFeatures() */
+void VoxelMap::getFeatures(const std::vector<CubeKey> &keys, pcl::PointCloud<PointType> &corners, pcl::PointCloud<PointType> &surfs) const {
+  for (const auto &key : keys) {
+    const auto it = _cubes.find(key);
+    if (it == _cubes.end()) {
+      continue;
+    }
+    corners += *it->second.corners;
+    surfs += *it->second.surfs;
+  }
+}
+/*//}*/
+
+/*//{ getMap() */
+void VoxelMap::getMap(pcl::PointCloud<PointType> &cloud) const {
+  for (const auto &[key, cube] : _cubes) {
+    cloud += *cube.corners;
+    cloud += *cube.surfs;
+  }
+}
+/*//}*/
+
+/*//{ downsampleModified() */
+void VoxelMap::downsampleModified(pcl::VoxelGrid<PointType> &filter_corners, pcl::VoxelGrid<PointType> &filter_surfs) {
+  std::vector<CubeUpdate> updates = takeModified();
+  downsample(updates, filter_corners, filter_surfs);
+  replaceCubes(updates);
+}
+/*//}*/
+
+/*//{ takeModified() */
+std::vector<CubeUpdate> VoxelMap::takeModified() {
+  std::vector<CubeUpdate> updates;
+  updates.reserve(_pending_cubes.size());
+  for (auto &[key, inserted] : _pending_cubes) {
+    CubeUpdate update;
+    update.key      = key;
+    update.epoch    = _epoch;
+    update.inserted = inserted;
+
+    const auto it = _cubes.find(key);
+    if (it != _cubes.end()) {
+      update.version = it->second.version;
+      update.cube    = it->second;
+    }
+
+    updates.push_back(update);
+  }
+  _pending_cubes.clear();
+  return updates;
+}
+/*//}*/
+
+/*//{ downsample() */
+void VoxelMap::downsample(std::vector<CubeUpdate> &updates, pcl::VoxelGrid<PointType> &filter_corners, pcl::VoxelGrid<PointType> &filter_surfs) const {
+  const auto downsampleCloud = [this](pcl::VoxelGrid<PointType> &filter, const pcl::PointCloud<PointType>::Ptr &current,
+                                      const pcl::PointCloud<PointType>::Ptr &inserted) {
+    const pcl::PointCloud<PointType>::Ptr merged = _cloud_pool->acquire();
+    if (current) {
+      *merged = *current;
+    }
+    *merged += *inserted;
+
+    const pcl::PointCloud<PointType>::Ptr filtered = _cloud_pool->acquire();
+    filter.setInputCloud(merged);
+    filter.filter(*filtered);
+    return filtered;
+  };
+
+  for (auto &update : updates) {
+    update.cube.corners = downsampleCloud(filter_corners, update.cube.corners, update.inserted.corners);
+    update.cube.surfs   = downsampleCloud(filter_surfs, update.cube.surfs, update.inserted.surfs);
+    update.inserted     = MapCube();
+  }
+}
+/*//}*/
+
+/*//{ replaceCubes() */
+void VoxelMap::replaceCubes(const std::vector<CubeUpdate> &updates) {
+  for (const auto &update : updates) {
+    // the map might have been cleared or the cube evicted in the meantime
+    if (update.epoch != _epoch || (_has_eviction_center && isOutOfEvictionRadius(update.key, _eviction_center))) {
+      continue;
+    }
+
+    // the cube was added or replaced since the update was taken, its clouds do not contain the current points of the cube
+    const auto it = _cubes.find(update.key);
+    if ((it != _cubes.end() ? it->second.version : 0) != update.version) {
+      MapCube &pending = getOrCreatePending(update.key);
+      *pending.corners += *update.cube.corners;
+      *pending.surfs += *update.cube.surfs;
+      continue;
+    }
+
+    MapCube &cube = _cubes[update.key];
+    cube.corners  = update.cube.corners;
+    cube.surfs    = update.cube.surfs;
+    cube.version  = _next_version++;
+    cube.modified = true;
+
+    if (_track_changes) {
+      _changed_cubes.insert(update.key);
+      _removed_cubes.erase(update.key);
+    }
+
+    if (_index_corners) {
+      _index_corners->setCube(update.key, *cube.corners);
+    }
+    if (_index_surfs) {
+      _index_surfs->setCube(update.key, *cube.surfs);
+    }
+  }
+}
+/*//}*/
+
+/*//{ setTrackChanges() */
+void VoxelMap::setTrackChanges(const bool track_changes) {
+  _track_changes = track_changes;
+  if (!_track_changes) {
+    _changed_cubes.clear();
+    _removed_cubes.clear();
+  }
+}
+/*//}*/
+
+/*//{ takeChanges() */
+void VoxelMap::takeChanges(std::vector<std::pair<CubeKey, MapCube>> &changed, std::vector<CubeKey> &removed) {
+  changed.clear();
+  removed.clear();
+
+  changed.reserve(_changed_cubes.size());
+  for (const auto &key : _changed_cubes) {
+    const auto it = _cubes.find(key);
+    if (it != _cubes.end()) {
+      changed.emplace_back(key, it->second);
+    }
+  }
+  removed.assign(_removed_cubes.begin(), _removed_cubes.end());
+
+  _changed_cubes.clear();
+  _removed_cubes.clear();
+}
+/*//}*/
+
+/*//{ getCubes() */
+void VoxelMap::getCubes(std::vector<std::pair<CubeKey, MapCube>> &cubes) const {
+  cubes.assign(_cubes.begin(), _cubes.end());
+}
+/*//}*/
+
+/*//{ addCubes() */
+void VoxelMap::addCubes(const std::vector<std::pair<CubeKey, MapCube>> &cubes) {
+  for (const auto &[key, cube] : cubes) {
+    if (_cubes.find(key) != _cubes.end() || (_has_eviction_center && isOutOfEvictionRadius(key, _eviction_center))) {
+      continue;
+    }
+
+    MapCube &added = _cubes[key];
+    added.corners  = cube.corners;
+    added.surfs    = cube.surfs;
+    added.version  = _next_version++;
+    added.modified = false;
+
+    if (_track_changes) {
+      _changed_cubes.insert(key);
+      _removed_cubes.erase(key);
+    }
+
+    if (_index_corners) {
+      _index_corners->setCube(key, *added.corners);
+    }
+    if (_index_surfs) {
+      _index_surfs->setCube(key, *added.surfs);
+    }
+  }
+}
+/*//}*/
+
+/*//{ contains() */
+bool VoxelMap::contains(const CubeKey &key) const {
+  return _cubes.find(key) != _cubes.end();
+}
+/*//}*/
+
+/*//{ evict() */
+void VoxelMap::evict(const CubeKey &center, std::vector<std::pair<CubeKey, MapCube>> &evicted_modified) {
+  if ((_eviction_radius_xy <= 0 && _eviction_radius_z <= 0) || (_has_eviction_center && center == _eviction_center)) {
+    return;
+  }
+
+  _has_eviction_center = true;
+  _eviction_center     = center;
+
+  for (auto it = _cubes.begin(); it != _cubes.end();) {
+    const CubeKey &key = it->first;
+
+    if (isOutOfEvictionRadius(key, center)) {
+      if (_index_corners) {
+        _index_corners->removeCube(key);
+      }
+      if (_index_surfs) {
+        _index_surfs->removeCube(key);
+      }
+      _pending_cubes.erase(key);
+      if (_track_changes) {
+        _changed_cubes.erase(key);
+        _removed_cubes.insert(key);
+      }
+      if (it->second.modified) {
+        evicted_modified.emplace_back(key, it->second);
+      }
+      it = _cubes.erase(it);
+    } else {
+      it++;
+    }
+  }
+}
+/*//}*/
+
+/*//{ clear() */
+void VoxelMap::clear() {
+  if (_index_corners) {
+    _index_corners->clear();
+  }
+  if (_index_surfs) {
+    _index_surfs->clear();
+  }
+  if (_track_changes) {
+    for (const auto &[key, cube] : _cubes) {
+      _removed_cubes.insert(key);
+    }
+  }
+  _cubes.clear();
+  _pending_cubes.clear();
+  _changed_cubes.clear();
+  _epoch++;
+}
+/*//}*/
+
+/*//{ size() */
+std::size_t VoxelMap::size() const {
+  return _cubes.size();
+}
+/*//}*/
+
+/*//{ isOutOfEvictionRadius() */
+bool VoxelMap::isOutOfEvictionRadius(const CubeKey &key, const CubeKey &center) const {
+  const bool out_xy = _eviction_radius_xy > 0 && (std::abs(key.i - center.i) > _eviction_radius_xy || std::abs(key.j - center.j) > _eviction_radius_xy);
+  const bool out_z  = _eviction_radius_z > 0 && std::abs(key.k - center.k) > _eviction_radius_z;
+  return out_xy || out_z;
+}
+/*//}*/
+
+/*//{ getOrCreatePending() */
+MapCube &VoxelMap::getOrCreatePending(const CubeKey &key) {
+  auto it = _pending_cubes.find(key);
+  if (it == _pending_cubes.end()) {
+    // the stored cube is loaded first, the inserted points are then merged into it
+    if (_cube_loader && _cubes.find(key) == _cubes.end()) {
+      MapCube stored;
+      if (_cube_loader(key, stored)) {
+        addCubes({{key, stored}});
+      }
+    }
+
+    MapCube cube;
+    cube.corners = _cloud_pool->acquire();
+    cube.surfs   = _cloud_pool->acquire();
+    it           = _pending_cubes.emplace(key, cube).first;
+  }
+  return it->second;
+}
+/*//}*/
+
+}  // namespace aloam_slam
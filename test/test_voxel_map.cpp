@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "aloam_slam/voxel_map.h"
+#include "aloam_slam/map_file.h"
+
+using namespace aloam_slam;
+
+namespace
+{
+
+const float   CUBE_SIZE = 10.0f;
+const CubeKey KEY{0, 0, 0};
+
+/*//{ makePoint() */
+PointType makePoint(const float x, const float y, const float z) {
+  PointType point;
+  point.x         = x;
+  point.y         = y;
+  point.z         = z;
+  point.intensity = 0.0f;
+  return point;
+}
+/*//}*/
+
+/*//{ makeCube() */
+// the cube KEY with `corners` corners and `surfs` surfs 1 m apart
+MapCube makeCube(CloudPool &cloud_pool, const int corners, const int surfs) {
+  MapCube cube;
+  cube.corners = cloud_pool.acquire();
+  cube.surfs   = cloud_pool.acquire();
+  for (int i = 0; i < corners; i++) {
+    cube.corners->push_back(makePoint(-4.0f + i, -4.0f, 0.0f));
+  }
+  for (int i = 0; i < surfs; i++) {
+    cube.surfs->push_back(makePoint(-4.0f + i, 4.0f, 0.0f));
+  }
+  return cube;
+}
+/*//}*/
+
+/*//{ downsample() */
+void downsample(VoxelMap &map) {
+  pcl::VoxelGrid<PointType> filter_corners;
+  pcl::VoxelGrid<PointType> filter_surfs;
+  filter_corners.setLeafSize(0.1f, 0.1f, 0.1f);
+  filter_surfs.setLeafSize(0.1f, 0.1f, 0.1f);
+  map.downsampleModified(filter_corners, filter_surfs);
+}
+/*//}*/
+
+}  // namespace
+
+/*//{ TEST(VoxelMap, InsertionIntoStreamedTileKeepsTile) */
+// the features inserted into a tile of the map file which is not loaded are merged into the tile, also after saving the map
+TEST(VoxelMap, InsertionIntoStreamedTileKeepsTile) {
+  CloudPool         cloud_pool(8);
+  std::string       error;
+  const std::string path = ::testing::TempDir() + "aloam_test_voxel_map.bin";
+
+  ASSERT_TRUE(saveMapFile(path, CUBE_SIZE, {{KEY, makeCube(cloud_pool, 2, 1)}}, error)) << error;
+
+  MappedMapFile map_file;
+  ASSERT_TRUE(map_file.open(path, error)) << error;
+
+  VoxelMap map(CUBE_SIZE, 0, 0);
+  map.setCubeLoader([&](const CubeKey &key, MapCube &cube) { return map_file.readCube(key, cloud_pool, cube); });
+  map.insertCorner(makePoint(1.0f, 1.0f, 1.0f));
+  downsample(map);
+
+  std::vector<std::pair<CubeKey, MapCube>> cubes;
+  map.getCubes(cubes);
+  ASSERT_EQ(cubes.size(), 1u);
+  EXPECT_EQ(cubes.front().second.corners->size(), 3u);
+  EXPECT_EQ(cubes.front().second.surfs->size(), 1u);
+
+  map_file.close();
+  ASSERT_TRUE(saveMapFile(path, CUBE_SIZE, cubes, error)) << error;
+  ASSERT_TRUE(map_file.open(path, error)) << error;
+
+  MapCube saved;
+  ASSERT_TRUE(map_file.readCube(KEY, cloud_pool, saved));
+  EXPECT_EQ(saved.corners->size(), 3u);
+  EXPECT_EQ(saved.surfs->size(), 1u);
+
+  map_file.close();
+  std::remove(path.c_str());
+}
+/*//}*/
+
+/*//{ TEST(VoxelMap, CubeAddedWhileDownsamplingIsNotOverwritten) */
+// a cube streamed into the map between takeModified() and replaceCubes() keeps its points, the inserted points are merged into it later
+TEST(VoxelMap, CubeAddedWhileDownsamplingIsNotOverwritten) {
+  CloudPool cloud_pool(8);
+  VoxelMap  map(CUBE_SIZE, 0, 0);
+
+  pcl::VoxelGrid<PointType> filter_corners;
+  pcl::VoxelGrid<PointType> filter_surfs;
+  filter_corners.setLeafSize(0.1f, 0.1f, 0.1f);
+  filter_surfs.setLeafSize(0.1f, 0.1f, 0.1f);
+
+  map.insertCorner(makePoint(1.0f, 1.0f, 1.0f));
+  std::vector<CubeUpdate> updates = map.takeModified();
+  map.downsample(updates, filter_corners, filter_surfs);
+
+  map.addCubes({{KEY, makeCube(cloud_pool, 2, 1)}});
+  map.replaceCubes(updates);
+
+  std::vector<std::pair<CubeKey, MapCube>> cubes;
+  map.getCubes(cubes);
+  ASSERT_EQ(cubes.size(), 1u);
+  EXPECT_EQ(cubes.front().second.corners->size(), 2u);
+
+  downsample(map);
+  map.getCubes(cubes);
+  ASSERT_EQ(cubes.size(), 1u);
+  EXPECT_EQ(cubes.front().second.corners->size(), 3u);
+  EXPECT_EQ(cubes.front().second.surfs->size(), 1u);
+}
+/*//}*/
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}